@@ -10,6 +10,7 @@
 #include <windows.h>
 
 #include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLRateAdapter.h"
 
 #define MINDELTAT 1.0e-10
 
@@ -79,6 +80,20 @@ void initialize_dll_outputs (Wrapped_IEEE_Cigre_DLL *pWrap, double x[])
   }
 }
 
+/* Runs the model steps due by atp_time through the rate adapter. ATP/MODELS has no way to stop
+   the run, so on a model error this prints it and returns 0, and the caller finalizes the model.
+*/
+int step_dll_rate_adapter (DLLRateAdapter *pAdapter, double atp_time, double xin[], double xout[])
+{
+  Wrapped_IEEE_Cigre_DLL *pWrap = pAdapter->pWrap;
+  if (DLLRateAdapterStep (pAdapter, atp_time, xin, xout) < IEEE_Cigre_DLLInterface_Return_Error) {
+    return 1;
+  }
+  printf ("DLL: *** %s failed at t=%g: %s\n", pWrap->pInfo->ModelName, atp_time,
+          NULL != pWrap->pModel->LastErrorMessage ? pWrap->pModel->LastErrorMessage : "");
+  return 0;
+}
+
 void transfer_dll_parameters (Wrapped_IEEE_Cigre_DLL *pWrap, double x[])
 {
   int i, iParm;
@@ -116,6 +131,7 @@ void transfer_dll_parameters (Wrapped_IEEE_Cigre_DLL *pWrap, double x[])
 */
 
 static Wrapped_IEEE_Cigre_DLL *pSCRX9 = NULL;
+static DLLRateAdapter *pSCRX9Rate = NULL;  // ATP steps faster than the 5 ms exciter
 
 void dll_scrx9_i__(double xdata_ar[],
                    double xin_ar[],
@@ -142,8 +158,6 @@ void dll_scrx9_m__(double xdata_ar[],
                    double xout_ar[],
                    double xvar_ar[])
 {
-  int i;
-  static double next_time = 0.0;
   double atp_time = xin_ar[7];
   double atp_stop = xin_ar[8];
 //  printf ("Executing model 'scrx9'\n");
@@ -162,22 +176,24 @@ void dll_scrx9_m__(double xdata_ar[],
     transfer_dll_parameters (pSCRX9, xdata_ar);
     pSCRX9->Model_CheckParameters (pSCRX9->pModel);
     pSCRX9->Model_Initialize (pSCRX9->pModel);
+    FreeDLLRateAdapter (pSCRX9Rate);
+    if ((pSCRX9Rate = CreateDLLRateAdapter (pSCRX9, DLL_RATE_INPUT_LINEAR, DLL_RATE_OUTPUT_HOLD)) == NULL) {
+      printf ("DLL: *** Failed to initialize pSCRX9\n");
+      FreeFirstDLLModel (pSCRX9);
+      pSCRX9 = NULL;
+      return;
+    }
   }
 
-  while (atp_time >= next_time) {
-//    printf("  trying a step at %lf with %lf, %lf\n", atp_time, xin_ar[0], xin_ar[1]);
-    transfer_dll_inputs (pSCRX9, xin_ar);
-//    printf("  transferred inputs\n");
-    pSCRX9->pModel->Time = next_time;
-    pSCRX9->Model_Outputs (pSCRX9->pModel);
-//    printf("  called the DLL step\n");
-    extract_dll_outputs (pSCRX9, xout_ar);
-//    printf("  extracted output %lf\n", xout_ar[0]);
-    next_time += pSCRX9->pInfo->FixedStepBaseSampleTime;
+  // runs the model steps due by atp_time, with inputs interpolated between ATP steps
+  if (!step_dll_rate_adapter (pSCRX9Rate, atp_time, xin_ar, xout_ar)) {
+    atp_stop = atp_time;
   }
 
   if (atp_time >= atp_stop - MINDELTAT) {
 //    printf("Reached the end of DLL execution\n");
+    FreeDLLRateAdapter (pSCRX9Rate);
+    pSCRX9Rate = NULL;
     FreeFirstDLLModel (pSCRX9);
 //    printf("  freed the model\n");
     pSCRX9 = NULL;
@@ -198,6 +214,7 @@ void dll_scrx9_m__(double xdata_ar[],
 #define JSON_FILE5 "C:\\src\\pecblocks\\examples\\hwpv\\bal3n\\bal3n_fhf.json"
 
 static Wrapped_IEEE_Cigre_DLL *pHWPV = NULL;
+static DLLRateAdapter *pHWPVRate = NULL;  // ATP usually steps faster than the model
 
 void dll_hwpv_i__(double xdata_ar[],
                   double xin_ar[],
@@ -206,14 +223,11 @@ void dll_hwpv_i__(double xdata_ar[],
 {
   char *pData;
   if ((pHWPV = CreateFirstDLLModel("HWPV.dll")) != NULL) {
-    // overwrite default JSON file with an actual one, knowing this is parameter 0
+    // overwrite default JSON file with an actual one, found by name
     union EditValueU val;
+    DLLPortHandle hJSON = GetParameterHandle (pHWPV, "JSONfile");
     val.Char_Ptr = JSON_FILE5;
-    edit_dll_value ((char *)pHWPV->pModel->Parameters, 
-                      pHWPV->pParameterMap[0].offset, 
-                      pHWPV->pParameterMap[0].dtype, 
-                      pHWPV->pParameterMap[0].size,
-                      val);
+    edit_dll_value ((char *)pHWPV->pModel->Parameters, hJSON.offset, hJSON.dtype, hJSON.size, val);
     if (NULL != pHWPV->Model_FirstCall) {
       pHWPV->Model_FirstCall (pHWPV->pModel);
     }
@@ -221,6 +235,10 @@ void dll_hwpv_i__(double xdata_ar[],
     // DO NOT CALL the generic transfer_dll_parameters (pHWPV, xdata_ar);
     pHWPV->Model_CheckParameters (pHWPV->pModel);  
     pHWPV->Model_Initialize (pHWPV->pModel);
+    if ((pHWPVRate = CreateDLLRateAdapter (pHWPV, DLL_RATE_INPUT_LINEAR, DLL_RATE_OUTPUT_HOLD)) == NULL) {
+      FreeFirstDLLModel (pHWPV);
+      pHWPV = NULL;
+    }
   }
   if (pHWPV != NULL) {
     //printf ("DLL: Initialized pHWPV\n");
@@ -235,23 +253,20 @@ void dll_hwpv_m__(double xdata_ar[],
                   double xout_ar[],
                   double xvar_ar[])
 {
-  int i;
-  static double next_time = 0.0;
   double atp_time = xin_ar[9];
   double atp_stop = xin_ar[10];
   if (NULL == pHWPV) {
     return;
   }
 
-  while (atp_time >= next_time) {
-    transfer_dll_inputs (pHWPV, xin_ar);
-    pHWPV->pModel->Time = next_time;
-    pHWPV->Model_Outputs (pHWPV->pModel);
-    extract_dll_outputs (pHWPV, xout_ar);
-    next_time += pHWPV->pInfo->FixedStepBaseSampleTime;
+  // runs the model steps due by atp_time, with inputs interpolated between ATP steps
+  if (!step_dll_rate_adapter (pHWPVRate, atp_time, xin_ar, xout_ar)) {
+    atp_stop = atp_time;
   }
 
   if (atp_time >= atp_stop - MINDELTAT) {
+    FreeDLLRateAdapter (pHWPVRate);
+    pHWPVRate = NULL;
     FreeFirstDLLModel (pHWPV);
     pHWPV = NULL;
     //printf ("DLL: Finalized pHWPV\n");
@@ -265,6 +280,7 @@ void dll_hwpv_m__(double xdata_ar[],
 */
 
 static Wrapped_IEEE_Cigre_DLL *pIBR = NULL;
+static DLLRateAdapter *pIBRRate = NULL;  // lets ATP step slower than the 10 us controller
 
 void dll_gfm_gfl_ibr_i__(double xdata_ar[],
                          double xin_ar[],
@@ -301,18 +317,15 @@ void dll_gfm_gfl_ibr_m__(double xdata_ar[],
                          double xvar_ar[])
 {
   int i;
-  static double next_time = 0.0;
   double atp_time = xin_ar[12];
   double atp_stop = xin_ar[13];
   if (NULL == pIBR) {
     return;
   }
 
-  // convert inputs to kV and kA
-  if (atp_time >= next_time) {
-    for (i=0; i < 9; i++) {
-      xin_ar[i] *= 0.001;
-    }
+  // convert inputs to kV and kA; every ATP sample goes into the input interpolation
+  for (i=0; i < 9; i++) {
+    xin_ar[i] *= 0.001;
   }
 
   if (atp_time <= 0.0) { // apply initial conditions here
@@ -324,18 +337,18 @@ void dll_gfm_gfl_ibr_m__(double xdata_ar[],
     transfer_dll_parameters (pIBR, xdata_ar);
     pIBR->Model_CheckParameters (pIBR->pModel);
     pIBR->Model_Initialize (pIBR->pModel);
+    FreeDLLRateAdapter (pIBRRate);  // ATP may start over at t=0
+    if ((pIBRRate = CreateDLLRateAdapter (pIBR, DLL_RATE_INPUT_LINEAR, DLL_RATE_OUTPUT_HOLD)) == NULL) {
+      printf ("DLL: *** Failed to initialize pIBR\n");
+      FreeFirstDLLModel (pIBR);
+      pIBR = NULL;
+      return;
+    }
   }
 
-  while (atp_time >= next_time) {
-    //printf("  trying a step at %lf with %lf, %lf\n", atp_time, xin_ar[0], xin_ar[1]);
-    transfer_dll_inputs (pIBR, xin_ar);
-    //printf("  transferred inputs\n");
-    pIBR->pModel->Time = next_time;
-    pIBR->Model_Outputs (pIBR->pModel);
-    //printf("  called the DLL step\n");
-    extract_dll_outputs (pIBR, xout_ar);
-    //printf("  extracted output %lf\n", xout_ar[0]);
-    next_time += pIBR->pInfo->FixedStepBaseSampleTime;
+  // runs the 10 us model steps due by atp_time, with inputs interpolated between ATP steps
+  if (!step_dll_rate_adapter (pIBRRate, atp_time, xin_ar, xout_ar)) {
+    atp_stop = atp_time;
   }
 
   // convert Ea, Eb, and Ec from kV to volts
@@ -344,6 +357,8 @@ void dll_gfm_gfl_ibr_m__(double xdata_ar[],
   }
 
   if (atp_time >= atp_stop - MINDELTAT) {
+    FreeDLLRateAdapter (pIBRRate);
+    pIBRRate = NULL;
     FreeFirstDLLModel (pIBR);
     pIBR = NULL;
     //printf ("DLL: Finalized pIBR\n");
@@ -357,6 +372,7 @@ void dll_gfm_gfl_ibr_m__(double xdata_ar[],
 */
 
 static Wrapped_IEEE_Cigre_DLL *pIBR2 = NULL;
+static DLLRateAdapter *pIBR2Rate = NULL;  // lets ATP step slower than the 10 us controller
 
 void dll_gfm_gfl_ibr2_i__(double xdata_ar[],
                          double xin_ar[],
@@ -383,20 +399,17 @@ void dll_gfm_gfl_ibr2_m__(double xdata_ar[],
                          double xvar_ar[])
 {
   int i;
-  static double next_time = 0.0;
   double atp_time = xin_ar[15];
   double atp_stop = xin_ar[16];
   if (NULL == pIBR2) {
     return;
   }
 
-  // convert inputs to kV, kA
-  if (atp_time >= next_time) {
-    for (i=0; i < 11; i++) {
-      xin_ar[i] *= 0.001;
-    }
-    xin_ar[13] *= 0.001;
+  // convert inputs to kV, kA; every ATP sample goes into the input interpolation
+  for (i=0; i < 11; i++) {
+    xin_ar[i] *= 0.001;
   }
+  xin_ar[13] *= 0.001;
 
   if (atp_time <= 0.0) { // apply initial conditions here
     initialize_dll_outputs (pIBR2, xout_ar);
@@ -404,18 +417,18 @@ void dll_gfm_gfl_ibr2_m__(double xdata_ar[],
     transfer_dll_parameters (pIBR2, xdata_ar);
     pIBR2->Model_CheckParameters (pIBR2->pModel);
     pIBR2->Model_Initialize (pIBR2->pModel);
+    FreeDLLRateAdapter (pIBR2Rate);
+    if ((pIBR2Rate = CreateDLLRateAdapter (pIBR2, DLL_RATE_INPUT_LINEAR, DLL_RATE_OUTPUT_HOLD)) == NULL) {
+      printf ("DLL: *** Failed to initialize pIBR2\n");
+      FreeFirstDLLModel (pIBR2);
+      pIBR2 = NULL;
+      return;
+    }
   }
 
-  while (atp_time >= next_time) {
-    //printf("  trying a step at %lf with %lf, %lf\n", atp_time, xin_ar[0], xin_ar[1]);
-    transfer_dll_inputs (pIBR2, xin_ar);
-    //printf("  transferred inputs\n");
-    pIBR2->pModel->Time = next_time;
-    pIBR2->Model_Outputs (pIBR2->pModel);
-    //printf("  called the DLL step\n");
-    extract_dll_outputs (pIBR2, xout_ar);
-    //printf("  extracted output %lf\n", xout_ar[0]);
-    next_time += pIBR2->pInfo->FixedStepBaseSampleTime;
+  // runs the 10 us model steps due by atp_time, with inputs interpolated between ATP steps
+  if (!step_dll_rate_adapter (pIBR2Rate, atp_time, xin_ar, xout_ar)) {
+    atp_stop = atp_time;
   }
 
   // convert m_a, m_b, and m_c from the modulation index to something else?
@@ -424,6 +437,8 @@ void dll_gfm_gfl_ibr2_m__(double xdata_ar[],
   }
 
   if (atp_time >= atp_stop - MINDELTAT) {
+    FreeDLLRateAdapter (pIBR2Rate);
+    pIBR2Rate = NULL;
     FreeFirstDLLModel (pIBR2);
     pIBR2 = NULL;
     //printf ("DLL: Finalized pIBR2\n");
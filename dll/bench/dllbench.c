@@ -0,0 +1,575 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Benchmark driver for any IEEE/Cigre model library. The inputs are driven by a synthetic stimulus
+instead of a simulated network, so the same command measures SCRX9, GFM_GFL_IBR, GFM_GFL_IBR2,
+HWPV or PPC. After the usual FirstCall, CheckParameters and Initialize, the model is stepped for
+the warm-up steps, then for several measured runs of the same length. Each run reports ns/step;
+the summary has the mean, variance, min, median and max over the runs, and steps/s from the mean.
+A separate loop times the stimulus alone, so its share of the host loop is known. With
+--instances n, every step drives n instances of the model with the same stimulus, through
+Model_Outputs one at a time, with --batch through DLLModelOutputsBatch, or with --threads through
+the DLLScheduler thread pool, and the times are per instance step.
+
+Stimulus, applied to every numeric input:
+  constant     level
+  ramp         level + amplitude * t
+  sine         level + amplitude * sin (2 pi f t)
+  threephase   inputs named <stem>a, <stem>b, <stem>c get balanced sinusoids, 120 degrees apart,
+               with a peak from the model's base: VLLbase (or Vbase, V_b) * sqrt(2/3) for inputs
+               starting with V, and the matching current for inputs starting with I. f comes from
+               w_nom or fn when present. Other inputs are held at level.
+
+Usage: dllbench library [options]
+  --stimulus constant|ramp|sine|threephase (threephase)
+  --level x (0), --amplitude x (1, or the base peak for threephase), --freq Hz (60, or the base)
+  --warmup n (10000), --steps n (100000), --runs n (10)
+  --param name=value, repeated, sets a parameter before CheckParameters
+  --instances n (1) steps n instances of the model
+  --batch steps the instances together through DLLModelOutputsBatch
+  --threads n steps the instances on n threads through the DLLScheduler, and prints its load report
+  --pin pins the scheduler's worker threads to logical cores
+  --json file writes the results for tracking over time
+  --counters also reads hardware counters around the measured runs and the stimulus loop (Linux),
+             reporting IPC and cycles, instructions, branch and cache misses per step
+*/
+
+#define _USE_MATH_DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLThreads.h"
+#include "IEEE_Cigre_DLLScheduler.h"
+#include "IEEE_Cigre_DLLPerfCounters.h"
+
+#define STIM_CONSTANT 0
+#define STIM_RAMP 1
+#define STIM_SINE 2
+#define STIM_THREEPHASE 3
+
+static const char *stimulus_names[] = {"constant", "ramp", "sine", "threephase"};
+
+#define MAX_BENCH_PARAMS 64
+
+typedef struct _BenchInput_ {  // one driven input port
+  DLLPortHandle h;
+  double amplitude;
+  int iPhase;                 // 0, 1, 2 for a, b, c, or -1 when not part of a triple
+} BenchInput;
+
+typedef struct _BenchOptions_ {
+  const char *library;
+  int stimulus;
+  double level;
+  double amplitude;
+  int bAmplitude;             // set on the command line
+  double freq;
+  int bFreq;
+  long warmup;
+  long steps;
+  int runs;
+  const char *json;
+  int bCounters;
+  int instances;
+  int bBatch;
+  int threads;                // 0 steps the instances on the calling thread only
+  int bPin;
+  int NumParams;
+  char *pParams[MAX_BENCH_PARAMS];
+} BenchOptions;
+
+typedef struct _BenchCounts_ {  // hardware counts per step, summed over the measured runs
+  DLLPerfCounters counters;
+  double pLoop[DLL_NUM_PERF_COUNTERS];      // stimulus and Model_Outputs
+  double pStimulus[DLL_NUM_PERF_COUNTERS];  // stimulus alone
+} BenchCounts;
+
+// value of the first parameter found in names, or dflt
+static double base_parameter (Wrapped_IEEE_Cigre_DLL *pWrap, const char **names, double dflt)
+{
+  for (int i = 0; NULL != names[i]; i++) {
+    DLLPortHandle h = GetParameterHandle (pWrap, names[i]);
+    if (h.index >= 0 && IEEE_Cigre_DLLInterface_DataType_real64_T == h.dtype) {
+      return DLL_PARAMETER_REAL64 (pWrap, h);
+    }
+  }
+  return dflt;
+}
+
+static int set_parameter (Wrapped_IEEE_Cigre_DLL *pWrap, char *assignment)
+{
+  char *pEq = strchr (assignment, '=');
+  DLLPortHandle h;
+  union EditValueU val;
+  double x;
+
+  if (NULL == pEq) {
+    printf ("--param %s should be name=value\n", assignment);
+    return 0;
+  }
+  *pEq = '\0';
+  h = GetParameterHandle (pWrap, assignment);
+  if (h.index < 0) {
+    printf ("%s has no parameter named %s\n", pWrap->pInfo->ModelName, assignment);
+    *pEq = '=';
+    return 0;
+  }
+  if (IEEE_Cigre_DLLInterface_DataType_c_string_T == h.dtype) {
+    val.Char_Ptr = pEq + 1;  // argv outlives the model
+    edit_dll_value ((char *) pWrap->pModel->Parameters, h.offset, h.dtype, h.size, val);
+  } else {
+    x = atof (pEq + 1);
+    write_dll_real64 ((char *) DLL_PORT_PTR (pWrap->pModel->Parameters, h), h.dtype, x);
+  }
+  *pEq = '=';  // each instance parses the same assignment
+  return 1;
+}
+
+// the peaks and phases of every input for the chosen stimulus
+static BenchInput *plan_inputs (Wrapped_IEEE_Cigre_DLL *pWrap, BenchOptions *pOpt)
+{
+  static const char *vbase_names[] = {"VLLbase", "Vbase", "V_b", NULL};
+  static const char *sbase_names[] = {"Sbase", "S_b", NULL};
+  static const char *wbase_names[] = {"w_nom", NULL};
+  static const char *fbase_names[] = {"fn", "Fbase", NULL};
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo = pWrap->pInfo;
+  int n = pInfo->NumInputPorts;
+  BenchInput *pInputs = calloc (n > 0 ? n : 1, sizeof (BenchInput));
+  double vbase = base_parameter (pWrap, vbase_names, 0.0);
+  double sbase = base_parameter (pWrap, sbase_names, 0.0);
+  double vpeak = vbase > 0.0 ? vbase * sqrt (2.0 / 3.0) : 1.0;
+  double ipeak = vbase > 0.0 && sbase > 0.0 ? sbase * sqrt (2.0 / 3.0) / vbase : 1.0;
+
+  if (!pOpt->bFreq) {
+    double w = base_parameter (pWrap, wbase_names, 0.0);
+    pOpt->freq = w > 0.0 ? w / (2.0 * M_PI) : base_parameter (pWrap, fbase_names, 60.0);
+  }
+  for (int i = 0; i < n; i++) {
+    const char *name = pInfo->InputPortsInfo[i].Name;
+    size_t len = strlen (name);
+    pInputs[i].h = GetInputHandle (pWrap, name);
+    pInputs[i].amplitude = pOpt->amplitude;
+    pInputs[i].iPhase = -1;
+    if (STIM_THREEPHASE == pOpt->stimulus && len > 1 && name[len - 1] >= 'a' && name[len - 1] <= 'c') {
+      int nFound = 0;
+      char sibling[256];
+      if (len >= sizeof (sibling)) {
+        continue;
+      }
+      strcpy (sibling, name);
+      for (char c = 'a'; c <= 'c'; c++) {
+        sibling[len - 1] = c;
+        nFound += (GetInputHandle (pWrap, sibling).index >= 0);
+      }
+      if (3 == nFound) {
+        pInputs[i].iPhase = name[len - 1] - 'a';
+        if (!pOpt->bAmplitude) {
+          pInputs[i].amplitude = ('V' == name[0] || 'v' == name[0]) ? vpeak :
+                                 ('I' == name[0] || 'i' == name[0]) ? ipeak : 1.0;
+        }
+      }
+    }
+  }
+  return pInputs;
+}
+
+static void apply_stimulus (Wrapped_IEEE_Cigre_DLL *pWrap, const BenchOptions *pOpt, const BenchInput *pInputs, double t)
+{
+  char *pData = (char *) pWrap->pModel->ExternalInputs;
+  double wt = 2.0 * M_PI * pOpt->freq * t;
+  double s[3] = {0.0, 0.0, 0.0};
+  double x;
+
+  if (STIM_SINE == pOpt->stimulus || STIM_THREEPHASE == pOpt->stimulus) {
+    s[0] = sin (wt);
+    if (STIM_THREEPHASE == pOpt->stimulus) {
+      s[1] = sin (wt - 2.0 * M_PI / 3.0);
+      s[2] = sin (wt + 2.0 * M_PI / 3.0);
+    }
+  }
+  for (int i = 0; i < pWrap->pInfo->NumInputPorts; i++) {
+    switch (pOpt->stimulus) {
+      case STIM_RAMP: x = pOpt->level + pInputs[i].amplitude * t; break;
+      case STIM_SINE: x = pOpt->level + pInputs[i].amplitude * s[0]; break;
+      case STIM_THREEPHASE:
+        x = pInputs[i].iPhase >= 0 ? pInputs[i].amplitude * s[pInputs[i].iPhase] : pOpt->level;
+        break;
+      default: x = pOpt->level; break;
+    }
+    write_dll_real64 (pData + pInputs[i].h.offset, pInputs[i].h.dtype, x);
+  }
+}
+
+// one step of every instance at time t, through pSched when it is not NULL
+static void step_instances (Wrapped_IEEE_Cigre_DLL **ppWraps, const BenchOptions *pOpt, const BenchInput *pInputs, double t,
+                            DLLScheduler *pSched)
+{
+  for (int j = 0; j < pOpt->instances; j++) {
+    ppWraps[j]->pModel->Time = t;
+    apply_stimulus (ppWraps[j], pOpt, pInputs, t);
+  }
+  if (NULL != pSched) {
+    DLLSchedulerStep (pSched, ppWraps, pOpt->instances);
+    return;
+  }
+  if (pOpt->bBatch) {
+    DLLModelOutputsBatch (ppWraps, pOpt->instances);
+    return;
+  }
+  for (int j = 0; j < pOpt->instances; j++) {
+    ppWraps[j]->Model_Outputs (ppWraps[j]->pModel);
+  }
+}
+
+static int compare_doubles (const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+static int parse_options (int argc, char **argv, BenchOptions *pOpt)
+{
+  memset (pOpt, 0, sizeof (*pOpt));
+  pOpt->stimulus = STIM_THREEPHASE;
+  pOpt->amplitude = 1.0;
+  pOpt->freq = 60.0;
+  pOpt->warmup = 10000;
+  pOpt->steps = 100000;
+  pOpt->runs = 10;
+  pOpt->instances = 1;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *next = i + 1 < argc ? argv[i + 1] : NULL;
+    if ('-' != arg[0]) {
+      pOpt->library = arg;
+      continue;
+    }
+    if (0 == strcmp (arg, "--counters")) {
+      pOpt->bCounters = 1;
+      continue;
+    }
+    if (0 == strcmp (arg, "--batch")) {
+      pOpt->bBatch = 1;
+      continue;
+    }
+    if (0 == strcmp (arg, "--pin")) {
+      pOpt->bPin = 1;
+      continue;
+    }
+    if (NULL == next) {
+      printf ("%s needs a value\n", arg);
+      return 0;
+    }
+    i += 1;
+    if (0 == strcmp (arg, "--stimulus")) {
+      pOpt->stimulus = -1;
+      for (int k = 0; k < 4; k++) {
+        if (0 == strcmp (next, stimulus_names[k])) {
+          pOpt->stimulus = k;
+        }
+      }
+      if (pOpt->stimulus < 0) {
+        printf ("unknown stimulus %s\n", next);
+        return 0;
+      }
+    } else if (0 == strcmp (arg, "--level")) {
+      pOpt->level = atof (next);
+    } else if (0 == strcmp (arg, "--amplitude")) {
+      pOpt->amplitude = atof (next);
+      pOpt->bAmplitude = 1;
+    } else if (0 == strcmp (arg, "--freq")) {
+      pOpt->freq = atof (next);
+      pOpt->bFreq = 1;
+    } else if (0 == strcmp (arg, "--warmup")) {
+      pOpt->warmup = atol (next);
+    } else if (0 == strcmp (arg, "--steps")) {
+      pOpt->steps = atol (next);
+    } else if (0 == strcmp (arg, "--runs")) {
+      pOpt->runs = atoi (next);
+    } else if (0 == strcmp (arg, "--instances")) {
+      pOpt->instances = atoi (next);
+    } else if (0 == strcmp (arg, "--threads")) {
+      pOpt->threads = atoi (next);
+    } else if (0 == strcmp (arg, "--json")) {
+      pOpt->json = next;
+    } else if (0 == strcmp (arg, "--param") && pOpt->NumParams < MAX_BENCH_PARAMS) {
+      pOpt->pParams[pOpt->NumParams++] = argv[i];
+    } else {
+      printf ("unknown option %s\n", arg);
+      return 0;
+    }
+  }
+  if (NULL == pOpt->library || pOpt->steps < 1 || pOpt->runs < 1 || pOpt->warmup < 0 || pOpt->instances < 1 ||
+      pOpt->threads < 0 || (pOpt->threads > 0 && pOpt->bBatch)) {
+    printf ("usage: dllbench library [--stimulus constant|ramp|sine|threephase] [--level x] [--amplitude x]\n");
+    printf ("       [--freq Hz] [--warmup n] [--steps n] [--runs n] [--param name=value]... [--json file]\n");
+    printf ("       [--counters] [--instances n] [--batch | --threads n [--pin]]\n");
+    return 0;
+  }
+  return 1;
+}
+
+// a JSON string value; Windows paths have backslashes
+static void write_json_string (FILE *fp, const char *key, const char *val)
+{
+  fprintf (fp, "  \"%s\": \"", key);
+  for (const char *p = NULL != val ? val : ""; *p; p++) {
+    if ('"' == *p || '\\' == *p) {
+      fputc ('\\', fp);
+    }
+    if ((unsigned char) *p >= 0x20) {
+      fputc (*p, fp);
+    }
+  }
+  fprintf (fp, "\",\n");
+}
+
+static void write_json_counts (FILE *fp, const char *key, const BenchCounts *pCounts, const double *pPerStep)
+{
+  int bFirst = 1;
+  fprintf (fp, ",\n  \"%s\": {", key);
+  for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+    if (DLLPerfCounterValid (&pCounts->counters, i)) {
+      fprintf (fp, "%s\"%s\": %.4f", bFirst ? "" : ", ", DLLPerfCounterName (i), pPerStep[i]);
+      bFirst = 0;
+    }
+  }
+  fprintf (fp, "}");
+}
+
+static double instructions_per_cycle (const BenchCounts *pCounts, const double *pPerStep)
+{
+  if (DLLPerfCounterValid (&pCounts->counters, DLL_PERF_CYCLES) &&
+      DLLPerfCounterValid (&pCounts->counters, DLL_PERF_INSTRUCTIONS) && pPerStep[DLL_PERF_CYCLES] > 0.0) {
+    return pPerStep[DLL_PERF_INSTRUCTIONS] / pPerStep[DLL_PERF_CYCLES];
+  }
+  return 0.0;
+}
+
+static void print_counts (const BenchCounts *pCounts)
+{
+  printf ("  hardware counters per step%s:\n", pCounts->counters.bScaled ? " (scaled for multiplexing)" : "");
+  printf ("    %-18s %12s %12s\n", "counter", "loop", "stimulus");
+  for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+    if (DLLPerfCounterValid (&pCounts->counters, i)) {
+      printf ("    %-18s %12.2f %12.2f\n", DLLPerfCounterName (i), pCounts->pLoop[i], pCounts->pStimulus[i]);
+    }
+  }
+  printf ("    %-18s %12.3f %12.3f\n", "IPC", instructions_per_cycle (pCounts, pCounts->pLoop),
+          instructions_per_cycle (pCounts, pCounts->pStimulus));
+}
+
+// pRuns in run order, pSorted ascending; pCounts is NULL when counters were not requested or none
+// could be opened
+static void write_json (const BenchOptions *pOpt, Wrapped_IEEE_Cigre_DLL *pWrap, const double *pRuns,
+                        const double *pSorted, double mean, double variance, double median, double stim_ns,
+                        const BenchCounts *pCounts)
+{
+  FILE *fp = fopen (pOpt->json, "w");
+  char stamp[32];
+  time_t now = time (NULL);
+
+  if (NULL == fp) {
+    printf ("could not open %s\n", pOpt->json);
+    return;
+  }
+  strftime (stamp, sizeof (stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime (&now));
+  fprintf (fp, "{\n");
+  write_json_string (fp, "model", pWrap->pInfo->ModelName);
+  write_json_string (fp, "version", pWrap->pInfo->ModelVersion);
+  write_json_string (fp, "library", pOpt->library);
+  write_json_string (fp, "timestamp", stamp);
+#if defined(__VERSION__)
+  write_json_string (fp, "compiler", __VERSION__);
+#endif
+  fprintf (fp, "  \"time_step\": %.9g,\n", pWrap->pInfo->FixedStepBaseSampleTime);
+  fprintf (fp, "  \"stimulus\": \"%s\",\n", stimulus_names[pOpt->stimulus]);
+  fprintf (fp, "  \"frequency\": %.9g,\n", pOpt->freq);
+  fprintf (fp, "  \"warmup_steps\": %ld,\n", pOpt->warmup);
+  fprintf (fp, "  \"steps_per_run\": %ld,\n", pOpt->steps);
+  fprintf (fp, "  \"runs\": %d,\n", pOpt->runs);
+  fprintf (fp, "  \"instances\": %d,\n", pOpt->instances);
+  fprintf (fp, "  \"batch\": %s,\n", pOpt->bBatch ? "true" : "false");
+  fprintf (fp, "  \"threads\": %d,\n", pOpt->threads);
+  fprintf (fp, "  \"ns_per_step\": [");
+  for (int r = 0; r < pOpt->runs; r++) {
+    fprintf (fp, r > 0 ? ", %.4f" : "%.4f", pRuns[r]);
+  }
+  fprintf (fp, "],\n");
+  fprintf (fp, "  \"mean_ns_per_step\": %.4f,\n", mean);
+  fprintf (fp, "  \"variance_ns2\": %.6g,\n", variance);
+  fprintf (fp, "  \"stddev_ns\": %.4f,\n", sqrt (variance));
+  fprintf (fp, "  \"min_ns_per_step\": %.4f,\n", pSorted[0]);
+  fprintf (fp, "  \"median_ns_per_step\": %.4f,\n", median);
+  fprintf (fp, "  \"max_ns_per_step\": %.4f,\n", pSorted[pOpt->runs - 1]);
+  fprintf (fp, "  \"steps_per_second\": %.2f,\n", 1.0e9 / mean);
+  fprintf (fp, "  \"stimulus_ns_per_step\": %.4f", stim_ns);
+  if (NULL != pCounts) {
+    write_json_counts (fp, "counters_per_step", pCounts, pCounts->pLoop);
+    write_json_counts (fp, "stimulus_counters_per_step", pCounts, pCounts->pStimulus);
+    fprintf (fp, ",\n  \"ipc\": %.4f", instructions_per_cycle (pCounts, pCounts->pLoop));
+  }
+  fprintf (fp, "\n}\n");
+  fclose (fp);
+  printf ("wrote %s\n", pOpt->json);
+}
+
+int main (int argc, char **argv)
+{
+  BenchOptions opt;
+  Wrapped_IEEE_Cigre_DLL *pWrap;
+  Wrapped_IEEE_Cigre_DLL **ppWraps;
+  BenchInput *pInputs;
+  double *pRuns;
+  double *pSorted;
+  double dt, mean = 0.0, variance = 0.0, median, stim_ns;
+  long long step = 0;
+  uint64_t t0;
+  BenchCounts counts;
+  int bCounting = 0;
+  DLLScheduler *pSched = NULL;
+
+  if (!parse_options (argc, argv, &opt)) {
+    return 1;
+  }
+  pWrap = CreateFirstDLLModel ((char *) opt.library);
+  if (NULL == pWrap) {
+    return 1;
+  }
+  ppWraps = calloc (opt.instances, sizeof (Wrapped_IEEE_Cigre_DLL *));
+  ppWraps[0] = pWrap;
+  for (int j = 1; j < opt.instances; j++) {
+    ppWraps[j] = CreateDLLModelInstance (pWrap->pClass);
+  }
+  for (int j = 0; j < opt.instances; j++) {
+    for (int i = 0; i < opt.NumParams; i++) {
+      if (!set_parameter (ppWraps[j], opt.pParams[i])) {
+        for (int k = 1; k < opt.instances; k++) {
+          FreeDLLModelInstance (ppWraps[k]);
+        }
+        free (ppWraps);
+        FreeFirstDLLModel (pWrap);
+        return 1;
+      }
+    }
+  }
+  pInputs = plan_inputs (pWrap, &opt);
+  pRuns = malloc (opt.runs * sizeof (double));
+  pSorted = malloc (opt.runs * sizeof (double));
+  dt = pWrap->pInfo->FixedStepBaseSampleTime;
+
+  for (int j = 0; j < opt.instances; j++) {
+    if (NULL != ppWraps[j]->Model_FirstCall) {
+      ppWraps[j]->Model_FirstCall (ppWraps[j]->pModel);
+    }
+    ppWraps[j]->Model_CheckParameters (ppWraps[j]->pModel);
+    check_messages ("Model_CheckParameters", ppWraps[j]->pModel);
+    apply_stimulus (ppWraps[j], &opt, pInputs, 0.0);
+    ppWraps[j]->Model_Initialize (ppWraps[j]->pModel);
+    check_messages ("Model_Initialize", ppWraps[j]->pModel);
+  }
+
+  if (opt.threads > 0) {
+    pSched = CreateDLLScheduler (opt.threads, opt.bPin ? DLL_PIN_WORKERS : DLL_PIN_NONE);
+    if (NULL == pSched) {
+      return 1;
+    }
+    pSched->bMeasureLoad = 1;
+  }
+
+  printf ("%s: dt=%g, %s stimulus at %g Hz, %ld warm-up steps, %d runs of %ld steps\n", pWrap->pInfo->ModelName,
+          dt, stimulus_names[opt.stimulus], opt.freq, opt.warmup, opt.runs, opt.steps);
+  if (NULL != pSched) {
+    printf ("%d instances stepped on %d threads%s; times are per instance step\n", opt.instances,
+            pSched->NumThreads, opt.bPin ? ", pinned to cores" : "");
+  } else if (opt.instances > 1) {
+    printf ("%d instances stepped %s; times are per instance step\n", opt.instances,
+            !opt.bBatch ? "one at a time" : NULL != pWrap->Model_OutputsBatch ? "through Model_OutputsBatch" :
+            "one at a time, the model has no Model_OutputsBatch");
+  }
+  for (long k = 0; k < opt.warmup; k++, step++) {
+    step_instances (ppWraps, &opt, pInputs, (double) step * dt, pSched);
+  }
+  check_messages ("Model_Outputs", pWrap->pModel);
+  memset (&counts, 0, sizeof (counts));
+  if (opt.bCounters) {
+    bCounting = OpenDLLPerfCounters (&counts.counters) > 0;
+  }
+  for (int r = 0; r < opt.runs; r++) {
+    if (bCounting) {
+      StartDLLPerfCounters (&counts.counters);
+    }
+    t0 = DLLMonotonicNanoseconds ();
+    for (long k = 0; k < opt.steps; k++, step++) {
+      step_instances (ppWraps, &opt, pInputs, (double) step * dt, pSched);
+    }
+    pRuns[r] = (double) (DLLMonotonicNanoseconds () - t0) / (double) opt.steps / (double) opt.instances;
+    if (bCounting) {
+      StopDLLPerfCounters (&counts.counters);
+      for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+        counts.pLoop[i] += (double) counts.counters.pValues[i] / (double) opt.steps / (double) opt.instances / (double) opt.runs;
+      }
+    }
+    printf ("  run %2d: %10.2f ns/step\n", r, pRuns[r]);
+  }
+  check_messages ("Model_Outputs", pWrap->pModel);
+
+  // the stimulus alone, over the same number of steps, writing the same input buffer
+  if (bCounting) {
+    StartDLLPerfCounters (&counts.counters);
+  }
+  t0 = DLLMonotonicNanoseconds ();
+  for (long k = 0; k < opt.steps; k++) {
+    apply_stimulus (pWrap, &opt, pInputs, (double) (step + k) * dt);
+  }
+  stim_ns = (double) (DLLMonotonicNanoseconds () - t0) / (double) opt.steps;
+  if (bCounting) {
+    StopDLLPerfCounters (&counts.counters);
+    for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+      counts.pStimulus[i] = (double) counts.counters.pValues[i] / (double) opt.steps;
+    }
+  }
+
+  for (int r = 0; r < opt.runs; r++) {
+    mean += pRuns[r];
+  }
+  mean /= opt.runs;
+  for (int r = 0; r < opt.runs; r++) {
+    variance += (pRuns[r] - mean) * (pRuns[r] - mean);
+  }
+  variance = opt.runs > 1 ? variance / (opt.runs - 1) : 0.0;
+  memcpy (pSorted, pRuns, opt.runs * sizeof (double));
+  qsort (pSorted, opt.runs, sizeof (double), compare_doubles);
+  median = 0 == opt.runs % 2 ? 0.5 * (pSorted[opt.runs / 2 - 1] + pSorted[opt.runs / 2]) : pSorted[opt.runs / 2];
+
+  printf ("%s: %.2f ns/step (stddev %.2f, min %.2f, median %.2f, max %.2f), %.0f steps/s; stimulus %.2f ns/step\n",
+          pWrap->pInfo->ModelName, mean, sqrt (variance), pSorted[0], median, pSorted[opt.runs - 1], 1.0e9 / mean, stim_ns);
+  if (bCounting) {
+    print_counts (&counts);
+  }
+  if (NULL != pSched) {
+    PrintDLLSchedulerLoad (pSched);
+    FreeDLLScheduler (pSched);
+  }
+  if (NULL != opt.json) {
+    write_json (&opt, pWrap, pRuns, pSorted, mean, variance, median, stim_ns, bCounting ? &counts : NULL);
+  }
+  if (bCounting) {
+    CloseDLLPerfCounters (&counts.counters);
+  }
+
+  free (pRuns);
+  free (pSorted);
+  free (pInputs);
+  for (int j = 1; j < opt.instances; j++) {
+    FreeDLLModelInstance (ppWraps[j]);
+  }
+  free (ppWraps);
+  FreeFirstDLLModel (pWrap);
+  return 0;
+}
@@ -0,0 +1,71 @@
+# Copyright (C) 2024-26 Meltran, Inc
+
+# Reads binary trace files from IEEE_Cigre_DLLTrace.c, mapping the rows into numpy without parsing
+
+import os
+import sys
+import struct
+import numpy as np
+
+TRACE_MAGIC = b'DLLTRACE'
+HEADER_FORMAT = '<8sIIIId32s'  # DLLTraceFileHeader, 64 bytes
+COLUMN_FORMAT = '<40s16sII'    # DLLTraceFileColumn, 64 bytes
+
+# numpy formats for enum IEEE_Cigre_DLLInterface_DataType
+DTYPES = {1: 'i1', 2: 'i1', 3: 'u1', 4: '<i2', 5: '<u2', 6: '<i4', 7: '<u4', 8: '<f4', 9: '<f8'}
+# c_string columns hold the writer's pointer, which means nothing in the file, so they are skipped
+C_STRING = 10
+
+def _text (raw):
+  return raw.split(b'\0', 1)[0].decode('utf-8', errors='replace')
+
+def read_trace (path):
+  """Returns (meta, rows), where rows is a read-only numpy memmap with one named field per numeric column"""
+  with open (path, 'rb') as f:
+    hdr = f.read (struct.calcsize (HEADER_FORMAT))
+    magic, version, header_bytes, ncols, row_bytes, dt, model = struct.unpack (HEADER_FORMAT, hdr)
+    if magic != TRACE_MAGIC:
+      raise ValueError ('{:s} is not a DLL trace file'.format (path))
+    columns = []
+    for i in range(ncols):
+      name, unit, dtype, offset = struct.unpack (COLUMN_FORMAT, f.read (struct.calcsize (COLUMN_FORMAT)))
+      if dtype != C_STRING and dtype not in DTYPES:
+        raise ValueError ('{:s} column {:s} has unknown data type {:d}'.format (path, _text(name), dtype))
+      if dtype != C_STRING:
+        columns.append ({'name': _text(name), 'unit': _text(unit), 'dtype': dtype, 'offset': offset})
+  rowtype = np.dtype ({'names': [c['name'] for c in columns],
+                       'formats': [DTYPES[c['dtype']] for c in columns],
+                       'offsets': [c['offset'] for c in columns],
+                       'itemsize': row_bytes})
+  nrows = (os.path.getsize (path) - header_bytes) // row_bytes
+  meta = {'version': version, 'model': _text(model), 'dt': dt, 'columns': columns, 'rows': nrows}
+  if nrows < 1:
+    return meta, np.zeros (0, dtype=rowtype)
+  return meta, np.memmap (path, dtype=rowtype, mode='r', offset=header_bytes, shape=(nrows,))
+
+def trace_dataframe (path):
+  """pandas DataFrame indexed by t, like pd.read_csv (csv_path, index_col='t')"""
+  import pandas as pd
+  meta, rows = read_trace (path)
+  df = pd.DataFrame ({c['name']: rows[c['name']] for c in meta['columns']})
+  return df.set_index ('t')
+
+def export_csv (path, csv_path):
+  meta, rows = read_trace (path)
+  names = [c['name'] for c in meta['columns']]
+  with open (csv_path, 'w') as fp:
+    fp.write (','.join (names) + '\n')
+    for row in rows:
+      fp.write (','.join ('{:g}'.format (row[n]) for n in names) + '\n')
+  return meta['rows']
+
+if __name__ == '__main__':
+  if len(sys.argv) < 2:
+    print ('usage: python dlltrace.py trace.dtr [out.csv]')
+    quit()
+  meta, rows = read_trace (sys.argv[1])
+  print ('{:s}: {:d} rows at dt={:g} s, {:d} columns'.format (meta['model'], meta['rows'], meta['dt'], len(meta['columns'])))
+  for c in meta['columns']:
+    print ('  {:24s} {:10s} {:s}'.format (c['name'], c['unit'], DTYPES[c['dtype']]))
+  if len(sys.argv) > 2:
+    export_csv (sys.argv[1], sys.argv[2])
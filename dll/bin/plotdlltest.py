@@ -6,6 +6,7 @@ import pandas as pd
 import numpy as np
 import matplotlib.pyplot as plt
 import math
+import dlltrace
 
 # CERTS inverter is 100 kW, 480 V
 hwpv_vbase = 480.0 * math.sqrt(2.0) / math.sqrt(3.0)
@@ -153,10 +154,16 @@ if __name__ == '__main__':
     data_path = sys.argv[1]
   if len(sys.argv) > 2 and int(sys.argv[2]) > 0:
     all_channels = True
-  df = pd.read_csv (data_path, index_col='t')
+  # binary traces use the same plot page as the CSV file they replace
+  plot_key = data_path.lower()
+  if plot_key.endswith ('.dtr'):
+    df = dlltrace.trace_dataframe (data_path)
+    plot_key = os.path.splitext (os.path.basename (plot_key))[0] + '.csv'
+  else:
+    df = pd.read_csv (data_path, index_col='t')
   df.info()
-  if data_path.lower() in plots and all_channels == False:
-    plot_page (df, plots[data_path])
+  if plot_key in plots and all_channels == False:
+    plot_page (df, plots[plot_key])
   else:
     df.plot(subplots=True, title=data_path.lower())
     plt.show()
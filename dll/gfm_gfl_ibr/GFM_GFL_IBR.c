@@ -119,8 +119,18 @@ January 27, 2022, Deepak Ramasubramanian, EPRI (dramasubramanian@epri.com)
 #define PI 3.14159265
 
 #include "IEEE_Cigre_DLLInterface.h"
+#include "IEEE_Cigre_DLLModelMessage.h"
 
-char ErrorMessage[1000];
+#if defined(_WIN32)
+#define DLL_EXPORT __declspec(dllexport)
+#define DLL_CALL __cdecl
+#else
+#define DLL_EXPORT __attribute__((visibility("default")))
+#define DLL_CALL
+#endif
+
+
+static char_T SharedMessage[DLL_MODEL_MESSAGE_BYTES];  // for programs that do not call Model_SetMessageBuffer
 
 // ----------------------------------------------------------------------
 // Structures defining inputs, outputs, parameters and program structure
@@ -829,14 +839,29 @@ IEEE_Cigre_DLLInterface_Model_Info Model_Info = {
 // ----------------------------------------------------------------
 // Subroutines that can be called by the main power system program
 // ----------------------------------------------------------------
-__declspec(dllexport) const IEEE_Cigre_DLLInterface_Model_Info* __cdecl Model_GetInfo() {
+DLL_EXPORT const IEEE_Cigre_DLLInterface_Model_Info* DLL_CALL Model_GetInfo() {
     /* Returns Model Information
     */
     return &Model_Info;
 };
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_SetMessageBuffer(IEEE_Cigre_DLLInterface_Instance* instance, char_T* pBuffer, int32_T nBytes) {
+    /*   Optional: gives this instance message text of its own, so instances can run on different threads
+       Arguments: Instance specific model structure, and a buffer the program keeps until after Model_Terminate
+       Return:    Integer status 0 (normal), 2 if the buffer is too small
+    */
+    if (NULL == pBuffer || nBytes < DLL_MODEL_MESSAGE_BYTES) {
+        return IEEE_Cigre_DLLInterface_Return_Error;
+    }
+    pBuffer[0] = '\0';
+    instance->LastGeneralMessage = pBuffer;
+    instance->LastErrorMessage = pBuffer;
+    return IEEE_Cigre_DLLInterface_Return_OK;
+};
+
+// ----------------------------------------------------------------
+DLL_EXPORT int32_T DLL_CALL Model_CheckParameters(IEEE_Cigre_DLLInterface_Instance* instance) {
     /*   Checks the parameters on the given range
        Arguments: Instance specific model structure containing Inputs, Parameters and Outputs
        Return:    Integer status 0 (normal), 1 if messages are written, 2 for errors.  See IEEE_Cigre_DLLInterface_types.h
@@ -889,38 +914,39 @@ __declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterf
     //
     double delt = Model_Info.FixedStepBaseSampleTime;
 
+    char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
     if ((1.0/KiI) < 2.0*delt) {
         // write error message
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter KiI is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiI, delt);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter KiI is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiI, delt);
         parameters->KiI = 1.0/(2.0*delt);
     }
     if ((1.0/KiPLL) < 2.0*delt) {
         // write error message
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter KiPLL is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiPLL, delt);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter KiPLL is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiPLL, delt);
         parameters->KiPLL = 1.0/(2.0*delt);
     }
     if ((1.0 / KiP) < 2.0 * delt) {
         // write error message
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter KiP is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiP, delt);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter KiP is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiP, delt);
         parameters->KiP = 1.0 / (2.0 * delt);
     }
     if ((1.0 / KiQ) < 2.0 * delt) {
         // write error message
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter KiQ is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiQ, delt);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter KiQ is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiQ, delt);
         parameters->KiQ = 1.0 / (2.0 * delt);
     }
     if ((1.0 / KiV) < 2.0 * delt) {
         // write error message
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter KiV is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiV, delt);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter KiV is: %f, but has been reset to be reciprocal of 2 times the time step: %f .\n", KiV, delt);
         parameters->KiV = 1.0 / (2.0 * delt);
     }
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Initialize(IEEE_Cigre_DLLInterface_Instance* instance) {
     /*   Initializes the system by resetting the internal states
        Arguments: Instance specific model structure containing Inputs, Parameters and Outputs
        Return:    Integer status 0 (normal), 1 if messages are written, 2 for errors.  See IEEE_Cigre_DLLInterface_types.h
@@ -1007,6 +1033,7 @@ __declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_I
     double Freqpll = outputs->Freqpll;
     double Pout = outputs->Pout;
     double Qout = outputs->Qout;
+    char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
 
     // save state variables
@@ -1047,7 +1074,7 @@ __declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_I
     instance->DoubleStates[34] = 0.0;
     instance->DoubleStates[35] = 0.0;
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 // Integrator with time constant T
@@ -1117,11 +1144,12 @@ double LEADLAG(double G, double T1, double T2, double x, double x_old, double y_
 
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Outputs(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Outputs(IEEE_Cigre_DLLInterface_Instance* instance) {
     /*   Calculates output equation
        Arguments: Instance specific model structure containing Inputs, Parameters and Outputs
        Return:    Integer status 0 (normal), 1 if messages are written, 2 for errors.  See IEEE_Cigre_DLLInterface_types.h
     */
+    char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
 
     MyModelParameters* parameters = (MyModelParameters*)instance->Parameters;
@@ -1509,20 +1537,21 @@ __declspec(dllexport) int32_T __cdecl Model_Outputs(IEEE_Cigre_DLLInterface_Inst
     instance->DoubleStates[34] = Iq_filter_s2;
     instance->DoubleStates[35] = Iq;
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Terminate(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Terminate(IEEE_Cigre_DLLInterface_Instance* instance) {
     /*   Destroys any objects allocated by the model code - not used
     */
+    char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
     instance->LastGeneralMessage = ErrorMessage;
 
     return IEEE_Cigre_DLLInterface_Return_OK;
 };
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_PrintInfo() {
+DLL_EXPORT int32_T DLL_CALL Model_PrintInfo() {
     /* Prints Model Information once
     */
     int Printed = 0;
@@ -2,7 +2,7 @@
 
 // see https://learn.microsoft.com/en-us/windows/win32/dlls/using-run-time-dynamic-linking
 
-#define DLL_NAME "GFM_GFL_IBR.dll"
+#define DLL_NAME DLL_FILE_NAME("GFM_GFL_IBR")
 
 #define TMAX 0.5
 #define VBASE 650.0
@@ -13,7 +13,6 @@
 // relative output path for execution from the build directory, e.g., release\test or debug\test
 #define CSV_NAME "ibr.csv"
 
-#include <windows.h> 
 #include <stdio.h> 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -137,13 +136,13 @@ int main( void )
       update_inputs (pWrap->pModel, pWrap->pInputMap, t, Ea/1000.0, Eb/1000.0, Ec/1000.0, Ia/1000.0, Ib/1000.0, Ic/1000.0);
 
       // execute the DLL for updated inverter voltages and other outputs
-      pWrap->Model_Outputs (pWrap->pModel);
+      int32_T rc = pWrap->Model_Outputs (pWrap->pModel);
       Ea = 1000.0 * extract_output (pWrap->pModel, pWrap->pOutputMap, 0);
       Eb = 1000.0 * extract_output (pWrap->pModel, pWrap->pOutputMap, 1);
       Ec = 1000.0 * extract_output (pWrap->pModel, pWrap->pOutputMap, 2);
 
       write_csv_values (fp, pWrap->pModel, pWrap->pInfo, pWrap->pInputMap, pWrap->pOutputMap, t);
-      check_messages ("Model_Outputs", pWrap->pModel);
+      check_model_return ("Model_Outputs", pWrap->pModel, rc);
       t += dt;
     }
     fclose (fp);
@@ -11,7 +11,6 @@ simulation program by running the "DLLImport" tool that comes with each program
 September 21, 2023, Vishal Verma 
 */ 
 
-#include <windows.h> 
 #include <stdio.h> 
 #include <math.h> 
 
@@ -25,7 +24,17 @@ September 21, 2023, Vishal Verma
 #define SQRT3H   0.866025404
 
 #include "IEEE_Cigre_DLLInterface.h" 
-char ErrorMessage[1000];
+#include "IEEE_Cigre_DLLModelMessage.h"
+
+#if defined(_WIN32)
+#define DLL_EXPORT __declspec(dllexport)
+#define DLL_CALL __cdecl
+#else
+#define DLL_EXPORT __attribute__((visibility("default")))
+#define DLL_CALL
+#endif
+
+static char_T SharedMessage[DLL_MODEL_MESSAGE_BYTES];  // for programs that do not call Model_SetMessageBuffer
 
 // ---------------------------------------------------------------------- 
 // Structures defining inputs, outputs, parameters and program structure 
@@ -963,12 +972,26 @@ IEEE_Cigre_DLLInterface_Model_Info Model_Info = {
 
 // Subroutines that can be called by the main power system program 
 
-__declspec(dllexport) const IEEE_Cigre_DLLInterface_Model_Info* __cdecl Model_GetInfo () {
+DLL_EXPORT const IEEE_Cigre_DLLInterface_Model_Info* DLL_CALL Model_GetInfo () {
 // Returns Model Information 
   return &Model_Info;
 };
 
-__declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_SetMessageBuffer(IEEE_Cigre_DLLInterface_Instance* instance, char_T* pBuffer, int32_T nBytes) {
+  /*   Optional: gives this instance message text of its own, so instances can run on different threads
+     Arguments: Instance specific model structure, and a buffer the program keeps until after Model_Terminate
+     Return:    Integer status 0 (normal), 2 if the buffer is too small
+  */
+  if (NULL == pBuffer || nBytes < DLL_MODEL_MESSAGE_BYTES) {
+    return IEEE_Cigre_DLLInterface_Return_Error;
+  }
+  pBuffer[0] = '\0';
+  instance->LastGeneralMessage = pBuffer;
+  instance->LastErrorMessage = pBuffer;
+  return IEEE_Cigre_DLLInterface_Return_OK;
+};
+
+DLL_EXPORT int32_T DLL_CALL Model_CheckParameters(IEEE_Cigre_DLLInterface_Instance* instance) {
 /* Checks the parameters on the given range 
    Arguments: Instance specific model structure containing Inputs, Parameters and Outputs 
    Return: Integer status O (normal), 1 if messages are written, 2 for errors.
@@ -1043,39 +1066,40 @@ __declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterf
   int bWarning = 0;
   int bError = 0;
 
+  char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
   ErrorMessage[0] = '\0';
 
   if ((1.0 / KiPLL) < 2.0 * delt) {
     // write error message 
-    sprintf_s (ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter KiPLL is %f , \
+    snprintf (ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter KiPLL is %f , \
 but has been reset to be reciprocal of 2 times the time step: %f \n", KiPLL, delt);
     parameters->KiPLL = 1.0 / (2.0 * delt);
     bWarning = 1;
   } 
   if ((1.0 / Ki_Vdc) < 2.0 * delt) { 
     // write error message 
-    sprintf_s(ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter Ki_Vdc is: %f, \
+    snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter Ki_Vdc is: %f, \
 but has been reset to be reciprocal of 2 times the time step %f \n", Ki_Vdc, delt);
     parameters->Ki_Vdc = 1.0 / (2.0 * delt);
     bWarning = 1;
   } 
   if ((1.0 / Kv_i) < 2.0 * delt) { 
     // write error message 
-    sprintf_s (ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter KiP is: %f, \
+    snprintf (ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter KiP is: %f, \
 but has been reset to be reciprocal of 2 times the time step: %f .\n", Kv_i, delt);
     parameters->Kv_i = 1.0 / (2.0 * delt);
     bWarning = 1;
   } 
   if ((1.0 / Kq_i) < 2.0 * delt) {
     // write error message 
-    sprintf_s (ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter KiQ is: %f, \
+    snprintf (ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter KiQ is: %f, \
 but has been reset to be reciprocal of 2 times the time step.%f .\n", Kq_i, delt);
     parameters->Kq_i = 1.0 / (2.0 * delt);
     bWarning = 1;
   }
   if ((1.0 / Kcc_i) < 2.0 * delt) {
     // write error message 
-    sprintf_s(ErrorMessage, sizeof(ErrorMessage), "GFL-IBR Error - Parameter KiV is: %f, \
+    snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "GFL-IBR Error - Parameter KiV is: %f, \
 but has been reset to be reciprocal of 2 times the time step: %f .\n", Kcc_i, delt);
     parameters->Kcc_i = 1.0 / (2.0 * delt);
     bWarning = 1;
@@ -1091,7 +1115,7 @@ but has been reset to be reciprocal of 2 times the time step: %f .\n", Kcc_i, de
 };
 
 // -------------------------------------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Initialize(IEEE_Cigre_DLLInterface_Instance* instance) {
 
 /* Initializes the system by resetting the internal states 
    Arguments.Instance specific model structure containing Inputs, Parameters and Outputs 
@@ -1204,7 +1228,8 @@ __declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_I
   double Pout = outputs->Pout;
   double Qout = outputs->Qout;
 
-  ErrorMessage [0]= '\0';
+  char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
+  ErrorMessage[0] = '\0';
 
   // save state variables 
   instance->DoubleStates[0]  = 0.0;
@@ -1293,7 +1318,7 @@ __declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_I
   instance->DoubleStates[83] = 0.0;
 
   instance->LastGeneralMessage = ErrorMessage;
-  return IEEE_Cigre_DLLInterface_Return_OK;
+  return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 // Integrator with time constant T 
@@ -1493,7 +1518,7 @@ double AWCLAMP(double ki, double y, double ymax, double ymin, double iin, double
 
 //---------------------------------------------------------------- 
 
-__declspec(dllexport) int32_T __cdecl Model_Outputs(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Outputs(IEEE_Cigre_DLLInterface_Instance* instance) {
 
 /* Calculates output equation 
   Arguments: Instance specific model structure containing Inputs, Parameters and Outputs 
@@ -1501,7 +1526,8 @@ __declspec(dllexport) int32_T __cdecl Model_Outputs(IEEE_Cigre_DLLInterface_Inst
   See IEEE_Cigre_DLLInterface_types.h 
 */ 
 
-  ErrorMessage [0]= '\0';
+  char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
+  ErrorMessage[0] = '\0';
 
   MyModelParameters* parameters = (MyModelParameters*)instance->Parameters;
   // Retrieve variables from Input, Output and State 
@@ -2168,28 +2194,28 @@ __declspec(dllexport) int32_T __cdecl Model_Outputs(IEEE_Cigre_DLLInterface_Inst
   instance->DoubleStates[82] = Qelec;
   instance->DoubleStates[83] = Qelec_meas;
   instance->LastGeneralMessage = ErrorMessage;
-  return IEEE_Cigre_DLLInterface_Return_OK;
+  return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 //---------------------------------------------------------------- 
 
-__declspec(dllexport) int32_T __cdecl Model_Terminate(IEEE_Cigre_DLLInterface_Instance* instance) { 
+DLL_EXPORT int32_T DLL_CALL Model_Terminate(IEEE_Cigre_DLLInterface_Instance* instance) { 
 // Destroys any objects allocated by the model code- not used 
   return IEEE_Cigre_DLLInterface_Return_OK;
 };
 
-__declspec(dllexport) int32_T __cdecl Model_FirstCall(IEEE_Cigre_DLLInterface_Instance* instance) { 
+DLL_EXPORT int32_T DLL_CALL Model_FirstCall(IEEE_Cigre_DLLInterface_Instance* instance) { 
 // Destroys any objects allocated by the model code not used 
   return IEEE_Cigre_DLLInterface_Return_OK;
 
 };
 
-__declspec(dllexport) int32_T __cdecl Model_Iterate(IEEE_Cigre_DLLInterface_Instance* instance) { 
+DLL_EXPORT int32_T DLL_CALL Model_Iterate(IEEE_Cigre_DLLInterface_Instance* instance) { 
 // Destroys any objects allocated by the model code not used 
   return IEEE_Cigre_DLLInterface_Return_OK;
 };
 
-__declspec(dllexport) int32_T __cdecl Model_PrintInfo () {
+DLL_EXPORT int32_T DLL_CALL Model_PrintInfo () {
 // Prints Model Information once 
   int Printed = 0;
   if (!Printed) { 
@@ -2,7 +2,7 @@
 
 // see https://learn.microsoft.com/en-us/windows/win32/dlls/using-run-time-dynamic-linking
 
-#define DLL_NAME "GFM_GFL_IBR2.dll"
+#define DLL_NAME DLL_FILE_NAME("GFM_GFL_IBR2")
 
 #define TMAX 2.0
 #define VBASE 600.0
@@ -12,14 +12,15 @@
 #define VDC_NOM 1200.0
 
 // relative output path for execution from the build directory, e.g., release\test or debug\test
-#define CSV_NAME "ibr2.csv"
+// export to CSV with python dlltrace.py ibr2.dtr ibr2.csv
+#define TRACE_NAME "ibr2.dtr"
 
-#include <windows.h> 
 #include <stdio.h> 
 #define _USE_MATH_DEFINES
 #include <math.h>
 
 #include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLTrace.h"
  
 void initialize_outputs (IEEE_Cigre_DLLInterface_Instance* pModel, ArrayMap *pMap, int nPorts)
 {
@@ -51,11 +52,14 @@ void update_inputs (IEEE_Cigre_DLLInterface_Instance* pModel, ArrayMap *pMap, do
   }
 }
 
-void set_parameter (Wrapped_IEEE_Cigre_DLL *pWrap, double val, int idx)
+void set_parameter (Wrapped_IEEE_Cigre_DLL *pWrap, double val, const char *name)
 {
-  char *pData = (char *) pWrap->pModel->Parameters;
-  ArrayMap *pMap = pWrap->pParameterMap;
-  memcpy (pData + pMap[idx].offset, &val, pMap[idx].size);
+  DLLPortHandle h = GetParameterHandle (pWrap, name);
+  if (h.index < 0) {
+    printf ("no parameter named %s\n", name);
+    return;
+  }
+  DLL_PARAMETER_REAL64 (pWrap, h) = val;
 }
 
 double extract_output (IEEE_Cigre_DLLInterface_Instance* pModel, ArrayMap *pMap, int idx)
@@ -84,11 +88,11 @@ int main( void )
   show_struct_alignment_requirements ();
   Wrapped_IEEE_Cigre_DLL *pWrap = CreateFirstDLLModel (DLL_NAME);
   if (NULL != pWrap) {
-    set_parameter (pWrap, 0.2, 12); // tstart_up
-    set_parameter (pWrap, 0.0, 53); // Rchoke
-    set_parameter (pWrap, 0.0, 54); // Lchoke
-    set_parameter (pWrap, 0.0, 55); // Cfilt
-    set_parameter (pWrap, 1.0e8, 56); // Rdamp
+    set_parameter (pWrap, 0.2, "tstart_up");
+    set_parameter (pWrap, 0.0, "Rchoke");
+    set_parameter (pWrap, 0.0, "Lchoke");
+    set_parameter (pWrap, 0.0, "Cfilt");
+    set_parameter (pWrap, 1.0e8, "Rdamp");
     PrintDLLModelParameters (pWrap);
     // initialize the model
     if (NULL != pWrap->Model_FirstCall) {
@@ -108,9 +112,8 @@ int main( void )
     double dt = pWrap->pInfo->FixedStepBaseSampleTime;
     printf("Looping with dt=%g, tmax=%g\n", dt, TMAX);
     double t = 0.0;
-    printf("opening %s\n", CSV_NAME);
-    FILE *fp = fopen (CSV_NAME, "w");
-    write_csv_header (fp, pWrap->pInfo);
+    printf("opening %s\n", TRACE_NAME);
+    DLLTraceWriter *pTrace = OpenDLLTraceAsync (TRACE_NAME, pWrap, 0, 0, 0);
     double tstop = TMAX + 0.5 * dt;
 
     // setting up for trapezoidal integration
@@ -138,16 +141,21 @@ int main( void )
       update_inputs (pWrap->pModel, pWrap->pInputMap, t, Ea/1000.0, Eb/1000.0, Ec/1000.0, Ia/1000.0, Ib/1000.0, Ic/1000.0);
 
       // execute the DLL for updated inverter voltages and other outputs
-      pWrap->Model_Outputs (pWrap->pModel);
+      int32_T rc = pWrap->Model_Outputs (pWrap->pModel);
       Ea = VDC_NOM * 0.5 * extract_output (pWrap->pModel, pWrap->pOutputMap, 0);
       Eb = VDC_NOM * 0.5 * extract_output (pWrap->pModel, pWrap->pOutputMap, 1);
       Ec = VDC_NOM * 0.5 * extract_output (pWrap->pModel, pWrap->pOutputMap, 2);
 
-      write_csv_values (fp, pWrap->pModel, pWrap->pInfo, pWrap->pInputMap, pWrap->pOutputMap, t);
-      check_messages ("Model_Outputs", pWrap->pModel);
+      if (NULL != pTrace) {
+        WriteDLLTraceRow (pTrace, t);
+      }
+      check_model_return ("Model_Outputs", pWrap->pModel, rc);
       t += dt;
     }
-    fclose (fp);
+    if (NULL != pTrace) {
+      PrintDLLTraceStats (pTrace);
+      CloseDLLTrace (pTrace);
+    }
     FreeFirstDLLModel (pWrap);
   }
   return 0;
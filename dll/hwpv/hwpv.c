@@ -11,9 +11,27 @@ November 11, 2024, TEMc
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
 #include <jansson.h>
 #include "IEEE_Cigre_DLLInterface.h"
-char ErrorMessage[1000];
+#include "IEEE_Cigre_DLLModelMessage.h"
+
+#if defined(_WIN32)
+#define DLL_EXPORT __declspec(dllexport)
+#define DLL_CALL __cdecl
+#else
+#define DLL_EXPORT __attribute__((visibility("default")))
+#define DLL_CALL
+#endif
+
+static char_T SharedMessage[DLL_MODEL_MESSAGE_BYTES];  // for programs that do not call Model_SetMessageBuffer
+
+#define HWPV_TANH_LIBM 0   // values of the Tanh parameter
+#define HWPV_TANH_FAST12 1
+#define HWPV_TANH_FAST7 2
 
 /* forward refs */
 void print_json(json_t *root);
@@ -139,31 +157,77 @@ void print_json_null(json_t *element, int indent) {
 //            calling Model_CheckParameters. If not, use Model_Initialize
 //  2 - freed in the DLL in Model_Terminate
 
+// y = sum over k of b[k] uw[k] - a[k] yw[k], for every channel at once; each array holds one row
+// of ldc channels per tap, and the window rows uw and yw are consecutive
+typedef void (*HWPV_IIR_FCN)(const real64_T *b, const real64_T *uw, int32_T nb, const real64_T *a,
+                             const real64_T *yw, int32_T na, int32_T ldc, real64_T *y);
+
 typedef struct _MyH {
   int32_T nin;
   int32_T nout;
   int32_T na;
   int32_T nb;
   int32_T nk;
-  real64_T ***a;     // index nout, nin, na
-  real64_T ***b;     // index nout, nin, nb
-  real64_T ***uhist; // index nout, nin, nb REVISIT
-  real64_T ***yhist; // index nout, nin, na REVISIT
+  int32_T nch;       // nout * nin channel pairs; input j to output i is channel j * nout + i
+  int32_T ldc;       // nch padded to HWPV_ALIGN_DOUBLES, the row stride of the arrays below
+  int32_T nring;     // history ring length, the larger of na and nb
+  int32_T head;      // ring row of the newest history entry, shared by every channel
+  real64_T *a;       // index na, ldc; taps stored oldest first, i.e., reversed from the JSON file
+  real64_T *b;       // index nb, ldc; taps stored oldest first, i.e., reversed from the JSON file
+  real64_T *uhist;   // index 2*nring, ldc; ring of past channel inputs, mirrored at +nring rows
+  real64_T *yhist;   // index 2*nring, ldc; ring of past channel outputs, mirrored at +nring rows
+  real64_T *uch;     // index ldc, the block inputs spread over the channels
+  real64_T *ynew;    // index ldc, the channel outputs of this step
   real64_T *ysum;    // index nout
+  HWPV_IIR_FCN iir;
 } MyH;
 
+// y = b + W x over nrows rows of W, each ld columns apart; x is zero-padded to ld
+typedef void (*HWPV_GEMV_FCN)(const real64_T *W, int32_T ld, int32_T nrows, const real64_T *b,
+                              const real64_T *x, real64_T *y);
+typedef void (*HWPV_TANH_FCN)(real64_T *y, int32_T n);  // in place over a hidden-layer vector
+// Y[i][n] = b[i] + sum over j < ncols of W[i][j] X[j][n], over nrows rows of W, ld apart, for the ldb
+// instances n side by side in every row of X and Y
+typedef void (*HWPV_GEMM_FCN)(const real64_T *W, int32_T ld, int32_T nrows, int32_T ncols, const real64_T *b,
+                              const real64_T *X, int32_T ldb, real64_T *Y);
+
 typedef struct _MyF {
   int32_T nin;
   int32_T nout;
   int32_T nhid;
-  real64_T **n0w; // index nhid, nin
-  real64_T **n2w; // index nout, nhid
+  int32_T ld0;    // row stride of n0w, nin padded to HWPV_ALIGN_DOUBLES
+  int32_T ld2;    // row stride of n2w, nhid padded to HWPV_ALIGN_DOUBLES
+  real64_T *n0w;  // index nhid, ld0, aligned and contiguous
+  real64_T *n2w;  // index nout, ld2, aligned and contiguous
   real64_T *n0b;  // index nhid
   real64_T *n2b;  // index nout
-  real64_T *yhid; // index nhid
+  real64_T *xin;  // index ld0, the block input with zero padding
+  real64_T *yhid; // index ld2, zero padding after nhid
   real64_T *yout; // index nout
+  HWPV_GEMV_FCN gemv;
+  HWPV_TANH_FCN activation;
 } MyF;
 
+typedef struct _MyKernels {  // chosen once per instance, in Model_CheckParameters
+  const char *name;
+  HWPV_GEMV_FCN gemv;
+  HWPV_TANH_FCN activation;
+  HWPV_IIR_FCN iir;
+  HWPV_GEMM_FCN gemm;
+} MyKernels;
+
+typedef struct _MyBatch {  // Model_OutputsBatch work space, [feature][instance] with ldb instances per row
+  int32_T capacity;  // instances, a multiple of HWPV_ALIGN_DOUBLES
+  int32_T ldb;       // the batch size padded to HWPV_ALIGN_DOUBLES
+  real64_T *x1;      // index F1 nin, ldb; normalized inputs
+  real64_T *h1;      // index F1 nhid, ldb
+  real64_T *y1;      // index F1 nout, ldb; the H1 inputs
+  real64_T *x2;      // index F2 nin, ldb; the H1 outputs
+  real64_T *h2;      // index F2 nhid, ldb
+  real64_T *y2;      // index F2 nout, ldb
+  real64_T *u;       // index F1 nout, one instance's H1 inputs
+} MyBatch;
+
 typedef struct _MyCoefficients {
   // training time step for H(z)
   real64_T t_step;
@@ -191,6 +255,8 @@ typedef struct _MyCoefficients {
   MyF *pF2;
   // normalized inputs
   real64_T *ub;
+  MyKernels kernels;
+  MyBatch *pBatch;  // NULL until this instance leads a Model_OutputsBatch call
 } MyCoefficients;
 
 // ----------------------------------------------------------------------
@@ -316,6 +382,7 @@ IEEE_Cigre_DLLInterface_Signal OutputSignals[] = {
 
 typedef struct _MyModelParameters {
   char_T *pFileName;
+  int32_T Tanh;
 } MyModelParameters;
 
 // Define Parameters
@@ -327,6 +394,16 @@ IEEE_Cigre_DLLInterface_Parameter Parameters[] = {
     .DataType = IEEE_Cigre_DLLInterface_DataType_c_string_T,
     .FixedValue = 1,  // 0 for parameters which can be modified at any time, 1 for parameters which need to be defined at T0 but cannot be changed.
     .DefaultValue.Char_Ptr = "bal3_fhf.json" // no minimum or maximum value
+  },
+  [1] = {
+    .Name = "Tanh",
+    .Description = "Hidden-layer tanh: 0=libm, 1=fast to 1e-12, 2=fast to 1e-7 relative error",
+    .Unit = "",
+    .DataType = IEEE_Cigre_DLLInterface_DataType_int32_T,
+    .FixedValue = 1,
+    .DefaultValue.Int32_Val = HWPV_TANH_LIBM,
+    .MinValue.Int32_Val = HWPV_TANH_LIBM,
+    .MaxValue.Int32_Val = HWPV_TANH_FAST7
   }
 };
 
@@ -343,6 +420,7 @@ IEEE_Cigre_DLLInterface_Model_Info Model_Info = {
   .ModelModifiedComment = "Version 0.0.0.8 for IEEE/Cigre DLL API V2",
   .ModelModifiedHistory = "History of Changes: V0.0.0.8 Initial model for API V1, V0.0.0.9 for IEEE P3743",
   .FixedStepBaseSampleTime = 0.002,                   // Time Step sampling time (sec) VARIABLE
+  .EMT_RMS_Mode = 3,                                  // EMT and RMS; the inputs and outputs are d-q quantities
 
   // Inputs
   .NumInputPorts = 9,
@@ -353,7 +431,7 @@ IEEE_Cigre_DLLInterface_Model_Info Model_Info = {
   .OutputPortsInfo = OutputSignals,
 
   // Parameters
-  .NumParameters = 1,
+  .NumParameters = 2,
   .ParametersInfo = Parameters,
 
   // Number of State Variables - this DLL will create its own internal storage
@@ -365,12 +443,26 @@ IEEE_Cigre_DLLInterface_Model_Info Model_Info = {
 // ----------------------------------------------------------------
 // Subroutines that can be called by the main power system program
 // ----------------------------------------------------------------
-__declspec(dllexport) const IEEE_Cigre_DLLInterface_Model_Info* __cdecl Model_GetInfo() {
+DLL_EXPORT const IEEE_Cigre_DLLInterface_Model_Info* DLL_CALL Model_GetInfo() {
   /* Returns Model Information
   */
   return &Model_Info;
 };
 
+DLL_EXPORT int32_T DLL_CALL Model_SetMessageBuffer(IEEE_Cigre_DLLInterface_Instance* instance, char_T* pBuffer, int32_T nBytes) {
+  /*   Optional: gives this instance message text of its own, so instances can run on different threads
+     Arguments: Instance specific model structure, and a buffer the program keeps until after Model_Terminate
+     Return:    Integer status 0 (normal), 2 if the buffer is too small
+  */
+  if (NULL == pBuffer || nBytes < DLL_MODEL_MESSAGE_BYTES) {
+    return IEEE_Cigre_DLLInterface_Return_Error;
+  }
+  pBuffer[0] = '\0';
+  instance->LastGeneralMessage = pBuffer;
+  instance->LastErrorMessage = pBuffer;
+  return IEEE_Cigre_DLLInterface_Return_OK;
+};
+
 char **make_string_array (json_t *pJson)
 {
   int n = json_array_size (pJson);
@@ -384,12 +476,491 @@ char **make_string_array (json_t *pJson)
   return ret;
 }
 
-MyF *load_F_block (json_t *pJson)
+// ------------------------------------------------------------------------------------------------
+// F block matrix-vector products. Each weight matrix is one aligned block with its rows padded to a
+// whole cache line, so the kernels need no remainder loops. The kernel is chosen once, when the
+// model is loaded, from the CPU features; HWPV_KERNEL=scalar, avx2 or avx512 in the environment
+// overrides the choice, e.g., to compare results or timings.
+// ------------------------------------------------------------------------------------------------
+
+#define HWPV_ALIGN_BYTES 64
+#define HWPV_ALIGN_DOUBLES (HWPV_ALIGN_BYTES / (int32_T) sizeof (real64_T))
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HWPV_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define HWPV_TARGET(isa)
+#else
+#define HWPV_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+static int32_T padded_doubles (int32_T n)
+{
+  return (n + HWPV_ALIGN_DOUBLES - 1) / HWPV_ALIGN_DOUBLES * HWPV_ALIGN_DOUBLES;
+}
+
+static real64_T *aligned_doubles (int32_T n)
+{
+  void *p = NULL;
+  size_t nBytes = sizeof (real64_T) * (n > 0 ? n : 1);
+#if defined(_WIN32)
+  p = _aligned_malloc (nBytes, HWPV_ALIGN_BYTES);
+#else
+  if (0 != posix_memalign (&p, HWPV_ALIGN_BYTES, nBytes)) {
+    p = NULL;
+  }
+#endif
+  if (NULL != p) {
+    memset (p, 0, nBytes);
+  }
+  return (real64_T *) p;
+}
+
+static void free_aligned (void *p)
+{
+#if defined(_WIN32)
+  _aligned_free (p);
+#else
+  free (p);
+#endif
+}
+
+static void gemv_scalar (const real64_T *W, int32_T ld, int32_T nrows, const real64_T *b,
+                         const real64_T *x, real64_T *y)
+{
+  for (int i = 0; i < nrows; i++) {
+    const real64_T *w = W + (size_t) i * ld;
+    real64_T sum = b[i];
+    for (int j = 0; j < ld; j++) {
+      sum += w[j] * x[j];
+    }
+    y[i] = sum;
+  }
+}
+
+#ifdef HWPV_X86
+// four rows at a time share each load of x
+HWPV_TARGET("avx2,fma") static void gemv_avx2 (const real64_T *W, int32_T ld, int32_T nrows, const real64_T *b,
+                                               const real64_T *x, real64_T *y)
+{
+  int i = 0;
+  for (; i + 4 <= nrows; i += 4) {
+    const real64_T *w = W + (size_t) i * ld;
+    __m256d s0 = _mm256_setzero_pd ();
+    __m256d s1 = _mm256_setzero_pd ();
+    __m256d s2 = _mm256_setzero_pd ();
+    __m256d s3 = _mm256_setzero_pd ();
+    for (int j = 0; j < ld; j += 4) {
+      __m256d xv = _mm256_load_pd (x + j);
+      s0 = _mm256_fmadd_pd (_mm256_load_pd (w + j), xv, s0);
+      s1 = _mm256_fmadd_pd (_mm256_load_pd (w + ld + j), xv, s1);
+      s2 = _mm256_fmadd_pd (_mm256_load_pd (w + 2 * ld + j), xv, s2);
+      s3 = _mm256_fmadd_pd (_mm256_load_pd (w + 3 * ld + j), xv, s3);
+    }
+    // horizontal sums of the four accumulators, as one vector of four row sums
+    __m256d h01 = _mm256_hadd_pd (s0, s1);
+    __m256d h23 = _mm256_hadd_pd (s2, s3);
+    __m256d sums = _mm256_add_pd (_mm256_permute2f128_pd (h01, h23, 0x20), _mm256_permute2f128_pd (h01, h23, 0x31));
+    _mm256_storeu_pd (y + i, _mm256_add_pd (sums, _mm256_loadu_pd (b + i)));
+  }
+  for (; i < nrows; i++) {
+    const real64_T *w = W + (size_t) i * ld;
+    __m256d s = _mm256_setzero_pd ();
+    for (int j = 0; j < ld; j += 4) {
+      s = _mm256_fmadd_pd (_mm256_load_pd (w + j), _mm256_load_pd (x + j), s);
+    }
+    __m128d h = _mm_add_pd (_mm256_castpd256_pd128 (s), _mm256_extractf128_pd (s, 1));
+    y[i] = b[i] + _mm_cvtsd_f64 (_mm_add_sd (h, _mm_unpackhi_pd (h, h)));
+  }
+}
+
+HWPV_TARGET("avx512f") static void gemv_avx512 (const real64_T *W, int32_T ld, int32_T nrows, const real64_T *b,
+                                                const real64_T *x, real64_T *y)
+{
+  int i = 0;
+  for (; i + 4 <= nrows; i += 4) {
+    const real64_T *w = W + (size_t) i * ld;
+    __m512d s0 = _mm512_setzero_pd ();
+    __m512d s1 = _mm512_setzero_pd ();
+    __m512d s2 = _mm512_setzero_pd ();
+    __m512d s3 = _mm512_setzero_pd ();
+    for (int j = 0; j < ld; j += 8) {
+      __m512d xv = _mm512_load_pd (x + j);
+      s0 = _mm512_fmadd_pd (_mm512_load_pd (w + j), xv, s0);
+      s1 = _mm512_fmadd_pd (_mm512_load_pd (w + ld + j), xv, s1);
+      s2 = _mm512_fmadd_pd (_mm512_load_pd (w + 2 * ld + j), xv, s2);
+      s3 = _mm512_fmadd_pd (_mm512_load_pd (w + 3 * ld + j), xv, s3);
+    }
+    y[i] = b[i] + _mm512_reduce_add_pd (s0);
+    y[i+1] = b[i+1] + _mm512_reduce_add_pd (s1);
+    y[i+2] = b[i+2] + _mm512_reduce_add_pd (s2);
+    y[i+3] = b[i+3] + _mm512_reduce_add_pd (s3);
+  }
+  for (; i < nrows; i++) {
+    const real64_T *w = W + (size_t) i * ld;
+    __m512d s = _mm512_setzero_pd ();
+    for (int j = 0; j < ld; j += 8) {
+      s = _mm512_fmadd_pd (_mm512_load_pd (w + j), _mm512_load_pd (x + j), s);
+    }
+    y[i] = b[i] + _mm512_reduce_add_pd (s);
+  }
+}
+
+static int cpu_has_avx2 (void)
+{
+#if defined(_MSC_VER)
+  int r[4];
+  __cpuid (r, 1);
+  if (!(r[2] & (1 << 27)) || !(r[2] & (1 << 12)) || (_xgetbv (0) & 0x6) != 0x6) {  // OSXSAVE, FMA, YMM state
+    return 0;
+  }
+  __cpuidex (r, 7, 0);
+  return (r[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+#endif
+}
+
+static int cpu_has_avx512 (void)
+{
+#if defined(_MSC_VER)
+  int r[4];
+  if (!cpu_has_avx2 () || (_xgetbv (0) & 0xe6) != 0xe6) {  // opmask and ZMM state
+    return 0;
+  }
+  __cpuidex (r, 7, 0);
+  return (r[1] & (1 << 16)) != 0;
+#else
+  return __builtin_cpu_supports ("avx512f");
+#endif
+}
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// Hidden-layer tanh over the whole vector at once. HWPV_TANH_LIBM calls tanh from libm, so the
+// outputs match earlier versions bit for bit. The fast modes select a numerator and denominator and
+// divide once, so the loops vectorize; -fno-trapping-math lets GCC evaluate both sides of each
+// select rather than branch. Below |x| = 0.625 they use a truncated Lambert continued fraction, and
+// above it (e - 1)/(e + 1) with e = exp(2|x|), from t = k ln2 + r, |r| <= ln2/2, a Taylor
+// polynomial in r and 2^k built in the exponent bits. HWPV_TANH_FAST12 keeps the relative error
+// to about 1e-12, and HWPV_TANH_FAST7, with shorter polynomials and saturation at |x| = 10, below 1e-8.
+// test_hwpv compare runs each mode against libm and reports the output deviations.
+// CMakeLists.txt sets -fno-trapping-math for the whole library, not just these loops. HWPV never
+// reads or traps on the floating-point exception flags, so the flag changes no results; it only
+// lets GCC hoist or speculate operations that could raise a flag, such as the unused side of a select.
+// ------------------------------------------------------------------------------------------------
+
+#define HWPV_LOG2E 1.4426950408889634
+#define HWPV_LN2_HI 6.93145751953125e-1          // ln2 = HI + LO, with k * HI exact
+#define HWPV_LN2_LO 1.42860682030941723212e-6
+#define HWPV_EXP_SHIFT 6755399441056767.0        // 1.5 * 2^52 + 1023: rounds to an integer and biases it
+
+static const real64_T exp_taylor[12] = {
+  1.0, 1.0, 1.0 / 2.0, 1.0 / 6.0, 1.0 / 24.0, 1.0 / 120.0, 1.0 / 720.0, 1.0 / 5040.0, 1.0 / 40320.0,
+  1.0 / 362880.0, 1.0 / 3628800.0, 1.0 / 39916800.0
+};
+
+// e^t for 0 <= t <= 40
+static inline real64_T exp_reduced (real64_T t, int degree)
+{
+  real64_T kd = t * HWPV_LOG2E + HWPV_EXP_SHIFT;  // k + 1023 in the low mantissa bits
+  uint64_t bits;
+  memcpy (&bits, &kd, sizeof (bits));
+  kd -= HWPV_EXP_SHIFT;
+  real64_T r = (t - kd * HWPV_LN2_HI) - kd * HWPV_LN2_LO;
+  real64_T p = exp_taylor[degree];
+  for (int j = degree - 1; j >= 0; j--) {
+    p = p * r + exp_taylor[j];
+  }
+  bits <<= 52;  // 2^k
+  real64_T scale;
+  memcpy (&scale, &bits, sizeof (scale));
+  return p * scale;
+}
+
+static inline real64_T tanh_fast12 (real64_T x)
+{
+  real64_T a = fabs (x);
+  real64_T z = a * a;
+  real64_T e = exp_reduced (2.0 * (a > 20.0 ? 20.0 : a), 11);
+  int bSmall = a < 0.625;
+  real64_T num = bSmall ? a * (135135.0 + z * (17325.0 + z * (378.0 + z))) : e - 1.0;
+  real64_T den = bSmall ? 135135.0 + z * (62370.0 + z * (3150.0 + 28.0 * z)) : e + 1.0;
+  return copysign (num / den, x);
+}
+
+static inline real64_T tanh_fast7 (real64_T x)
+{
+  real64_T a = fabs (x);
+  real64_T z = a * a;
+  real64_T e = exp_reduced (2.0 * (a > 10.0 ? 10.0 : a), 7);
+  int bSmall = a < 0.625;
+  real64_T num = bSmall ? a * (945.0 + z * (105.0 + z)) : e - 1.0;
+  real64_T den = bSmall ? 945.0 + z * (420.0 + 15.0 * z) : e + 1.0;
+  return copysign (num / den, x);
+}
+
+static void tanh_libm (real64_T *y, int32_T n)
+{
+  for (int i = 0; i < n; i++) {
+    y[i] = tanh (y[i]);
+  }
+}
+
+static void tanh12_scalar (real64_T *y, int32_T n)
+{
+  for (int i = 0; i < n; i++) {
+    y[i] = tanh_fast12 (y[i]);
+  }
+}
+
+static void tanh7_scalar (real64_T *y, int32_T n)
+{
+  for (int i = 0; i < n; i++) {
+    y[i] = tanh_fast7 (y[i]);
+  }
+}
+
+#ifdef HWPV_X86
+// the same loops, vectorized for the wider registers
+HWPV_TARGET("avx2,fma") static void tanh12_avx2 (real64_T *y, int32_T n)
+{
+  for (int i = 0; i < n; i++) {
+    y[i] = tanh_fast12 (y[i]);
+  }
+}
+
+HWPV_TARGET("avx2,fma") static void tanh7_avx2 (real64_T *y, int32_T n)
+{
+  for (int i = 0; i < n; i++) {
+    y[i] = tanh_fast7 (y[i]);
+  }
+}
+
+HWPV_TARGET("avx512f") static void tanh12_avx512 (real64_T *y, int32_T n)
+{
+  for (int i = 0; i < n; i++) {
+    y[i] = tanh_fast12 (y[i]);
+  }
+}
+
+HWPV_TARGET("avx512f") static void tanh7_avx512 (real64_T *y, int32_T n)
+{
+  for (int i = 0; i < n; i++) {
+    y[i] = tanh_fast7 (y[i]);
+  }
+}
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// H block taps across all channels; the loops over ldc channels vectorize without remainders. The
+// windows are oldest first, but the taps accumulate newest first, in the order of the per-channel
+// loops they replaced, so the scalar kernel matches those outputs bit for bit.
+// ------------------------------------------------------------------------------------------------
+
+static inline void iir_taps (const real64_T *b, const real64_T *uw, int32_T nb, const real64_T *a,
+                             const real64_T *yw, int32_T na, int32_T ldc, real64_T *y)
+{
+  for (int c = 0; c < ldc; c++) {
+    y[c] = 0.0;
+  }
+  for (int k = nb - 1; k >= 0; k--) {
+    const real64_T *bk = b + (size_t) k * ldc;
+    const real64_T *uk = uw + (size_t) k * ldc;
+    for (int c = 0; c < ldc; c++) {
+      y[c] += bk[c] * uk[c];
+    }
+  }
+  for (int k = na - 1; k >= 0; k--) {
+    const real64_T *ak = a + (size_t) k * ldc;
+    const real64_T *yk = yw + (size_t) k * ldc;
+    for (int c = 0; c < ldc; c++) {
+      y[c] -= ak[c] * yk[c];
+    }
+  }
+}
+
+static void iir_scalar (const real64_T *b, const real64_T *uw, int32_T nb, const real64_T *a,
+                        const real64_T *yw, int32_T na, int32_T ldc, real64_T *y)
+{
+  iir_taps (b, uw, nb, a, yw, na, ldc, y);
+}
+
+#ifdef HWPV_X86
+HWPV_TARGET("avx2,fma") static void iir_avx2 (const real64_T *b, const real64_T *uw, int32_T nb, const real64_T *a,
+                                              const real64_T *yw, int32_T na, int32_T ldc, real64_T *y)
+{
+  iir_taps (b, uw, nb, a, yw, na, ldc, y);
+}
+
+HWPV_TARGET("avx512f") static void iir_avx512 (const real64_T *b, const real64_T *uw, int32_T nb, const real64_T *a,
+                                               const real64_T *yw, int32_T na, int32_T ldc, real64_T *y)
+{
+  iir_taps (b, uw, nb, a, yw, na, ldc, y);
+}
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// Batched F block products. The activations of a batch are stored [feature][instance], with ldb a
+// multiple of HWPV_ALIGN_DOUBLES, so each weight is loaded once and broadcast across a block of
+// instances, several rows of W share each row of X, and there are no horizontal sums. Each product
+// starts from the bias and adds the columns in order, as gemv_scalar does.
+// ------------------------------------------------------------------------------------------------
+
+static void gemm_scalar (const real64_T *W, int32_T ld, int32_T nrows, int32_T ncols, const real64_T *b,
+                         const real64_T *X, int32_T ldb, real64_T *Y)
+{
+  for (int i = 0; i < nrows; i++) {
+    const real64_T *w = W + (size_t) i * ld;
+    real64_T *y = Y + (size_t) i * ldb;
+    for (int n = 0; n < ldb; n++) {
+      y[n] = b[i];
+    }
+    for (int j = 0; j < ncols; j++) {
+      const real64_T *x = X + (size_t) j * ldb;
+      for (int n = 0; n < ldb; n++) {
+        y[n] += w[j] * x[n];
+      }
+    }
+  }
+}
+
+#ifdef HWPV_X86
+// four rows by eight instances in eight accumulators
+HWPV_TARGET("avx2,fma") static void gemm_avx2 (const real64_T *W, int32_T ld, int32_T nrows, int32_T ncols,
+                                               const real64_T *b, const real64_T *X, int32_T ldb, real64_T *Y)
+{
+  for (int n = 0; n < ldb; n += 8) {
+    int i = 0;
+    for (; i + 4 <= nrows; i += 4) {
+      const real64_T *w = W + (size_t) i * ld;
+      __m256d s00 = _mm256_broadcast_sd (b + i), s01 = s00;
+      __m256d s10 = _mm256_broadcast_sd (b + i + 1), s11 = s10;
+      __m256d s20 = _mm256_broadcast_sd (b + i + 2), s21 = s20;
+      __m256d s30 = _mm256_broadcast_sd (b + i + 3), s31 = s30;
+      for (int j = 0; j < ncols; j++) {
+        const real64_T *x = X + (size_t) j * ldb + n;
+        __m256d x0 = _mm256_load_pd (x);
+        __m256d x1 = _mm256_load_pd (x + 4);
+        __m256d wv = _mm256_broadcast_sd (w + j);
+        s00 = _mm256_fmadd_pd (wv, x0, s00);
+        s01 = _mm256_fmadd_pd (wv, x1, s01);
+        wv = _mm256_broadcast_sd (w + ld + j);
+        s10 = _mm256_fmadd_pd (wv, x0, s10);
+        s11 = _mm256_fmadd_pd (wv, x1, s11);
+        wv = _mm256_broadcast_sd (w + 2 * ld + j);
+        s20 = _mm256_fmadd_pd (wv, x0, s20);
+        s21 = _mm256_fmadd_pd (wv, x1, s21);
+        wv = _mm256_broadcast_sd (w + 3 * ld + j);
+        s30 = _mm256_fmadd_pd (wv, x0, s30);
+        s31 = _mm256_fmadd_pd (wv, x1, s31);
+      }
+      real64_T *y = Y + (size_t) i * ldb + n;
+      _mm256_store_pd (y, s00);
+      _mm256_store_pd (y + 4, s01);
+      _mm256_store_pd (y + ldb, s10);
+      _mm256_store_pd (y + ldb + 4, s11);
+      _mm256_store_pd (y + 2 * ldb, s20);
+      _mm256_store_pd (y + 2 * ldb + 4, s21);
+      _mm256_store_pd (y + 3 * ldb, s30);
+      _mm256_store_pd (y + 3 * ldb + 4, s31);
+    }
+    for (; i < nrows; i++) {
+      const real64_T *w = W + (size_t) i * ld;
+      __m256d s0 = _mm256_broadcast_sd (b + i), s1 = s0;
+      for (int j = 0; j < ncols; j++) {
+        const real64_T *x = X + (size_t) j * ldb + n;
+        __m256d wv = _mm256_broadcast_sd (w + j);
+        s0 = _mm256_fmadd_pd (wv, _mm256_load_pd (x), s0);
+        s1 = _mm256_fmadd_pd (wv, _mm256_load_pd (x + 4), s1);
+      }
+      _mm256_store_pd (Y + (size_t) i * ldb + n, s0);
+      _mm256_store_pd (Y + (size_t) i * ldb + n + 4, s1);
+    }
+  }
+}
+
+// eight rows by eight instances, one register per row
+HWPV_TARGET("avx512f") static void gemm_avx512 (const real64_T *W, int32_T ld, int32_T nrows, int32_T ncols,
+                                                const real64_T *b, const real64_T *X, int32_T ldb, real64_T *Y)
+{
+  for (int n = 0; n < ldb; n += 8) {
+    int i = 0;
+    for (; i + 8 <= nrows; i += 8) {
+      const real64_T *w = W + (size_t) i * ld;
+      __m512d s[8];
+      for (int r = 0; r < 8; r++) {
+        s[r] = _mm512_set1_pd (b[i + r]);
+      }
+      for (int j = 0; j < ncols; j++) {
+        __m512d xv = _mm512_load_pd (X + (size_t) j * ldb + n);
+        for (int r = 0; r < 8; r++) {
+          s[r] = _mm512_fmadd_pd (_mm512_set1_pd (w[(size_t) r * ld + j]), xv, s[r]);
+        }
+      }
+      for (int r = 0; r < 8; r++) {
+        _mm512_store_pd (Y + (size_t) (i + r) * ldb + n, s[r]);
+      }
+    }
+    for (; i < nrows; i++) {
+      const real64_T *w = W + (size_t) i * ld;
+      __m512d s0 = _mm512_set1_pd (b[i]);
+      for (int j = 0; j < ncols; j++) {
+        s0 = _mm512_fmadd_pd (_mm512_set1_pd (w[j]), _mm512_load_pd (X + (size_t) j * ldb + n), s0);
+      }
+      _mm512_store_pd (Y + (size_t) i * ldb + n, s0);
+    }
+  }
+}
+#endif
+
+static HWPV_TANH_FCN pick_tanh (int32_T TanhMode, HWPV_TANH_FCN fast12, HWPV_TANH_FCN fast7)
+{
+  return (HWPV_TANH_FAST12 == TanhMode) ? fast12 : (HWPV_TANH_FAST7 == TanhMode) ? fast7 : tanh_libm;
+}
+
+// picks the kernels for this CPU and the Tanh parameter
+static void select_kernels (int32_T TanhMode, MyKernels *pKernels)
+{
+#ifdef HWPV_X86
+  const char *env = getenv ("HWPV_KERNEL");
+  int bAny = (NULL == env || '\0' == env[0]);
+  if ((bAny || 0 == strcmp (env, "avx512")) && cpu_has_avx512 ()) {
+    pKernels->name = "avx512";
+    pKernels->gemv = gemv_avx512;
+    pKernels->activation = pick_tanh (TanhMode, tanh12_avx512, tanh7_avx512);
+    pKernels->iir = iir_avx512;
+    pKernels->gemm = gemm_avx512;
+    return;
+  }
+  if ((bAny || 0 == strcmp (env, "avx2")) && cpu_has_avx2 ()) {
+    pKernels->name = "avx2";
+    pKernels->gemv = gemv_avx2;
+    pKernels->activation = pick_tanh (TanhMode, tanh12_avx2, tanh7_avx2);
+    pKernels->iir = iir_avx2;
+    pKernels->gemm = gemm_avx2;
+    return;
+  }
+#endif
+  pKernels->name = "scalar";
+  pKernels->gemv = gemv_scalar;
+  pKernels->activation = pick_tanh (TanhMode, tanh12_scalar, tanh7_scalar);
+  pKernels->iir = iir_scalar;
+  pKernels->gemm = gemm_scalar;
+}
+
+MyF *load_F_block (json_t *pJson, const MyKernels *pKernels)
 {
   MyF *pF = malloc (sizeof (*pF));
   pF->nin = pF->nout = pF->nhid = 0;
+  pF->ld0 = pF->ld2 = 0;
   pF->n0w = pF->n2w = NULL;
-  pF->n0b = pF->n2b = pF->yhid = pF->yout = NULL;
+  pF->n0b = pF->n2b = pF->xin = pF->yhid = pF->yout = NULL;
+  pF->gemv = pKernels->gemv;
+  pF->activation = pKernels->activation;
   const char *key;
   json_t *val;
   json_object_foreach (pJson, key, val) {
@@ -399,30 +970,27 @@ MyF *load_F_block (json_t *pJson)
       pF->nhid = json_integer_value (val);
     } else if (0 == strcmp(key, "n_out")) {
       pF->nout = json_integer_value (val);
-      pF->n0w = malloc (sizeof (real64_T *) * pF->nhid);
-      for (int i=0; i < pF->nhid; i++) {
-        pF->n0w[i] = malloc (sizeof (real64_T) * pF->nin);
-      }
-      pF->n2w = malloc (sizeof (real64_T *) * pF->nout);
-      for (int i=0; i < pF->nout; i++) {
-        pF->n2w[i] = malloc (sizeof (real64_T) * pF->nhid);
-      }
-      pF->n0b = malloc (sizeof (real64_T) * pF->nhid);
-      pF->n2b = malloc (sizeof (real64_T) * pF->nout);
-      pF->yhid = malloc (sizeof (real64_T) * pF->nhid);
-      pF->yout = malloc (sizeof (real64_T) * pF->nout);
+      pF->ld0 = padded_doubles (pF->nin);
+      pF->ld2 = padded_doubles (pF->nhid);
+      pF->n0w = aligned_doubles (pF->nhid * pF->ld0);
+      pF->n2w = aligned_doubles (pF->nout * pF->ld2);
+      pF->n0b = aligned_doubles (pF->nhid);
+      pF->n2b = aligned_doubles (pF->nout);
+      pF->xin = aligned_doubles (pF->ld0);
+      pF->yhid = aligned_doubles (pF->ld2);
+      pF->yout = aligned_doubles (pF->nout);
     } else if (0 == strcmp(key, "net.0.weight")) {
       for (int i=0; i < pF->nhid; i++) {
         json_t *row = json_array_get (val, i);
         for (int j=0; j < pF->nin; j++) {
-          pF->n0w[i][j] = json_real_value (json_array_get (row, j));
+          pF->n0w[i*pF->ld0 + j] = json_real_value (json_array_get (row, j));
         }
       }
     } else if (0 == strcmp(key, "net.2.weight")) {
       for (int i=0; i < pF->nout; i++) {
         json_t *row = json_array_get (val, i);
         for (int j=0; j < pF->nhid; j++) {
-          pF->n2w[i][j] = json_real_value (json_array_get (row, j));
+          pF->n2w[i*pF->ld2 + j] = json_real_value (json_array_get (row, j));
         }
       }
     } else if (0 == strcmp(key, "net.0.bias")) {
@@ -440,29 +1008,24 @@ MyF *load_F_block (json_t *pJson)
 
 void evaluate_F_block (MyF *pF, real64_T *u)
 {
-  for (int i = 0; i < pF->nhid; i++) {
-    pF->yhid[i] = pF->n0b[i];
-    for (int j = 0; j < pF->nin; j++) {
-      pF->yhid[i] += pF->n0w[i][j] * u[j];
-    }
-    pF->yhid[i] = tanh (pF->yhid[i]);
-  }
-  for (int i = 0; i < pF->nout; i++) {
-    pF->yout[i] = pF->n2b[i];
-    for (int j = 0; j < pF->nhid; j++) {
-      pF->yout[i] += pF->n2w[i][j] * pF->yhid[j];
-    }
-  }
+  memcpy (pF->xin, u, sizeof (real64_T) * pF->nin);  // the padding after nin stays zero
+  pF->gemv (pF->n0w, pF->ld0, pF->nhid, pF->n0b, pF->xin, pF->yhid);
+  pF->activation (pF->yhid, pF->nhid);
+  pF->gemv (pF->n2w, pF->ld2, pF->nout, pF->n2b, pF->yhid, pF->yout);
 }
 
-MyH *load_H_block (json_t *pJson)
+MyH *load_H_block (json_t *pJson, const MyKernels *pKernels)
 {
   char buf[100];
   int row, col;
   MyH *pH = malloc (sizeof (*pH));
   pH->nin = pH->nout = pH->na = pH->nb = pH->nk = 0;
+  pH->nch = pH->ldc = 0;
+  pH->nring = 1;
+  pH->head = 0;
   pH->a = pH->b = pH->uhist = pH->yhist = NULL;
-  pH->ysum = NULL;
+  pH->uch = pH->ynew = pH->ysum = NULL;
+  pH->iir = pKernels->iir;
   const char *key;
   json_t *val;
   json_object_foreach (pJson, key, val) {
@@ -476,118 +1039,91 @@ MyH *load_H_block (json_t *pJson)
       pH->nb = json_integer_value (val);
     } else if (0 == strcmp(key, "n_k")) {
       pH->nk = json_integer_value (val);
-      pH->a = malloc (sizeof (real64_T **) * pH->nout);
-      pH->b = malloc (sizeof (real64_T **) * pH->nout);
-      pH->uhist = malloc (sizeof (real64_T **) * pH->nout);
-      pH->yhist = malloc (sizeof (real64_T **) * pH->nout);
-      pH->ysum = malloc (sizeof (real64_T) * pH->nout);
-      for (int i = 0; i < pH->nout; i++) {
-        pH->a[i] = malloc (sizeof (real64_T *) * pH->nin);
-        pH->b[i] = malloc (sizeof (real64_T *) * pH->nin);
-        pH->uhist[i] = malloc (sizeof (real64_T *) * pH->nin);
-        pH->yhist[i] = malloc (sizeof (real64_T *) * pH->nin);
-        for (int j = 0; j < pH->nin; j++) {
-          pH->a[i][j] = malloc (sizeof (real64_T) * pH->na);
-          pH->yhist[i][j] = malloc (sizeof (real64_T) * pH->na);
-          memset (pH->yhist[i][j], 0, sizeof (real64_T) * pH->na);
-          pH->b[i][j] = malloc (sizeof (real64_T) * pH->nb);
-          pH->uhist[i][j] = malloc (sizeof (real64_T) * pH->nb);
-          memset (pH->uhist[i][j], 0, sizeof (real64_T) * pH->nb);
-        }
+      pH->nch = pH->nout * pH->nin;
+      pH->ldc = padded_doubles (pH->nch);
+      pH->nring = (pH->na > pH->nb) ? pH->na : pH->nb;
+      if (pH->nring < 1) {
+        pH->nring = 1;
       }
+      pH->a = aligned_doubles (pH->na * pH->ldc);
+      pH->b = aligned_doubles (pH->nb * pH->ldc);
+      pH->uhist = aligned_doubles (2 * pH->nring * pH->ldc);
+      pH->yhist = aligned_doubles (2 * pH->nring * pH->ldc);
+      pH->uch = aligned_doubles (pH->ldc);
+      pH->ynew = aligned_doubles (pH->ldc);
+      pH->ysum = aligned_doubles (pH->nout);
     } else if (0 == strncmp (key, "a_", 2)) {
       sscanf (key, "%[^_]_%d_%d", buf, &row, &col);
       //printf("   found %s and parsed %s[%d,%d] size %zd\n", key, buf, row, col, json_array_size(val));
       for (int i=0; i < pH->na; i++) {
-        pH->a[row][col][i] = json_real_value (json_array_get (val, i));
+        pH->a[(pH->na - 1 - i) * pH->ldc + col * pH->nout + row] = json_real_value (json_array_get (val, i));
       }
     } else if (0 == strncmp (key, "b_", 2)) {
       sscanf (key, "%[^_]_%d_%d", buf, &row, &col);
       //printf("   found %s and parsed %s[%d,%d] size %zd\n", key, buf, row, col, json_array_size(val));
       for (int i=0; i < pH->nb; i++) {
-        pH->b[row][col][i] = json_real_value (json_array_get (val, i));
+        pH->b[(pH->nb - 1 - i) * pH->ldc + col * pH->nout + row] = json_real_value (json_array_get (val, i));
       }
     }
   }
   return pH;
 }
 
+// The channel pairs are laid out side by side in every array, so each tap of H(z) is one multiply-add
+// across all channels, and each output sums nin consecutive rows of nout channels. The input and output
+// histories are rings of nring rows, advancing together from one head index. Each new row is written
+// twice, at its slot and nring rows later, so the newest nb inputs, or the newest na outputs, always
+// lie in one contiguous window, oldest first, that lines up with the reversed coefficients.
 void evaluate_H_block (MyH *pH, real64_T *u)
 {
-//for (int i = 0; i < pH->nout; i++) {
-//  for (int j = 0; j < pH->nin; j++) {
-//    pH->ysum[i] = u[j];
-//  }
-//}
-//return;
+  int32_T L = pH->nring;
+  int32_T ldc = pH->ldc;
+  int32_T head = (pH->head + 1 < L) ? pH->head + 1 : 0;
+  // add the latest inputs, then evaluate H(z) over the windows ending at the latest input and the
+  // previous output
+  for (int j = 0; j < pH->nin; j++) {
+    for (int i = 0; i < pH->nout; i++) {
+      pH->uch[j * pH->nout + i] = u[j];
+    }
+  }
+  memcpy (pH->uhist + (size_t) head * ldc, pH->uch, sizeof (real64_T) * ldc);
+  memcpy (pH->uhist + (size_t) (head + L) * ldc, pH->uch, sizeof (real64_T) * ldc);
+  pH->iir (pH->b, pH->uhist + (size_t) (head + L + 1 - pH->nb) * ldc, pH->nb,
+           pH->a, pH->yhist + (size_t) (pH->head + L + 1 - pH->na) * ldc, pH->na, ldc, pH->ynew);
+  memcpy (pH->yhist + (size_t) head * ldc, pH->ynew, sizeof (real64_T) * ldc);
+  memcpy (pH->yhist + (size_t) (head + L) * ldc, pH->ynew, sizeof (real64_T) * ldc);
+  pH->head = head;
+  // accumulate contributions from inputs to outputs
   for (int i = 0; i < pH->nout; i++) {
     pH->ysum[i] = 0.0;
-    for (int j = 0; j < pH->nin; j++) {
-      // local convenience pointers
-      real64_T *uh = pH->uhist[i][j];
-      real64_T *yh = pH->yhist[i][j];
-      real64_T *a = pH->a[i][j];
-      real64_T *b = pH->b[i][j];
-      // shift the input history one point, add the latest input
-      for (int k = pH->nb-1; k > 0; k--) {
-        uh[k] = uh[k-1];
-      }
-      uh[0] = u[j];
-      // evaluate H(z) for this input-output channel pair
-      real64_T ynew = 0.0;
-      for (int k = 0; k < pH->nb; k++) {
-        ynew += b[k] * uh[k];
-      }
-      for (int k = 0; k < pH->na; k++) {
-        ynew -= a[k] * yh[k];
-      }
-      // shift the output history one point, add the latest output
-      for (int k = pH->na-1; k > 0; k--) {
-        yh[k] = yh[k-1];
-      }
-//    if (fabs(yh[0] - ynew) > 1.0e-5) {
-//      printf("evaluate_H_block [%d][%d] changes ynew from %g to %g\n", i, j, yh[0], ynew);
-//      printf(" k            ub            uh             b            yh             a\n");
-//      for (int k=0; k < pH->na; k++) {
-//        printf("%2d %13g %13g %13g %13g %13g\n", k, u[k], uh[k], b[k], yh[k], a[k]);
-//      }
-//      //exit (EXIT_FAILURE);
-//    }
-      yh[0] = ynew;
-      // accumulate contributions from inputs to outputs
-      pH->ysum[i] += ynew;
+  }
+  for (int j = 0; j < pH->nin; j++) {
+    const real64_T *y = pH->ynew + j * pH->nout;
+    for (int i = 0; i < pH->nout; i++) {
+      pH->ysum[i] += y[i];
     }
   }
 }
 
 void initialize_H_history (MyH *pH, real64_T *u)
 {
-  for (int i = 0; i < pH->nout; i++) {
-    for (int j = 0; j < pH->nin; j++) {
-      // local convenience pointers
-      real64_T *uh = pH->uhist[i][j];
-      real64_T *yh = pH->yhist[i][j];
-      real64_T *a = pH->a[i][j];
-      real64_T *b = pH->b[i][j];
+  int32_T ldc = pH->ldc;
+  for (int j = 0; j < pH->nin; j++) {
+    for (int i = 0; i < pH->nout; i++) {
+      int32_T c = j * pH->nout + i;
       real64_T denominator = 1.0;
       real64_T numerator = 0.0;
-      for (int k = 0; k < pH->nb; k++) {
-        uh[k] = u[j];
-        numerator += b[k];
+      for (int k = pH->nb - 1; k >= 0; k--) {  // the coefficients are stored in reverse
+        numerator += pH->b[k * ldc + c];
       }
-      for (int k = 0; k < pH->na; k++) {
-        denominator += a[k];
+      for (int k = pH->na - 1; k >= 0; k--) {
+        denominator += pH->a[k * ldc + c];
       }
       real64_T ynew = u[j] * numerator / denominator;
-      for (int k = 0; k < pH->na; k++) {
-        yh[k] = ynew;
+      for (int k = 0; k < 2 * pH->nring; k++) {
+        pH->uhist[k * ldc + c] = u[j];
+        pH->yhist[k * ldc + c] = ynew;
       }
-      //printf("initialize_H_block [%d][%d] ynew=%g\n", i, j, ynew);
-      //printf(" k            ub            uh             b            yh             a\n");
-      //for (int k=0; k < pH->na; k++) {
-      //  printf("%2d %13g %13g %13g %13g %13g\n", k, u[k], uh[k], b[k], yh[k], a[k]);
-      //}
-      // exit (EXIT_FAILURE);
     }
   }
 }
@@ -643,7 +1179,7 @@ void set_coefficient_pointer (MyCoefficients *ptr, int32_T *pVals)
 }
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_CheckParameters(IEEE_Cigre_DLLInterface_Instance* instance) {
   /*   Checks the parameters on the given range
      Arguments: Instance specific model structure containing Inputs, Parameters and Outputs
      Return:  Integer status 0 (normal), 1 if messages are written, 2 for errors.  See IEEE_Cigre_DLLInterface_types.h
@@ -652,7 +1188,15 @@ __declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterf
   // Note - standard min/max checks should be done by the higher level GUI/Program
   MyModelParameters* parameters = (MyModelParameters*)instance->Parameters;
   MyCoefficients *pCoeff = NULL;
+  char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
+  ErrorMessage[0] = '\0';
 
+  if (parameters->Tanh < HWPV_TANH_LIBM || parameters->Tanh > HWPV_TANH_FAST7) {
+    snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "HWPV Error - Tanh=%d must be %d to %d\n",
+             parameters->Tanh, HWPV_TANH_LIBM, HWPV_TANH_FAST7);
+    instance->LastErrorMessage = ErrorMessage;
+    return IEEE_Cigre_DLLInterface_Return_Error;
+  }
   char_T *pFileName = parameters->pFileName;
   json_error_t json_error;
   json_t *pJson = json_load_file (pFileName, 0, &json_error);
@@ -671,6 +1215,8 @@ __declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterf
     pCoeff->pMaxs=NULL;
     pCoeff->ub=NULL;
 
+    pCoeff->pBatch=NULL;
+    select_kernels (parameters->Tanh, &pCoeff->kernels);
     const char *key;
     json_t *value;
     json_object_foreach (pJson, key, value) {
@@ -702,11 +1248,11 @@ __declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterf
       } else if (0 == strcmp (key, "normfacs")) {
         load_normalization_factors (pCoeff, value);
       } else if (0 == strcmp (key, "F1")) {
-        pCoeff->pF1 = load_F_block (value);
+        pCoeff->pF1 = load_F_block (value, &pCoeff->kernels);
       } else if (0 == strcmp (key, "F2")) {
-        pCoeff->pF2 = load_F_block (value);
+        pCoeff->pF2 = load_F_block (value, &pCoeff->kernels);
       } else if (0 == strcmp (key, "H1")) {
-        pCoeff->pH1 = load_H_block (value);
+        pCoeff->pH1 = load_H_block (value, &pCoeff->kernels);
       }
     }
     json_decref (pJson);
@@ -722,11 +1268,12 @@ __declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterf
       int j = i + pCoeff->nin;
       printf("  col_y[%d]=%6s %13g %13g %13g %13g\n", i, pCoeff->col_y[i], pCoeff->pScales[j], pCoeff->pOffsets[j], pCoeff->pMins[j], pCoeff->pMaxs[j]);
     }
-    printf("F1: nin=%d, nout=%d, nhid=%d\n", pCoeff->pF1->nin, pCoeff->pF1->nout, pCoeff->pF1->nhid);
+    printf("F1: nin=%d, nout=%d, nhid=%d, %s kernel, %s tanh\n", pCoeff->pF1->nin, pCoeff->pF1->nout, pCoeff->pF1->nhid, pCoeff->kernels.name,
+           (HWPV_TANH_FAST12 == parameters->Tanh) ? "fast 1e-12" : (HWPV_TANH_FAST7 == parameters->Tanh) ? "fast 1e-7" : "libm");
 //  for (int i=0; i < pCoeff->pF1->nhid; i++) {
 //    printf("n0w[%d]\n", i);
 //    for (int j=0; j < pCoeff->pF1->nin; j++) {
-//      printf("  %d=%g\n", j, pCoeff->pF1->n0w[i][j]);
+//      printf("  %d=%g\n", j, pCoeff->pF1->n0w[i*pCoeff->pF1->ld0 + j]);
 //    }
 //  }
     printf("H1: nin=%d, nout=%d, na=%d, nb=%d, nk=%d\n", pCoeff->pH1->nin, pCoeff->pH1->nout, pCoeff->pH1->na, pCoeff->pH1->nb, pCoeff->pH1->nk);
@@ -742,23 +1289,22 @@ __declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterf
 
   real64_T delt = Model_Info.FixedStepBaseSampleTime;
 
-  ErrorMessage[0] = '\0';
 //if (TE < 2.0*delt) {
 //  // write error message
-//  sprintf_s(ErrorMessage, sizeof(ErrorMessage), "SCRX9 Error - Parameter TE is: %f, but has been reset to be 2 times the time step: %f .\n", TE, delt);
+//  snprintf(ErrorMessage, sizeof(ErrorMessage), "SCRX9 Error - Parameter TE is: %f, but has been reset to be 2 times the time step: %f .\n", TE, delt);
 //  parameters->TE = 2.0*delt;
 //}
 //if (TB < 2.0*delt) {
 //  // write error message
-//  sprintf_s(ErrorMessage, sizeof(ErrorMessage), "SCRX9 Error - Parameter TB is: %f, but has been reset to be 2 times the time step: %f .\n", TB, delt);
+//  snprintf(ErrorMessage, sizeof(ErrorMessage), "SCRX9 Error - Parameter TB is: %f, but has been reset to be 2 times the time step: %f .\n", TB, delt);
 //  parameters->TB = 2.0*delt;
 //}
   instance->LastGeneralMessage = ErrorMessage;
-  return IEEE_Cigre_DLLInterface_Return_OK;
+  return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Initialize(IEEE_Cigre_DLLInterface_Instance* instance) {
   /*   Initializes the system by resetting the internal states
      Arguments: Instance specific model structure containing Inputs, Parameters and Outputs
      Return:  Integer status 0 (normal), 1 if messages are written, 2 for errors.  See IEEE_Cigre_DLLInterface_types.h
@@ -777,18 +1323,20 @@ __declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_I
   MyCoefficients *pCoeff = get_coefficient_pointer (instance->IntStates);
   printf("Restored t_step=%g from %p\n", pCoeff->t_step, pCoeff);
 
+  char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
   ErrorMessage[0] = '\0';
 
   instance->LastGeneralMessage = ErrorMessage;
-  return IEEE_Cigre_DLLInterface_Return_OK;
+  return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Outputs(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Outputs(IEEE_Cigre_DLLInterface_Instance* instance) {
   /*   Calculates output equation
      Arguments: Instance specific model structure containing Inputs, Parameters and Outputs
      Return:  Integer status 0 (normal), 1 if messages are written, 2 for errors.  See IEEE_Cigre_DLLInterface_types.h
   */
+  char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
   ErrorMessage[0] = '\0';
 
   MyModelParameters* parameters = (MyModelParameters*)instance->Parameters;
@@ -820,53 +1368,184 @@ __declspec(dllexport) int32_T __cdecl Model_Outputs(IEEE_Cigre_DLLInterface_Inst
   }
 
   instance->LastGeneralMessage = ErrorMessage;
-  return IEEE_Cigre_DLLInterface_Return_OK;
+  return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
-void free_F_block (MyF *pF)
+// ----------------------------------------------------------------
+// Batched outputs for plants with many units of one trained model. The instances must have loaded
+// the same JSON file with the same Tanh mode. The weights and work space of the first instance
+// serve the whole batch, and the F blocks run as matrix-matrix products over the batch. Each
+// instance keeps its own H1 history, so it can still be stepped alone, saved or restored between
+// batches.
+
+static void free_batch (MyBatch *pBatch)
+{
+  if (NULL == pBatch) {
+    return;
+  }
+  free_aligned (pBatch->x1);
+  free_aligned (pBatch->h1);
+  free_aligned (pBatch->y1);
+  free_aligned (pBatch->x2);
+  free_aligned (pBatch->h2);
+  free_aligned (pBatch->y2);
+  free_aligned (pBatch->u);
+  free (pBatch);
+}
+
+// work space for at least n instances, or NULL if it could not be allocated
+static MyBatch *reserve_batch (MyCoefficients *pCoeff, int32_T n)
+{
+  MyBatch *pBatch = pCoeff->pBatch;
+  int32_T ldb = padded_doubles (n);
+
+  if (NULL == pBatch || pBatch->capacity < ldb) {
+    free_batch (pBatch);
+    pCoeff->pBatch = NULL;
+    if (NULL == (pBatch = malloc (sizeof (*pBatch)))) {
+      return NULL;  // Model_OutputsBatch steps the instances one at a time
+    }
+    pBatch->capacity = ldb;
+    pBatch->x1 = aligned_doubles (pCoeff->pF1->nin * ldb);
+    pBatch->h1 = aligned_doubles (pCoeff->pF1->nhid * ldb);
+    pBatch->y1 = aligned_doubles (pCoeff->pF1->nout * ldb);
+    pBatch->x2 = aligned_doubles (pCoeff->pF2->nin * ldb);
+    pBatch->h2 = aligned_doubles (pCoeff->pF2->nhid * ldb);
+    pBatch->y2 = aligned_doubles (pCoeff->pF2->nout * ldb);
+    pBatch->u = aligned_doubles (pCoeff->pF1->nout);
+    if (NULL == pBatch->x1 || NULL == pBatch->h1 || NULL == pBatch->y1 || NULL == pBatch->x2 ||
+        NULL == pBatch->h2 || NULL == pBatch->y2 || NULL == pBatch->u) {
+      free_batch (pBatch);
+      pBatch = NULL;
+    }
+    pCoeff->pBatch = pBatch;
+  }
+  if (NULL != pBatch) {
+    pBatch->ldb = ldb;
+  }
+  return pBatch;
+}
+
+static int same_trained_model (IEEE_Cigre_DLLInterface_Instance *pLead, IEEE_Cigre_DLLInterface_Instance *instance)
 {
-  for (int i=0; i < pF->nhid; i++) {
-    free (pF->n0w[i]);
+  MyModelParameters *pLeadParms = (MyModelParameters*)pLead->Parameters;
+  MyModelParameters *parameters = (MyModelParameters*)instance->Parameters;
+  return NULL != get_coefficient_pointer (instance->IntStates) && pLeadParms->Tanh == parameters->Tanh &&
+         0 == strcmp (pLeadParms->pFileName, parameters->pFileName);
+}
+
+DLL_EXPORT int32_T DLL_CALL Model_OutputsBatch(IEEE_Cigre_DLLInterface_Instance** instances, int32_T n) {
+  /*   Calculates the output equations of n instances at once, each at its own Time
+     Arguments: n instance structures that loaded the same JSON file, with the same Tanh
+     Return:  the highest status over the instances; instances of different models are stepped one at a time
+  */
+  int32_T worst = IEEE_Cigre_DLLInterface_Return_OK;
+  MyCoefficients *pCoeff = (n > 0) ? get_coefficient_pointer (instances[0]->IntStates) : NULL;
+  MyBatch *pBatch = NULL;
+  int bSame = (NULL != pCoeff);
+
+  for (int k = 1; k < n && bSame; k++) {
+    bSame = same_trained_model (instances[0], instances[k]);
+  }
+  if (bSame) {
+    pBatch = reserve_batch (pCoeff, n);
+  }
+  if (NULL == pBatch) {
+    for (int k = 0; k < n; k++) {
+      int32_T rc = Model_Outputs (instances[k]);
+      worst = (rc > worst) ? rc : worst;
+    }
+    return worst;
   }
-  for (int i=0; i < pF->nout; i++) {
-    free (pF->n2w[i]);
+  MyF *pF1 = pCoeff->pF1;
+  MyF *pF2 = pCoeff->pF2;
+  int32_T ldb = pBatch->ldb;
+  HWPV_GEMM_FCN gemm = pCoeff->kernels.gemm;
+
+  // normalize the input vectors
+  for (int k = 0; k < n; k++) {
+    real64_T *inputs = (real64_T *)instances[k]->ExternalInputs;
+    for (int i = 0; i < pCoeff->nin; i++) {
+      pBatch->x1[i * ldb + k] = (inputs[i] - pCoeff->pOffsets[i]) / pCoeff->pScales[i];
+    }
+  }
+
+  // evaluate F1
+  gemm (pF1->n0w, pF1->ld0, pF1->nhid, pF1->nin, pF1->n0b, pBatch->x1, ldb, pBatch->h1);
+  pF1->activation (pBatch->h1, pF1->nhid * ldb);
+  gemm (pF1->n2w, pF1->ld2, pF1->nout, pF1->nhid, pF1->n2b, pBatch->h1, ldb, pBatch->y1);
+
+  // evaluate H1 on each instance's own history
+  for (int k = 0; k < n; k++) {
+    IEEE_Cigre_DLLInterface_Instance *instance = instances[k];
+    MyH *pH = get_coefficient_pointer (instance->IntStates)->pH1;
+    for (int i = 0; i < pF1->nout; i++) {
+      pBatch->u[i] = pBatch->y1[i * ldb + k];
+    }
+    if (instance->Time <= 0.0) {
+      initialize_H_history (pH, pBatch->u);
+    }
+    evaluate_H_block (pH, pBatch->u);
+    for (int i = 0; i < pH->nout; i++) {
+      pBatch->x2[i * ldb + k] = pH->ysum[i];
+    }
   }
-  free (pF->n0w);
-  free (pF->n2w);
-  free (pF->n0b);
-  free (pF->n2b);
-  free (pF->yhid);
-  free (pF->yout);
+
+  // evaluate F2
+  gemm (pF2->n0w, pF2->ld0, pF2->nhid, pF2->nin, pF2->n0b, pBatch->x2, ldb, pBatch->h2);
+  pF2->activation (pBatch->h2, pF2->nhid * ldb);
+  gemm (pF2->n2w, pF2->ld2, pF2->nout, pF2->nhid, pF2->n2b, pBatch->h2, ldb, pBatch->y2);
+
+  // de-normalize the output vectors
+  for (int k = 0; k < n; k++) {
+    IEEE_Cigre_DLLInterface_Instance *instance = instances[k];
+    real64_T *outputs = (real64_T *)instance->ExternalOutputs;
+    char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
+    for (int i = 0; i < pCoeff->nout; i++) {
+      outputs[i] = pBatch->y2[i * ldb + k] * pCoeff->pScales[i+pCoeff->nin] + pCoeff->pOffsets[i+pCoeff->nin];
+    }
+    ErrorMessage[0] = '\0';
+    instance->LastGeneralMessage = ErrorMessage;
+  }
+  return worst;
+};
+
+void free_F_block (MyF *pF)
+{
+  free_aligned (pF->n0w);
+  free_aligned (pF->n2w);
+  free_aligned (pF->n0b);
+  free_aligned (pF->n2b);
+  free_aligned (pF->xin);
+  free_aligned (pF->yhid);
+  free_aligned (pF->yout);
   free (pF);
 }
 
 void free_H_block (MyH *pH)
 {
-  for (int i=0; i < pH->nout; i++) {
-    for (int j=0; j < pH->nin; j++) {
-      free (pH->a[i][j]);
-      free (pH->b[i][j]);
-      free (pH->uhist[i][j]);
-      free (pH->yhist[i][j]);
-    }
-    free (pH->a[i]);
-    free (pH->b[i]);
-    free (pH->uhist[i]);
-    free (pH->yhist[i]);
-  }
-  free (pH->a);
-  free (pH->b);
-  free (pH->uhist);
-  free (pH->yhist);
-  free (pH->ysum);
+  free_aligned (pH->a);
+  free_aligned (pH->b);
+  free_aligned (pH->uhist);
+  free_aligned (pH->yhist);
+  free_aligned (pH->uch);
+  free_aligned (pH->ynew);
+  free_aligned (pH->ysum);
   free (pH);
 }
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Terminate(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Terminate(IEEE_Cigre_DLLInterface_Instance* instance) {
   /*   Destroys any objects allocated by the model code 
   */
   MyCoefficients *pCoeff = get_coefficient_pointer (instance->IntStates);
+  char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
+
+  ErrorMessage[0] = '\0';
+  instance->LastGeneralMessage = ErrorMessage;
+  if (NULL == pCoeff) {  // Model_CheckParameters failed, or already terminated
+    return IEEE_Cigre_DLLInterface_Return_OK;
+  }
 
   free (pCoeff->activation);
 
@@ -890,20 +1569,103 @@ __declspec(dllexport) int32_T __cdecl Model_Terminate(IEEE_Cigre_DLLInterface_In
 
   free (pCoeff->ub);
 
+  free_batch (pCoeff->pBatch);
   free_H_block (pCoeff->pH1);
   free_F_block (pCoeff->pF1);
   free_F_block (pCoeff->pF2);
 
   free (pCoeff);
+  set_coefficient_pointer (NULL, instance->IntStates);
+
+  return IEEE_Cigre_DLLInterface_Return_OK;
+};
+
+// ----------------------------------------------------------------
+// Snapshot hooks for the wrapper. The only state that carries from one step to the next is the
+// H1 history; everything else under the coefficient pointer is fixed after Model_CheckParameters
+// or recomputed in each Model_Outputs. The IntStates hold that pointer, so they are not saved.
+
+#define HWPV_STATE_HEADER 4  // nout, nin, na, nb, to refuse histories from a different model
+
+static int32_T H_history_bytes (MyH *pH)
+{
+  return (int32_T) (HWPV_STATE_HEADER * sizeof (int32_T) + pH->nout * pH->nin * (pH->na + pH->nb) * sizeof (real64_T));
+}
+
+// copies channel c of one history ring to (bSave) or from n flat values, newest first
+static void copy_ring (MyH *pH, real64_T *pRing, int32_T c, real64_T *pFlat, int32_T n, int bSave)
+{
+  int32_T slot = pH->head;
+  for (int k = 0; k < n; k++) {
+    if (bSave) {
+      pFlat[k] = pRing[slot * pH->ldc + c];
+    } else {
+      pRing[slot * pH->ldc + c] = pRing[(slot + pH->nring) * pH->ldc + c] = pFlat[k];
+    }
+    slot = (slot > 0) ? slot - 1 : pH->nring - 1;
+  }
+}
 
+// copies the H block history to (bSave) or from a flat buffer after the dimensions. The flat
+// layout is newest first for each channel pair, independent of where the ring head is.
+static void copy_H_history (MyH *pH, real64_T *pFlat, int bSave)
+{
+  for (int i = 0; i < pH->nout; i++) {
+    for (int j = 0; j < pH->nin; j++) {
+      copy_ring (pH, pH->uhist, j * pH->nout + i, pFlat, pH->nb, bSave);
+      copy_ring (pH, pH->yhist, j * pH->nout + i, pFlat + pH->nb, pH->na, bSave);
+      pFlat += pH->nb + pH->na;
+    }
+  }
+}
+
+DLL_EXPORT int32_T DLL_CALL Model_SaveState(IEEE_Cigre_DLLInterface_Instance* instance, void *pBuffer, int32_T nBytes) {
+  /*   Writes the filter histories for a snapshot
+     Return:  bytes needed if pBuffer is NULL, otherwise bytes written, -1 if nBytes is too small
+  */
+  MyCoefficients *pCoeff = get_coefficient_pointer (instance->IntStates);
+  MyH *pH = pCoeff->pH1;
+  int32_T nNeeded = H_history_bytes (pH);
+  int32_T *pDims = (int32_T *)pBuffer;
+
+  if (NULL == pBuffer) {
+    return nNeeded;
+  }
+  if (nBytes < nNeeded) {
+    return -1;
+  }
+  pDims[0] = pH->nout;
+  pDims[1] = pH->nin;
+  pDims[2] = pH->na;
+  pDims[3] = pH->nb;
+  copy_H_history (pH, (real64_T *)(pDims + HWPV_STATE_HEADER), 1);
+  return nNeeded;
+};
+
+DLL_EXPORT int32_T DLL_CALL Model_RestoreState(IEEE_Cigre_DLLInterface_Instance* instance, const void *pBuffer, int32_T nBytes) {
+  /*   Reads the filter histories from a snapshot into an initialized instance
+     Return:  Integer status 0 (normal), 2 if the snapshot came from different model dimensions
+  */
+  MyCoefficients *pCoeff = get_coefficient_pointer (instance->IntStates);
+  MyH *pH = pCoeff->pH1;
+  const int32_T *pDims = (const int32_T *)pBuffer;
+
+  char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
   ErrorMessage[0] = '\0';
   instance->LastGeneralMessage = ErrorMessage;
-
+  if (nBytes != H_history_bytes (pH) || pDims[0] != pH->nout || pDims[1] != pH->nin ||
+      pDims[2] != pH->na || pDims[3] != pH->nb) {
+    snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "HWPV Error - snapshot dimensions do not match the model in %s\n",
+             ((MyModelParameters*)instance->Parameters)->pFileName);
+    instance->LastErrorMessage = ErrorMessage;
+    return IEEE_Cigre_DLLInterface_Return_Error;
+  }
+  copy_H_history (pH, (real64_T *)(pDims + HWPV_STATE_HEADER), 0);
   return IEEE_Cigre_DLLInterface_Return_OK;
 };
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_PrintInfo() {
+DLL_EXPORT int32_T DLL_CALL Model_PrintInfo() {
   /* Prints Model Information once
   */
   int Printed = 0;
@@ -2,7 +2,7 @@
 
 // see https://learn.microsoft.com/en-us/windows/win32/dlls/using-run-time-dynamic-linking
 
-#define DLL_NAME "hwpv.dll"
+#define DLL_NAME DLL_FILE_NAME("HWPV")
 
 #define JSON_FILE1 "C:\\src\\pecblocks\\examples\\hwpv\\bal3\\bal3_fhf.json"
 #define JSON_FILE2 "C:\\src\\pecblocks\\examples\\hwpv\\ucf4t\\ucf4t_fhf.json"
@@ -13,12 +13,17 @@
 #define TMAX 8.0
 // relative output path for execution from the build directory, e.g., release\test or debug\test
 #define CSV_NAME "hwpv.csv"
+#define RMS_CSV_NAME "hwpv_rms.csv"
+#define RMS_HOST_STEP 0.01
+#define RMS_ITERATIONS 10
+#define BATCH_INSTANCES 16
+#define BATCH_TOLERANCE 1.0e-9  // largest batched deviation, relative to the largest output of the lone instance
 
-#include <windows.h> 
 #include <stdio.h>
 #include <math.h>
 
 #include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLRms.h"
  
 // interpolated inputs
 
@@ -201,34 +206,261 @@ void extract_outputs (IEEE_Cigre_DLLInterface_Instance* pModel, ArrayMap *pMap,
   memcpy (pIq, pData + pMap[3].offset, pMap[3].size);
 }
 
-int main( void ) 
+// the grid is a resistance Rg, so each RMS network solution is Vd=Rg*Id and Vq=Rg*Iq from the latest outputs
+int32_T rms_network (void *pContext, Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps, double t, int iteration)
+{
+  Wrapped_IEEE_Cigre_DLL *pWrap = ppWraps[0];
+  double Id, Iq;
+  double Rg = interpolate (&Rg_table, t);
+  (void) pContext;
+  (void) NumWraps;
+  (void) iteration;
+  extract_outputs (pWrap->pModel, pWrap->pOutputMap, &Id, &Iq);
+  update_inputs (pWrap->pModel, pWrap->pInputMap, t, Rg * Id, Rg * Iq);
+  return IEEE_Cigre_DLLInterface_Return_OK;
+}
+
+// sets the JSON file and the Tanh mode, then checks parameters and initializes the instance
+void setup_instance (Wrapped_IEEE_Cigre_DLL *pWrap, int TanhMode)
+{
+  union EditValueU val;
+  DLLPortHandle hJSON = GetParameterHandle (pWrap, "JSONfile");
+  val.Char_Ptr = JSON_FILE5;
+  edit_dll_value ((char *)pWrap->pModel->Parameters, hJSON.offset, hJSON.dtype, hJSON.size, val);
+  DLLPortHandle hTanh = GetParameterHandle (pWrap, "Tanh");
+  val.Int32_Val = TanhMode;
+  edit_dll_value ((char *)pWrap->pModel->Parameters, hTanh.offset, hTanh.dtype, hTanh.size, val);
+  PrintDLLModelParameters (pWrap);
+  if (NULL != pWrap->Model_FirstCall) {
+    pWrap->Model_FirstCall (pWrap->pModel);
+  }
+  printf("calling CheckParameters\n");
+  pWrap->Model_CheckParameters (pWrap->pModel);
+  check_messages ("Model_CheckParameters", pWrap->pModel);
+  printf("calling Initialize\n");
+  initialize_outputs (pWrap->pModel, pWrap->pOutputMap);
+  pWrap->Model_Initialize (pWrap->pModel);
+  check_messages ("Model_Initialize", pWrap->pModel);
+}
+
+// the RMS loop on a new instance of the class, created in RMS mode
+void run_rms (DLLModelClass *pClass, double HostStep, int MaxIterations)
+{
+  DLLRmsOptions options = {HostStep, MaxIterations, 1.0e-4, 1.0e-4, DLL_RMS_ITERATE_AUTO};
+  if (!SetDLLModelClassMode (pClass, 2)) {
+    return;
+  }
+  Wrapped_IEEE_Cigre_DLL *pWrap = CreateDLLModelInstance (pClass);
+  if (NULL == pWrap) {
+    return;
+  }
+  setup_instance (pWrap, 0);
+  DLLRmsLoop *pLoop = CreateDLLRmsLoop (&pWrap, 1, &options, rms_network, NULL);
+  if (NULL == pLoop) {
+    FreeDLLModelInstance (pWrap);
+    return;
+  }
+  printf("RMS looping with host step=%g, up to %d iterations, tmax=%g\n", HostStep, MaxIterations, TMAX);
+  printf("opening %s\n", RMS_CSV_NAME);
+  FILE *fp = fopen (RMS_CSV_NAME, "w");
+  write_csv_header (fp, pWrap->pInfo);
+  double tstop = TMAX + 0.5 * HostStep;
+  for (long k = 0; k * HostStep <= tstop; k++) {
+    double t = k * HostStep;
+    int32_T rc = DLLRmsStep (pLoop, t);
+    write_csv_values (fp, pWrap->pModel, pWrap->pInfo, pWrap->pInputMap, pWrap->pOutputMap, t);
+    check_model_return ("DLLRmsStep", pWrap->pModel, rc);
+  }
+  fclose (fp);
+  PrintDLLRmsStats (pLoop);
+  FreeDLLRmsLoop (pLoop);
+  FreeDLLModelInstance (pWrap);
+}
+
+// runs one instance per fast Tanh mode in lockstep with the libm instance pRef, each closing its own
+// loop through the grid resistance, and reports how far each output strays from the libm trace
+void run_compare (Wrapped_IEEE_Cigre_DLL *pRef)
+{
+  DLLPortHandle hTanh = GetParameterHandle (pRef, "Tanh");
+  int nModes = pRef->pInfo->ParametersInfo[hTanh.index].MaxValue.Int32_Val + 1;
+  int nOut = pRef->pInfo->NumOutputPorts;
+  Wrapped_IEEE_Cigre_DLL **ppWraps = calloc (nModes, sizeof (Wrapped_IEEE_Cigre_DLL *));
+  double *pId = calloc (nModes, sizeof (double));
+  double *pIq = calloc (nModes, sizeof (double));
+  double *pMaxRef = calloc (nOut, sizeof (double));
+  double *pMaxDev = calloc (nModes * nOut, sizeof (double));
+  long *pStepsDiffering = calloc (nModes, sizeof (long));
+
+  ppWraps[0] = pRef;
+  for (int k = 1; k < nModes; k++) {
+    ppWraps[k] = CreateDLLModelInstance (pRef->pClass);
+    setup_instance (ppWraps[k], k);
+  }
+  double dt = pRef->pInfo->FixedStepBaseSampleTime;
+  double tstop = TMAX + 0.5 * dt;
+  long nSteps = 0;
+  printf("Comparing %d Tanh modes with dt=%g, tmax=%g\n", nModes, dt, TMAX);
+  for (double t = 0.0; t <= tstop; t += dt) {
+    double Rg = interpolate (&Rg_table, t);
+    for (int k = 0; k < nModes; k++) {
+      Wrapped_IEEE_Cigre_DLL *pWrap = ppWraps[k];
+      pWrap->pModel->Time = t;
+      update_inputs (pWrap->pModel, pWrap->pInputMap, t, Rg * pId[k], Rg * pIq[k]);
+      int32_T rc = pWrap->Model_Outputs (pWrap->pModel);
+      extract_outputs (pWrap->pModel, pWrap->pOutputMap, &pId[k], &pIq[k]);
+      check_model_return ("Model_Outputs", pWrap->pModel, rc);
+    }
+    const char *pRefData = (const char *) pRef->pModel->ExternalOutputs;
+    for (int k = 1; k < nModes; k++) {
+      const char *pData = (const char *) ppWraps[k]->pModel->ExternalOutputs;
+      int bDiffers = 0;
+      for (int i = 0; i < nOut; i++) {
+        ArrayMap *pMap = &pRef->pOutputMap[i];
+        double yRef = read_dll_real64 (pRefData + pMap->offset, pMap->dtype);
+        double dev = fabs (read_dll_real64 (pData + pMap->offset, pMap->dtype) - yRef);
+        if (fabs (yRef) > pMaxRef[i]) {
+          pMaxRef[i] = fabs (yRef);
+        }
+        if (dev > pMaxDev[k * nOut + i]) {
+          pMaxDev[k * nOut + i] = dev;
+        }
+        if (dev != 0.0) {
+          bDiffers = 1;
+        }
+      }
+      pStepsDiffering[k] += bDiffers;
+    }
+    ++nSteps;
+  }
+  for (int k = 1; k < nModes; k++) {
+    printf("Tanh=%d against libm over %ld steps, %ld steps differ\n", k, nSteps, pStepsDiffering[k]);
+    printf("  %-8s %13s %13s %13s\n", "Output", "Max |libm|", "Max Dev", "Relative");
+    for (int i = 0; i < nOut; i++) {
+      double dev = pMaxDev[k * nOut + i];
+      printf("  %-8s %13.6g %13.6g %13.6g\n", pRef->pInfo->OutputPortsInfo[i].Name, pMaxRef[i], dev,
+             pMaxRef[i] > 0.0 ? dev / pMaxRef[i] : dev);
+    }
+    FreeDLLModelInstance (ppWraps[k]);
+  }
+  free (ppWraps);
+  free (pId);
+  free (pIq);
+  free (pMaxRef);
+  free (pMaxDev);
+  free (pStepsDiffering);
+}
+
+// runs n more instances through Model_OutputsBatch in lockstep with pRef, which steps alone through
+// Model_Outputs, each closing its own loop through the grid resistance, and reports how far the
+// batched outputs stray from pRef. Returns the number of outputs that stray beyond BATCH_TOLERANCE.
+int run_batch (Wrapped_IEEE_Cigre_DLL *pRef, int n)
+{
+  int nOut = pRef->pInfo->NumOutputPorts;
+  Wrapped_IEEE_Cigre_DLL **ppWraps = calloc (n, sizeof (Wrapped_IEEE_Cigre_DLL *));
+  double *pId = calloc (n + 1, sizeof (double));
+  double *pIq = calloc (n + 1, sizeof (double));
+  double *pMaxRef = calloc (nOut, sizeof (double));
+  double *pMaxDev = calloc (nOut, sizeof (double));
+  long nDiffering = 0;
+  int nFailed = 0;
+
+  for (int k = 0; k < n; k++) {
+    ppWraps[k] = CreateDLLModelInstance (pRef->pClass);
+    setup_instance (ppWraps[k], 0);
+  }
+  printf("Batch of %d instances %s Model_OutputsBatch\n", n, NULL != pRef->Model_OutputsBatch ? "through" : "without");
+  double dt = pRef->pInfo->FixedStepBaseSampleTime;
+  double tstop = TMAX + 0.5 * dt;
+  long nSteps = 0;
+  for (double t = 0.0; t <= tstop; t += dt) {
+    double Rg = interpolate (&Rg_table, t);
+    pRef->pModel->Time = t;
+    update_inputs (pRef->pModel, pRef->pInputMap, t, Rg * pId[n], Rg * pIq[n]);
+    check_model_return ("Model_Outputs", pRef->pModel, pRef->Model_Outputs (pRef->pModel));
+    extract_outputs (pRef->pModel, pRef->pOutputMap, &pId[n], &pIq[n]);
+    for (int k = 0; k < n; k++) {
+      ppWraps[k]->pModel->Time = t;
+      update_inputs (ppWraps[k]->pModel, ppWraps[k]->pInputMap, t, Rg * pId[k], Rg * pIq[k]);
+    }
+    int32_T rc = DLLModelOutputsBatch (ppWraps, n);
+    const char *pRefData = (const char *) pRef->pModel->ExternalOutputs;
+    for (int i = 0; i < nOut; i++) {
+      ArrayMap *pMap = &pRef->pOutputMap[i];
+      double ref = fabs (read_dll_real64 (pRefData + pMap->offset, pMap->dtype));
+      if (ref > pMaxRef[i]) {
+        pMaxRef[i] = ref;
+      }
+    }
+    for (int k = 0; k < n; k++) {
+      const char *pData = (const char *) ppWraps[k]->pModel->ExternalOutputs;
+      int bDiffers = 0;
+      check_model_return ("DLLModelOutputsBatch", ppWraps[k]->pModel, rc);
+      extract_outputs (ppWraps[k]->pModel, ppWraps[k]->pOutputMap, &pId[k], &pIq[k]);
+      for (int i = 0; i < nOut; i++) {
+        ArrayMap *pMap = &pRef->pOutputMap[i];
+        double dev = fabs (read_dll_real64 (pData + pMap->offset, pMap->dtype) - read_dll_real64 (pRefData + pMap->offset, pMap->dtype));
+        if (dev > pMaxDev[i]) {
+          pMaxDev[i] = dev;
+        }
+        if (dev != 0.0) {
+          bDiffers = 1;
+        }
+      }
+      nDiffering += bDiffers;
+    }
+    ++nSteps;
+  }
+  printf("%ld instance steps, %ld differ from the instance stepped alone\n", nSteps * n, nDiffering);
+  printf("  %-8s %13s %13s %13s\n", "Output", "Max |alone|", "Max Dev", "Relative");
+  for (int i = 0; i < nOut; i++) {
+    double rel = pMaxRef[i] > 0.0 ? pMaxDev[i] / pMaxRef[i] : pMaxDev[i];
+    int bFailed = (rel > BATCH_TOLERANCE);
+    printf("  %-8s %13.6g %13.6g %13.6g %s\n", pRef->pInfo->OutputPortsInfo[i].Name, pMaxRef[i], pMaxDev[i], rel,
+           bFailed ? "FAIL" : "ok");
+    nFailed += bFailed;
+  }
+  printf("Batch tolerance %g: %d outputs failed\n", BATCH_TOLERANCE, nFailed);
+  for (int k = 0; k < n; k++) {
+    FreeDLLModelInstance (ppWraps[k]);
+  }
+  free (ppWraps);
+  free (pId);
+  free (pIq);
+  free (pMaxRef);
+  free (pMaxDev);
+  return nFailed;
+}
+
+// test_hwpv runs the EMT loop at the model's own time step; test_hwpv rms [host_step [iterations]]
+// runs the RMS loop instead, test_hwpv compare runs the EMT loop with each Tanh mode against libm,
+// and test_hwpv batch [n] runs n instances through Model_OutputsBatch against one stepped alone
+int main (int argc, char *argv[]) 
 {
   show_struct_alignment_requirements ();
   Wrapped_IEEE_Cigre_DLL *pWrap = CreateFirstDLLModel (DLL_NAME);
   if (NULL != pWrap) {
-    // overwrite default JSON file with an actual one, knowing this is parameter 0
-    union EditValueU val;
-    val.Char_Ptr = JSON_FILE5;
-    edit_dll_value ((char *)pWrap->pModel->Parameters, 
-                      pWrap->pParameterMap[0].offset, 
-                      pWrap->pParameterMap[0].dtype, 
-                      pWrap->pParameterMap[0].size,
-                      val);
-    PrintDLLModelParameters (pWrap);
-    // initialize the model
-    if (NULL != pWrap->Model_FirstCall) {
-      pWrap->Model_FirstCall (pWrap->pModel);
-    }
-    printf("calling CheckParameters\n");
-    pWrap->Model_CheckParameters (pWrap->pModel);
-    check_messages ("Model_CheckParameters", pWrap->pModel);
-
-    // initialize time-stepping
+    // overwrite default JSON file with an actual one, found by name, and initialize the model
     initialize_tables ();
-    printf("calling Initialize\n");
-    initialize_outputs (pWrap->pModel, pWrap->pOutputMap);
-    pWrap->Model_Initialize (pWrap->pModel);
-    check_messages ("Model_Initialize", pWrap->pModel);
+    setup_instance (pWrap, 0);  // Tanh=0 is libm
+
+    if (argc > 1 && 0 == strcmp (argv[1], "rms")) {
+      run_rms (pWrap->pClass, argc > 2 ? atof (argv[2]) : RMS_HOST_STEP, argc > 3 ? atoi (argv[3]) : RMS_ITERATIONS);
+      FreeFirstDLLModel (pWrap);
+      free_tables ();
+      return 0;
+    }
+    if (argc > 1 && 0 == strcmp (argv[1], "compare")) {
+      run_compare (pWrap);
+      FreeFirstDLLModel (pWrap);
+      free_tables ();
+      return 0;
+    }
+    if (argc > 1 && 0 == strcmp (argv[1], "batch")) {
+      int nFailed = run_batch (pWrap, argc > 2 ? atoi (argv[2]) : BATCH_INSTANCES);
+      FreeFirstDLLModel (pWrap);
+      free_tables ();
+      return nFailed;
+    }
 
     // time step loop, matching the DLL's desired time step
     double dt = pWrap->pInfo->FixedStepBaseSampleTime;
@@ -250,10 +482,10 @@ int main( void )
       Vd = Rg * Id;
       Vq = Rg * Iq;
       update_inputs (pWrap->pModel, pWrap->pInputMap, t, Vd, Vq);
-      pWrap->Model_Outputs (pWrap->pModel);
+      int32_T rc = pWrap->Model_Outputs (pWrap->pModel);
       extract_outputs (pWrap->pModel, pWrap->pOutputMap, &Id, &Iq);
       write_csv_values (fp, pWrap->pModel, pWrap->pInfo, pWrap->pInputMap, pWrap->pOutputMap, t);
-      check_messages ("Model_Outputs", pWrap->pModel);
+      check_model_return ("Model_Outputs", pWrap->pModel, rc);
       t += dt;
     }
     fclose (fp);
@@ -0,0 +1,52 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Contingency fan-out: initialize and run one instance to a branch time, then fork a child process per case
+
+#ifndef __IEEE_Cigre_DLLFanout__
+#define __IEEE_Cigre_DLLFanout__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLTrace.h"
+
+typedef struct _DLLDisturbance_ {  // a step change in an input or parameter
+  double Time;                     // seconds, at or after the branch time
+  const char *Name;                // an input port or parameter; inputs are searched first
+  double Value;
+} DLLDisturbance;
+
+typedef struct _DLLContingency_ {
+  const char *Name;
+  const char *TraceFile;           // NULL writes no trace
+  const DLLTracePolicy *pPolicy;   // NULL traces every port at every step
+  int NumDisturbances;
+  const DLLDisturbance *pDisturbances;
+} DLLContingency;
+
+typedef struct _DLLContingencyResult_ {
+  int Pid;
+  int ExitCode;                    // 0 if the case ran to the end time; see DLL_FANOUT_ codes
+  int Signal;                      // the signal that killed the child, or 0
+  double Seconds;                  // from fork to exit, as seen by the parent
+  long MaxRSSKilobytes;            // peak resident set of the child, shared pages included
+} DLLContingencyResult;
+
+#define DLL_FANOUT_OK 0
+#define DLL_FANOUT_MODEL_ERROR 1   // Model_Outputs returned IEEE_Cigre_DLLInterface_Return_Error
+#define DLL_FANOUT_BAD_CASE 2      // a disturbance names no input or parameter
+#define DLL_FANOUT_TRACE_ERROR 3   // the trace file could not be opened
+
+// sets the inputs that are not disturbed, before each Model_Outputs at time t; may be NULL to hold
+// the inputs. Disturbances are written after it returns, so they hold until the next disturbance.
+typedef void (*DLL_FANOUT_STEP_FCN)(Wrapped_IEEE_Cigre_DLL *pWrap, double t, void *pUser);
+
+// pWrap must be through Model_CheckParameters and Model_Initialize, with its Time at the start of
+// the run. The parent steps it to tBranch, then forks one child per case, keeping at most MaxWorkers
+// alive (0 uses the core count). Each child steps its copy to tEnd and writes its own trace. The
+// parent's instance is left at tBranch. Returns the number of cases that did not exit with
+// DLL_FANOUT_OK, or -1 if the instance failed before tBranch or nothing could be forked. pResults, if not NULL, gets NumCases entries.
+// Fork copies only the calling thread, so call this before starting scheduler or trace threads.
+int RunDLLContingencies (Wrapped_IEEE_Cigre_DLL *pWrap, double tBranch, double tEnd,
+                         const DLLContingency *pCases, int NumCases, int MaxWorkers,
+                         DLL_FANOUT_STEP_FCN StepFcn, void *pUser, DLLContingencyResult *pResults);
+
+#endif
@@ -0,0 +1,72 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// A queue of model messages with severity and timestamps, posted from any thread and rate limited
+// per instance and message text
+
+#ifndef __IEEE_Cigre_DLLMessages__
+#define __IEEE_Cigre_DLLMessages__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLThreads.h"
+
+#define DLL_MESSAGE_TEXT_BYTES 256
+#define DLL_MESSAGE_QUEUE_CAPACITY 1024
+#define DLL_MESSAGE_RATE_SLOTS 1024  // distinct (instance, text) pairs tracked by the rate limit at once
+
+typedef struct _DLLMessage_ {
+  real64_T Time;             // model time of the instance that posted it
+  uint64_t Nanoseconds;      // DLLMonotonicNanoseconds when posted
+  int32_T Severity;          // IEEE_Cigre_DLLInterface_Return_Message or IEEE_Cigre_DLLInterface_Return_Error
+  long Repeats;              // copies suppressed by the rate limit since this text was last queued
+  const void *pSource;       // the posting instance, for matching messages to instances
+  char Source[32];           // model name
+  char Location[32];         // entry point or other context
+  char Text[DLL_MESSAGE_TEXT_BYTES];
+} DLLMessage;
+
+typedef struct _DLLMessageRate_ {  // last queued time of one message text from one instance
+  const void *pSource;       // NULL for an empty slot
+  uint32_t Hash;
+  real64_T LastTime;
+  long Suppressed;
+  long long LastPosted;      // NumPosted when the pair last came in; the lowest in a full window is reused
+} DLLMessageRate;
+
+typedef struct _DLLMessageQueue_ {
+  int Capacity;
+  DLLMessage *pMessages;     // ring of Capacity messages
+  long Head;                 // messages posted, guarded by the lock
+  long Tail;                 // messages popped, guarded by the lock
+  DLL_ATOMIC_LONG Ticket;    // ticket lock; posting only happens when a model returns a message
+  DLL_ATOMIC_LONG Serving;
+  real64_T MinInterval;      // model seconds between queued copies of the same text, 0 for no limit
+  DLLMessageRate *pRates;    // DLL_MESSAGE_RATE_SLOTS, open addressing
+  long long NumPosted;
+  long long NumSuppressed;   // by the rate limit
+  long long NumDropped;      // lost while the ring was full
+  long long NumEvicted;      // rate slots taken over by a new pair
+} DLLMessageQueue;
+
+// Capacity 0 uses DLL_MESSAGE_QUEUE_CAPACITY; returns NULL if out of memory
+DLLMessageQueue * CreateDLLMessageQueue (int Capacity, double MinInterval);
+
+void FreeDLLMessageQueue (DLLMessageQueue *pQueue);
+
+// queues one message; returns 1 if queued, 0 if rate limited or dropped because the ring is full
+int PostDLLMessage (DLLMessageQueue *pQueue, const void *pSource, const char *source, const char *loc,
+                    double t, int32_T Severity, const char *text);
+
+// queues the message of an instance after one of its entry points returned rc, reading
+// LastErrorMessage or LastGeneralMessage only when rc is not IEEE_Cigre_DLLInterface_Return_OK.
+// Safe to call from the thread that stepped the instance; returns rc.
+int32_T PostDLLModelMessages (DLLMessageQueue *pQueue, Wrapped_IEEE_Cigre_DLL *pWrap, const char *loc, int32_T rc);
+
+// copies out and removes the oldest message; returns 0 if the queue is empty
+int PopDLLMessage (DLLMessageQueue *pQueue, DLLMessage *pMessage);
+
+// pops and prints every queued message; returns the number printed
+int PrintDLLMessages (DLLMessageQueue *pQueue);
+
+void PrintDLLMessageStats (DLLMessageQueue *pQueue);
+
+#endif
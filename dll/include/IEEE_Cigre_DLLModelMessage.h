@@ -0,0 +1,34 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Message text owned by each model instance, for model DLLs. A model that exports the optional
+// Model_SetMessageBuffer hook lets the simulation tool hand every instance a text buffer of its own,
+// so two instances stepped on different threads never write the same buffer. The hook keeps that
+// buffer in the instance's LastGeneralMessage and LastErrorMessage, which only the model writes. A
+// tool that never calls the hook must start them at NULL, as in a zeroed instance, and the model then
+// uses its one shared buffer instead.
+// Each entry point clears the text at the top, and returns IEEE_Cigre_DLLInterface_Return_Message
+// after writing it, so the tool only reads LastGeneralMessage when there is something to read.
+//
+//   int32_T Model_SetMessageBuffer (IEEE_Cigre_DLLInterface_Instance *instance, char_T *pBuffer, int32_T nBytes)
+//
+// is called before any other entry point of the instance. The tool owns pBuffer and keeps it until
+// after Model_Terminate. The hook returns IEEE_Cigre_DLLInterface_Return_Error, keeping the shared
+// buffer, if nBytes is less than DLL_MODEL_MESSAGE_BYTES.
+
+#ifndef __IEEE_Cigre_DLLModelMessage__
+#define __IEEE_Cigre_DLLModelMessage__
+
+#include "IEEE_Cigre_DLLInterface.h"
+
+#define DLL_MODEL_MESSAGE_BYTES 512  // the most text a model writes, with its terminating null
+
+// the text buffer of instance: the one from Model_SetMessageBuffer, or else Shared, the model's
+// own buffer of DLL_MODEL_MESSAGE_BYTES that entry points point LastGeneralMessage at
+#define DLL_MODEL_MESSAGE(instance, Shared) \
+  ((NULL != (instance)->LastGeneralMessage) ? (char_T *) (instance)->LastGeneralMessage : (Shared))
+
+// the return value of an entry point that wrote pText, or left it empty, and had no error
+#define DLL_MODEL_MESSAGE_RETURN(pText) \
+  (('\0' != (pText)[0]) ? IEEE_Cigre_DLLInterface_Return_Message : IEEE_Cigre_DLLInterface_Return_OK)
+
+#endif
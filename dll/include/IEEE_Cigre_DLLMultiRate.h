@@ -0,0 +1,60 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Multi-rate stepping of DLL models on an integer tick clock, from a firing table over the hyperperiod
+
+#ifndef __IEEE_Cigre_DLLMultiRate__
+#define __IEEE_Cigre_DLLMultiRate__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+
+#define DLL_TICKS_PER_SECOND 1000000000LL   // sample times are resolved to 1 ns before taking the GCD
+#define DLL_MAX_HYPERPERIOD_TICKS 1048576   // longer hyperperiods fall back to the next due tick per model
+
+// runs a batch of models that are due at the same tick, e.g. DLLSchedulerBatch; returns the
+// highest Model_Outputs return value
+typedef int32_T (*DLL_BATCH_FCN)(void *pContext, Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps);
+
+typedef struct _DLLMultiRateScheduler_ {
+  int NumModels;
+  Wrapped_IEEE_Cigre_DLL **ppWraps;
+  long long *pPeriodTicks;        // FixedStepBaseSampleTime of each model, in ticks
+  long long TickNanoseconds;      // GCD of the host step and all model sample times
+  double TickSeconds;
+  long long HostTicks;            // host step, in ticks
+  long long HyperPeriodTicks;     // LCM of all model periods, 0 if the table was not built
+  int NumFiringTicks;             // ticks of the hyperperiod at which some model is due
+  long long *pFiringTick;         // those ticks, ascending from 0
+  int *pFiringStart;              // NumFiringTicks+1 offsets into pFiring
+  Wrapped_IEEE_Cigre_DLL **pFiring; // models due at each firing tick, in model order
+  int NextFiring;                 // index in pFiringTick of the next firing to run
+  long long CycleTicks;           // first tick of the hyperperiod that holds NextFiring
+  Wrapped_IEEE_Cigre_DLL **pDue;  // scratch list when there is no table
+  long long NextTick;             // first tick not yet run
+  long long HostTick;             // tick reached at the end of the next host step
+  long long *pCalls;              // Model_Outputs calls per model
+  DLL_BATCH_FCN RunBatch;         // NULL calls Model_Outputs serially
+  void *pBatchContext;
+} DLLMultiRateScheduler;
+
+// builds the firing table for models on a common host step; returns NULL if a sample time is not
+// positive or does not resolve to whole nanoseconds
+DLLMultiRateScheduler * CreateDLLMultiRateScheduler (double HostStep, Wrapped_IEEE_Cigre_DLL **ppWraps, int NumModels);
+
+// advances one host step, calling Model_Outputs on each model at every one of its sample times up
+// to the new host time, with Time set from the integer tick count. The first call runs tick 0. Only
+// the ticks at which some model is due are visited, so a fine tick costs nothing between firings.
+int32_T DLLMultiRateStep (DLLMultiRateScheduler *pSched);
+
+// host time at the end of the most recent DLLMultiRateStep
+double DLLMultiRateTime (DLLMultiRateScheduler *pSched);
+
+void PrintDLLMultiRateTable (DLLMultiRateScheduler *pSched);
+
+void FreeDLLMultiRateScheduler (DLLMultiRateScheduler *pSched);
+
+// for host glue that steps one model on its own: returns 1 if model step number nStep, at time
+// nStep * dt, is due at host_time. Comparing against a product instead of a running sum of dt
+// keeps the model clock from drifting over long runs.
+int DLLModelStepDue (double host_time, long long nStep, double dt);
+
+#endif
@@ -0,0 +1,44 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Hardware performance counters around a block of model steps; perf_event on Linux, unavailable elsewhere
+
+#ifndef __IEEE_Cigre_DLLPerfCounters__
+#define __IEEE_Cigre_DLLPerfCounters__
+
+#include <stdint.h>
+
+enum DLLPerfCounter {
+  DLL_PERF_CYCLES,
+  DLL_PERF_INSTRUCTIONS,
+  DLL_PERF_BRANCHES,
+  DLL_PERF_BRANCH_MISSES,
+  DLL_PERF_L1D_MISSES,     // L1 data cache read misses
+  DLL_PERF_LLC_MISSES,     // last-level cache misses
+  DLL_NUM_PERF_COUNTERS
+};
+
+typedef struct _DLLPerfCounters_ {
+  int NumOpen;                               // 0 when counters are not available
+  int pFd[DLL_NUM_PERF_COUNTERS];            // -1 for a counter that could not be opened
+  uint64_t pValues[DLL_NUM_PERF_COUNTERS];   // counts between the last start and stop, scaled if multiplexed
+  int bScaled;                               // the kernel multiplexed at least one counter
+} DLLPerfCounters;
+
+// opens every counter it can for the calling thread, user mode only; returns the number opened.
+// Containers and restrictive perf_event_paranoid settings often allow none, which is not an error.
+int OpenDLLPerfCounters (DLLPerfCounters *pCounters);
+
+// zeroes and enables the open counters
+void StartDLLPerfCounters (DLLPerfCounters *pCounters);
+
+// disables the open counters and reads them into pValues
+void StopDLLPerfCounters (DLLPerfCounters *pCounters);
+
+void CloseDLLPerfCounters (DLLPerfCounters *pCounters);
+
+// 1 if counter i was read by the last StopDLLPerfCounters
+int DLLPerfCounterValid (const DLLPerfCounters *pCounters, int i);
+
+const char *DLLPerfCounterName (int i);
+
+#endif
@@ -0,0 +1,53 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Adapts a host time step to a model's FixedStepBaseSampleTime, interpolating inputs into model
+// sub-steps and extrapolating outputs between model steps
+
+#ifndef __IEEE_Cigre_DLLRateAdapter__
+#define __IEEE_Cigre_DLLRateAdapter__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+
+#define DLL_RATE_INPUT_HOLD 0      // every model step inside a host step sees the newest host sample
+#define DLL_RATE_INPUT_LINEAR 1    // between the last two host samples
+#define DLL_RATE_INPUT_CUBIC 2     // through the last four host samples, linear until there are four
+
+#define DLL_RATE_OUTPUT_HOLD 0     // the host sees the newest model outputs until the next model step
+#define DLL_RATE_OUTPUT_LINEAR 1   // extrapolated from the last two model steps to the host time
+
+#define DLL_RATE_HOST_SAMPLES 4
+
+typedef struct _DLLRateAdapter_ {
+  Wrapped_IEEE_Cigre_DLL *pWrap;
+  int InputMode;
+  int OutputMode;
+  int NumInputs;
+  int NumOutputs;
+  double dt;                  // FixedStepBaseSampleTime
+  long long NextStep;         // first model step not yet run, at NextStep * dt
+  int NumHostSamples;         // up to DLL_RATE_HOST_SAMPLES
+  double HostTimes[DLL_RATE_HOST_SAMPLES];  // oldest first
+  double *pHostInputs;        // DLL_RATE_HOST_SAMPLES rows of NumInputs, in the order of HostTimes
+  double *pModelInput;        // scratch row for one model step
+  int NumModelSamples;        // up to 2
+  double ModelTimes[2];       // oldest first
+  double *pModelOutputs;      // 2 rows of NumOutputs, in the order of ModelTimes
+  long long NumHostSteps;
+  long long NumModelSteps;
+} DLLRateAdapter;
+
+// an adapter for an instance that has been through Model_CheckParameters and Model_Initialize,
+// or NULL if out of memory
+DLLRateAdapter * CreateDLLRateAdapter (Wrapped_IEEE_Cigre_DLL *pWrap, int InputMode, int OutputMode);
+
+// takes the host inputs at host_time, one double per model input port in port order, runs every
+// model step due by host_time with interpolated inputs, and writes one double per model output port
+// at host_time. Real ports are interpolated and extrapolated; other ports are held. Calls at the
+// same host_time replace that host sample. Returns the highest Model_Outputs return value, or
+// stops at the first model step that returns IEEE_Cigre_DLLInterface_Return_Error and returns it,
+// leaving pOutputs unchanged; the host should then stop stepping the model.
+int32_T DLLRateAdapterStep (DLLRateAdapter *pAdapter, double host_time, const double *pInputs, double *pOutputs);
+
+void FreeDLLRateAdapter (DLLRateAdapter *pAdapter);
+
+#endif
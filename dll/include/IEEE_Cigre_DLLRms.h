@@ -0,0 +1,70 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// RMS co-simulation: a phasor-domain host step, then Model_Iterate rounds until the model outputs converge
+
+#ifndef __IEEE_Cigre_DLLRms__
+#define __IEEE_Cigre_DLLRms__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+
+#define DLL_RMS_ITERATE_AUTO 0    // Model_Iterate if the model exports it, otherwise replay
+#define DLL_RMS_ITERATE_MODEL 1   // Model_Iterate only; models without it keep their outputs
+#define DLL_RMS_ITERATE_REPLAY 2  // restore the states saved before the host step and repeat Model_Outputs
+
+#define DLL_RMS_MAX_ITERATIONS 20
+
+// the host's network solution at time t: reads the model outputs and writes the model inputs.
+// Iteration 0 comes before the models step; iteration k > 0 comes before the k'th Model_Iterate round.
+typedef int32_T (*DLL_RMS_NETWORK_FCN)(void *pContext, Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps,
+                                       double t, int iteration);
+
+typedef struct _DLLRmsOptions_ {
+  double HostStep;           // seconds, typically 0.005 to 0.02; a whole multiple of each model's sample time
+  int MaxIterations;         // Model_Iterate rounds per host step, at most DLL_RMS_MAX_ITERATIONS
+  double AbsTol;             // converged when every real output moves by less than
+  double RelTol;             //   AbsTol + RelTol * |output| in one round
+  int IterateMode;           // DLL_RMS_ITERATE_AUTO, _MODEL or _REPLAY
+} DLLRmsOptions;
+
+typedef struct _DLLRmsModel_ {  // per instance
+  int NumSubsteps;           // Model_Outputs calls per host step, HostStep / FixedStepBaseSampleTime
+  int bReplay;               // iterates by replaying the host step
+  int bHooks;                // replay saves state through Model_SaveState and Model_RestoreState
+  char *pSaved;              // states at the start of the host step, for replay
+  int32_T SavedBytes;
+  char *pPrevOutputs;        // outputs after the previous round
+} DLLRmsModel;
+
+typedef struct _DLLRmsLoop_ {
+  DLLRmsOptions options;
+  Wrapped_IEEE_Cigre_DLL **ppWraps;
+  int NumWraps;
+  DLLRmsModel *pModels;
+  DLL_RMS_NETWORK_FCN Network;  // NULL if the caller sets the inputs before each host step
+  void *pContext;
+  long NumSteps;
+  long long NumRounds;          // Model_Iterate rounds over all host steps
+  long NumNotConverged;         // host steps that ran out of iterations
+  double LastResidual;          // largest output change over its tolerance in the last round, <= 1 when converged
+  double MaxResidual;           // over the steps that did not converge
+  long RoundCounts[DLL_RMS_MAX_ITERATIONS + 1];  // host steps by the number of rounds they took
+} DLLRmsLoop;
+
+// sets up an RMS loop over instances that were created after SetDLLModelClassMode (pClass, 2), so the
+// model saw SimTool_EMT_RMS_Mode = 2 from Model_CheckParameters on, and have been through
+// Model_Initialize. Returns NULL if a model does not advertise RMS in its EMT_RMS_Mode, an instance
+// is not in RMS mode, the host step is not a whole multiple of some model's sample time, or memory runs out.
+DLLRmsLoop * CreateDLLRmsLoop (Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps, const DLLRmsOptions *pOptions,
+                               DLL_RMS_NETWORK_FCN Network, void *pContext);
+
+// one host step at time t: the network, NumSubsteps Model_Outputs calls on each model at t, t + dt, ...,
+// then rounds of network and Model_Iterate until the outputs converge or MaxIterations is reached.
+// Returns the highest model return value, or IEEE_Cigre_DLLInterface_Return_Error if a replayed
+// model's Model_SaveState or Model_RestoreState fails.
+int32_T DLLRmsStep (DLLRmsLoop *pLoop, double t);
+
+void PrintDLLRmsStats (DLLRmsLoop *pLoop);
+
+void FreeDLLRmsLoop (DLLRmsLoop *pLoop);
+
+#endif
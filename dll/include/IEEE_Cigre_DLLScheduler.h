@@ -0,0 +1,59 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Persistent thread pool that calls Model_Outputs on many independent model instances per time step
+
+#ifndef __IEEE_Cigre_DLLScheduler__
+#define __IEEE_Cigre_DLLScheduler__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLThreads.h"
+#include "IEEE_Cigre_DLLMessages.h"
+
+typedef struct _DLLWorkerSlot_ {  // one per thread, padded so neighbouring slots never share a cache line
+  DLL_ATOMIC_LONG next;  // next instance index in this thread's share, also taken by thieves
+  long end;              // one past the last instance index in this thread's share
+  int32_T worst;         // highest Model_Outputs return value in this step
+  long calls;            // cumulative Model_Outputs calls
+  long steals;           // cumulative calls taken from other threads' shares
+  uint64_t busy_ns;      // cumulative time running models, when measuring load
+  char pad[DLL_INSTANCE_ALIGNMENT];
+} DLLWorkerSlot;
+
+typedef struct _DLLScheduler_ {
+  int NumThreads;             // including the thread that calls DLLSchedulerStep
+  int bPinCores;              // DLL_PIN_WORKERS or DLL_PIN_CALLER: thread i runs on logical core i
+  int bMeasureLoad;           // time each thread's work, for PrintDLLSchedulerLoad
+  DLLMessageQueue *pMessages; // if not NULL, the workers post the messages their instances return
+  long NumSteps;
+  uint64_t StepNanoseconds;   // cumulative wall time in DLLSchedulerStep, when measuring load
+  DLL_THREAD *pThreads;
+  DLLWorkerSlot *pSlots;
+  Wrapped_IEEE_Cigre_DLL **ppWraps;
+  int NumWraps;
+  DLL_ATOMIC_LONG generation; // incremented to release the workers into a step
+  DLL_ATOMIC_LONG pending;    // workers still running in this step
+  DLL_ATOMIC_LONG shutdown;
+} DLLScheduler;
+
+#define DLL_PIN_NONE 0
+#define DLL_PIN_WORKERS 1   // pins worker threads 1..NumThreads-1 to logical cores 1..NumThreads-1
+#define DLL_PIN_CALLER 2    // also pins the calling thread, worker 0, to core 0; it stays pinned after
+                            // FreeDLLScheduler, so use this only from a thread dedicated to stepping
+
+// NumThreads < 1 uses one thread per logical core; bPinCores is one of the DLL_PIN_ values.
+// Returns NULL if memory runs out; fewer threads are used if some cannot be started.
+DLLScheduler * CreateDLLScheduler (int NumThreads, int bPinCores);
+
+// calls Model_Outputs once on each instance, returning after all have finished; the caller
+// sets Time and ExternalInputs beforehand. Returns the highest Model_Outputs return value.
+int32_T DLLSchedulerStep (DLLScheduler *pSched, Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps);
+
+// DLLSchedulerStep with the scheduler passed as a context pointer, for DLLMultiRateScheduler.RunBatch
+int32_T DLLSchedulerBatch (void *pContext, Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps);
+
+// per-thread calls, steals and busy time, with the max/mean busy-time imbalance ratio
+void PrintDLLSchedulerLoad (DLLScheduler *pSched);
+
+void FreeDLLScheduler (DLLScheduler *pSched);
+
+#endif
@@ -0,0 +1,76 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Connections from model outputs to model inputs, declared by port name and resolved once to pointers
+
+#ifndef __IEEE_Cigre_DLLSignalGraph__
+#define __IEEE_Cigre_DLLSignalGraph__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+
+typedef struct _DLLSignalConnection_ {  // as declared, before BuildDLLSignalGraph
+  int FromNode;
+  int FromPort;  // index into OutputPortsInfo
+  int ToNode;
+  int ToPort;    // index into InputPortsInfo
+} DLLSignalConnection;
+
+typedef struct _DLLSignalCopy_ {  // one gather operation, resolved to pointers
+  char *pDst;
+  const char *pSrc;
+  int nBytes;     // may span several adjacent ports when both types are equal
+  enum IEEE_Cigre_DLLInterface_DataType DstType;
+  enum IEEE_Cigre_DLLInterface_DataType SrcType;
+} DLLSignalCopy;
+
+typedef struct _DLLSignalNode_ {
+  Wrapped_IEEE_Cigre_DLL *pWrap;
+  void *pOwnInputs;  // the instance's ExternalInputs, restored by BuildDLLSignalGraph and FreeDLLSignalGraph
+  int bAliased;      // ExternalInputs points into another node's ExternalOutputs
+  int FirstCopy;     // this node's gather list in pCopies
+  int NumCopies;
+} DLLSignalNode;
+
+typedef struct _DLLSignalGraph_ {
+  int NumNodes;
+  int MaxNodes;
+  DLLSignalNode *pNodes;             // in the order DLLSignalGraphStep calls them
+  int NumConnections;
+  int MaxConnections;
+  DLLSignalConnection *pConnections;
+  int NumCopies;
+  DLLSignalCopy *pCopies;
+  int bBuilt;
+} DLLSignalGraph;
+
+// returns NULL if out of memory
+DLLSignalGraph * CreateDLLSignalGraph (void);
+
+// returns the node index, or -1 if out of memory; nodes are stepped in the order they are added
+int AddDLLSignalNode (DLLSignalGraph *pGraph, Wrapped_IEEE_Cigre_DLL *pWrap);
+
+// connects an output port of one node to an input port of another, by name. Each input takes at
+// most one connection; inputs left unconnected are written by the host as before. Returns 0 on error.
+int ConnectDLLSignals (DLLSignalGraph *pGraph, Wrapped_IEEE_Cigre_DLL *pFrom, const char *OutputName,
+                       Wrapped_IEEE_Cigre_DLL *pTo, const char *InputName);
+
+// resolves the connections. When every input of a node comes, in order and with the same data
+// types and spacing, from one other node's outputs, the node's ExternalInputs is pointed into that
+// node's ExternalOutputs and it never copies. Other connections become a gather list per node,
+// with runs of adjacent same-type ports merged into one memcpy and mixed types converted through
+// real64_T. The host must not write the ExternalInputs of an aliased node, which are the source's
+// outputs; RestoreInstance writes the saved inputs to the node's own buffer instead. Returns 0 on error.
+int BuildDLLSignalGraph (DLLSignalGraph *pGraph);
+
+// copies the connected inputs of one node from the current outputs of their sources
+void DLLSignalGraphGather (DLLSignalGraph *pGraph, int node);
+
+// for each node in order, gathers its inputs and calls Model_Outputs, so a chain of models settles
+// in one step. The caller sets Time on each instance beforehand. Returns the highest return value.
+int32_T DLLSignalGraphStep (DLLSignalGraph *pGraph);
+
+void PrintDLLSignalGraph (DLLSignalGraph *pGraph);
+
+// restores each aliased node's own ExternalInputs; call this before freeing the instances
+void FreeDLLSignalGraph (DLLSignalGraph *pGraph);
+
+#endif
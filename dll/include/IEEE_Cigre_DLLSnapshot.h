@@ -0,0 +1,62 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Checkpoints of a model instance, restored into the same or another instance of its class
+
+#ifndef __IEEE_Cigre_DLLSnapshot__
+#define __IEEE_Cigre_DLLSnapshot__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+
+#define DLL_SNAPSHOT_MAGIC "DLLSNAP"
+#define DLL_SNAPSHOT_VERSION 1
+
+typedef struct _DLLSnapshotHeader_ {  // 96 bytes, then the sections in the order of these sizes
+  char Magic[8];             // DLL_SNAPSHOT_MAGIC with its terminating null, exactly 8 bytes
+  uint32_t Version;
+  uint32_t bModelState;      // 1 if the model's hooks saved its state arrays and heap state
+  uint64_t TotalBytes;
+  real64_T Time;
+  char ModelName[32];
+  int32_T ParameterBytes;
+  int32_T InputBytes;
+  int32_T OutputBytes;
+  int32_T DoubleStateBytes;  // 0 when bModelState
+  int32_T FloatStateBytes;
+  int32_T IntStateBytes;
+  int32_T ModelBytes;        // from Model_SaveState
+  int32_T Reserved;
+} DLLSnapshotHeader;
+
+/*
+Models that keep state outside the instance buffers, such as the HWPV coefficient structure or
+the PPC FMU component, may export two hooks:
+
+  int32_T Model_SaveState (IEEE_Cigre_DLLInterface_Instance *instance, void *pBuffer, int32_T nBytes)
+    returns the number of bytes needed when pBuffer is NULL; otherwise writes at most nBytes and
+    returns the number written, or -1 on error.
+  int32_T Model_RestoreState (IEEE_Cigre_DLLInterface_Instance *instance, const void *pBuffer, int32_T nBytes)
+    returns IEEE_Cigre_DLLInterface_Return_OK, or _Error if the bytes do not fit this instance.
+
+A model with hooks owns its three state arrays, which may hold handles to its own heap, so the
+wrapper neither saves nor writes them back. The target of a restore must already have been
+through Model_CheckParameters and Model_Initialize, so its heap state exists.
+*/
+
+// a malloced blob holding the parameters, inputs, outputs, state arrays, Time and any model state;
+// NULL on error. Parameter pointers (c_string) are copied as pointers, valid within this process.
+void * SnapshotInstance (Wrapped_IEEE_Cigre_DLL *pWrap, size_t *pBytes);
+
+// writes a snapshot back into an instance of the same model; returns IEEE_Cigre_DLLInterface_Return_OK,
+// or _Error if the blob does not match the instance. Inputs aliased by a DLLSignalGraph are left alone;
+// the saved inputs go to the instance's own buffer instead.
+int32_T RestoreInstance (Wrapped_IEEE_Cigre_DLL *pWrap, const void *pBlob, size_t nBytes);
+
+void FreeInstanceSnapshot (void *pBlob);
+
+// the blob as a file, e.g., to keep a steady-state snapshot between runs of the same executable
+int WriteInstanceSnapshot (const char *file_name, const void *pBlob, size_t nBytes);
+
+// a malloced blob read from a file, or NULL
+void * ReadInstanceSnapshot (const char *file_name, size_t *pBytes);
+
+#endif
@@ -0,0 +1,86 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Parameter sweeps and Monte Carlo runs of one model class across threads, with scalar metrics computed as each variant steps
+
+#ifndef __IEEE_Cigre_DLLSweep__
+#define __IEEE_Cigre_DLLSweep__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+
+enum DLLSweepSampling {
+  DLL_SWEEP_GRID,             // every combination of NumLevels values per parameter
+  DLL_SWEEP_LATIN_HYPERCUBE,  // NumSamples variants, one in each of NumSamples strata of every parameter
+  DLL_SWEEP_RANDOM            // NumSamples independent uniform draws
+};
+
+typedef struct _DLLSweepParameter_ {
+  const char *Name;
+  double Low;                 // Low >= High uses the parameter's MinValue and MaxValue;
+  double High;                // otherwise both are clipped to them
+  int NumLevels;              // for DLL_SWEEP_GRID; 1 sweeps only the midpoint
+  int bLog;                   // samples uniformly in log(value); needs Low > 0
+} DLLSweepParameter;
+
+enum DLLSweepMetricType {
+  DLL_METRIC_OVERSHOOT,       // percent of the step from the value at StartTime to Reference
+  DLL_METRIC_SETTLING_TIME,   // seconds after StartTime until the output stays within Band of Reference
+  DLL_METRIC_RMS_ERROR,       // RMS of output - Reference from StartTime
+  DLL_METRIC_PEAK,            // largest absolute value from StartTime
+  DLL_METRIC_FINAL,           // the value at the last step
+  DLL_NUM_METRIC_TYPES
+};
+
+typedef struct _DLLSweepMetric_ {
+  int Type;                   // enum DLLSweepMetricType
+  const char *Output;         // output port name
+  double Reference;           // target value of the output
+  double Band;                // settling band as a fraction of the step size, e.g., 0.02
+  double StartTime;           // metrics ignore the steps before this time, e.g., the time of a disturbance
+} DLLSweepMetric;
+
+// sets the inputs of variant iVariant before each Model_Outputs at time t; NULL holds the inputs.
+// Called concurrently for different variants, so any state it keeps must be per variant.
+typedef void (*DLL_SWEEP_STEP_FCN)(Wrapped_IEEE_Cigre_DLL *pWrap, double t, int iVariant, void *pUser);
+
+typedef struct _DLLSweepSpec_ {
+  int Sampling;               // enum DLLSweepSampling
+  int NumSamples;             // variants for DLL_SWEEP_LATIN_HYPERCUBE and DLL_SWEEP_RANDOM
+  uint64_t Seed;              // the same seed gives the same variants on any platform
+  int NumParameters;
+  const DLLSweepParameter *pParameters;
+  int NumMetrics;
+  const DLLSweepMetric *pMetrics;
+  double EndTime;             // each variant runs from 0 to EndTime
+  Wrapped_IEEE_Cigre_DLL *pTemplate;  // parameters, inputs and outputs copied into each variant before the swept
+                                      // values; NULL starts from the defaults and zeros
+  DLL_SWEEP_STEP_FCN StepFcn;
+  void *pUser;
+} DLLSweepSpec;
+
+#define DLL_SWEEP_OK 0
+#define DLL_SWEEP_MODEL_ERROR 1   // a model call returned IEEE_Cigre_DLLInterface_Return_Error
+#define DLL_SWEEP_NOT_FINITE 2    // a metric output became NaN or infinite
+
+typedef struct _DLLSweepResults_ {
+  int NumVariants;
+  int NumParameters;
+  int NumMetrics;
+  char **pNames;              // NumParameters parameter names, then NumMetrics column names like overshoot(Id)
+  double *pValues;            // NumVariants rows of NumParameters swept values, then NumMetrics metrics
+  int *pStatus;               // DLL_SWEEP_ code of each variant; its metrics are NaN unless DLL_SWEEP_OK
+  double Seconds;             // wall time of the runs
+} DLLSweepResults;
+
+// generates the variants and runs them on NumThreads threads (0 uses the core count), each with one
+// instance of pClass that is terminated and re-checked between variants. NULL if a parameter or
+// output name is not found, a parameter is not numeric, or an instance or the results cannot be allocated.
+DLLSweepResults * RunDLLSweep (DLLModelClass *pClass, const DLLSweepSpec *pSpec, int NumThreads);
+
+// one row per variant: index, status, swept values, metrics; returns 0 if the file could not be written
+int WriteDLLSweepCSV (const DLLSweepResults *pResults, const char *file_name);
+
+void FreeDLLSweepResults (DLLSweepResults *pResults);
+
+const char *DLLSweepMetricName (int Type);
+
+#endif
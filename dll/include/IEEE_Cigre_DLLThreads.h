@@ -0,0 +1,46 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Portable threads, atomics and clocks for the DLL wrapper; Win32 threads on Windows, pthreads elsewhere
+
+#ifndef __IEEE_Cigre_DLLThreads__
+#define __IEEE_Cigre_DLLThreads__
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+typedef HANDLE DLL_THREAD;
+#define DLL_ATOMIC_LOAD(p) InterlockedCompareExchange ((p), 0, 0)
+#define DLL_ATOMIC_STORE(p, v) InterlockedExchange ((p), (v))
+#define DLL_ATOMIC_ADD(p, v) InterlockedExchangeAdd ((p), (v))  // returns the old value
+#else
+#include <pthread.h>
+typedef pthread_t DLL_THREAD;
+#define DLL_ATOMIC_LOAD(p) __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define DLL_ATOMIC_STORE(p, v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#define DLL_ATOMIC_ADD(p, v) __atomic_fetch_add ((p), (v), __ATOMIC_ACQ_REL)  // returns the old value
+#endif
+
+typedef volatile long DLL_ATOMIC_LONG;
+
+typedef void (*DLL_THREAD_FCN)(void *);
+
+int StartDLLThread (DLL_THREAD *pThread, DLL_THREAD_FCN fcn, void *arg);
+
+void JoinDLLThread (DLL_THREAD thread);
+
+// pins the calling thread to one logical core; returns 0 if pinning is not supported
+int PinDLLThread (int core);
+
+int GetDLLCoreCount (void);
+
+// called in spin loops; after spins > DLL_SPINS_BEFORE_YIELD, also gives up the time slice
+#define DLL_SPINS_BEFORE_YIELD 4096
+void DLLSpinPause (long spins);
+
+// for background threads that can wait longer than a spin loop
+void DLLSleepMicroseconds (long us);
+
+uint64_t DLLMonotonicNanoseconds (void);
+
+#endif
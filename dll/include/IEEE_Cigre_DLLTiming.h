@@ -0,0 +1,70 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Latency histograms of every call through a wrapped model's entry points, built with -DDLL_TIMING
+
+#ifndef __IEEE_Cigre_DLLTiming__
+#define __IEEE_Cigre_DLLTiming__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+
+enum DLLTimedEntry {
+  DLL_TIMED_FIRSTCALL,
+  DLL_TIMED_CHECKPARAMETERS,
+  DLL_TIMED_INITIALIZE,
+  DLL_TIMED_OUTPUTS,
+  DLL_TIMED_ITERATE,
+  DLL_TIMED_TERMINATE,
+  DLL_NUM_TIMED_ENTRIES
+};
+
+#define DLL_TIMING_SUBBUCKETS 4  // log-scale buckets per octave of nanoseconds
+#define DLL_TIMING_BUCKETS (64 * DLL_TIMING_SUBBUCKETS)
+
+typedef struct _DLLTimingHistogram_ {
+  uint64_t NumCalls;
+  uint64_t TotalNanoseconds;
+  uint64_t MinNanoseconds;
+  uint64_t MaxNanoseconds;
+  uint32_t pCounts[DLL_TIMING_BUCKETS];
+} DLLTimingHistogram;
+
+typedef struct _DLLModelTiming_ {  // one per instance, found from the DLLInstanceHeader of each pModel
+  const IEEE_Cigre_DLLInterface_Instance *pModel;
+  const char *ModelName;
+  DLL_MODEL_FCN pFunctions[DLL_NUM_TIMED_ENTRIES];  // the model's own entry points
+  DLL_OUTPUTS_BATCH_FCN Model_OutputsBatch;         // restored by DetachDLLModelTiming
+  DLLTimingHistogram entries[DLL_NUM_TIMED_ENTRIES];
+} DLLModelTiming;
+
+// an upper bound on the p'th percentile (0 to 100) in nanoseconds, accurate to one bucket, 25% at most
+uint64_t DLLTimingPercentile (const DLLTimingHistogram *pHist, double p);
+
+#ifdef DLL_TIMING
+
+// replaces the instance's entry-point pointers with timed calls through to the model, and clears
+// Model_OutputsBatch so batched steps are timed one instance at a time;
+// from CreateDLLModelInstance and CreateDLLModelInstanceInArena
+void AttachDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap);
+
+// NULL if the instance is not timed
+DLLModelTiming * GetDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap);
+
+// calls, mean, p50, p99 and max for each entry point that was called; FreeFirstDLLModel calls this
+void PrintDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap);
+
+void ResetDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap);
+
+// after Model_Terminate, from FreeDLLModelInstance
+void DetachDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap);
+
+#else
+
+#define AttachDLLModelTiming(pWrap) ((void) 0)
+#define GetDLLModelTiming(pWrap) ((DLLModelTiming *) NULL)
+#define PrintDLLModelTiming(pWrap) ((void) 0)
+#define ResetDLLModelTiming(pWrap) ((void) 0)
+#define DetachDLLModelTiming(pWrap) ((void) 0)
+
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+// Binary trace files of model inputs and outputs, with fixed-size typed rows behind a metadata header
+
+#ifndef __IEEE_Cigre_DLLTrace__
+#define __IEEE_Cigre_DLLTrace__
+
+#include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLThreads.h"
+
+#define DLL_TRACE_MAGIC "DLLTRACE"
+#define DLL_TRACE_VERSION 1
+#define DLL_TRACE_BUFFER_BYTES (4 * 1024 * 1024)
+#define DLL_TRACE_RING_BLOCKS 4
+
+typedef struct _DLLTraceFileHeader_ {  // 64 bytes at the start of the file, then NumColumns column records
+  char Magic[8];          // DLL_TRACE_MAGIC, not null-terminated
+  uint32_t Version;
+  uint32_t HeaderBytes;   // file offset of the first row
+  uint32_t NumColumns;
+  uint32_t RowBytes;
+  real64_T TimeStep;      // FixedStepBaseSampleTime of the model
+  char ModelName[32];
+} DLLTraceFileHeader;
+
+typedef struct _DLLTraceFileColumn_ {  // 64 bytes; column 0 is the real64_T time t
+  char Name[40];
+  char Unit[16];
+  uint32_t DataType;      // enum IEEE_Cigre_DLLInterface_DataType
+  uint32_t Offset;        // bytes from the start of the row
+} DLLTraceFileColumn;
+
+typedef struct _DLLTraceSegment_ {  // bytes copied into each row from an instance buffer
+  void **ppBase;          // &pModel->ExternalInputs or &pModel->ExternalOutputs, read at every row
+  int SrcOffset;
+  int DstOffset;
+  int nBytes;
+} DLLTraceSegment;
+
+typedef struct _DLLTraceWriter_ {
+  FILE *fp;
+  DLLTraceFileHeader header;
+  DLLTraceFileColumn *pColumns;
+  int NumSegments;
+  DLLTraceSegment *pSegments;
+  char *pBuffer;          // rows waiting for the next fwrite, or the ring block being filled; NULL while dropping
+  size_t BufferBytes;
+  size_t BufferUsed;
+  long long NumRows;
+  // ring of blocks drained by a writer thread, from OpenDLLTraceAsync
+  int bAsync;
+  int NumBlocks;
+  int bDropWhenFull;      // 1 drops rows while every block is queued; 0 waits for the writer thread
+  char *pRing;            // NumBlocks blocks of BufferBytes
+  size_t *pBlockUsed;     // bytes of rows in each queued block
+  DLL_ATOMIC_LONG head;   // blocks handed to the writer thread, written only by the simulation thread
+  DLL_ATOMIC_LONG tail;   // blocks written to disk, written only by the writer thread
+  DLL_ATOMIC_LONG shutdown;
+  DLL_THREAD thread;
+  long long NumDropped;   // rows lost while the ring was full, or after a failed write
+  long NumStalls;         // times the simulation thread waited for a free block
+  uint64_t StallNanoseconds;
+  long MaxQueued;         // most blocks waiting for the writer thread at once
+  DLL_ATOMIC_LONG WriteFailed;  // set by the first failed write; later rows are dropped
+} DLLTraceWriter;
+
+// creates the file and writes its header; the rows hold t, then every input and output port.
+// BufferBytes 0 uses DLL_TRACE_BUFFER_BYTES. Returns NULL if the file cannot be created or memory runs out.
+DLLTraceWriter * OpenDLLTrace (const char *file_name, Wrapped_IEEE_Cigre_DLL *pWrap, size_t BufferBytes);
+
+// as OpenDLLTrace, but a writer thread does the fwrite calls from a single-producer, single-consumer
+// ring of NumBlocks blocks, so WriteDLLTraceRow only copies memory. When all blocks are queued, the
+// next row waits for the writer, or is dropped if bDropWhenFull. BlockBytes 0 uses
+// DLL_TRACE_BUFFER_BYTES and NumBlocks < 2 uses DLL_TRACE_RING_BLOCKS.
+DLLTraceWriter * OpenDLLTraceAsync (const char *file_name, Wrapped_IEEE_Cigre_DLL *pWrap, size_t BlockBytes,
+                                    int NumBlocks, int bDropWhenFull);
+
+// appends the current inputs and outputs at time t
+void WriteDLLTraceRow (DLLTraceWriter *pTrace, double t);
+
+// writes any buffered rows, stops the writer thread if there is one, and closes the file.
+// Returns -1 if any write failed, so the file ends early, or 0.
+int CloseDLLTrace (DLLTraceWriter *pTrace);
+
+// rows written and dropped, and the time the simulation thread spent waiting on the writer thread
+void PrintDLLTraceStats (DLLTraceWriter *pTrace);
+
+#define DLL_TRACE_RISING 1
+#define DLL_TRACE_FALLING 2
+
+typedef struct _DLLTraceChannel_ {
+  const char *Name;    // an input or output port; inputs are searched first
+  int Decimation;      // write every Decimation'th step, < 2 for every step
+} DLLTraceChannel;
+
+typedef struct _DLLTracePolicy_ {
+  int NumChannels;                  // 0 traces every port at every step
+  const DLLTraceChannel *pChannels;
+  const char *TriggerName;          // port that opens a full-resolution window, or NULL for none
+  int TriggerEdge;                  // DLL_TRACE_RISING or DLL_TRACE_FALLING through TriggerLevel
+  double TriggerLevel;
+  int PreTriggerSteps;              // steps kept in memory and written when the trigger fires
+  int PostTriggerSteps;             // steps written after the last trigger
+  int bAsync;                       // each file gets a writer thread, as OpenDLLTraceAsync
+} DLLTracePolicy;
+
+typedef struct _DLLTraceSet_ {  // the trace files for one instance under a DLLTracePolicy
+  int NumGroups;
+  DLLTraceWriter **ppGroups;        // one file per distinct decimation
+  int *pDecimation;
+  long long NumSteps;
+  DLLTraceWriter *pWindows;         // every selected channel at every step around each trigger
+  void **ppTriggerBase;
+  ArrayMap TriggerMap;
+  double LastTriggerValue;
+  char *pPreRows;                   // ring of PreTriggerSteps assembled rows
+  int PreCount;
+  int PreNext;
+  long long PostLeft;               // steps still to write after the last trigger
+  long NumTriggers;
+  DLLTracePolicy policy;
+} DLLTraceSet;
+
+// opens the files for a trace policy. Channels with decimation 1 go to file_name; channels with
+// decimation N > 1 go to <stem>_dN<ext>, with N times the model's time step in the header, and
+// trigger windows to <stem>_trig<ext>. Returns NULL, with no files left open, if any file fails.
+DLLTraceSet * OpenDLLTraceSet (const char *file_name, Wrapped_IEEE_Cigre_DLL *pWrap, const DLLTracePolicy *pPolicy);
+
+// called once per model step, after Model_Outputs
+void WriteDLLTraceSet (DLLTraceSet *pSet, double t);
+
+void PrintDLLTraceSetStats (DLLTraceSet *pSet);
+
+// returns -1 if any of the files could not be written completely, or 0
+int CloseDLLTraceSet (DLLTraceSet *pSet);
+
+// writes a trace as CSV in the same format as write_csv_values; returns the number of rows, or -1
+long long ExportDLLTraceCSV (const char *trace_name, const char *csv_name);
+
+#endif
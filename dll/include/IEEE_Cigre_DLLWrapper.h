@@ -3,11 +3,43 @@
 #ifndef __IEEE_Cigre_DLLWrapper__
 #define __IEEE_Cigre_DLLWrapper__
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
 #include "IEEE_Cigre_DLLInterface.h"
- 
-typedef int32_T (__cdecl *DLL_INFO_FCN)(void); 
-typedef const IEEE_Cigre_DLLInterface_Model_Info * (__cdecl *DLL_STRUCT_FCN)(void);
-typedef int32_T (__cdecl *DLL_MODEL_FCN)(IEEE_Cigre_DLLInterface_Instance *);
+#include "IEEE_Cigre_DLLModelMessage.h"
+
+// platform-specific shared library handles; LoadLibrary on Windows, dlopen on Linux and macOS
+#if defined(_WIN32)
+#include <windows.h>
+typedef HINSTANCE DLL_HANDLE;
+#define DLL_CALL __cdecl
+#define DLL_FILE_NAME(base) base ".dll"
+#else
+#include <dlfcn.h>
+typedef void * DLL_HANDLE;
+#define DLL_CALL
+#if defined(__APPLE__)
+#define DLL_FILE_NAME(base) "lib" base ".dylib"
+#else
+#define DLL_FILE_NAME(base) "lib" base ".so"
+#endif
+#endif
+
+typedef int32_T (DLL_CALL *DLL_INFO_FCN)(void); 
+typedef const IEEE_Cigre_DLLInterface_Model_Info * (DLL_CALL *DLL_STRUCT_FCN)(void);
+typedef int32_T (DLL_CALL *DLL_MODEL_FCN)(IEEE_Cigre_DLLInterface_Instance *);
+// optional model hooks for state kept outside the instance buffers; see IEEE_Cigre_DLLSnapshot.h
+typedef int32_T (DLL_CALL *DLL_SAVE_FCN)(IEEE_Cigre_DLLInterface_Instance *, void *pBuffer, int32_T nBytes);
+typedef int32_T (DLL_CALL *DLL_RESTORE_FCN)(IEEE_Cigre_DLLInterface_Instance *, const void *pBuffer, int32_T nBytes);
+// optional model hook that steps several instances of one model together; see DLLModelOutputsBatch
+typedef int32_T (DLL_CALL *DLL_OUTPUTS_BATCH_FCN)(IEEE_Cigre_DLLInterface_Instance **ppInstances, int32_T NumInstances);
+// optional model hook that takes a message buffer for one instance; see IEEE_Cigre_DLLModelMessage.h
+typedef int32_T (DLL_CALL *DLL_MESSAGE_BUFFER_FCN)(IEEE_Cigre_DLLInterface_Instance *, char_T *pBuffer, int32_T nBytes);
+
+#define DLL_BATCH_CHUNK 64  // instances per Model_OutputsBatch call
 
 typedef struct _ArrayMap {  // we will have arrays of these for Parameters, ExternalInputs and ExternalOutputs
   int size;    // size of the value from IEEE_Cigre_DLLInterface_types.h
@@ -28,8 +60,87 @@ union EditValueU {
   real64_T Real64_Val;
 };
 
-typedef struct _Wrapped_IEEE_Cigre_DLL_ {
-  HINSTANCE hLib;
+#define DLL_INSTANCE_ALIGNMENT 64  // bytes in a cache line
+
+typedef struct _DLLModelLayout_ {  // computed once per model type from its IEEE_Cigre_DLLInterface_Model_Info
+  ArrayMap *pParameterMap; 
+  ArrayMap *pInputMap; 
+  ArrayMap *pOutputMap; 
+  int ParameterSize;         // bytes in the Parameters struct
+  int InputSize;             // bytes in the ExternalInputs struct
+  int OutputSize;            // bytes in the ExternalOutputs struct
+  char *pDefaultParameters;  // Parameters struct filled with default values, copied into each new instance
+  int bArena;                // 1 (default) packs each instance into one aligned block; 0 uses a malloc per buffer
+  uint8_T SimMode;           // SimTool_EMT_RMS_Mode of each new instance, 1 (default) for EMT or 2 for RMS
+  size_t InstanceBlockSize;  // bytes in one aligned instance block, a multiple of DLL_INSTANCE_ALIGNMENT
+} DLLModelLayout;
+
+typedef struct _DLLInstanceHeader_ {  // AllocateModelInstance puts each instance struct in one of these
+  IEEE_Cigre_DLLInterface_Instance Model;  // first, so the pModel passed to the model also points here
+  struct _DLLModelTiming_ *pTiming;        // from AttachDLLModelTiming, so its thunks need only pModel
+  char_T Message[DLL_MODEL_MESSAGE_BYTES]; // handed to the model's Model_SetMessageBuffer, if it has one
+  void *pOwnInputs;                        // the instance's own ExternalInputs, which a DLLSignalGraph may alias
+} DLLInstanceHeader;
+
+// the wrapper's own data for an instance from AllocateModelInstance or CreateModelInstance
+#define DLL_INSTANCE_HEADER(pModel) ((DLLInstanceHeader *) (pModel))
+
+typedef struct _DLLNameIndex_ {  // minimal perfect hash over one set of port or parameter names
+  int NumNames;
+  int NumBuckets;       // 0 if the names could not be hashed, so pNames is a plain list
+  uint32_t *pSeeds;     // displacement seed for each bucket
+  int *pIndex;          // slot -> port or parameter index
+  const char **pNames;  // slot -> name, to reject names that are not in the set
+} DLLNameIndex;
+
+typedef struct _DLLPortHandle_ {  // resolved once by name, then used as a byte offset into the buffer
+  int index;     // -1 if the name was not found
+  int offset;
+  int size;
+  enum IEEE_Cigre_DLLInterface_DataType dtype;
+} DLLPortHandle;
+
+#define DLL_PORT_PTR(pBuffer, h) ((void *) ((char *) (pBuffer) + (h).offset))
+#define DLL_INPUT_REAL64(pWrap, h) (*(real64_T *) DLL_PORT_PTR ((pWrap)->pModel->ExternalInputs, h))
+#define DLL_OUTPUT_REAL64(pWrap, h) (*(real64_T *) DLL_PORT_PTR ((pWrap)->pModel->ExternalOutputs, h))
+#define DLL_PARAMETER_REAL64(pWrap, h) (*(real64_T *) DLL_PORT_PTR ((pWrap)->pModel->Parameters, h))
+
+typedef struct _DLLModelClass_ {  // one loaded library, shared by any number of model instances
+  DLL_HANDLE hLib;
+  DLL_INFO_FCN Model_PrintInfo;
+  DLL_STRUCT_FCN Model_GetInfo;
+  DLL_MODEL_FCN Model_CheckParameters;
+  DLL_MODEL_FCN Model_Initialize;
+  DLL_MODEL_FCN Model_Outputs;
+  DLL_MODEL_FCN Model_FirstCall;
+  DLL_MODEL_FCN Model_Iterate;
+  DLL_MODEL_FCN Model_Terminate;
+  DLL_SAVE_FCN Model_SaveState;        // optional, NULL if the model keeps no private heap state
+  DLL_RESTORE_FCN Model_RestoreState;
+  DLL_OUTPUTS_BATCH_FCN Model_OutputsBatch;    // optional, NULL if the model steps one instance at a time
+  DLL_MESSAGE_BUFFER_FCN Model_SetMessageBuffer;  // optional, NULL if the model shares one message buffer
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo;
+  DLLModelLayout layout;
+  DLLNameIndex InputIndex;
+  DLLNameIndex OutputIndex;
+  DLLNameIndex ParameterIndex;
+  int NumInstances;
+} DLLModelClass;
+
+typedef struct _DLLInstanceArena_ {  // contiguous instance blocks for many instances of one class
+  DLLModelClass *pClass;
+  char *pBlock;
+  size_t Stride;     // the class InstanceBlockSize
+  int NumInstances;  // capacity
+  int NumUsed;       // blocks handed out
+  int NumLive;       // blocks not yet freed
+} DLLInstanceArena;
+
+typedef struct _Wrapped_IEEE_Cigre_DLL_ {  // one model instance; function pointers and maps are copied from its class
+  DLLModelClass *pClass;
+  DLLInstanceArena *pArena;  // NULL unless created with CreateDLLModelInstanceInArena
+  int bOwnsClass;  // from CreateFirstDLLModel, so FreeFirstDLLModel also frees the class
+  DLL_HANDLE hLib;
   DLL_INFO_FCN Model_PrintInfo;
   DLL_STRUCT_FCN Model_GetInfo;
   DLL_MODEL_FCN Model_CheckParameters;
@@ -38,6 +149,10 @@ typedef struct _Wrapped_IEEE_Cigre_DLL_ {
   DLL_MODEL_FCN Model_FirstCall;
   DLL_MODEL_FCN Model_Iterate;
   DLL_MODEL_FCN Model_Terminate;
+  DLL_SAVE_FCN Model_SaveState;
+  DLL_RESTORE_FCN Model_RestoreState;
+  DLL_OUTPUTS_BATCH_FCN Model_OutputsBatch;
+  DLL_MESSAGE_BUFFER_FCN Model_SetMessageBuffer;
   const IEEE_Cigre_DLLInterface_Model_Info *pInfo;
   IEEE_Cigre_DLLInterface_Instance *pModel;
   ArrayMap *pParameterMap; 
@@ -45,8 +160,52 @@ typedef struct _Wrapped_IEEE_Cigre_DLL_ {
   ArrayMap *pOutputMap; 
 } Wrapped_IEEE_Cigre_DLL;
 
+DLL_HANDLE OpenModelLibrary (const char *dll_name);
+
+void *FindModelSymbol (DLL_HANDLE hLib, const char *name);
+
+void CloseModelLibrary (DLL_HANDLE hLib);
+
+DLLModelClass * LoadDLLModelClass (char *dll_name);
+
+// the SimTool_EMT_RMS_Mode, 1 for EMT or 2 for RMS, of instances created from now on; returns 0,
+// leaving the mode alone, if the model's EMT_RMS_Mode does not include it
+int SetDLLModelClassMode (DLLModelClass *pClass, uint8_T SimMode);
+
+Wrapped_IEEE_Cigre_DLL * CreateDLLModelInstance (DLLModelClass *pClass);
+
+DLLInstanceArena * CreateInstanceArena (DLLModelClass *pClass, int NumInstances);
+
+Wrapped_IEEE_Cigre_DLL * CreateDLLModelInstanceInArena (DLLInstanceArena *pArena);
+
+void FreeInstanceArena (DLLInstanceArena *pArena);
+
+void FreeDLLModelInstance (Wrapped_IEEE_Cigre_DLL *pWrap);
+
+void FreeDLLModelClass (DLLModelClass *pClass);
+
+// Model_Outputs on NumWraps instances, each at its own pModel->Time. Consecutive instances that share
+// a class and its Model_OutputsBatch go to the model in calls of up to DLL_BATCH_CHUNK; the rest are
+// stepped one at a time. Messages stay with each instance. Returns the highest return value.
+int32_T DLLModelOutputsBatch (Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps);
+
 Wrapped_IEEE_Cigre_DLL * CreateFirstDLLModel (char *dll_name);
 
+// builds the name indices when the class is loaded; returns 0 if out of memory
+int BuildModelNameIndices (DLLModelClass *pClass);
+
+void FreeModelNameIndices (DLLModelClass *pClass);
+
+// constant-time lookup, or a scan if the names could not be hashed; returns -1 if the name is not in the index
+int LookupDLLName (const DLLNameIndex *pIndex, const char *name);
+
+// handles for hosts that bind signals by name; the handle index is -1 if the name is not found
+DLLPortHandle GetInputHandle (Wrapped_IEEE_Cigre_DLL *pWrap, const char *name);
+
+DLLPortHandle GetOutputHandle (Wrapped_IEEE_Cigre_DLL *pWrap, const char *name);
+
+DLLPortHandle GetParameterHandle (Wrapped_IEEE_Cigre_DLL *pWrap, const char *name);
+
 #ifndef ATP_MINGW
 void PrintDLLModelParameters (Wrapped_IEEE_Cigre_DLL *pWrap);
 #endif
@@ -63,6 +222,27 @@ int get_datatype_size (enum IEEE_Cigre_DLLInterface_DataType dtype);
 
 void edit_dll_value (char *pVals, int offset, enum IEEE_Cigre_DLLInterface_DataType dtype, int dsize, union EditValueU val);
 
+// name=value, e.g., from the command line, into a parameter (bInput 0) or an input (bInput 1).
+// Overwrites the '=' with '\0'; a c_string value points into assignment, which must outlive the model.
+// Returns 0 if the text is not name=value or the model has no such port or parameter.
+int assign_dll_value (Wrapped_IEEE_Cigre_DLL *pWrap, char *assignment, int bInput);
+
+// stores x at p, converted to any numeric dtype; c_string values are left alone
+void write_dll_real64 (char *p, enum IEEE_Cigre_DLLInterface_DataType dtype, double x);
+
+// the value at p as a double, for any numeric dtype; 0 for c_string
+double read_dll_real64 (const char *p, enum IEEE_Cigre_DLLInterface_DataType dtype);
+
+// returns 0 if the maps could not be allocated, leaving none allocated
+int ComputeModelLayout (const IEEE_Cigre_DLLInterface_Model_Info *pInfo, DLLModelLayout *pLayout);
+
+void FreeModelLayout (DLLModelLayout *pLayout);
+
+IEEE_Cigre_DLLInterface_Instance* AllocateModelInstance (const IEEE_Cigre_DLLInterface_Model_Info *pInfo,
+                                                         const DLLModelLayout *pLayout);
+
+void ReleaseModelInstance (IEEE_Cigre_DLLInterface_Instance *pModel, const DLLModelLayout *pLayout);
+
 IEEE_Cigre_DLLInterface_Instance* CreateModelInstance (const IEEE_Cigre_DLLInterface_Model_Info *pInfo,
                                                        ArrayMap **pParameterMap,
                                                        ArrayMap **pInputMap,
@@ -73,6 +253,10 @@ void FreeModelInstance (IEEE_Cigre_DLLInterface_Instance *pModel, ArrayMap *pPar
 
 void check_messages (const char *loc, IEEE_Cigre_DLLInterface_Instance *pModel);
 
+// as check_messages, but reads the message only when rc, returned by the entry point, is not
+// IEEE_Cigre_DLLInterface_Return_OK, so a time step loop makes no string scan; returns rc
+int32_T check_model_return (const char *loc, IEEE_Cigre_DLLInterface_Instance *pModel, int32_T rc);
+
 void get_parm_value_string (char *pBuf, char *pData, ArrayMap sMap);
 
 #ifndef ATP_MINGW
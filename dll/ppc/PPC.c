@@ -15,6 +15,7 @@ IEEE/CIGRE interface header does not define a boolean parameter datatype.
 #include <string.h>
 
 #include "IEEE_Cigre_DLLInterface.h"
+#include "IEEE_Cigre_DLLModelMessage.h"
 #include "PPC_FMU.h"
 #include "PPC_vr.h"
 
@@ -157,7 +158,7 @@ static const IEEE_Cigre_DLLInterface_Model_Info Model_Info = {
     .NumDoubleStates = 0
 };
 
-static char ErrorMessage[1024];
+static char_T SharedMessage[DLL_MODEL_MESSAGE_BYTES];  /* for programs that do not call Model_SetMessageBuffer */
 static fmi2Component PPC_FMU_COMPONENT = NULL;
 #if defined(_WIN32)
 static char PPC_RESOURCE_DIR[MAX_PATH];
@@ -174,11 +175,11 @@ static void ppc_logger(
     fmi2String message,
     ...)
 {
-    (void)env;
+    char *ErrorMessage = (char *)env;
     (void)status;
     (void)category;
-    if (instanceName != NULL && message != NULL) {
-        PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "[%s] %s", instanceName, message);
+    if (ErrorMessage != NULL && instanceName != NULL && message != NULL) {
+        PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "[%s] %s", instanceName, message);
     }
 }
 
@@ -216,7 +217,8 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpReserved)
     return TRUE;
 }
 
-static int ppc_extract_embedded_resource(HMODULE module, int resource_id, const char *resource_name, const char *output_dir)
+static int ppc_extract_embedded_resource(HMODULE module, int resource_id, const char *resource_name, const char *output_dir,
+                                         char *ErrorMessage)
 {
     char output_path[MAX_PATH];
     HRSRC resource_handle;
@@ -229,32 +231,32 @@ static int ppc_extract_embedded_resource(HMODULE module, int resource_id, const
 
     resource_handle = FindResourceA(module, MAKEINTRESOURCEA(resource_id), RT_RCDATA);
     if (resource_handle == NULL) {
-        PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "Missing embedded resource %s", resource_name);
+        PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "Missing embedded resource %s", resource_name);
         return 0;
     }
 
     loaded_resource = LoadResource(module, resource_handle);
     if (loaded_resource == NULL) {
-        PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "Failed to load embedded resource %s", resource_name);
+        PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "Failed to load embedded resource %s", resource_name);
         return 0;
     }
 
     resource_size = SizeofResource(module, resource_handle);
     resource_data = LockResource(loaded_resource);
     if (resource_data == NULL) {
-        PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "Failed to lock embedded resource %s", resource_name);
+        PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "Failed to lock embedded resource %s", resource_name);
         return 0;
     }
 
     fp = fopen(output_path, "wb");
     if (fp == NULL) {
-        PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "Failed to create %s", output_path);
+        PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "Failed to create %s", output_path);
         return 0;
     }
 
     if (resource_size > 0 && fwrite(resource_data, 1, resource_size, fp) != resource_size) {
         fclose(fp);
-        PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "Failed to write %s", output_path);
+        PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "Failed to write %s", output_path);
         return 0;
     }
 
@@ -262,7 +264,7 @@ static int ppc_extract_embedded_resource(HMODULE module, int resource_id, const
     return 1;
 }
 
-static int ppc_prepare_resource_dir(void)
+static int ppc_prepare_resource_dir(char *ErrorMessage)
 {
     DWORD temp_len;
     DWORD error_code;
@@ -277,7 +279,7 @@ static int ppc_prepare_resource_dir(void)
 
     temp_len = GetTempPathA((DWORD)sizeof(temp_path), temp_path);
     if (temp_len == 0 || temp_len >= sizeof(temp_path)) {
-        PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "Failed to get temp path");
+        PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "Failed to get temp path");
         return 0;
     }
 
@@ -291,19 +293,19 @@ static int ppc_prepare_resource_dir(void)
     if (!CreateDirectoryA(PPC_RESOURCE_DIR, NULL)) {
         error_code = GetLastError();
         if (error_code != ERROR_ALREADY_EXISTS) {
-            PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "Failed to create temp resource dir %s", PPC_RESOURCE_DIR);
+            PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "Failed to create temp resource dir %s", PPC_RESOURCE_DIR);
             return 0;
         }
     }
 
     module = PPC_DLL_MODULE;
     if (module == NULL) {
-        PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "Failed to resolve PPC module handle");
+        PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "Failed to resolve PPC module handle");
         return 0;
     }
 
     for (i = 0; i < PPC_EMBEDDED_RESOURCE_COUNT; ++i) {
-        if (!ppc_extract_embedded_resource(module, PPC_EMBEDDED_RESOURCE_IDS[i], PPC_EMBEDDED_RESOURCE_NAMES[i], PPC_RESOURCE_DIR)) {
+        if (!ppc_extract_embedded_resource(module, PPC_EMBEDDED_RESOURCE_IDS[i], PPC_EMBEDDED_RESOURCE_NAMES[i], PPC_RESOURCE_DIR, ErrorMessage)) {
             return 0;
         }
     }
@@ -341,7 +343,9 @@ static void ppc_cleanup_resource_dir(void)
 }
 #endif
 
-static int32_T ensure_fmu_created(void)
+/* The FMU component is shared by the whole process, so there can be only one PPC instance at a time.
+   Its logger writes into the message text of the instance that created it. */
+static int32_T ensure_fmu_created(char *ErrorMessage)
 {
     fmi2CallbackFunctions callbacks;
     const char *resource_uri = "";
@@ -354,10 +358,10 @@ static int32_T ensure_fmu_created(void)
     callbacks.allocateMemory = calloc;
     callbacks.freeMemory = free;
     callbacks.stepFinished = NULL;
-    callbacks.componentEnvironment = NULL;
+    callbacks.componentEnvironment = ErrorMessage;
 
 #if defined(_WIN32)
-    if (!ppc_prepare_resource_dir()) {
+    if (!ppc_prepare_resource_dir(ErrorMessage)) {
         return IEEE_Cigre_DLLInterface_Return_Error;
     }
     resource_uri = PPC_RESOURCE_URI;
@@ -365,7 +369,7 @@ static int32_T ensure_fmu_created(void)
 
     PPC_FMU_COMPONENT = fmi2Instantiate("PPC", fmi2CoSimulation, MODEL_GUID, resource_uri, &callbacks, fmi2False, fmi2False);
     if (PPC_FMU_COMPONENT == NULL) {
-        PPC_SNPRINTF(ErrorMessage, sizeof(ErrorMessage), "Failed to instantiate FMU");
+        PPC_SNPRINTF(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "Failed to instantiate FMU");
 #if defined(_WIN32)
         ppc_cleanup_resource_dir();
 #endif
@@ -434,23 +438,43 @@ DLL_EXPORT const IEEE_Cigre_DLLInterface_Model_Info *DLL_CALL Model_GetInfo(void
     return &Model_Info;
 }
 
+/* Optional: message text of the instance's own, in a buffer the program keeps until after Model_Terminate */
+DLL_EXPORT int32_T DLL_CALL Model_SetMessageBuffer(IEEE_Cigre_DLLInterface_Instance *instance, char_T *pBuffer, int32_T nBytes)
+{
+    if (pBuffer == NULL || nBytes < DLL_MODEL_MESSAGE_BYTES) {
+        return IEEE_Cigre_DLLInterface_Return_Error;
+    }
+    pBuffer[0] = '\0';
+    instance->LastGeneralMessage = pBuffer;
+    instance->LastErrorMessage = pBuffer;
+    return IEEE_Cigre_DLLInterface_Return_OK;
+}
+
 DLL_EXPORT int32_T DLL_CALL Model_CheckParameters(IEEE_Cigre_DLLInterface_Instance *instance)
 {
     MyModelParameters *parameters = (MyModelParameters *)instance->Parameters;
+    char *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
 
     parameters->FrqFlag = parameters->FrqFlag ? 1 : 0;
     parameters->RefFlag = parameters->RefFlag ? 1 : 0;
     parameters->VcmpFlag = parameters->VcmpFlag ? 1 : 0;
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 }
 
 DLL_EXPORT int32_T DLL_CALL Model_FirstCall(IEEE_Cigre_DLLInterface_Instance *instance)
 {
-    (void)instance;
+    char *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
+    int32_T rc;
+
     ErrorMessage[0] = '\0';
-    return ensure_fmu_created();
+    rc = ensure_fmu_created(ErrorMessage);
+    if (rc == IEEE_Cigre_DLLInterface_Return_Error) {
+        instance->LastErrorMessage = ErrorMessage;
+    }
+    instance->LastGeneralMessage = ErrorMessage;
+    return rc;
 }
 
 DLL_EXPORT int32_T DLL_CALL Model_Initialize(IEEE_Cigre_DLLInterface_Instance *instance)
@@ -460,11 +484,12 @@ DLL_EXPORT int32_T DLL_CALL Model_Initialize(IEEE_Cigre_DLLInterface_Instance *i
     MyModelOutputs *outputs = (MyModelOutputs *)instance->ExternalOutputs;
     fmi2Status status;
 
+    char *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
     outputs->Pref = 0.0;
     outputs->Qext = 0.0;
 
-    if (ensure_fmu_created() != IEEE_Cigre_DLLInterface_Return_OK) {
+    if (ensure_fmu_created(ErrorMessage) != IEEE_Cigre_DLLInterface_Return_OK) {
         instance->LastErrorMessage = ErrorMessage;
         return IEEE_Cigre_DLLInterface_Return_Error;
     }
@@ -488,7 +513,7 @@ DLL_EXPORT int32_T DLL_CALL Model_Initialize(IEEE_Cigre_DLLInterface_Instance *i
     if (status > fmi2Warning) return map_fmi_status(status);
 
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 }
 
 DLL_EXPORT int32_T DLL_CALL Model_Outputs(IEEE_Cigre_DLLInterface_Instance *instance)
@@ -499,9 +524,10 @@ DLL_EXPORT int32_T DLL_CALL Model_Outputs(IEEE_Cigre_DLLInterface_Instance *inst
     fmi2Real qext = 0.0;
     fmi2Status status;
 
+    char *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
 
-    if (ensure_fmu_created() != IEEE_Cigre_DLLInterface_Return_OK) {
+    if (ensure_fmu_created(ErrorMessage) != IEEE_Cigre_DLLInterface_Return_OK) {
         instance->LastErrorMessage = ErrorMessage;
         return IEEE_Cigre_DLLInterface_Return_Error;
     }
@@ -524,11 +550,12 @@ DLL_EXPORT int32_T DLL_CALL Model_Outputs(IEEE_Cigre_DLLInterface_Instance *inst
     outputs->Pref = pref;
     outputs->Qext = qext;
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 }
 
 DLL_EXPORT int32_T DLL_CALL Model_Terminate(IEEE_Cigre_DLLInterface_Instance *instance)
 {
+    char *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
     if (PPC_FMU_COMPONENT != NULL) {
         fmi2Terminate(PPC_FMU_COMPONENT);
@@ -539,7 +566,57 @@ DLL_EXPORT int32_T DLL_CALL Model_Terminate(IEEE_Cigre_DLLInterface_Instance *in
     ppc_cleanup_resource_dir();
 #endif
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
+}
+
+/* Snapshot hooks for the wrapper: the FMU state is serialized through fmi2GetFMUstate, so an
+   FMU exported without canGetAndSetFMUstate and canSerializeFMUstate cannot be snapshotted. */
+DLL_EXPORT int32_T DLL_CALL Model_SaveState(IEEE_Cigre_DLLInterface_Instance *instance, void *pBuffer, int32_T nBytes)
+{
+    fmi2FMUstate state = NULL;
+    size_t size = 0;
+    fmi2Status status;
+
+    char *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
+    ErrorMessage[0] = '\0';
+    instance->LastGeneralMessage = ErrorMessage;
+    if (PPC_FMU_COMPONENT == NULL) {
+        return -1;
+    }
+    status = fmi2GetFMUstate(PPC_FMU_COMPONENT, &state);
+    if (status > fmi2Warning) return -1;
+    status = fmi2SerializedFMUstateSize(PPC_FMU_COMPONENT, state, &size);
+    if (status <= fmi2Warning && pBuffer != NULL) {
+        if ((size_t)nBytes < size) {
+            status = fmi2Error;
+        } else {
+            status = fmi2SerializeFMUstate(PPC_FMU_COMPONENT, state, (fmi2Byte *)pBuffer, size);
+        }
+    }
+    fmi2FreeFMUstate(PPC_FMU_COMPONENT, &state);
+    if (status > fmi2Warning) return -1;
+    return (int32_T)size;
+}
+
+DLL_EXPORT int32_T DLL_CALL Model_RestoreState(IEEE_Cigre_DLLInterface_Instance *instance, const void *pBuffer, int32_T nBytes)
+{
+    fmi2FMUstate state = NULL;
+    fmi2Status status;
+
+    char *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
+    ErrorMessage[0] = '\0';
+    if (ensure_fmu_created(ErrorMessage) != IEEE_Cigre_DLLInterface_Return_OK) {
+        instance->LastErrorMessage = ErrorMessage;
+        return IEEE_Cigre_DLLInterface_Return_Error;
+    }
+    status = fmi2DeSerializeFMUstate(PPC_FMU_COMPONENT, (const fmi2Byte *)pBuffer, (size_t)nBytes, &state);
+    if (status > fmi2Warning) return map_fmi_status(status);
+    status = fmi2SetFMUstate(PPC_FMU_COMPONENT, state);
+    fmi2FreeFMUstate(PPC_FMU_COMPONENT, &state);
+    if (status > fmi2Warning) return map_fmi_status(status);
+
+    instance->LastGeneralMessage = ErrorMessage;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 }
 
 DLL_EXPORT int32_T DLL_CALL Model_PrintInfo(void)
@@ -1,11 +1,10 @@
-#define DLL_NAME "PPC.dll"
+#define DLL_NAME DLL_FILE_NAME("PPC")
 #define TMAX 10.0
 #define CSV_DIR ""
 #define VBASE 400e3
 #define SBASE 100e6
 #define MBASE 100e6
 
-#include <windows.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -171,10 +170,10 @@ int main( void )
     while (t <= tstop) {
       pWrap->pModel->Time = t;
       update_inputs (pWrap, pScenario, t);
-      pWrap->Model_Outputs (pWrap->pModel);
+      int32_T rc = pWrap->Model_Outputs (pWrap->pModel);
       (void) extract_outputs (pWrap->pModel, pWrap->pOutputMap, pWrap->pInfo->NumOutputPorts);
       write_csv_values (fp, pWrap->pModel, pWrap->pInfo, pWrap->pInputMap, pWrap->pOutputMap, t);
-      check_messages ("Model_Outputs", pWrap->pModel);
+      check_model_return ("Model_Outputs", pWrap->pModel, rc);
       t += dt;
     }
     fclose (fp);
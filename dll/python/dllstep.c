@@ -0,0 +1,737 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+CPython extension that steps IEEE/Cigre model DLLs from numpy arrays. ctypes costs a few microseconds
+per call, and a call per port per step, which is far slower than the models themselves at EMT time
+steps. Here step(n, inputs) runs the whole loop in C: it converts each row of the input array into
+the model's ExternalInputs, calls Model_Outputs, and converts ExternalOutputs into a row of the output
+array, with the GIL released so other Python threads, e.g., one stepping another instance, keep going.
+
+A ModelClass loads one library through the wrapper and owns its DLLModelClass; each Instance holds a
+reference to its ModelClass, so the library stays loaded while any instance is alive. An instance
+steps on its own integer clock, Time = k * FixedStepBaseSampleTime, like the wrapper drivers.
+While a step runs without the GIL, the instance is marked busy and every other method on it raises.
+
+Ports are treated as scalars of any numeric type, as in the rest of the wrapper; the arrays are
+always float64. Values of c_string parameters are copied, and the copies live as long as the instance.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLSnapshot.h"
+
+typedef struct _ModelClassObject_ {
+  PyObject_HEAD
+  DLLModelClass *pClass;
+  PyObject *pInputNames;      // tuples of str, in port order
+  PyObject *pOutputNames;
+  PyObject *pParameterNames;
+} ModelClassObject;
+
+typedef struct _InstanceObject_ {
+  PyObject_HEAD
+  ModelClassObject *pOwner;
+  Wrapped_IEEE_Cigre_DLL *pWrap;
+  long Step;                  // index of the next call to Model_Outputs
+  int bChecked;               // Model_CheckParameters has run, so Model_Terminate is safe
+  int bInitialized;
+  int bBusy;                  // step() is running without the GIL
+  int bAllReal64;             // every input and output is real64_T, so no conversions in the loop
+  char **pStrings;            // copies of the c_string parameter values, indexed by parameter
+} InstanceObject;
+
+static PyTypeObject ModelClassType;
+static PyTypeObject InstanceType;
+
+/********************************* ModelClass *********************************/
+
+static PyObject *signal_names (const IEEE_Cigre_DLLInterface_Signal *pSignals, int n)
+{
+  PyObject *pNames = PyTuple_New (n);
+  for (int i = 0; pNames != NULL && i < n; i++) {
+    PyTuple_SET_ITEM (pNames, i, PyUnicode_FromString (pSignals[i].Name));
+  }
+  return pNames;
+}
+
+static int ModelClass_init (ModelClassObject *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[] = {"library", NULL};
+  PyObject *pPath = NULL;
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "O&", kwlist, PyUnicode_FSConverter, &pPath)) {
+    return -1;
+  }
+  if (NULL != self->pClass) {
+    PyErr_SetString (PyExc_RuntimeError, "ModelClass is already loaded");
+    Py_DECREF (pPath);
+    return -1;
+  }
+  self->pClass = LoadDLLModelClass (PyBytes_AS_STRING (pPath));
+  if (NULL == self->pClass) {
+    PyErr_Format (PyExc_OSError, "could not load model library %s", PyBytes_AS_STRING (pPath));
+    Py_DECREF (pPath);
+    return -1;
+  }
+  Py_DECREF (pPath);
+  pInfo = self->pClass->pInfo;
+  self->pInputNames = signal_names (pInfo->InputPortsInfo, pInfo->NumInputPorts);
+  self->pOutputNames = signal_names (pInfo->OutputPortsInfo, pInfo->NumOutputPorts);
+  self->pParameterNames = PyTuple_New (pInfo->NumParameters);
+  for (int i = 0; NULL != self->pParameterNames && i < pInfo->NumParameters; i++) {
+    PyTuple_SET_ITEM (self->pParameterNames, i, PyUnicode_FromString (pInfo->ParametersInfo[i].Name));
+  }
+  if (NULL == self->pInputNames || NULL == self->pOutputNames || NULL == self->pParameterNames) {
+    return -1;
+  }
+  return 0;
+}
+
+static void ModelClass_dealloc (ModelClassObject *self)
+{
+  Py_XDECREF (self->pInputNames);
+  Py_XDECREF (self->pOutputNames);
+  Py_XDECREF (self->pParameterNames);
+  if (NULL != self->pClass) {
+    FreeDLLModelClass (self->pClass);
+  }
+  Py_TYPE (self)->tp_free ((PyObject *) self);
+}
+
+static int check_loaded (ModelClassObject *self)
+{
+  if (NULL == self->pClass) {
+    PyErr_SetString (PyExc_RuntimeError, "ModelClass was not loaded");
+    return 0;
+  }
+  return 1;
+}
+
+static PyObject *ModelClass_instance (ModelClassObject *self, PyObject *Py_UNUSED (ignored))
+{
+  return PyObject_CallOneArg ((PyObject *) &InstanceType, (PyObject *) self);
+}
+
+static PyObject *ModelClass_get_name (ModelClassObject *self, void *closure)
+{
+  return check_loaded (self) ? PyUnicode_FromString (self->pClass->pInfo->ModelName) : NULL;
+}
+
+static PyObject *ModelClass_get_version (ModelClassObject *self, void *closure)
+{
+  return check_loaded (self) ? PyUnicode_FromString (self->pClass->pInfo->ModelVersion) : NULL;
+}
+
+static PyObject *ModelClass_get_dt (ModelClassObject *self, void *closure)
+{
+  return check_loaded (self) ? PyFloat_FromDouble (self->pClass->pInfo->FixedStepBaseSampleTime) : NULL;
+}
+
+static PyObject *ModelClass_get_mode (ModelClassObject *self, void *closure)
+{
+  return check_loaded (self) ? PyUnicode_FromString (modeEMTorRMS (self->pClass->pInfo->EMT_RMS_Mode)) : NULL;
+}
+
+static PyObject *names_or_error (ModelClassObject *self, PyObject *pNames)
+{
+  if (!check_loaded (self)) {
+    return NULL;
+  }
+  Py_INCREF (pNames);
+  return pNames;
+}
+
+static PyObject *ModelClass_get_inputs (ModelClassObject *self, void *closure)
+{
+  return names_or_error (self, self->pInputNames);
+}
+
+static PyObject *ModelClass_get_outputs (ModelClassObject *self, void *closure)
+{
+  return names_or_error (self, self->pOutputNames);
+}
+
+static PyObject *ModelClass_get_parameters (ModelClassObject *self, void *closure)
+{
+  return names_or_error (self, self->pParameterNames);
+}
+
+static PyMethodDef ModelClass_methods[] = {
+  {"instance", (PyCFunction) ModelClass_instance, METH_NOARGS,
+   "instance() -> Instance with the default parameters, equivalent to Instance(self)"},
+  {NULL}
+};
+
+static PyGetSetDef ModelClass_getset[] = {
+  {"name", (getter) ModelClass_get_name, NULL, "ModelName from the library", NULL},
+  {"version", (getter) ModelClass_get_version, NULL, "ModelVersion from the library", NULL},
+  {"dt", (getter) ModelClass_get_dt, NULL, "FixedStepBaseSampleTime in seconds", NULL},
+  {"mode", (getter) ModelClass_get_mode, NULL, "EMT, RMS or both", NULL},
+  {"inputs", (getter) ModelClass_get_inputs, NULL, "input port names, in the column order of step()", NULL},
+  {"outputs", (getter) ModelClass_get_outputs, NULL, "output port names, in the column order of step()", NULL},
+  {"parameters", (getter) ModelClass_get_parameters, NULL, "parameter names", NULL},
+  {NULL}
+};
+
+static PyTypeObject ModelClassType = {
+  PyVarObject_HEAD_INIT (NULL, 0)
+  .tp_name = "dllstep.ModelClass",
+  .tp_doc = PyDoc_STR ("ModelClass(library) loads an IEEE/Cigre model DLL, shared by its instances"),
+  .tp_basicsize = sizeof (ModelClassObject),
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_new = PyType_GenericNew,
+  .tp_init = (initproc) ModelClass_init,
+  .tp_dealloc = (destructor) ModelClass_dealloc,
+  .tp_methods = ModelClass_methods,
+  .tp_getset = ModelClass_getset,
+};
+
+/********************************** Instance **********************************/
+
+static int check_idle (InstanceObject *self)
+{
+  if (NULL == self->pWrap) {
+    PyErr_SetString (PyExc_RuntimeError, "Instance was not created");
+    return 0;
+  }
+  if (self->bBusy) {
+    PyErr_SetString (PyExc_RuntimeError, "Instance is stepping in another thread");
+    return 0;
+  }
+  return 1;
+}
+
+// raises RuntimeError with the model's error message
+static void set_model_error (InstanceObject *self, const char *loc)
+{
+  IEEE_Cigre_DLLInterface_Instance *pModel = self->pWrap->pModel;
+  const char *msg = (NULL != pModel->LastErrorMessage) ? pModel->LastErrorMessage : "";
+  PyErr_Format (PyExc_RuntimeError, "%s failed in %s at t=%g: %s", self->pWrap->pInfo->ModelName,
+                loc, pModel->Time, msg);
+}
+
+static int Instance_init (InstanceObject *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[] = {"model_class", NULL};
+  ModelClassObject *pOwner;
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "O!", kwlist, &ModelClassType, &pOwner)) {
+    return -1;
+  }
+  if (!check_loaded (pOwner)) {
+    return -1;
+  }
+  if (NULL != self->pWrap) {
+    PyErr_SetString (PyExc_RuntimeError, "Instance was already created");
+    return -1;
+  }
+  self->pWrap = CreateDLLModelInstance (pOwner->pClass);
+  if (NULL == self->pWrap) {
+    PyErr_NoMemory ();
+    return -1;
+  }
+  Py_INCREF (pOwner);
+  self->pOwner = pOwner;
+  pInfo = self->pWrap->pInfo;
+  self->pStrings = (char **) PyMem_Calloc (pInfo->NumParameters + 1, sizeof (char *));
+  self->bAllReal64 = 1;
+  for (int i = 0; i < pInfo->NumInputPorts; i++) {
+    if (IEEE_Cigre_DLLInterface_DataType_real64_T != self->pWrap->pInputMap[i].dtype) {
+      self->bAllReal64 = 0;
+    }
+  }
+  for (int i = 0; i < pInfo->NumOutputPorts; i++) {
+    if (IEEE_Cigre_DLLInterface_DataType_real64_T != self->pWrap->pOutputMap[i].dtype) {
+      self->bAllReal64 = 0;
+    }
+  }
+  return 0;
+}
+
+static void Instance_dealloc (InstanceObject *self)
+{
+  if (NULL != self->pWrap) {
+    if (!self->bChecked) {  // FreeDLLModelInstance calls Model_Terminate, which some models only survive after this
+      self->pWrap->Model_CheckParameters (self->pWrap->pModel);
+    }
+    FreeDLLModelInstance (self->pWrap);
+  }
+  if (NULL != self->pStrings) {
+    for (int i = 0; NULL != self->pOwner && i < self->pOwner->pClass->pInfo->NumParameters; i++) {
+      PyMem_Free (self->pStrings[i]);
+    }
+    PyMem_Free (self->pStrings);
+  }
+  Py_XDECREF (self->pOwner);
+  Py_TYPE (self)->tp_free ((PyObject *) self);
+}
+
+// numeric values are converted to the parameter's type; str only for c_string parameters
+static int set_one_parameter (InstanceObject *self, PyObject *pName, PyObject *pValue)
+{
+  const char *name = PyUnicode_AsUTF8 (pName);
+  DLLPortHandle h;
+  char *pBase = (char *) self->pWrap->pModel->Parameters;
+
+  if (NULL == name) {
+    return 0;
+  }
+  h = GetParameterHandle (self->pWrap, name);
+  if (h.index < 0) {
+    PyErr_Format (PyExc_KeyError, "%s has no parameter named %s", self->pWrap->pInfo->ModelName, name);
+    return 0;
+  }
+  if (IEEE_Cigre_DLLInterface_DataType_c_string_T == h.dtype) {
+    union EditValueU val;
+    Py_ssize_t len;
+    const char *str = PyUnicode_Check (pValue) ? PyUnicode_AsUTF8AndSize (pValue, &len) : NULL;
+    char *pCopy;
+    if (NULL == str) {
+      if (!PyErr_Occurred ()) {
+        PyErr_Format (PyExc_TypeError, "parameter %s takes a str", name);
+      }
+      return 0;
+    }
+    pCopy = (char *) PyMem_Malloc (len + 1);
+    if (NULL == pCopy) {
+      PyErr_NoMemory ();
+      return 0;
+    }
+    memcpy (pCopy, str, len + 1);
+    PyMem_Free (self->pStrings[h.index]);
+    self->pStrings[h.index] = pCopy;
+    val.Char_Ptr = pCopy;
+    edit_dll_value (pBase, h.offset, h.dtype, h.size, val);
+  } else {
+    double x = PyFloat_AsDouble (pValue);
+    if (-1.0 == x && PyErr_Occurred ()) {
+      return 0;
+    }
+    write_dll_real64 (pBase + h.offset, h.dtype, x);
+  }
+  return 1;
+}
+
+static PyObject *Instance_set_parameters (InstanceObject *self, PyObject *args, PyObject *kwds)
+{
+  PyObject *pDict = NULL;
+  PyObject *pName, *pValue;
+  Py_ssize_t pos = 0;
+
+  if (!check_idle (self) || !PyArg_ParseTuple (args, "|O!", &PyDict_Type, &pDict)) {
+    return NULL;
+  }
+  while (NULL != pDict && PyDict_Next (pDict, &pos, &pName, &pValue)) {
+    if (!set_one_parameter (self, pName, pValue)) {
+      return NULL;
+    }
+  }
+  pos = 0;
+  while (NULL != kwds && PyDict_Next (kwds, &pos, &pName, &pValue)) {
+    if (!set_one_parameter (self, pName, pValue)) {
+      return NULL;
+    }
+  }
+  Py_RETURN_NONE;
+}
+
+static PyObject *Instance_get_parameter (InstanceObject *self, PyObject *pName)
+{
+  const char *name;
+  DLLPortHandle h;
+  const char *p;
+
+  if (!check_idle (self) || NULL == (name = PyUnicode_AsUTF8 (pName))) {
+    return NULL;
+  }
+  h = GetParameterHandle (self->pWrap, name);
+  if (h.index < 0) {
+    PyErr_Format (PyExc_KeyError, "%s has no parameter named %s", self->pWrap->pInfo->ModelName, name);
+    return NULL;
+  }
+  p = (const char *) self->pWrap->pModel->Parameters + h.offset;
+  if (IEEE_Cigre_DLLInterface_DataType_c_string_T == h.dtype) {
+    const char *str;
+    memcpy (&str, p, sizeof (str));
+    return PyUnicode_FromString (NULL != str ? str : "");
+  }
+  return PyFloat_FromDouble (read_dll_real64 (p, h.dtype));
+}
+
+// copies one row of nin doubles into ExternalInputs
+static void write_inputs (InstanceObject *self, const double *pRow)
+{
+  char *pInputs = (char *) self->pWrap->pModel->ExternalInputs;
+  const ArrayMap *pMap = self->pWrap->pInputMap;
+  int nin = self->pWrap->pInfo->NumInputPorts;
+
+  if (self->bAllReal64) {
+    for (int i = 0; i < nin; i++) {
+      *(double *) (pInputs + pMap[i].offset) = pRow[i];
+    }
+  } else {
+    for (int i = 0; i < nin; i++) {
+      write_dll_real64 (pInputs + pMap[i].offset, pMap[i].dtype, pRow[i]);
+    }
+  }
+}
+
+static void read_outputs (InstanceObject *self, double *pRow)
+{
+  const char *pOutputs = (const char *) self->pWrap->pModel->ExternalOutputs;
+  const ArrayMap *pMap = self->pWrap->pOutputMap;
+  int nout = self->pWrap->pInfo->NumOutputPorts;
+
+  if (self->bAllReal64) {
+    for (int i = 0; i < nout; i++) {
+      pRow[i] = *(const double *) (pOutputs + pMap[i].offset);
+    }
+  } else {
+    for (int i = 0; i < nout; i++) {
+      pRow[i] = read_dll_real64 (pOutputs + pMap[i].offset, pMap[i].dtype);
+    }
+  }
+}
+
+// NULL, None or a 1-D array of nin; returns a new reference to a float64 array, or NULL with an exception
+static PyArrayObject *input_row (InstanceObject *self, PyObject *pObj)
+{
+  int nin = self->pWrap->pInfo->NumInputPorts;
+  PyArrayObject *pArr = (PyArrayObject *) PyArray_FROMANY (pObj, NPY_FLOAT64, 1, 1, NPY_ARRAY_IN_ARRAY);
+
+  if (NULL != pArr && PyArray_DIM (pArr, 0) != nin) {
+    PyErr_Format (PyExc_ValueError, "%s has %d inputs, not %zd", self->pWrap->pInfo->ModelName, nin,
+                  (Py_ssize_t) PyArray_DIM (pArr, 0));
+    Py_DECREF (pArr);
+    return NULL;
+  }
+  return pArr;
+}
+
+static PyObject *Instance_initialize (InstanceObject *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[] = {"inputs", NULL};
+  PyObject *pObj = Py_None;
+  Wrapped_IEEE_Cigre_DLL *pWrap;
+
+  if (!check_idle (self) || !PyArg_ParseTupleAndKeywords (args, kwds, "|O", kwlist, &pObj)) {
+    return NULL;
+  }
+  pWrap = self->pWrap;
+  if (Py_None != pObj) {
+    PyArrayObject *pArr = input_row (self, pObj);
+    if (NULL == pArr) {
+      return NULL;
+    }
+    write_inputs (self, (const double *) PyArray_DATA (pArr));
+    Py_DECREF (pArr);
+  }
+  if (self->bChecked) {  // re-initializing, e.g., with new parameters
+    pWrap->Model_Terminate (pWrap->pModel);
+    self->bChecked = 0;
+  }
+  self->bInitialized = 0;
+  self->Step = 0;
+  pWrap->pModel->Time = 0.0;
+  if (NULL != pWrap->Model_FirstCall && IEEE_Cigre_DLLInterface_Return_Error == pWrap->Model_FirstCall (pWrap->pModel)) {
+    set_model_error (self, "Model_FirstCall");
+    return NULL;
+  }
+  self->bChecked = 1;
+  if (IEEE_Cigre_DLLInterface_Return_Error == pWrap->Model_CheckParameters (pWrap->pModel)) {
+    set_model_error (self, "Model_CheckParameters");
+    return NULL;
+  }
+  if (IEEE_Cigre_DLLInterface_Return_Error == pWrap->Model_Initialize (pWrap->pModel)) {
+    set_model_error (self, "Model_Initialize");
+    return NULL;
+  }
+  check_messages ("initialize", pWrap->pModel);
+  self->bInitialized = 1;
+  Py_RETURN_NONE;
+}
+
+static PyObject *Instance_step (InstanceObject *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[] = {"n", "inputs", "out", NULL};
+  Py_ssize_t n;
+  PyObject *pInObj, *pOutObj = Py_None;
+  PyArrayObject *pIn, *pOut;
+  Wrapped_IEEE_Cigre_DLL *pWrap;
+  int nin, nout, bHold, rc = IEEE_Cigre_DLLInterface_Return_OK;
+  double dt;
+  long k0;
+  Py_ssize_t k;
+
+  if (!check_idle (self) || !PyArg_ParseTupleAndKeywords (args, kwds, "nO|O", kwlist, &n, &pInObj, &pOutObj)) {
+    return NULL;
+  }
+  if (!self->bInitialized) {
+    PyErr_SetString (PyExc_RuntimeError, "call initialize() before step()");
+    return NULL;
+  }
+  if (n < 0) {
+    PyErr_SetString (PyExc_ValueError, "n must not be negative");
+    return NULL;
+  }
+  pWrap = self->pWrap;
+  nin = pWrap->pInfo->NumInputPorts;
+  nout = pWrap->pInfo->NumOutputPorts;
+
+  pIn = (PyArrayObject *) PyArray_FROMANY (pInObj, NPY_FLOAT64, 1, 2, NPY_ARRAY_IN_ARRAY);
+  if (NULL == pIn) {
+    return NULL;
+  }
+  bHold = (1 == PyArray_NDIM (pIn));  // one row of inputs held for all n steps
+  if (PyArray_DIM (pIn, bHold ? 0 : 1) != nin || (!bHold && PyArray_DIM (pIn, 0) != n)) {
+    PyErr_Format (PyExc_ValueError, "inputs must have shape (%zd, %d) or (%d,)", n, nin, nin);
+    Py_DECREF (pIn);
+    return NULL;
+  }
+  if (Py_None == pOutObj) {
+    npy_intp dims[2] = {n, nout};
+    pOut = (PyArrayObject *) PyArray_SimpleNew (2, dims, NPY_FLOAT64);
+    if (NULL == pOut) {
+      Py_DECREF (pIn);
+      return NULL;
+    }
+  } else {
+    if (!PyArray_Check (pOutObj) || PyArray_TYPE ((PyArrayObject *) pOutObj) != NPY_FLOAT64 ||
+        !PyArray_ISCARRAY ((PyArrayObject *) pOutObj) || PyArray_NDIM ((PyArrayObject *) pOutObj) != 2 ||
+        PyArray_DIM ((PyArrayObject *) pOutObj, 0) != n || PyArray_DIM ((PyArrayObject *) pOutObj, 1) != nout) {
+      PyErr_Format (PyExc_ValueError, "out must be a writable C-contiguous float64 array of shape (%zd, %d)", n, nout);
+      Py_DECREF (pIn);
+      return NULL;
+    }
+    pOut = (PyArrayObject *) pOutObj;
+    Py_INCREF (pOut);
+  }
+
+  dt = pWrap->pInfo->FixedStepBaseSampleTime;
+  k0 = self->Step;
+  self->bBusy = 1;
+  {
+    const double *pInRow = (const double *) PyArray_DATA (pIn);
+    double *pOutRow = (double *) PyArray_DATA (pOut);
+    Py_BEGIN_ALLOW_THREADS
+    if (bHold) {
+      write_inputs (self, pInRow);
+    }
+    for (k = 0; k < n; k++) {
+      if (!bHold) {
+        write_inputs (self, pInRow + k * nin);
+      }
+      pWrap->pModel->Time = (double) (k0 + k) * dt;
+      rc = pWrap->Model_Outputs (pWrap->pModel);
+      if (IEEE_Cigre_DLLInterface_Return_Error == rc) {
+        break;
+      }
+      read_outputs (self, pOutRow + k * nout);
+    }
+    Py_END_ALLOW_THREADS
+  }
+  self->bBusy = 0;
+  self->Step = k0 + (long) k;
+  Py_DECREF (pIn);
+  if (IEEE_Cigre_DLLInterface_Return_Error == rc) {
+    self->Step++;  // the failed step was taken
+    set_model_error (self, "Model_Outputs");
+    Py_DECREF (pOut);
+    return NULL;
+  }
+  return (PyObject *) pOut;
+}
+
+static PyObject *Instance_terminate (InstanceObject *self, PyObject *Py_UNUSED (ignored))
+{
+  if (!check_idle (self)) {
+    return NULL;
+  }
+  if (self->bChecked) {
+    self->pWrap->Model_Terminate (self->pWrap->pModel);
+    self->bChecked = 0;
+  }
+  self->bInitialized = 0;
+  Py_RETURN_NONE;
+}
+
+static PyObject *Instance_save (InstanceObject *self, PyObject *Py_UNUSED (ignored))
+{
+  size_t nBytes;
+  void *pBlob;
+  PyObject *pBytes;
+
+  if (!check_idle (self)) {
+    return NULL;
+  }
+  if (!self->bInitialized) {
+    PyErr_SetString (PyExc_RuntimeError, "call initialize() before save()");
+    return NULL;
+  }
+  pBlob = SnapshotInstance (self->pWrap, &nBytes);
+  if (NULL == pBlob) {
+    PyErr_Format (PyExc_RuntimeError, "could not save the state of %s", self->pWrap->pInfo->ModelName);
+    return NULL;
+  }
+  pBytes = PyBytes_FromStringAndSize ((const char *) pBlob, (Py_ssize_t) nBytes);
+  FreeInstanceSnapshot (pBlob);
+  return pBytes;
+}
+
+static PyObject *Instance_restore (InstanceObject *self, PyObject *args)
+{
+  Py_buffer blob;
+  int32_T rc;
+
+  if (!check_idle (self) || !PyArg_ParseTuple (args, "y*", &blob)) {
+    return NULL;
+  }
+  if (!self->bInitialized) {
+    PyBuffer_Release (&blob);
+    PyErr_SetString (PyExc_RuntimeError, "call initialize() before restore()");
+    return NULL;
+  }
+  rc = RestoreInstance (self->pWrap, blob.buf, (size_t) blob.len);
+  PyBuffer_Release (&blob);
+  if (IEEE_Cigre_DLLInterface_Return_OK != rc) {
+    PyErr_Format (PyExc_ValueError, "the state does not match this %s instance", self->pWrap->pInfo->ModelName);
+    return NULL;
+  }
+  self->Step = (long) (self->pWrap->pModel->Time / self->pWrap->pInfo->FixedStepBaseSampleTime + 0.5);
+  Py_RETURN_NONE;
+}
+
+static PyObject *port_values (InstanceObject *self, int bInputs)
+{
+  npy_intp n;
+  PyArrayObject *pArr;
+
+  if (!check_idle (self)) {
+    return NULL;
+  }
+  n = bInputs ? self->pWrap->pInfo->NumInputPorts : self->pWrap->pInfo->NumOutputPorts;
+  pArr = (PyArrayObject *) PyArray_SimpleNew (1, &n, NPY_FLOAT64);
+  if (NULL == pArr) {
+    return NULL;
+  }
+  if (bInputs) {
+    const char *pInputs = (const char *) self->pWrap->pModel->ExternalInputs;
+    for (npy_intp i = 0; i < n; i++) {
+      ((double *) PyArray_DATA (pArr))[i] = read_dll_real64 (pInputs + self->pWrap->pInputMap[i].offset,
+                                                             self->pWrap->pInputMap[i].dtype);
+    }
+  } else {
+    read_outputs (self, (double *) PyArray_DATA (pArr));
+  }
+  return (PyObject *) pArr;
+}
+
+static PyObject *Instance_get_inputs (InstanceObject *self, void *closure)
+{
+  return port_values (self, 1);
+}
+
+static PyObject *Instance_get_outputs (InstanceObject *self, void *closure)
+{
+  return port_values (self, 0);
+}
+
+static PyObject *Instance_get_time (InstanceObject *self, void *closure)
+{
+  if (!check_idle (self)) {
+    return NULL;
+  }
+  return PyFloat_FromDouble ((double) self->Step * self->pWrap->pInfo->FixedStepBaseSampleTime);
+}
+
+static PyObject *Instance_get_model_class (InstanceObject *self, void *closure)
+{
+  if (NULL == self->pOwner) {
+    Py_RETURN_NONE;
+  }
+  Py_INCREF (self->pOwner);
+  return (PyObject *) self->pOwner;
+}
+
+static PyMethodDef Instance_methods[] = {
+  {"set_parameters", (PyCFunction) (void (*)(void)) Instance_set_parameters, METH_VARARGS | METH_KEYWORDS,
+   "set_parameters([dict], **values) writes parameters by name; takes effect at the next initialize(), "
+   "or at once for parameters the model allows to change during a run"},
+  {"get_parameter", (PyCFunction) Instance_get_parameter, METH_O,
+   "get_parameter(name) -> float, or str for a c_string parameter"},
+  {"initialize", (PyCFunction) (void (*)(void)) Instance_initialize, METH_VARARGS | METH_KEYWORDS,
+   "initialize(inputs=None) calls Model_FirstCall, Model_CheckParameters and Model_Initialize at t=0, "
+   "after writing the initial inputs if given; terminates a previous run first"},
+  {"step", (PyCFunction) (void (*)(void)) Instance_step, METH_VARARGS | METH_KEYWORDS,
+   "step(n, inputs, out=None) -> ndarray[n, nout]\n\n"
+   "Calls Model_Outputs n times without the GIL. inputs is ndarray[n, nin], one row per step, or "
+   "ndarray[nin] held for all n steps. out is an optional preallocated C-contiguous float64 array "
+   "that receives the outputs and is returned. Raises RuntimeError if the model reports an error; "
+   "the rows of out before that step are filled."},
+  {"terminate", (PyCFunction) Instance_terminate, METH_NOARGS, "terminate() calls Model_Terminate"},
+  {"save", (PyCFunction) Instance_save, METH_NOARGS,
+   "save() -> bytes with the instance state, valid within this process; see IEEE_Cigre_DLLSnapshot.h"},
+  {"restore", (PyCFunction) Instance_restore, METH_VARARGS,
+   "restore(state) writes bytes from save() back into an initialized instance of the same model"},
+  {NULL}
+};
+
+static PyGetSetDef Instance_getset[] = {
+  {"time", (getter) Instance_get_time, NULL, "time of the next step, in seconds", NULL},
+  {"inputs", (getter) Instance_get_inputs, NULL, "copy of the current inputs", NULL},
+  {"outputs", (getter) Instance_get_outputs, NULL, "copy of the latest outputs", NULL},
+  {"model_class", (getter) Instance_get_model_class, NULL, "the ModelClass of this instance", NULL},
+  {NULL}
+};
+
+static PyTypeObject InstanceType = {
+  PyVarObject_HEAD_INIT (NULL, 0)
+  .tp_name = "dllstep.Instance",
+  .tp_doc = PyDoc_STR ("Instance(model_class) is one model instance with the default parameters"),
+  .tp_basicsize = sizeof (InstanceObject),
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_new = PyType_GenericNew,
+  .tp_init = (initproc) Instance_init,
+  .tp_dealloc = (destructor) Instance_dealloc,
+  .tp_methods = Instance_methods,
+  .tp_getset = Instance_getset,
+};
+
+/*********************************** module ***********************************/
+
+static struct PyModuleDef dllstep_module = {
+  PyModuleDef_HEAD_INIT,
+  .m_name = "dllstep",
+  .m_doc = "Steps IEEE/Cigre model DLLs from numpy arrays, looping in C without the GIL",
+  .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_dllstep (void)
+{
+  PyObject *m;
+
+  import_array ();
+  if (PyType_Ready (&ModelClassType) < 0 || PyType_Ready (&InstanceType) < 0) {
+    return NULL;
+  }
+  m = PyModule_Create (&dllstep_module);
+  if (NULL == m) {
+    return NULL;
+  }
+  Py_INCREF (&ModelClassType);
+  Py_INCREF (&InstanceType);
+  if (PyModule_AddObject (m, "ModelClass", (PyObject *) &ModelClassType) < 0 ||
+      PyModule_AddObject (m, "Instance", (PyObject *) &InstanceType) < 0) {
+    Py_DECREF (&ModelClassType);
+    Py_DECREF (&InstanceType);
+    Py_DECREF (m);
+    return NULL;
+  }
+  return m;
+}
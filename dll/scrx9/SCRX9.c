@@ -41,13 +41,26 @@ Changes for EMTHub:
 - Inserted two printf statements in Model_Initialize for parameter checking, currently commented out
 - Initialize LastGeneralMessage for the case Model_Terminate called without actually using the model
 October 30, 2024, TEMc
+- DLL_EXPORT and DLL_CALL macros, and snprintf instead of sprintf_s, so the model also builds as a Linux shared object
+- Optional Model_SetMessageBuffer, so each instance can write its messages into a buffer of its own and
+  instances can run on different threads; entry points return IEEE_Cigre_DLLInterface_Return_Message when they write one
 
 */
 // #include <windows.h>
 #include <stdio.h>
 
 #include "IEEE_Cigre_DLLInterface.h"
-char ErrorMessage[1000];
+#include "IEEE_Cigre_DLLModelMessage.h"
+
+#if defined(_WIN32)
+#define DLL_EXPORT __declspec(dllexport)
+#define DLL_CALL __cdecl
+#else
+#define DLL_EXPORT __attribute__((visibility("default")))
+#define DLL_CALL
+#endif
+
+static char_T SharedMessage[DLL_MODEL_MESSAGE_BYTES];  // for programs that do not call Model_SetMessageBuffer
 
 // ----------------------------------------------------------------------
 // Structures defining inputs, outputs, parameters and program structure
@@ -266,14 +279,29 @@ IEEE_Cigre_DLLInterface_Model_Info Model_Info = {
 // ----------------------------------------------------------------
 // Subroutines that can be called by the main power system program
 // ----------------------------------------------------------------
-__declspec(dllexport) const IEEE_Cigre_DLLInterface_Model_Info* __cdecl Model_GetInfo() {
+DLL_EXPORT const IEEE_Cigre_DLLInterface_Model_Info* DLL_CALL Model_GetInfo() {
     /* Returns Model Information
     */
     return &Model_Info;
 };
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_SetMessageBuffer(IEEE_Cigre_DLLInterface_Instance* instance, char_T* pBuffer, int32_T nBytes) {
+    /*   Optional: gives this instance message text of its own, so instances can run on different threads
+       Arguments: Instance specific model structure, and a buffer the program keeps until after Model_Terminate
+       Return:    Integer status 0 (normal), 2 if the buffer is too small
+    */
+    if (NULL == pBuffer || nBytes < DLL_MODEL_MESSAGE_BYTES) {
+        return IEEE_Cigre_DLLInterface_Return_Error;
+    }
+    pBuffer[0] = '\0';
+    instance->LastGeneralMessage = pBuffer;
+    instance->LastErrorMessage = pBuffer;
+    return IEEE_Cigre_DLLInterface_Return_OK;
+};
+
+// ----------------------------------------------------------------
+DLL_EXPORT int32_T DLL_CALL Model_CheckParameters(IEEE_Cigre_DLLInterface_Instance* instance) {
     /*   Checks the parameters on the given range
        Arguments: Instance specific model structure containing Inputs, Parameters and Outputs
        Return:    Integer status 0 (normal), 1 if messages are written, 2 for errors.  See IEEE_Cigre_DLLInterface_types.h
@@ -293,23 +321,24 @@ __declspec(dllexport) int32_T __cdecl Model_CheckParameters(IEEE_Cigre_DLLInterf
     //
     double delt = Model_Info.FixedStepBaseSampleTime;
 
+    char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
     if (TE < 2.0*delt) {
         // write error message
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "SCRX9 Error - Parameter TE is: %f, but has been reset to be 2 times the time step: %f .\n", TE, delt);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "SCRX9 Error - Parameter TE is: %f, but has been reset to be 2 times the time step: %f .\n", TE, delt);
         parameters->TE = 2.0*delt;
     }
     if (TB < 2.0*delt) {
         // write error message
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "SCRX9 Error - Parameter TB is: %f, but has been reset to be 2 times the time step: %f .\n", TB, delt);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "SCRX9 Error - Parameter TB is: %f, but has been reset to be 2 times the time step: %f .\n", TB, delt);
         parameters->TB = 2.0*delt;
     }
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Initialize(IEEE_Cigre_DLLInterface_Instance* instance) {
     /*   Initializes the system by resetting the internal states
        Arguments: Instance specific model structure containing Inputs, Parameters and Outputs
        Return:    Integer status 0 (normal), 1 if messages are written, 2 for errors.  See IEEE_Cigre_DLLInterface_types.h
@@ -353,10 +382,11 @@ __declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_I
     // Working back from initial output
     MyModelOutputs* outputs = (MyModelOutputs*)instance->ExternalOutputs;
     double EFD = outputs->EFD;
+    char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
     // test if  initial conditions use negative field logic
     if (IFD < 0.0) {
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "SCRX9 Warning - initial field current: %f is negative.\n", IFD);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "SCRX9 Warning - initial field current: %f is negative.\n", IFD);
     }
 
     // check if bus-fed or independent supply
@@ -367,11 +397,11 @@ __declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_I
     }
     // test EFD initial condition is on a EMax or EMin limit
     if (OControl < EMin) {
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "SCRX9 Warning - initial field voltage is %f and is < EMin: %f.\n", OControl, EMin);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "SCRX9 Warning - initial field voltage is %f and is < EMin: %f.\n", OControl, EMin);
         OControl = EMin;
     }
     if (OControl > EMax) {
-        sprintf_s(ErrorMessage, sizeof(ErrorMessage), "SCRX9 Warning - initial field voltage is %f and is > EMax: %f.\n", OControl, EMax);
+        snprintf(ErrorMessage, DLL_MODEL_MESSAGE_BYTES, "SCRX9 Warning - initial field voltage is %f and is > EMax: %f.\n", OControl, EMax);
         OControl = EMax;
     }
     OLeadLag = OControl / K;
@@ -386,7 +416,7 @@ __declspec(dllexport) int32_T __cdecl Model_Initialize(IEEE_Cigre_DLLInterface_I
     instance->DoubleStates[4] = OControl;
     instance->DoubleStates[5] = OLeadLag*(1.0 - TAdTB);
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 // first order lag with gain G, time constant T, with non-windup internal limits
@@ -417,11 +447,12 @@ double LEADLAG(double G, double T1, double T2, double x, double x_old, double y_
 
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Outputs(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Outputs(IEEE_Cigre_DLLInterface_Instance* instance) {
     /*   Calculates output equation
        Arguments: Instance specific model structure containing Inputs, Parameters and Outputs
        Return:    Integer status 0 (normal), 1 if messages are written, 2 for errors.  See IEEE_Cigre_DLLInterface_types.h
     */
+    char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
 
     MyModelParameters* parameters = (MyModelParameters*)instance->Parameters;
@@ -492,20 +523,21 @@ __declspec(dllexport) int32_T __cdecl Model_Outputs(IEEE_Cigre_DLLInterface_Inst
     instance->DoubleStates[4] = S_OControl;
     instance->DoubleStates[5] = S_OLeadLag;
     instance->LastGeneralMessage = ErrorMessage;
-    return IEEE_Cigre_DLLInterface_Return_OK;
+    return DLL_MODEL_MESSAGE_RETURN(ErrorMessage);
 };
 
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_Terminate(IEEE_Cigre_DLLInterface_Instance* instance) {
+DLL_EXPORT int32_T DLL_CALL Model_Terminate(IEEE_Cigre_DLLInterface_Instance* instance) {
     /*   Destroys any objects allocated by the model code - not used
     */
+    char_T *ErrorMessage = DLL_MODEL_MESSAGE(instance, SharedMessage);
     ErrorMessage[0] = '\0';
     instance->LastGeneralMessage = ErrorMessage;
 
     return IEEE_Cigre_DLLInterface_Return_OK;
 };
 // ----------------------------------------------------------------
-__declspec(dllexport) int32_T __cdecl Model_PrintInfo() {
+DLL_EXPORT int32_T DLL_CALL Model_PrintInfo() {
     /* Prints Model Information once
     */
     int Printed = 0;
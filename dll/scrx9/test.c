@@ -155,6 +155,8 @@ IEEE_Cigre_DLLInterface_Instance* CreateModelInstance (const IEEE_Cigre_DLLInter
   pModel->ExternalInputs = NULL;
   pModel->ExternalOutputs = NULL;
   pModel->Parameters = NULL;
+  pModel->LastErrorMessage = NULL;    // until the model points them at its message text
+  pModel->LastGeneralMessage = NULL;
   if (pInfo->NumInputPorts > 0) {
     size_t input_align = 0;
     for (int i = 0; i < pInfo->NumInputPorts; i++) {
@@ -2,12 +2,11 @@
 
 // see https://learn.microsoft.com/en-us/windows/win32/dlls/using-run-time-dynamic-linking
 
-#define DLL_NAME "SCRX9.dll"
+#define DLL_NAME DLL_FILE_NAME("SCRX9")
 #define TMAX 10.0
 // relative output path for execution from the build directory, e.g., release\test or debug\test
 #define CSV_NAME "scrx9.csv"
 
-#include <windows.h> 
 #include <stdio.h> 
 
 #include "IEEE_Cigre_DLLWrapper.h"
@@ -85,10 +84,10 @@ int main( void )
       pWrap->pModel->Time = t;
       update_inputs (pWrap->pModel, pWrap->pInputMap, t, pWrap->pInfo->NumInputPorts);
       // execute the DLL
-      pWrap->Model_Outputs (pWrap->pModel);
+      int32_T rc = pWrap->Model_Outputs (pWrap->pModel);
       double efd = extract_outputs (pWrap->pModel, pWrap->pOutputMap, pWrap->pInfo->NumOutputPorts);
       write_csv_values (fp, pWrap->pModel, pWrap->pInfo, pWrap->pInputMap, pWrap->pOutputMap, t);
-      check_messages ("Model_Outputs", pWrap->pModel);
+      check_model_return ("Model_Outputs", pWrap->pModel, rc);
       t += dt;
     }
     fclose (fp);
@@ -0,0 +1,373 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Contingency runner for any IEEE/Cigre model library. The model is initialized once and stepped to
+the branch time with its inputs held, then RunDLLContingencies forks one child per case. Each child
+applies its own disturbances, steps to the end time and writes its own trace file. Linux and macOS
+only, since the branch is a fork.
+
+Cases file, one disturbance per line, '#' starts a comment:
+  case-name time name value    steps input or parameter name to value at time (seconds)
+  case-name                    a case with no disturbances, e.g., the base case
+Lines with the same case name make one case, in order of first appearance.
+
+Usage: dllfanout library cases-file [options]
+  --param name=value, repeated, sets a parameter before CheckParameters
+  --input name=value, repeated, holds an input at value (others stay at 0)
+  --branch seconds (1.0), --end seconds (branch + 1.0)
+  --workers n (0 for the core count) children alive at once
+  --trace-dir dir writes dir/<case-name>.dtr for each case; no traces without it
+  --channel name[:N], repeated, traces only these ports, each every N steps (1); ports with N > 1
+    go to dir/<case-name>_dN.dtr
+  --trigger name:level[:falling] also writes every channel at every step around each rising (or
+    falling) crossing of level to dir/<case-name>_trig.dtr
+  --pre steps (0), --post steps (100) kept before and written after each trigger
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLFanout.h"
+#include "IEEE_Cigre_DLLThreads.h"
+
+#define MAX_FANOUT_ASSIGNMENTS 64
+#define MAX_FANOUT_CHANNELS 64
+#define MAX_LINE 512
+
+typedef struct _FanoutOptions_ {
+  const char *library;
+  const char *cases;
+  double branch;
+  double end;
+  int bEnd;
+  int workers;
+  const char *trace_dir;
+  int NumParams;
+  char *pParams[MAX_FANOUT_ASSIGNMENTS];
+  int NumInputs;
+  char *pInputs[MAX_FANOUT_ASSIGNMENTS];
+  int NumChannels;
+  DLLTraceChannel channels[MAX_FANOUT_CHANNELS];
+  int bPolicy;
+  DLLTracePolicy policy;        // pChannels points into channels, names into argv
+} FanoutOptions;
+
+typedef struct _FanoutCases_ {  // everything read from the cases file
+  int NumCases;
+  DLLContingency *pCases;
+  int NumDisturbances;
+  DLLDisturbance *pDisturbances;
+  int *pCaseOf;                 // case index of each disturbance, in file order
+} FanoutCases;
+
+static void usage (void)
+{
+  printf ("usage: dllfanout library cases-file [--param name=value]... [--input name=value]...\n");
+  printf ("                 [--branch seconds] [--end seconds] [--workers n] [--trace-dir dir]\n");
+  printf ("                 [--channel name[:N]]... [--trigger name:level[:falling]] [--pre steps] [--post steps]\n");
+}
+
+// name[:N] into the next channel
+static int parse_channel (char *arg, FanoutOptions *pOpt)
+{
+  char *pColon = strchr (arg, ':');
+  DLLTraceChannel *pChannel = &pOpt->channels[pOpt->NumChannels];
+
+  if (pOpt->NumChannels >= MAX_FANOUT_CHANNELS) {
+    printf ("at most %d channels\n", MAX_FANOUT_CHANNELS);
+    return 0;
+  }
+  pChannel->Decimation = 1;
+  if (NULL != pColon) {
+    *pColon = '\0';
+    pChannel->Decimation = atoi (pColon + 1);
+    if (pChannel->Decimation < 1) {
+      printf ("--channel %s:%s needs a decimation of at least 1\n", arg, pColon + 1);
+      return 0;
+    }
+  }
+  pChannel->Name = arg;
+  pOpt->NumChannels++;
+  return 1;
+}
+
+// name:level[:falling] into the trigger of the policy
+static int parse_trigger (char *arg, FanoutOptions *pOpt)
+{
+  char *pLevel = strchr (arg, ':');
+  char *pEdge;
+
+  if (NULL == pLevel) {
+    printf ("--trigger %s should be name:level[:falling]\n", arg);
+    return 0;
+  }
+  *pLevel++ = '\0';
+  pEdge = strchr (pLevel, ':');
+  pOpt->policy.TriggerEdge = DLL_TRACE_RISING;
+  if (NULL != pEdge) {
+    *pEdge++ = '\0';
+    if (0 == strcmp (pEdge, "falling")) {
+      pOpt->policy.TriggerEdge = DLL_TRACE_FALLING;
+    } else if (0 != strcmp (pEdge, "rising")) {
+      printf ("--trigger edge %s should be rising or falling\n", pEdge);
+      return 0;
+    }
+  }
+  pOpt->policy.TriggerName = arg;
+  pOpt->policy.TriggerLevel = atof (pLevel);
+  return 1;
+}
+
+static int parse_options (int argc, char **argv, FanoutOptions *pOpt)
+{
+  memset (pOpt, 0, sizeof (*pOpt));
+  pOpt->branch = 1.0;
+  pOpt->policy.PostTriggerSteps = 100;
+  if (argc < 3) {
+    usage ();
+    return 0;
+  }
+  pOpt->library = argv[1];
+  pOpt->cases = argv[2];
+  for (int i = 3; i < argc; i++) {
+    const char *arg = argv[i];
+    if (i + 1 >= argc) {
+      printf ("%s needs a value\n", arg);
+      return 0;
+    }
+    if (0 == strcmp (arg, "--branch")) {
+      pOpt->branch = atof (argv[++i]);
+    } else if (0 == strcmp (arg, "--end")) {
+      pOpt->end = atof (argv[++i]);
+      pOpt->bEnd = 1;
+    } else if (0 == strcmp (arg, "--workers")) {
+      pOpt->workers = atoi (argv[++i]);
+    } else if (0 == strcmp (arg, "--trace-dir")) {
+      pOpt->trace_dir = argv[++i];
+    } else if (0 == strcmp (arg, "--param") && pOpt->NumParams < MAX_FANOUT_ASSIGNMENTS) {
+      pOpt->pParams[pOpt->NumParams++] = argv[++i];
+    } else if (0 == strcmp (arg, "--input") && pOpt->NumInputs < MAX_FANOUT_ASSIGNMENTS) {
+      pOpt->pInputs[pOpt->NumInputs++] = argv[++i];
+    } else if (0 == strcmp (arg, "--channel")) {
+      if (!parse_channel (argv[++i], pOpt)) {
+        return 0;
+      }
+      pOpt->bPolicy = 1;
+    } else if (0 == strcmp (arg, "--trigger")) {
+      if (!parse_trigger (argv[++i], pOpt)) {
+        return 0;
+      }
+      pOpt->bPolicy = 1;
+    } else if (0 == strcmp (arg, "--pre")) {
+      pOpt->policy.PreTriggerSteps = atoi (argv[++i]);
+    } else if (0 == strcmp (arg, "--post")) {
+      pOpt->policy.PostTriggerSteps = atoi (argv[++i]);
+    } else {
+      printf ("unknown option %s\n", arg);
+      usage ();
+      return 0;
+    }
+  }
+  if (!pOpt->bEnd) {
+    pOpt->end = pOpt->branch + 1.0;
+  }
+  if (pOpt->end <= pOpt->branch) {
+    printf ("--end %g must be after --branch %g\n", pOpt->end, pOpt->branch);
+    return 0;
+  }
+  if (pOpt->bPolicy && NULL == pOpt->trace_dir) {
+    printf ("--channel and --trigger need --trace-dir\n");
+    return 0;
+  }
+  pOpt->policy.NumChannels = pOpt->NumChannels;
+  pOpt->policy.pChannels = pOpt->channels;
+  return 1;
+}
+
+static int find_case (FanoutCases *pSet, const char *name)
+{
+  for (int i = 0; i < pSet->NumCases; i++) {
+    if (0 == strcmp (pSet->pCases[i].Name, name)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// reads the cases file, then points each case at its run of disturbances, grouped by case
+static int read_cases (const char *file_name, FanoutCases *pSet)
+{
+  FILE *fp = fopen (file_name, "r");
+  char line[MAX_LINE];
+  int nLine = 0, maxCases = 0, maxDist = 0;
+  DLLDisturbance *pSorted;
+  int next = 0;
+
+  memset (pSet, 0, sizeof (*pSet));
+  if (NULL == fp) {
+    printf ("could not open cases file %s\n", file_name);
+    return 0;
+  }
+  while (NULL != fgets (line, sizeof (line), fp)) {
+    char *pHash = strchr (line, '#');
+    char *pName, *pTime, *pPort, *pValue;
+    int iCase;
+
+    nLine++;
+    if (NULL != pHash) {
+      *pHash = '\0';
+    }
+    pName = strtok (line, " \t\r\n");
+    if (NULL == pName) {
+      continue;
+    }
+    pTime = strtok (NULL, " \t\r\n");
+    pPort = strtok (NULL, " \t\r\n");
+    pValue = strtok (NULL, " \t\r\n");
+    if (NULL != pTime && (NULL == pPort || NULL == pValue)) {
+      printf ("%s line %d should be: case-name time name value\n", file_name, nLine);
+      fclose (fp);
+      return 0;
+    }
+    iCase = find_case (pSet, pName);
+    if (iCase < 0) {
+      if (pSet->NumCases >= maxCases) {
+        maxCases = 2 * maxCases + 8;
+        pSet->pCases = (DLLContingency *) realloc (pSet->pCases, maxCases * sizeof (DLLContingency));
+      }
+      iCase = pSet->NumCases++;
+      memset (&pSet->pCases[iCase], 0, sizeof (DLLContingency));
+      pSet->pCases[iCase].Name = strdup (pName);
+    }
+    if (NULL != pTime) {
+      if (pSet->NumDisturbances >= maxDist) {
+        maxDist = 2 * maxDist + 16;
+        pSet->pDisturbances = (DLLDisturbance *) realloc (pSet->pDisturbances, maxDist * sizeof (DLLDisturbance));
+        pSet->pCaseOf = (int *) realloc (pSet->pCaseOf, maxDist * sizeof (int));
+      }
+      pSet->pDisturbances[pSet->NumDisturbances].Time = atof (pTime);
+      pSet->pDisturbances[pSet->NumDisturbances].Name = strdup (pPort);
+      pSet->pDisturbances[pSet->NumDisturbances].Value = atof (pValue);
+      pSet->pCaseOf[pSet->NumDisturbances] = iCase;
+      pSet->NumDisturbances++;
+      pSet->pCases[iCase].NumDisturbances++;
+    }
+  }
+  fclose (fp);
+  if (0 == pSet->NumCases) {
+    printf ("%s has no cases\n", file_name);
+    return 0;
+  }
+
+  pSorted = (DLLDisturbance *) malloc ((pSet->NumDisturbances + 1) * sizeof (DLLDisturbance));
+  for (int c = 0; c < pSet->NumCases; c++) {
+    pSet->pCases[c].pDisturbances = pSorted + next;
+    for (int i = 0; i < pSet->NumDisturbances; i++) {
+      if (pSet->pCaseOf[i] == c) {
+        pSorted[next++] = pSet->pDisturbances[i];
+      }
+    }
+  }
+  free (pSet->pDisturbances);
+  pSet->pDisturbances = pSorted;
+  return 1;
+}
+
+static void free_cases (FanoutCases *pSet)
+{
+  for (int i = 0; i < pSet->NumDisturbances; i++) {
+    free ((char *) pSet->pDisturbances[i].Name);
+  }
+  for (int i = 0; i < pSet->NumCases; i++) {
+    free ((char *) pSet->pCases[i].Name);
+    free ((char *) pSet->pCases[i].TraceFile);
+  }
+  free (pSet->pDisturbances);
+  free (pSet->pCases);
+  free (pSet->pCaseOf);
+}
+
+static const char *exit_text (const DLLContingencyResult *pRes)
+{
+  switch (pRes->ExitCode) {
+    case DLL_FANOUT_OK: return "ok";
+    case DLL_FANOUT_MODEL_ERROR: return "model error";
+    case DLL_FANOUT_BAD_CASE: return "bad case";
+    case DLL_FANOUT_TRACE_ERROR: return "trace error";
+    default: return pRes->Signal > 0 ? "killed" : "not run";
+  }
+}
+
+int main (int argc, char **argv)
+{
+  FanoutOptions opt;
+  FanoutCases cases;
+  Wrapped_IEEE_Cigre_DLL *pWrap;
+  DLLContingencyResult *pResults;
+  uint64_t t0;
+  int nFailed;
+
+  if (!parse_options (argc, argv, &opt) || !read_cases (opt.cases, &cases)) {
+    return 1;
+  }
+  pWrap = CreateFirstDLLModel ((char *) opt.library);
+  if (NULL == pWrap) {
+    free_cases (&cases);
+    return 1;
+  }
+  for (int i = 0; i < opt.NumParams; i++) {
+    if (!assign_dll_value (pWrap, opt.pParams[i], 0)) {
+      FreeFirstDLLModel (pWrap);
+      free_cases (&cases);
+      return 1;
+    }
+  }
+  for (int i = 0; i < opt.NumInputs; i++) {
+    if (!assign_dll_value (pWrap, opt.pInputs[i], 1)) {
+      FreeFirstDLLModel (pWrap);
+      free_cases (&cases);
+      return 1;
+    }
+  }
+  if (NULL != opt.trace_dir) {
+    for (int i = 0; i < cases.NumCases; i++) {
+      size_t len = strlen (opt.trace_dir) + strlen (cases.pCases[i].Name) + 6;
+      char *pFile = (char *) malloc (len);
+      snprintf (pFile, len, "%s/%s.dtr", opt.trace_dir, cases.pCases[i].Name);
+      cases.pCases[i].TraceFile = pFile;
+      cases.pCases[i].pPolicy = opt.bPolicy ? &opt.policy : NULL;
+    }
+  }
+  pResults = (DLLContingencyResult *) malloc (cases.NumCases * sizeof (DLLContingencyResult));
+
+  if (NULL != pWrap->Model_FirstCall) {
+    pWrap->Model_FirstCall (pWrap->pModel);
+  }
+  pWrap->Model_CheckParameters (pWrap->pModel);
+  check_messages ("Model_CheckParameters", pWrap->pModel);
+  pWrap->pModel->Time = 0.0;
+  pWrap->Model_Initialize (pWrap->pModel);
+  check_messages ("Model_Initialize", pWrap->pModel);
+
+  printf ("%s: %d cases branching at %g s, ending at %g s, %d workers\n", pWrap->pInfo->ModelName,
+          cases.NumCases, opt.branch, opt.end, opt.workers > 0 ? opt.workers : GetDLLCoreCount ());
+  t0 = DLLMonotonicNanoseconds ();
+  nFailed = RunDLLContingencies (pWrap, opt.branch, opt.end, cases.pCases, cases.NumCases, opt.workers,
+                                 NULL, NULL, pResults);
+  if (nFailed >= 0) {
+    printf ("  %-24s %8s %-12s %10s %12s\n", "case", "pid", "exit", "seconds", "max RSS MB");
+    for (int i = 0; i < cases.NumCases; i++) {
+      printf ("  %-24s %8d %-12s %10.3f %12.1f\n", cases.pCases[i].Name, pResults[i].Pid, exit_text (&pResults[i]),
+              pResults[i].Seconds, (double) pResults[i].MaxRSSKilobytes / 1024.0);
+    }
+    printf ("%d of %d cases ran to the end in %.3f s\n", cases.NumCases - nFailed, cases.NumCases,
+            1.0e-9 * (double) (DLLMonotonicNanoseconds () - t0));
+  }
+
+  free (pResults);
+  free_cases (&cases);
+  FreeFirstDLLModel (pWrap);
+  return 0 == nFailed ? 0 : 1;
+}
@@ -0,0 +1,351 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Parameter sweep and Monte Carlo driver for any IEEE/Cigre model library. The swept parameters are
+sampled on a grid, a Latin hypercube or at random, within the model's MinValue and MaxValue unless
+narrower bounds are given. RunDLLSweep runs the variants on all cores, each thread with its own
+instance of the one loaded class, and keeps only the requested scalar metrics of each variant.
+The inputs are held at their --input values, with optional steps at given times to excite the
+response that the metrics measure.
+
+Usage: dllsweep library [options]
+  --sweep name[:low:high[:levels[:log]]], repeated; levels is for grid sampling (5)
+  --sampling grid|lhs|random (grid), --samples n (100) for lhs and random, --seed n (1)
+  --metric type:output:reference[:start[:band]], repeated; type is overshoot, settling_time,
+           rms_error, peak or final; start in seconds (0), band as a fraction of the step (0.02)
+  --param name=value, repeated, sets a fixed parameter in every variant
+  --input name=value, repeated, holds an input at value (others stay at 0)
+  --step name=value@seconds, repeated, steps an input at a time
+  --end seconds (1.0), --threads n (0 for the core count), --csv file (sweep.csv)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLSweep.h"
+#include "IEEE_Cigre_DLLThreads.h"
+
+#define MAX_SWEEP_ARGS 64
+
+static const char *sampling_names[] = {"grid", "lhs", "random"};
+
+typedef struct _InputStep_ {  // an input that changes to Value at Time, in every variant
+  DLLPortHandle h;
+  double Value;
+  double Time;
+} InputStep;
+
+typedef struct _StepSchedule_ {
+  int NumSteps;
+  InputStep pSteps[MAX_SWEEP_ARGS];
+} StepSchedule;
+
+typedef struct _SweepOptions_ {
+  const char *library;
+  const char *csv;
+  double end;
+  int threads;
+  int sampling;
+  int samples;
+  uint64_t seed;
+  int NumSweeps;
+  char *pSweeps[MAX_SWEEP_ARGS];
+  int NumMetrics;
+  char *pMetrics[MAX_SWEEP_ARGS];
+  int NumParams;
+  char *pParams[MAX_SWEEP_ARGS];
+  int NumInputs;
+  char *pInputs[MAX_SWEEP_ARGS];
+  int NumSteps;
+  char *pSteps[MAX_SWEEP_ARGS];
+} SweepOptions;
+
+static void usage (void)
+{
+  printf ("usage: dllsweep library --sweep name[:low:high[:levels[:log]]]... --metric type:output:reference[:start[:band]]...\n");
+  printf ("                [--sampling grid|lhs|random] [--samples n] [--seed n] [--param name=value]...\n");
+  printf ("                [--input name=value]... [--step name=value@seconds]... [--end seconds] [--threads n] [--csv file]\n");
+}
+
+static int add_arg (char **pArgs, int *pNum, char *arg)
+{
+  if (*pNum >= MAX_SWEEP_ARGS) {
+    printf ("at most %d of each repeated option\n", MAX_SWEEP_ARGS);
+    return 0;
+  }
+  pArgs[(*pNum)++] = arg;
+  return 1;
+}
+
+static int parse_options (int argc, char **argv, SweepOptions *pOpt)
+{
+  int ok = 1;
+
+  memset (pOpt, 0, sizeof (*pOpt));
+  pOpt->csv = "sweep.csv";
+  pOpt->end = 1.0;
+  pOpt->samples = 100;
+  pOpt->seed = 1;
+  if (argc < 2) {
+    usage ();
+    return 0;
+  }
+  pOpt->library = argv[1];
+  for (int i = 2; ok && i < argc; i++) {
+    const char *arg = argv[i];
+    if (i + 1 >= argc) {
+      printf ("%s needs a value\n", arg);
+      return 0;
+    }
+    if (0 == strcmp (arg, "--sweep")) {
+      ok = add_arg (pOpt->pSweeps, &pOpt->NumSweeps, argv[++i]);
+    } else if (0 == strcmp (arg, "--metric")) {
+      ok = add_arg (pOpt->pMetrics, &pOpt->NumMetrics, argv[++i]);
+    } else if (0 == strcmp (arg, "--param")) {
+      ok = add_arg (pOpt->pParams, &pOpt->NumParams, argv[++i]);
+    } else if (0 == strcmp (arg, "--input")) {
+      ok = add_arg (pOpt->pInputs, &pOpt->NumInputs, argv[++i]);
+    } else if (0 == strcmp (arg, "--step")) {
+      ok = add_arg (pOpt->pSteps, &pOpt->NumSteps, argv[++i]);
+    } else if (0 == strcmp (arg, "--sampling")) {
+      const char *val = argv[++i];
+      pOpt->sampling = -1;
+      for (int s = 0; s < 3; s++) {
+        if (0 == strcmp (val, sampling_names[s])) {
+          pOpt->sampling = s;
+        }
+      }
+      if (pOpt->sampling < 0) {
+        printf ("unknown sampling %s\n", val);
+        return 0;
+      }
+    } else if (0 == strcmp (arg, "--samples")) {
+      pOpt->samples = atoi (argv[++i]);
+    } else if (0 == strcmp (arg, "--seed")) {
+      pOpt->seed = strtoull (argv[++i], NULL, 10);
+    } else if (0 == strcmp (arg, "--end")) {
+      pOpt->end = atof (argv[++i]);
+    } else if (0 == strcmp (arg, "--threads")) {
+      pOpt->threads = atoi (argv[++i]);
+    } else if (0 == strcmp (arg, "--csv")) {
+      pOpt->csv = argv[++i];
+    } else {
+      printf ("unknown option %s\n", arg);
+      usage ();
+      return 0;
+    }
+  }
+  if (ok && (0 == pOpt->NumSweeps || 0 == pOpt->NumMetrics)) {
+    printf ("at least one --sweep and one --metric are needed\n");
+    usage ();
+    return 0;
+  }
+  return ok;
+}
+
+// name[:low:high[:levels[:log]]]
+static int parse_sweep (char *arg, DLLSweepParameter *pPar)
+{
+  char *pField = strtok (arg, ":");
+
+  memset (pPar, 0, sizeof (*pPar));
+  pPar->Name = pField;
+  pPar->NumLevels = 5;
+  if (NULL != (pField = strtok (NULL, ":"))) {
+    pPar->Low = atof (pField);
+    pField = strtok (NULL, ":");
+    if (NULL == pField) {
+      printf ("--sweep %s needs both low and high\n", pPar->Name);
+      return 0;
+    }
+    pPar->High = atof (pField);
+    if (NULL != (pField = strtok (NULL, ":"))) {
+      pPar->NumLevels = atoi (pField);
+      if (NULL != (pField = strtok (NULL, ":"))) {
+        pPar->bLog = 0 == strcmp (pField, "log");
+      }
+    }
+  }
+  return 1;
+}
+
+// type:output:reference[:start[:band]]
+static int parse_metric (char *arg, DLLSweepMetric *pMetric)
+{
+  char *pType = strtok (arg, ":");
+  char *pOutput = strtok (NULL, ":");
+  char *pRef = strtok (NULL, ":");
+  char *pField;
+
+  memset (pMetric, 0, sizeof (*pMetric));
+  pMetric->Type = -1;
+  pMetric->Band = 0.02;
+  for (int t = 0; NULL != pType && t < DLL_NUM_METRIC_TYPES; t++) {
+    if (0 == strcmp (pType, DLLSweepMetricName (t))) {
+      pMetric->Type = t;
+    }
+  }
+  if (pMetric->Type < 0 || NULL == pOutput || NULL == pRef) {
+    printf ("--metric should be type:output:reference[:start[:band]] with a type of overshoot, settling_time, rms_error, peak or final\n");
+    return 0;
+  }
+  pMetric->Output = pOutput;
+  pMetric->Reference = atof (pRef);
+  if (NULL != (pField = strtok (NULL, ":"))) {
+    pMetric->StartTime = atof (pField);
+    if (NULL != (pField = strtok (NULL, ":"))) {
+      pMetric->Band = atof (pField);
+    }
+  }
+  return 1;
+}
+
+// name=value@seconds
+static int parse_step (Wrapped_IEEE_Cigre_DLL *pWrap, char *arg, InputStep *pStep)
+{
+  char *pEq = strchr (arg, '=');
+  char *pAt = strchr (arg, '@');
+
+  if (NULL == pEq || NULL == pAt || pAt < pEq) {
+    printf ("--step %s should be name=value@seconds\n", arg);
+    return 0;
+  }
+  *pEq = '\0';
+  pStep->h = GetInputHandle (pWrap, arg);
+  if (pStep->h.index < 0 || IEEE_Cigre_DLLInterface_DataType_c_string_T == pStep->h.dtype) {
+    printf ("%s has no numeric input named %s\n", pWrap->pInfo->ModelName, arg);
+    return 0;
+  }
+  pStep->Value = atof (pEq + 1);
+  pStep->Time = atof (pAt + 1);
+  return 1;
+}
+
+// the input steps are the same in every variant, so the schedule needs no per-variant state
+static void apply_steps (Wrapped_IEEE_Cigre_DLL *pWrap, double t, int iVariant, void *pUser)
+{
+  const StepSchedule *pSchedule = (const StepSchedule *) pUser;
+  double half = 0.5 * pWrap->pInfo->FixedStepBaseSampleTime;
+
+  (void) iVariant;
+  for (int i = 0; i < pSchedule->NumSteps; i++) {
+    const InputStep *pStep = &pSchedule->pSteps[i];
+    if (t >= pStep->Time - half) {
+      write_dll_real64 ((char *) DLL_PORT_PTR (pWrap->pModel->ExternalInputs, pStep->h), pStep->h.dtype, pStep->Value);
+    }
+  }
+}
+
+// the variant with the smallest finite value of each metric
+static void print_summary (const DLLSweepResults *pResults)
+{
+  int stride = pResults->NumParameters + pResults->NumMetrics;
+  int nOk = 0;
+
+  for (int i = 0; i < pResults->NumVariants; i++) {
+    nOk += DLL_SWEEP_OK == pResults->pStatus[i];
+  }
+  printf ("%d variants in %.3f s (%.1f variants/s), %d ran to the end\n", pResults->NumVariants, pResults->Seconds,
+          pResults->Seconds > 0.0 ? pResults->NumVariants / pResults->Seconds : 0.0, nOk);
+  for (int m = 0; m < pResults->NumMetrics; m++) {
+    int best = -1;
+    for (int i = 0; i < pResults->NumVariants; i++) {
+      double x = pResults->pValues[(size_t) i * stride + pResults->NumParameters + m];
+      if (isfinite (x) && (best < 0 || x < pResults->pValues[(size_t) best * stride + pResults->NumParameters + m])) {
+        best = i;
+      }
+    }
+    if (best < 0) {
+      printf ("  %-28s no finite values\n", pResults->pNames[pResults->NumParameters + m]);
+      continue;
+    }
+    printf ("  %-28s min %12.6g at variant %d:", pResults->pNames[pResults->NumParameters + m],
+            pResults->pValues[(size_t) best * stride + pResults->NumParameters + m], best);
+    for (int j = 0; j < pResults->NumParameters; j++) {
+      printf (" %s=%g", pResults->pNames[j], pResults->pValues[(size_t) best * stride + j]);
+    }
+    printf ("\n");
+  }
+}
+
+int main (int argc, char **argv)
+{
+  SweepOptions opt;
+  DLLModelClass *pClass;
+  Wrapped_IEEE_Cigre_DLL *pTemplate;
+  DLLSweepParameter pParameters[MAX_SWEEP_ARGS];
+  DLLSweepMetric pMetrics[MAX_SWEEP_ARGS];
+  StepSchedule schedule;
+  DLLSweepSpec spec;
+  DLLSweepResults *pResults;
+  int ok = 1;
+
+  if (!parse_options (argc, argv, &opt)) {
+    return 1;
+  }
+  for (int i = 0; ok && i < opt.NumSweeps; i++) {
+    ok = parse_sweep (opt.pSweeps[i], &pParameters[i]);
+  }
+  for (int i = 0; ok && i < opt.NumMetrics; i++) {
+    ok = parse_metric (opt.pMetrics[i], &pMetrics[i]);
+  }
+  if (!ok) {
+    return 1;
+  }
+  pClass = LoadDLLModelClass ((char *) opt.library);
+  if (NULL == pClass) {
+    return 1;
+  }
+  // the template is checked once, so bad fixed parameters show up before the sweep, but never stepped
+  pTemplate = CreateDLLModelInstance (pClass);
+  memset (&schedule, 0, sizeof (schedule));
+  for (int i = 0; ok && i < opt.NumParams; i++) {
+    ok = assign_dll_value (pTemplate, opt.pParams[i], 0);
+  }
+  for (int i = 0; ok && i < opt.NumInputs; i++) {
+    ok = assign_dll_value (pTemplate, opt.pInputs[i], 1);
+  }
+  for (int i = 0; ok && i < opt.NumSteps; i++) {
+    ok = parse_step (pTemplate, opt.pSteps[i], &schedule.pSteps[schedule.NumSteps++]);
+  }
+
+  pResults = NULL;
+  if (NULL != pTemplate->Model_FirstCall) {
+    pTemplate->Model_FirstCall (pTemplate->pModel);
+  }
+  if (IEEE_Cigre_DLLInterface_Return_Error == pTemplate->Model_CheckParameters (pTemplate->pModel)) {
+    ok = 0;  // still freed below, as the model may have allocated before failing
+  }
+  check_messages ("Model_CheckParameters", pTemplate->pModel);
+  if (ok) {
+    memset (&spec, 0, sizeof (spec));
+    spec.Sampling = opt.sampling;
+    spec.NumSamples = opt.samples;
+    spec.Seed = opt.seed;
+    spec.NumParameters = opt.NumSweeps;
+    spec.pParameters = pParameters;
+    spec.NumMetrics = opt.NumMetrics;
+    spec.pMetrics = pMetrics;
+    spec.EndTime = opt.end;
+    spec.pTemplate = pTemplate;
+    spec.StepFcn = schedule.NumSteps > 0 ? apply_steps : NULL;
+    spec.pUser = &schedule;
+    printf ("%s: %s sampling of %d parameters, %g s per variant, %d threads\n", pClass->pInfo->ModelName,
+            sampling_names[opt.sampling], opt.NumSweeps, opt.end, opt.threads > 0 ? opt.threads : GetDLLCoreCount ());
+    pResults = RunDLLSweep (pClass, &spec, opt.threads);
+  }
+  if (NULL != pResults) {
+    print_summary (pResults);
+    if (WriteDLLSweepCSV (pResults, opt.csv)) {
+      printf ("wrote %s\n", opt.csv);
+    }
+    FreeDLLSweepResults (pResults);
+  }
+
+  FreeDLLModelInstance (pTemplate);
+  FreeDLLModelClass (pClass);
+  return NULL != pResults ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Contingency fan-out by fork. The parent initializes one instance and steps it to the branch time,
+so every case starts from the same state. fork then copies the whole process, including state the
+wrapper cannot see, like the model's static ErrorMessage, the PPC FMU component or the HWPV
+coefficients on the model's heap. The pages stay shared copy-on-write until a child writes them,
+so K children cost little more memory than one until their simulations diverge.
+
+Each child resolves its disturbance names, opens its trace, steps to the end time, flushes its
+output and leaves through _exit with a DLL_FANOUT_ code, so no atexit handler or model destructor
+runs twice on state it shares with the parent.
+The parent keeps at most MaxWorkers children alive, starting the next case as each one is reaped.
+Windows has no fork; there, RunDLLContingencies reports that and returns -1.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLFanout.h"
+#include "IEEE_Cigre_DLLThreads.h"
+
+#if defined(_WIN32)
+
+int RunDLLContingencies (Wrapped_IEEE_Cigre_DLL *pWrap, double tBranch, double tEnd,
+                         const DLLContingency *pCases, int NumCases, int MaxWorkers,
+                         DLL_FANOUT_STEP_FCN StepFcn, void *pUser, DLLContingencyResult *pResults)
+{
+  printf ("RunDLLContingencies needs fork, which Windows does not have\n");
+  return -1;
+}
+
+#else
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+typedef struct _ResolvedDisturbance_ {
+  long Step;       // first step at which the value is written
+  char *pTarget;   // into the instance's input or parameter buffer
+  enum IEEE_Cigre_DLLInterface_DataType dtype;
+  double Value;
+} ResolvedDisturbance;
+
+// NULL if a name is not an input or parameter of the model, or out of memory
+static ResolvedDisturbance *resolve_disturbances (Wrapped_IEEE_Cigre_DLL *pWrap, const DLLContingency *pCase, double dt)
+{
+  ResolvedDisturbance *pRes = (ResolvedDisturbance *) calloc (pCase->NumDisturbances + 1, sizeof (ResolvedDisturbance));
+
+  if (NULL == pRes) {
+    printf ("case %s: out of memory for %d disturbances\n", pCase->Name, pCase->NumDisturbances);
+    return NULL;
+  }
+  for (int i = 0; i < pCase->NumDisturbances; i++) {
+    const DLLDisturbance *pDist = &pCase->pDisturbances[i];
+    DLLPortHandle h = GetInputHandle (pWrap, pDist->Name);
+    char *pBase = (char *) pWrap->pModel->ExternalInputs;
+
+    if (h.index < 0) {
+      h = GetParameterHandle (pWrap, pDist->Name);
+      pBase = (char *) pWrap->pModel->Parameters;
+    }
+    if (h.index < 0 || IEEE_Cigre_DLLInterface_DataType_c_string_T == h.dtype) {
+      printf ("case %s: %s is not a numeric input or parameter of %s\n", pCase->Name, pDist->Name,
+              pWrap->pInfo->ModelName);
+      free (pRes);
+      return NULL;
+    }
+    pRes[i].Step = (long) (pDist->Time / dt + 0.5);
+    pRes[i].pTarget = pBase + h.offset;
+    pRes[i].dtype = h.dtype;
+    pRes[i].Value = pDist->Value;
+  }
+  // a stable insertion sort by step, so a later entry for the same step and port wins
+  for (int i = 1; i < pCase->NumDisturbances; i++) {
+    ResolvedDisturbance r = pRes[i];
+    int j = i;
+    for (; j > 0 && pRes[j-1].Step > r.Step; j--) {
+      pRes[j] = pRes[j-1];
+    }
+    pRes[j] = r;
+  }
+  return pRes;
+}
+
+// the body of one child process; returns its exit code
+static int run_case (Wrapped_IEEE_Cigre_DLL *pWrap, const DLLContingency *pCase, long kBranch, long kEnd,
+                     DLL_FANOUT_STEP_FCN StepFcn, void *pUser)
+{
+  double dt = pWrap->pInfo->FixedStepBaseSampleTime;
+  ResolvedDisturbance *pRes = resolve_disturbances (pWrap, pCase, dt);
+  DLLTraceWriter *pTrace = NULL;
+  DLLTraceSet *pSet = NULL;
+  int nActive = 0;   // disturbances already reached, written after StepFcn at every step
+  int rc = DLL_FANOUT_OK;
+
+  if (NULL == pRes) {
+    return DLL_FANOUT_BAD_CASE;
+  }
+  if (NULL != pCase->TraceFile) {
+    if (NULL != pCase->pPolicy) {
+      pSet = OpenDLLTraceSet (pCase->TraceFile, pWrap, pCase->pPolicy);
+    } else {
+      pTrace = OpenDLLTrace (pCase->TraceFile, pWrap, 0);
+    }
+    if (NULL == pSet && NULL == pTrace) {
+      free (pRes);
+      return DLL_FANOUT_TRACE_ERROR;
+    }
+  }
+  for (long k = kBranch; k < kEnd; k++) {
+    double t = (double) k * dt;
+    pWrap->pModel->Time = t;
+    if (NULL != StepFcn) {
+      StepFcn (pWrap, t, pUser);
+    }
+    while (nActive < pCase->NumDisturbances && pRes[nActive].Step <= k) {
+      nActive++;
+    }
+    for (int i = 0; i < nActive; i++) {
+      write_dll_real64 (pRes[i].pTarget, pRes[i].dtype, pRes[i].Value);
+    }
+    if (IEEE_Cigre_DLLInterface_Return_Error == pWrap->Model_Outputs (pWrap->pModel)) {
+      check_messages (pCase->Name, pWrap->pModel);
+      rc = DLL_FANOUT_MODEL_ERROR;
+      break;
+    }
+    if (NULL != pSet) {
+      WriteDLLTraceSet (pSet, t);
+    } else if (NULL != pTrace) {
+      WriteDLLTraceRow (pTrace, t);
+    }
+  }
+  if (NULL != pSet) {
+    CloseDLLTraceSet (pSet);
+  } else if (NULL != pTrace) {
+    CloseDLLTrace (pTrace);
+  }
+  free (pRes);
+  return rc;
+}
+
+int RunDLLContingencies (Wrapped_IEEE_Cigre_DLL *pWrap, double tBranch, double tEnd,
+                         const DLLContingency *pCases, int NumCases, int MaxWorkers,
+                         DLL_FANOUT_STEP_FCN StepFcn, void *pUser, DLLContingencyResult *pResults)
+{
+  double dt = pWrap->pInfo->FixedStepBaseSampleTime;
+  long k = (long) (pWrap->pModel->Time / dt + 0.5);
+  long kBranch = (long) (tBranch / dt + 0.5);
+  long kEnd = (long) (tEnd / dt + 0.5);
+  DLLContingencyResult *pRes = pResults;
+  uint64_t *pStart;
+  int nLaunched = 0, nForked = 0, nRunning = 0, nFailed = 0;
+
+  if (NULL == pRes) {
+    pRes = (DLLContingencyResult *) malloc (NumCases * sizeof (DLLContingencyResult));
+  }
+  pStart = (uint64_t *) malloc (NumCases * sizeof (uint64_t));
+  if (NULL == pRes || NULL == pStart) {
+    printf ("RunDLLContingencies: out of memory for %d cases\n", NumCases);
+    free (pStart);
+    if (pRes != pResults) {
+      free (pRes);
+    }
+    return -1;
+  }
+  memset (pRes, 0, NumCases * sizeof (DLLContingencyResult));
+  if (MaxWorkers < 1) {
+    MaxWorkers = GetDLLCoreCount ();
+  }
+
+  // the common part of every case
+  for (; k < kBranch; k++) {
+    double t = (double) k * dt;
+    pWrap->pModel->Time = t;
+    if (NULL != StepFcn) {
+      StepFcn (pWrap, t, pUser);
+    }
+    if (IEEE_Cigre_DLLInterface_Return_Error == pWrap->Model_Outputs (pWrap->pModel)) {
+      check_messages ("RunDLLContingencies", pWrap->pModel);
+      printf ("RunDLLContingencies: %s failed at t=%g, before the branch time; no cases run\n",
+              pWrap->pInfo->ModelName, t);
+      free (pStart);
+      if (pRes != pResults) {
+        free (pRes);
+      }
+      return -1;
+    }
+  }
+  check_messages ("RunDLLContingencies", pWrap->pModel);
+  fflush (NULL);  // or the children would each flush a copy of the parent's buffered output
+
+  while (nLaunched < NumCases || nRunning > 0) {
+    if (nLaunched < NumCases && nRunning < MaxWorkers) {
+      pid_t pid;
+      pStart[nLaunched] = DLLMonotonicNanoseconds ();
+      pid = fork ();
+      if (0 == pid) {
+        int rc = run_case (pWrap, &pCases[nLaunched], kBranch, kEnd, StepFcn, pUser);
+        fflush (stdout);
+        _exit (rc);
+      }
+      if (pid < 0) {
+        printf ("could not fork case %s\n", pCases[nLaunched].Name);
+        pRes[nLaunched].Pid = -1;
+        pRes[nLaunched].ExitCode = -1;
+        nFailed++;
+      } else {
+        pRes[nLaunched].Pid = (int) pid;
+        nForked++;
+        nRunning++;
+      }
+      nLaunched++;
+    } else {
+      struct rusage usage;
+      int status;
+      pid_t pid;
+      do {
+        pid = wait4 (-1, &status, 0, &usage);
+      } while (pid < 0 && EINTR == errno);
+      if (pid < 0) {
+        break;
+      }
+      for (int i = 0; i < nLaunched; i++) {
+        if (pRes[i].Pid == (int) pid) {
+          pRes[i].Seconds = 1.0e-9 * (double) (DLLMonotonicNanoseconds () - pStart[i]);
+          pRes[i].MaxRSSKilobytes = usage.ru_maxrss;
+          if (WIFEXITED (status)) {
+            pRes[i].ExitCode = WEXITSTATUS (status);
+          } else {
+            pRes[i].ExitCode = -1;
+            pRes[i].Signal = WIFSIGNALED (status) ? WTERMSIG (status) : 0;
+          }
+          if (DLL_FANOUT_OK != pRes[i].ExitCode) {
+            nFailed++;
+          }
+          break;
+        }
+      }
+      nRunning--;
+    }
+  }
+
+  free (pStart);
+  if (pRes != pResults) {
+    free (pRes);
+  }
+  return (NumCases > 0 && 0 == nForked) ? -1 : nFailed;
+}
+
+#endif
@@ -0,0 +1,227 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Models that export Model_SetMessageBuffer write their message text into a buffer the wrapper keeps
+for each instance, and return IEEE_Cigre_DLLInterface_Return_Message or
+IEEE_Cigre_DLLInterface_Return_Error when they write one, so the thread that stepped an instance
+can test the return value and leave the text alone on the usual step with nothing to say. When
+there is a message, PostDLLModelMessages copies it into a ring under a ticket lock, stamped with
+the model time and the monotonic clock, and the simulation or reporting thread pops and prints it
+later. Messages are rare, so the lock is not contended in practice.
+
+A model that repeats the same text every step would flood the queue. Each (instance, text) pair
+has a slot in a small hash table holding the model time it was last queued; copies that arrive
+within MinInterval model seconds are counted instead of queued, and the count goes out with the
+next copy that is queued. Model time that goes backward, as after a snapshot restore, starts over.
+A new pair whose probe window is full takes the slot of the pair posted least recently, so a long
+run with many distinct texts, e.g., with the time in them, keeps its rate limit; the evicted pair
+starts over if it comes back.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLMessages.h"
+
+#define DLL_MESSAGE_RATE_PROBES 16  // slots searched for a pair before evicting one
+
+static void lock_queue (DLLMessageQueue *pQueue)
+{
+  long ticket = DLL_ATOMIC_ADD (&pQueue->Ticket, 1);
+  long spins = 0;
+  while (DLL_ATOMIC_LOAD (&pQueue->Serving) != ticket) {
+    DLLSpinPause (++spins);
+  }
+}
+
+static void unlock_queue (DLLMessageQueue *pQueue)
+{
+  DLL_ATOMIC_STORE (&pQueue->Serving, pQueue->Serving + 1);
+}
+
+static uint32_t hash_text (const char *text)
+{
+  uint32_t h = 2166136261u;  // FNV-1a
+  while ('\0' != *text) {
+    h = (h ^ (uint8_t) *text++) * 16777619u;
+  }
+  return h;
+}
+
+static void copy_text (char *pDst, size_t n, const char *pSrc)
+{
+  size_t len = 0;
+  if (NULL != pSrc) {
+    len = strlen (pSrc);
+    if (len > n - 1) {
+      len = n - 1;
+    }
+    memcpy (pDst, pSrc, len);
+  }
+  while (len > 0 && ('\n' == pDst[len-1] || '\r' == pDst[len-1])) {  // models end their text with a newline
+    --len;
+  }
+  pDst[len] = '\0';
+}
+
+// the rate slot for this instance and text. Slots are never emptied, only taken over, so a pair
+// is never found past an empty slot in its window.
+static DLLMessageRate *find_rate (DLLMessageQueue *pQueue, const void *pSource, uint32_t hash)
+{
+  uint32_t mix = hash ^ (uint32_t) ((uintptr_t) pSource >> 4) * 2654435761u;
+  DLLMessageRate *pFree = NULL;
+
+  for (int i = 0; i < DLL_MESSAGE_RATE_PROBES; i++) {
+    DLLMessageRate *pRate = pQueue->pRates + (mix + i) % DLL_MESSAGE_RATE_SLOTS;
+    if (pSource == pRate->pSource && hash == pRate->Hash) {
+      pRate->LastPosted = pQueue->NumPosted;
+      return pRate;
+    }
+    if (NULL == pRate->pSource) {
+      pFree = pRate;
+      break;
+    }
+    if (NULL == pFree || pRate->LastPosted < pFree->LastPosted) {
+      pFree = pRate;
+    }
+  }
+  if (NULL != pFree->pSource) {
+    pQueue->NumEvicted += 1;
+  }
+  pFree->pSource = pSource;
+  pFree->Hash = hash;
+  pFree->LastTime = 0.0;
+  pFree->Suppressed = -1;  // not yet queued
+  pFree->LastPosted = pQueue->NumPosted;
+  return pFree;
+}
+
+DLLMessageQueue * CreateDLLMessageQueue (int Capacity, double MinInterval)
+{
+  if (Capacity < 1) {
+    Capacity = DLL_MESSAGE_QUEUE_CAPACITY;
+  }
+  DLLMessageQueue *pQueue = calloc (1, sizeof *pQueue);
+  if (NULL == pQueue) {
+    return NULL;
+  }
+  pQueue->Capacity = Capacity;
+  pQueue->pMessages = malloc (Capacity * sizeof (DLLMessage));
+  pQueue->pRates = calloc (DLL_MESSAGE_RATE_SLOTS, sizeof (DLLMessageRate));
+  pQueue->MinInterval = MinInterval;
+  if (NULL == pQueue->pMessages || NULL == pQueue->pRates) {
+    FreeDLLMessageQueue (pQueue);
+    return NULL;
+  }
+  return pQueue;
+}
+
+void FreeDLLMessageQueue (DLLMessageQueue *pQueue)
+{
+  if (NULL == pQueue) {
+    return;
+  }
+  free (pQueue->pMessages);
+  free (pQueue->pRates);
+  free (pQueue);
+}
+
+int PostDLLMessage (DLLMessageQueue *pQueue, const void *pSource, const char *source, const char *loc,
+                    double t, int32_T Severity, const char *text)
+{
+  uint64_t ns = DLLMonotonicNanoseconds ();
+  uint32_t hash = hash_text (NULL != text ? text : "");
+  int bQueued = 0;
+
+  lock_queue (pQueue);
+  pQueue->NumPosted += 1;
+  long repeats = 0;
+  DLLMessageRate *pRate = NULL;
+  if (pQueue->MinInterval > 0.0) {
+    pRate = find_rate (pQueue, pSource, hash);
+  }
+  if (NULL != pRate && pRate->Suppressed >= 0 && t >= pRate->LastTime && t - pRate->LastTime < pQueue->MinInterval) {
+    pRate->Suppressed += 1;
+    pQueue->NumSuppressed += 1;
+  } else if (pQueue->Head - pQueue->Tail >= pQueue->Capacity) {
+    pQueue->NumDropped += 1;
+  } else {
+    if (NULL != pRate) {
+      repeats = pRate->Suppressed > 0 ? pRate->Suppressed : 0;
+      pRate->Suppressed = 0;
+      pRate->LastTime = t;
+    }
+    DLLMessage *pMessage = pQueue->pMessages + pQueue->Head % pQueue->Capacity;
+    pMessage->Time = t;
+    pMessage->Nanoseconds = ns;
+    pMessage->Severity = Severity;
+    pMessage->Repeats = repeats;
+    pMessage->pSource = pSource;
+    copy_text (pMessage->Source, sizeof (pMessage->Source), source);
+    copy_text (pMessage->Location, sizeof (pMessage->Location), loc);
+    copy_text (pMessage->Text, sizeof (pMessage->Text), text);
+    pQueue->Head += 1;
+    bQueued = 1;
+  }
+  unlock_queue (pQueue);
+  return bQueued;
+}
+
+int32_T PostDLLModelMessages (DLLMessageQueue *pQueue, Wrapped_IEEE_Cigre_DLL *pWrap, const char *loc, int32_T rc)
+{
+  if (IEEE_Cigre_DLLInterface_Return_OK == rc) {
+    return rc;
+  }
+  IEEE_Cigre_DLLInterface_Instance *pModel = pWrap->pModel;
+  const char_T *pText = pModel->LastGeneralMessage;
+  if (IEEE_Cigre_DLLInterface_Return_Error == rc && NULL != pModel->LastErrorMessage) {
+    pText = pModel->LastErrorMessage;
+  }
+  if (NULL != pText && '\0' != pText[0]) {
+    PostDLLMessage (pQueue, pModel, pWrap->pInfo->ModelName, loc, pModel->Time, rc, pText);
+  }
+  return rc;
+}
+
+int PopDLLMessage (DLLMessageQueue *pQueue, DLLMessage *pMessage)
+{
+  int bFound = 0;
+
+  lock_queue (pQueue);
+  if (pQueue->Tail < pQueue->Head) {
+    memcpy (pMessage, pQueue->pMessages + pQueue->Tail % pQueue->Capacity, sizeof (DLLMessage));
+    pQueue->Tail += 1;
+    bFound = 1;
+  }
+  unlock_queue (pQueue);
+  return bFound;
+}
+
+int PrintDLLMessages (DLLMessageQueue *pQueue)
+{
+  DLLMessage msg;
+  int n = 0;
+
+  while (PopDLLMessage (pQueue, &msg)) {
+#ifndef ATP_MINGW
+    printf ("  t=%.6f %s %s %s says %s", msg.Time,
+            (IEEE_Cigre_DLLInterface_Return_Error == msg.Severity) ? "ERROR" : "INFO",
+            msg.Source, msg.Location, msg.Text);
+    if (msg.Repeats > 0) {
+      printf (" (repeated %ld times)", msg.Repeats);
+    }
+    printf ("\n");
+#endif
+    ++n;
+  }
+  return n;
+}
+
+void PrintDLLMessageStats (DLLMessageQueue *pQueue)
+{
+#ifndef ATP_MINGW
+  printf ("Messages: %lld posted, %lld suppressed by rate limit of %g s, %lld dropped with the queue full, %lld rate slots reused\n",
+          pQueue->NumPosted, pQueue->NumSuppressed, pQueue->MinInterval, pQueue->NumDropped, pQueue->NumEvicted);
+#endif
+}
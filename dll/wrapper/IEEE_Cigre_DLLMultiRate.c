@@ -0,0 +1,256 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Models with different FixedStepBaseSampleTime values share one integer tick clock. The tick is the
+GCD of the host step and all sample times, resolved to nanoseconds, so every model period and the
+host step are whole numbers of ticks. Over the hyperperiod (LCM of the model periods) the set of
+models due at each tick repeats, so it is tabulated once, keeping only the ticks at which some
+model is due. Each host step then jumps from one of those ticks to the next and runs the models
+listed for it. Without a table, the next tick is the earliest next multiple of a model period.
+Model time is always tick * TickSeconds, never a running sum.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "IEEE_Cigre_DLLMultiRate.h"
+
+static long long gcd_ticks (long long a, long long b)
+{
+  while (b != 0) {
+    long long t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// returns 0 if the sample time is not positive or not a whole number of nanoseconds
+static long long seconds_to_ns (double dt)
+{
+  double ns = dt * (double) DLL_TICKS_PER_SECOND;
+  long long n = llround (ns);
+  if (n <= 0 || fabs (ns - (double) n) > 1.0e-3) {
+    return 0;
+  }
+  return n;
+}
+
+static void build_firing_table (DLLMultiRateScheduler *pSched)
+{
+  long long H = 1;
+  int nFirings = 0;
+  int nTicks = 0;
+
+  for (int i = 0; i < pSched->NumModels; i++) {
+    long long P = pSched->pPeriodTicks[i];
+    long long g = gcd_ticks (H, P);
+    if (H / g > DLL_MAX_HYPERPERIOD_TICKS / P) {
+      printf ("DLL multi-rate: hyperperiod exceeds %d ticks, stepping to each model's next due tick\n", DLL_MAX_HYPERPERIOD_TICKS);
+      return;
+    }
+    H = H / g * P;
+  }
+  for (long long t = 0; t < H; t++) {
+    int nDue = 0;
+    for (int i = 0; i < pSched->NumModels; i++) {
+      nDue += (0 == t % pSched->pPeriodTicks[i]);
+    }
+    nFirings += nDue;
+    nTicks += (nDue > 0);
+  }
+  pSched->pFiringTick = malloc (nTicks * sizeof (long long));
+  pSched->pFiringStart = malloc ((nTicks + 1) * sizeof (int));
+  pSched->pFiring = malloc (nFirings * sizeof (Wrapped_IEEE_Cigre_DLL *));
+  if (NULL == pSched->pFiringTick || NULL == pSched->pFiringStart || NULL == pSched->pFiring) {
+    printf ("DLL multi-rate: out of memory for the firing table, stepping to each model's next due tick\n");
+    free (pSched->pFiringTick);
+    free (pSched->pFiringStart);
+    free (pSched->pFiring);
+    pSched->pFiringTick = NULL;
+    pSched->pFiringStart = NULL;
+    pSched->pFiring = NULL;
+    return;
+  }
+  nFirings = 0;
+  nTicks = 0;
+  for (long long t = 0; t < H; t++) {
+    int first = nFirings;
+    for (int i = 0; i < pSched->NumModels; i++) {
+      if (0 == t % pSched->pPeriodTicks[i]) {
+        pSched->pFiring[nFirings++] = pSched->ppWraps[i];
+      }
+    }
+    if (nFirings > first) {
+      pSched->pFiringTick[nTicks] = t;
+      pSched->pFiringStart[nTicks++] = first;
+    }
+  }
+  pSched->pFiringStart[nTicks] = nFirings;
+  pSched->NumFiringTicks = nTicks;
+  pSched->HyperPeriodTicks = H;
+}
+
+// the models due at tick t, when there is no table; returns the first tick >= t at which any is due
+static long long next_due_tick (DLLMultiRateScheduler *pSched, long long t, int *pNumDue)
+{
+  long long next = -1;
+  int nDue = 0;
+
+  for (int i = 0; i < pSched->NumModels; i++) {
+    long long P = pSched->pPeriodTicks[i];
+    long long due = (t + P - 1) / P * P;
+    if (next < 0 || due < next) {
+      next = due;
+      nDue = 0;
+    }
+    if (due == next) {
+      pSched->pDue[nDue++] = pSched->ppWraps[i];
+    }
+  }
+  *pNumDue = nDue;
+  return next;
+}
+
+// runs the models due at tick t
+static int32_T run_due (DLLMultiRateScheduler *pSched, long long t, Wrapped_IEEE_Cigre_DLL **ppDue, int nDue)
+{
+  int32_T worst = IEEE_Cigre_DLLInterface_Return_OK;
+  int32_T val;
+  double Time = (double) t * pSched->TickSeconds;
+
+  for (int i = 0; i < nDue; i++) {
+    ppDue[i]->pModel->Time = Time;
+  }
+  if (NULL != pSched->RunBatch) {
+    return pSched->RunBatch (pSched->pBatchContext, ppDue, nDue);
+  }
+  for (int i = 0; i < nDue; i++) {
+    val = ppDue[i]->Model_Outputs (ppDue[i]->pModel);
+    if (val > worst) {
+      worst = val;
+    }
+  }
+  return worst;
+}
+
+DLLMultiRateScheduler * CreateDLLMultiRateScheduler (double HostStep, Wrapped_IEEE_Cigre_DLL **ppWraps, int NumModels)
+{
+  DLLMultiRateScheduler *pSched;
+  long long host_ns = seconds_to_ns (HostStep);
+  long long tick_ns = host_ns;
+
+  if (host_ns <= 0) {
+    printf ("DLL multi-rate: host step %g is not a whole number of nanoseconds\n", HostStep);
+    return NULL;
+  }
+  pSched = calloc (1, sizeof (*pSched));
+  if (NULL == pSched) {
+    printf ("DLL multi-rate: out of memory\n");
+    return NULL;
+  }
+  pSched->NumModels = NumModels;
+  pSched->ppWraps = ppWraps;
+  pSched->pPeriodTicks = calloc (NumModels, sizeof (long long));
+  pSched->pCalls = calloc (NumModels, sizeof (long long));
+  pSched->pDue = calloc (NumModels, sizeof (Wrapped_IEEE_Cigre_DLL *));
+  if (NULL == pSched->pPeriodTicks || NULL == pSched->pCalls || NULL == pSched->pDue) {
+    printf ("DLL multi-rate: out of memory for %d models\n", NumModels);
+    FreeDLLMultiRateScheduler (pSched);
+    return NULL;
+  }
+  for (int i = 0; i < NumModels; i++) {
+    double dt = ppWraps[i]->pInfo->FixedStepBaseSampleTime;
+    pSched->pPeriodTicks[i] = seconds_to_ns (dt);
+    if (pSched->pPeriodTicks[i] <= 0) {
+      printf ("DLL multi-rate: %s sample time %g is not a whole number of nanoseconds\n", ppWraps[i]->pInfo->ModelName, dt);
+      FreeDLLMultiRateScheduler (pSched);
+      return NULL;
+    }
+    tick_ns = gcd_ticks (tick_ns, pSched->pPeriodTicks[i]);
+  }
+  for (int i = 0; i < NumModels; i++) {
+    pSched->pPeriodTicks[i] /= tick_ns;
+  }
+  pSched->TickNanoseconds = tick_ns;
+  pSched->TickSeconds = (double) tick_ns / (double) DLL_TICKS_PER_SECOND;
+  pSched->HostTicks = host_ns / tick_ns;
+  build_firing_table (pSched);
+  return pSched;
+}
+
+int32_T DLLMultiRateStep (DLLMultiRateScheduler *pSched)
+{
+  int32_T worst = IEEE_Cigre_DLLInterface_Return_OK;
+  int32_T val;
+  int nDue;
+
+  if (pSched->HyperPeriodTicks > 0) {
+    while (pSched->CycleTicks + pSched->pFiringTick[pSched->NextFiring] <= pSched->HostTick) {
+      int k = pSched->NextFiring;
+      nDue = pSched->pFiringStart[k + 1] - pSched->pFiringStart[k];
+      val = run_due (pSched, pSched->CycleTicks + pSched->pFiringTick[k], pSched->pFiring + pSched->pFiringStart[k], nDue);
+      if (val > worst) {
+        worst = val;
+      }
+      if (++pSched->NextFiring == pSched->NumFiringTicks) {
+        pSched->NextFiring = 0;
+        pSched->CycleTicks += pSched->HyperPeriodTicks;
+      }
+    }
+  } else {
+    long long t = pSched->NextTick;
+    while ((t = next_due_tick (pSched, t, &nDue)) <= pSched->HostTick) {
+      val = run_due (pSched, t, pSched->pDue, nDue);
+      if (val > worst) {
+        worst = val;
+      }
+      t += 1;
+    }
+  }
+  for (int i = 0; i < pSched->NumModels; i++) {  // calls made in ticks (NextTick-1, HostTick]
+    long long P = pSched->pPeriodTicks[i];
+    long long before = pSched->NextTick > 0 ? (pSched->NextTick - 1) / P + 1 : 0;
+    pSched->pCalls[i] += pSched->HostTick / P + 1 - before;
+  }
+  pSched->NextTick = pSched->HostTick + 1;
+  pSched->HostTick += pSched->HostTicks;
+  return worst;
+}
+
+double DLLMultiRateTime (DLLMultiRateScheduler *pSched)
+{
+  return (double) (pSched->NextTick - 1) * pSched->TickSeconds;
+}
+
+void PrintDLLMultiRateTable (DLLMultiRateScheduler *pSched)
+{
+  printf ("DLL multi-rate: tick %lld ns, host step %lld ticks, ", pSched->TickNanoseconds, pSched->HostTicks);
+  if (pSched->HyperPeriodTicks > 0) {
+    printf ("hyperperiod %lld ticks, %d firing ticks, %d firings\n", pSched->HyperPeriodTicks, pSched->NumFiringTicks,
+            pSched->pFiringStart[pSched->NumFiringTicks]);
+  } else {
+    printf ("no firing table\n");
+  }
+  printf ("  model                          period [ticks]        calls\n");
+  for (int i = 0; i < pSched->NumModels; i++) {
+    printf ("  %-30s %14lld %12lld\n", pSched->ppWraps[i]->pInfo->ModelName, pSched->pPeriodTicks[i], pSched->pCalls[i]);
+  }
+}
+
+void FreeDLLMultiRateScheduler (DLLMultiRateScheduler *pSched)
+{
+  free (pSched->pPeriodTicks);
+  free (pSched->pCalls);
+  free (pSched->pDue);
+  free (pSched->pFiringTick);
+  free (pSched->pFiringStart);
+  free (pSched->pFiring);
+  free (pSched);
+}
+
+int DLLModelStepDue (double host_time, long long nStep, double dt)
+{
+  return host_time >= (double) nStep * dt - 1.0e-6 * dt;
+}
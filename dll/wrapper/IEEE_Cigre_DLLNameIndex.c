@@ -0,0 +1,319 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Minimal perfect hash (hash and displace) over the input, output and parameter names of a model
+class, built once in LoadDLLModelClass. Names first hash into buckets of about four; the largest
+buckets are placed first, each trying seeds until all of its names land in free slots. A lookup is
+then two hashes and one strcmp, the strcmp rejecting names that are not in the set. If no seeds
+place every bucket even with four buckets per name, the index keeps the names in a plain list
+(NumBuckets 0) and LookupDLLName scans it.
+*/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLWrapper.h"
+
+#define DLL_NAMES_PER_BUCKET 4
+#define DLL_MAX_BUCKET_SEED 1000000
+
+static uint32_t hash_name (const char *name, uint32_t seed)
+{
+  uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);  // FNV-1a with a murmur3 finalizer
+  while (*name) {
+    h ^= (unsigned char) *name++;
+    h *= 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+// the sort keys carry what the comparisons need, so classes can be loaded from several threads at once
+typedef struct _NameKey {
+  const char *name;
+  int index;
+} NameKey;
+
+typedef struct _BucketKey {
+  int size;
+  int bucket;
+} BucketKey;
+
+static int compare_name_key (const void *a, const void *b)
+{
+  const NameKey *x = (const NameKey *) a;
+  const NameKey *y = (const NameKey *) b;
+  int c = strcmp (x->name, y->name);
+  return c != 0 ? c : x->index - y->index;
+}
+
+// largest first, then by bucket number, so the order does not depend on the qsort implementation
+static int compare_bucket_key (const void *a, const void *b)
+{
+  const BucketKey *x = (const BucketKey *) a;
+  const BucketKey *y = (const BucketKey *) b;
+  return x->size != y->size ? y->size - x->size : x->bucket - y->bucket;
+}
+
+// tries to place every bucket with NumBuckets buckets; returns 0 if some bucket needs too many seeds,
+// or -1 if out of memory
+static int place_buckets (DLLNameIndex *pIndex, const char **pKeys, const int *pKeep, int nKeep)
+{
+  int n = nKeep;
+  int B = pIndex->NumBuckets;
+  int *pSize = calloc (B, sizeof (int));
+  int *pStart = calloc (B + 1, sizeof (int));
+  int *pMembers = malloc (n * sizeof (int));
+  BucketKey *pOrder = malloc (B * sizeof (BucketKey));
+  int *pSlots = malloc (n * sizeof (int));
+  char *pTaken = calloc (n, 1);
+  int ok = 1;
+
+  if (NULL == pSize || NULL == pStart || NULL == pMembers || NULL == pOrder || NULL == pSlots || NULL == pTaken) {
+    ok = -1;
+    n = 0;
+    B = 0;
+  }
+  for (int k = 0; k < n; k++) {
+    pSize[hash_name (pKeys[pKeep[k]], 0) % B] += 1;
+  }
+  for (int b = 0; b < B; b++) {
+    pStart[b + 1] = pStart[b] + pSize[b];
+    pOrder[b].size = pSize[b];
+    pOrder[b].bucket = b;
+    pSize[b] = 0;
+  }
+  for (int k = 0; k < n; k++) {
+    int b = hash_name (pKeys[pKeep[k]], 0) % B;
+    pMembers[pStart[b] + pSize[b]++] = pKeep[k];
+  }
+  qsort (pOrder, B, sizeof (BucketKey), compare_bucket_key);
+  for (int ib = 0; ib < B && ok; ib++) {
+    int b = pOrder[ib].bucket;
+    uint32_t seed;
+    pIndex->pSeeds[b] = 0;
+    if (pSize[b] < 1) {
+      continue;
+    }
+    for (seed = 1; seed <= DLL_MAX_BUCKET_SEED; seed++) {
+      int m;
+      for (m = 0; m < pSize[b]; m++) {
+        int slot = (int) (hash_name (pKeys[pMembers[pStart[b] + m]], seed) % (uint32_t) n);
+        int clash = pTaken[slot];
+        for (int q = 0; q < m && !clash; q++) {
+          clash = (pSlots[q] == slot);
+        }
+        if (clash) {
+          break;
+        }
+        pSlots[m] = slot;
+      }
+      if (m == pSize[b]) {
+        break;
+      }
+    }
+    if (seed > DLL_MAX_BUCKET_SEED) {
+      ok = 0;
+      break;
+    }
+    pIndex->pSeeds[b] = seed;
+    for (int m = 0; m < pSize[b]; m++) {
+      pTaken[pSlots[m]] = 1;
+      pIndex->pIndex[pSlots[m]] = pMembers[pStart[b] + m];
+      pIndex->pNames[pSlots[m]] = pKeys[pMembers[pStart[b] + m]];
+    }
+  }
+  free (pSize);
+  free (pStart);
+  free (pMembers);
+  free (pOrder);
+  free (pSlots);
+  free (pTaken);
+  return ok;
+}
+
+// returns 0 if out of memory
+static int build_name_index (DLLNameIndex *pIndex, const char **pKeys, int n, const char *label)
+{
+  NameKey *pSorted;
+  int *pKeep;
+  int nKeep = 0;
+  int placed = 0;
+
+  memset (pIndex, 0, sizeof (*pIndex));
+  if (n < 1) {
+    return 1;
+  }
+  pSorted = malloc (n * sizeof (NameKey));  // drop repeated names, keeping the lowest index
+  pKeep = malloc (n * sizeof (int));
+  if (NULL == pSorted || NULL == pKeep) {
+    free (pSorted);
+    free (pKeep);
+    return 0;
+  }
+  for (int i = 0; i < n; i++) {
+    pSorted[i].name = pKeys[i];
+    pSorted[i].index = i;
+  }
+  qsort (pSorted, n, sizeof (NameKey), compare_name_key);
+  for (int i = 0; i < n; i++) {
+    if (nKeep > 0 && 0 == strcmp (pSorted[i].name, pKeys[pKeep[nKeep - 1]])) {
+#ifndef ATP_MINGW
+      printf ("  %s name %s is repeated; lookups return index %d\n", label, pSorted[i].name, pKeep[nKeep - 1]);
+#endif
+      continue;
+    }
+    pKeep[nKeep++] = pSorted[i].index;
+  }
+  free (pSorted);
+  pIndex->NumNames = nKeep;
+  pIndex->pIndex = malloc (nKeep * sizeof (int));
+  pIndex->pNames = malloc (nKeep * sizeof (const char *));
+  if (NULL == pIndex->pIndex || NULL == pIndex->pNames) {
+    free (pKeep);
+    return 0;
+  }
+  for (int B = (nKeep + DLL_NAMES_PER_BUCKET - 1) / DLL_NAMES_PER_BUCKET; B <= 4 * nKeep && 0 == placed; B *= 2) {
+    pIndex->NumBuckets = B;
+    free (pIndex->pSeeds);
+    pIndex->pSeeds = calloc (B, sizeof (uint32_t));
+    placed = NULL != pIndex->pSeeds ? place_buckets (pIndex, pKeys, pKeep, nKeep) : -1;
+  }
+  if (placed < 1) {  // a plain list, in index order
+    free (pIndex->pSeeds);
+    pIndex->pSeeds = NULL;
+    pIndex->NumBuckets = 0;
+    for (int k = 0; k < nKeep; k++) {
+      pIndex->pIndex[k] = pKeep[k];
+      pIndex->pNames[k] = pKeys[pKeep[k]];
+    }
+#ifndef ATP_MINGW
+    printf ("  %s names are not hashed; lookups scan %d names\n", label, nKeep);
+#endif
+  }
+  free (pKeep);
+  return placed >= 0;
+}
+
+int BuildModelNameIndices (DLLModelClass *pClass)
+{
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo = pClass->pInfo;
+  int n = pInfo->NumInputPorts;
+  const char **pKeys;
+  int ok;
+
+  memset (&pClass->InputIndex, 0, sizeof (DLLNameIndex));
+  memset (&pClass->OutputIndex, 0, sizeof (DLLNameIndex));
+  memset (&pClass->ParameterIndex, 0, sizeof (DLLNameIndex));
+  if (pInfo->NumOutputPorts > n) n = pInfo->NumOutputPorts;
+  if (pInfo->NumParameters > n) n = pInfo->NumParameters;
+  pKeys = malloc ((n > 0 ? n : 1) * sizeof (const char *));
+  if (NULL == pKeys) {
+    return 0;
+  }
+  for (int i = 0; i < pInfo->NumInputPorts; i++) {
+    pKeys[i] = pInfo->InputPortsInfo[i].Name;
+  }
+  ok = build_name_index (&pClass->InputIndex, pKeys, pInfo->NumInputPorts, "Input");
+  for (int i = 0; i < pInfo->NumOutputPorts; i++) {
+    pKeys[i] = pInfo->OutputPortsInfo[i].Name;
+  }
+  ok = build_name_index (&pClass->OutputIndex, pKeys, pInfo->NumOutputPorts, "Output") && ok;
+  for (int i = 0; i < pInfo->NumParameters; i++) {
+    pKeys[i] = pInfo->ParametersInfo[i].Name;
+  }
+  ok = build_name_index (&pClass->ParameterIndex, pKeys, pInfo->NumParameters, "Parameter") && ok;
+  free (pKeys);
+  return ok;
+}
+
+static void free_name_index (DLLNameIndex *pIndex)
+{
+  free (pIndex->pSeeds);
+  free (pIndex->pIndex);
+  free (pIndex->pNames);
+  memset (pIndex, 0, sizeof (*pIndex));
+}
+
+void FreeModelNameIndices (DLLModelClass *pClass)
+{
+  free_name_index (&pClass->InputIndex);
+  free_name_index (&pClass->OutputIndex);
+  free_name_index (&pClass->ParameterIndex);
+}
+
+int LookupDLLName (const DLLNameIndex *pIndex, const char *name)
+{
+  if (pIndex->NumNames < 1) {
+    return -1;
+  }
+  if (pIndex->NumBuckets < 1) {
+    for (int k = 0; k < pIndex->NumNames; k++) {
+      if (0 == strcmp (pIndex->pNames[k], name)) {
+        return pIndex->pIndex[k];
+      }
+    }
+    return -1;
+  }
+  uint32_t seed = pIndex->pSeeds[hash_name (name, 0) % (uint32_t) pIndex->NumBuckets];
+  int slot = (int) (hash_name (name, seed) % (uint32_t) pIndex->NumNames);
+  return 0 == strcmp (pIndex->pNames[slot], name) ? pIndex->pIndex[slot] : -1;
+}
+
+static DLLPortHandle make_handle (int index, const ArrayMap *pMap)
+{
+  DLLPortHandle h = {-1, 0, 0, IEEE_Cigre_DLLInterface_DataType_real64_T};
+  if (index >= 0) {
+    h.index = index;
+    h.offset = pMap[index].offset;
+    h.size = pMap[index].size;
+    h.dtype = pMap[index].dtype;
+  }
+  return h;
+}
+
+// instances made with CreateModelInstance have no class, so no index. One scan serves the signal
+// and parameter arrays, finding each entry's Name at offset within entries stride bytes apart.
+static int scan_names (const void *pEntries, size_t offset, size_t stride, int n, const char *name)
+{
+  const char *p = (const char *) pEntries + offset;
+  for (int i = 0; i < n; i++, p += stride) {
+    if (0 == strcmp (*(const char_T * const *) p, name)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int scan_signals (const IEEE_Cigre_DLLInterface_Signal *pSignals, int n, const char *name)
+{
+  return scan_names (pSignals, offsetof (IEEE_Cigre_DLLInterface_Signal, Name), sizeof (*pSignals), n, name);
+}
+
+DLLPortHandle GetInputHandle (Wrapped_IEEE_Cigre_DLL *pWrap, const char *name)
+{
+  int i = NULL != pWrap->pClass ? LookupDLLName (&pWrap->pClass->InputIndex, name) :
+          scan_signals (pWrap->pInfo->InputPortsInfo, pWrap->pInfo->NumInputPorts, name);
+  return make_handle (i, pWrap->pInputMap);
+}
+
+DLLPortHandle GetOutputHandle (Wrapped_IEEE_Cigre_DLL *pWrap, const char *name)
+{
+  int i = NULL != pWrap->pClass ? LookupDLLName (&pWrap->pClass->OutputIndex, name) :
+          scan_signals (pWrap->pInfo->OutputPortsInfo, pWrap->pInfo->NumOutputPorts, name);
+  return make_handle (i, pWrap->pOutputMap);
+}
+
+DLLPortHandle GetParameterHandle (Wrapped_IEEE_Cigre_DLL *pWrap, const char *name)
+{
+  int i = NULL != pWrap->pClass ? LookupDLLName (&pWrap->pClass->ParameterIndex, name) :
+          scan_names (pWrap->pInfo->ParametersInfo, offsetof (IEEE_Cigre_DLLInterface_Parameter, Name),
+                      sizeof (IEEE_Cigre_DLLInterface_Parameter), pWrap->pInfo->NumParameters, name);
+  return make_handle (i, pWrap->pParameterMap);
+}
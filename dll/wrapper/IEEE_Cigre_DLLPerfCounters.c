@@ -0,0 +1,153 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Hardware counters for benchmark runs. On Linux, each counter is a separate perf_event file
+descriptor for the calling thread, excluding kernel and hypervisor time. They are opened
+disabled, then reset and enabled around the measured loop. Each counter is read with its
+enabled and running times, so a count is scaled up when the kernel had to multiplex more
+counters than the PMU holds. A counter that cannot be opened, as in most containers or with
+perf_event_paranoid above 2, is left out; the caller reports what it has. Other platforms open
+no counters.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLPerfCounters.h"
+
+static const char *counter_names[DLL_NUM_PERF_COUNTERS] = {"cycles", "instructions", "branches",
+                                                           "branch-misses", "L1D-read-misses", "LLC-misses"};
+
+const char *DLLPerfCounterName (int i)
+{
+  return (i >= 0 && i < DLL_NUM_PERF_COUNTERS) ? counter_names[i] : "";
+}
+
+int DLLPerfCounterValid (const DLLPerfCounters *pCounters, int i)
+{
+  return pCounters->pFd[i] >= 0;
+}
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static int open_counter (uint32_t type, uint64_t config)
+{
+  struct perf_event_attr attr;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.size = sizeof (attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int) syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int OpenDLLPerfCounters (DLLPerfCounters *pCounters)
+{
+  static const uint32_t types[DLL_NUM_PERF_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                                        PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+  static const uint64_t configs[DLL_NUM_PERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_MISSES};
+  int err = 0;
+
+  memset (pCounters, 0, sizeof (*pCounters));
+  for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+    pCounters->pFd[i] = open_counter (types[i], configs[i]);
+    if (pCounters->pFd[i] >= 0) {
+      pCounters->NumOpen += 1;
+    } else if (0 == err) {
+      err = errno;
+    }
+  }
+  if (0 == pCounters->NumOpen) {
+    printf ("hardware counters unavailable (%s); check perf_event_paranoid or the container's seccomp profile\n",
+            strerror (err));
+  }
+  return pCounters->NumOpen;
+}
+
+void StartDLLPerfCounters (DLLPerfCounters *pCounters)
+{
+  for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+    if (pCounters->pFd[i] >= 0) {
+      ioctl (pCounters->pFd[i], PERF_EVENT_IOC_RESET, 0);
+    }
+  }
+  for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+    if (pCounters->pFd[i] >= 0) {
+      ioctl (pCounters->pFd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void StopDLLPerfCounters (DLLPerfCounters *pCounters)
+{
+  uint64_t buf[3];  // value, time enabled, time running
+
+  for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+    if (pCounters->pFd[i] >= 0) {
+      ioctl (pCounters->pFd[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+  pCounters->bScaled = 0;
+  for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+    pCounters->pValues[i] = 0;
+    if (pCounters->pFd[i] >= 0 && sizeof (buf) == read (pCounters->pFd[i], buf, sizeof (buf))) {
+      if (buf[2] > 0 && buf[2] < buf[1]) {
+        pCounters->pValues[i] = (uint64_t) ((double) buf[0] * (double) buf[1] / (double) buf[2]);
+        pCounters->bScaled = 1;
+      } else {
+        pCounters->pValues[i] = buf[0];
+      }
+    }
+  }
+}
+
+void CloseDLLPerfCounters (DLLPerfCounters *pCounters)
+{
+  for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+    if (pCounters->pFd[i] >= 0) {
+      close (pCounters->pFd[i]);
+      pCounters->pFd[i] = -1;
+    }
+  }
+  pCounters->NumOpen = 0;
+}
+
+#else
+
+int OpenDLLPerfCounters (DLLPerfCounters *pCounters)
+{
+  memset (pCounters, 0, sizeof (*pCounters));
+  for (int i = 0; i < DLL_NUM_PERF_COUNTERS; i++) {
+    pCounters->pFd[i] = -1;
+  }
+  printf ("hardware counters are only supported on Linux\n");
+  return 0;
+}
+
+void StartDLLPerfCounters (DLLPerfCounters *pCounters)
+{
+}
+
+void StopDLLPerfCounters (DLLPerfCounters *pCounters)
+{
+}
+
+void CloseDLLPerfCounters (DLLPerfCounters *pCounters)
+{
+}
+
+#endif
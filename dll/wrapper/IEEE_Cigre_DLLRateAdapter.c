@@ -0,0 +1,198 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+A host that calls a model at its own time step, e.g., an ATP network at 50 us around a 10 us
+controller, runs every model step that falls due by the host time, as the ATP glue in usedll.c
+does. With the inputs sampled once per host step, a 10 us controller sees a staircase of 50 us
+treads. The adapter keeps the last few host samples and gives each model step at t_k the host
+inputs interpolated to t_k: linearly between the last two samples, or by the cubic Lagrange
+polynomial through the last four, which need not be evenly spaced. Every model step lies between
+the previous host time and this one, so nothing is extrapolated on the input side.
+
+When the host step is shorter than the model's, most host steps run no model step. The host then
+sees the newest model outputs, or a line through the last two model steps extended to the host
+time. Only real32 and real64 ports are interpolated or extrapolated; integer ports carry flags
+and modes, so they are held at the newest value.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLRateAdapter.h"
+#include "IEEE_Cigre_DLLMultiRate.h"
+
+static int is_real_port (const ArrayMap *pMap)
+{
+  return IEEE_Cigre_DLLInterface_DataType_real64_T == pMap->dtype || IEEE_Cigre_DLLInterface_DataType_real32_T == pMap->dtype;
+}
+
+// adds or replaces the newest host sample
+static void push_host_sample (DLLRateAdapter *pAdapter, double host_time, const double *pInputs)
+{
+  int n = pAdapter->NumInputs;
+  int k = pAdapter->NumHostSamples;
+
+  if (k > 0 && host_time <= pAdapter->HostTimes[k-1]) {
+    k -= 1;
+  } else if (k == DLL_RATE_HOST_SAMPLES) {
+    memmove (pAdapter->HostTimes, pAdapter->HostTimes + 1, (k - 1) * sizeof (double));
+    memmove (pAdapter->pHostInputs, pAdapter->pHostInputs + n, (k - 1) * n * sizeof (double));
+    k -= 1;
+  }
+  pAdapter->HostTimes[k] = host_time;
+  memcpy (pAdapter->pHostInputs + k * n, pInputs, n * sizeof (double));
+  pAdapter->NumHostSamples = k + 1;
+}
+
+// host inputs at time t, which lies between the last two host samples
+static void interpolate_inputs (DLLRateAdapter *pAdapter, double t, double *pRow)
+{
+  int n = pAdapter->NumInputs;
+  int k = pAdapter->NumHostSamples;
+  const double *pT = pAdapter->HostTimes + k - 1;
+  const double *pNew = pAdapter->pHostInputs + (k - 1) * n;
+  ArrayMap *pMap = pAdapter->pWrap->pInputMap;
+  double w[DLL_RATE_HOST_SAMPLES];
+  int m = 0;   // samples in the interpolant
+
+  if (DLL_RATE_INPUT_CUBIC == pAdapter->InputMode && k >= 4) {
+    m = 4;
+  } else if (DLL_RATE_INPUT_HOLD != pAdapter->InputMode && k >= 2) {
+    m = 2;
+  }
+  if (m < 2 || t >= pT[0]) {
+    memcpy (pRow, pNew, n * sizeof (double));
+    return;
+  }
+  // Lagrange weights of the last m samples, oldest first
+  const double *pX = pAdapter->HostTimes + k - m;
+  for (int a = 0; a < m; a++) {
+    w[a] = 1.0;
+    for (int b = 0; b < m; b++) {
+      if (b != a) {
+        w[a] *= (t - pX[b]) / (pX[a] - pX[b]);
+      }
+    }
+  }
+  const double *pRows = pAdapter->pHostInputs + (k - m) * n;
+  for (int i = 0; i < n; i++) {
+    if (!is_real_port (&pMap[i])) {
+      pRow[i] = pNew[i];
+      continue;
+    }
+    double y = 0.0;
+    for (int a = 0; a < m; a++) {
+      y += w[a] * pRows[a * n + i];
+    }
+    pRow[i] = y;
+  }
+}
+
+static void push_model_sample (DLLRateAdapter *pAdapter, double t)
+{
+  Wrapped_IEEE_Cigre_DLL *pWrap = pAdapter->pWrap;
+  int n = pAdapter->NumOutputs;
+  const char *pData = (const char *) pWrap->pModel->ExternalOutputs;
+
+  if (2 == pAdapter->NumModelSamples) {
+    pAdapter->ModelTimes[0] = pAdapter->ModelTimes[1];
+    memcpy (pAdapter->pModelOutputs, pAdapter->pModelOutputs + n, n * sizeof (double));
+  } else {
+    pAdapter->NumModelSamples += 1;
+  }
+  double *pRow = pAdapter->pModelOutputs + (pAdapter->NumModelSamples - 1) * n;
+  pAdapter->ModelTimes[pAdapter->NumModelSamples - 1] = t;
+  for (int i = 0; i < n; i++) {
+    pRow[i] = read_dll_real64 (pData + pWrap->pOutputMap[i].offset, pWrap->pOutputMap[i].dtype);
+  }
+}
+
+static void extrapolate_outputs (DLLRateAdapter *pAdapter, double host_time, double *pOutputs)
+{
+  int n = pAdapter->NumOutputs;
+  int k = pAdapter->NumModelSamples;
+  const double *pNew = pAdapter->pModelOutputs + (k - 1) * n;
+
+  if (k < 1) {
+    return;  // no model step yet, the host keeps its own values
+  }
+  if (DLL_RATE_OUTPUT_LINEAR != pAdapter->OutputMode || k < 2 || host_time <= pAdapter->ModelTimes[1]) {
+    memcpy (pOutputs, pNew, n * sizeof (double));
+    return;
+  }
+  const double *pOld = pAdapter->pModelOutputs;
+  double s = (host_time - pAdapter->ModelTimes[1]) / (pAdapter->ModelTimes[1] - pAdapter->ModelTimes[0]);
+  for (int i = 0; i < n; i++) {
+    pOutputs[i] = is_real_port (&pAdapter->pWrap->pOutputMap[i]) ? pNew[i] + s * (pNew[i] - pOld[i]) : pNew[i];
+  }
+}
+
+DLLRateAdapter * CreateDLLRateAdapter (Wrapped_IEEE_Cigre_DLL *pWrap, int InputMode, int OutputMode)
+{
+  DLLRateAdapter *pAdapter = calloc (1, sizeof (*pAdapter));
+  int nIn = pWrap->pInfo->NumInputPorts;
+  int nOut = pWrap->pInfo->NumOutputPorts;
+
+  if (NULL == pAdapter) {
+    printf ("CreateDLLRateAdapter: out of memory for %s\n", pWrap->pInfo->ModelName);
+    return NULL;
+  }
+  pAdapter->pWrap = pWrap;
+  pAdapter->InputMode = InputMode;
+  pAdapter->OutputMode = OutputMode;
+  pAdapter->NumInputs = nIn;
+  pAdapter->NumOutputs = nOut;
+  pAdapter->dt = pWrap->pInfo->FixedStepBaseSampleTime;
+  pAdapter->pHostInputs = calloc (DLL_RATE_HOST_SAMPLES * nIn + 1, sizeof (double));
+  pAdapter->pModelInput = calloc (nIn + 1, sizeof (double));
+  pAdapter->pModelOutputs = calloc (2 * nOut + 1, sizeof (double));
+  if (NULL == pAdapter->pHostInputs || NULL == pAdapter->pModelInput || NULL == pAdapter->pModelOutputs) {
+    printf ("CreateDLLRateAdapter: out of memory for %s\n", pWrap->pInfo->ModelName);
+    FreeDLLRateAdapter (pAdapter);
+    return NULL;
+  }
+  return pAdapter;
+}
+
+int32_T DLLRateAdapterStep (DLLRateAdapter *pAdapter, double host_time, const double *pInputs, double *pOutputs)
+{
+  Wrapped_IEEE_Cigre_DLL *pWrap = pAdapter->pWrap;
+  IEEE_Cigre_DLLInterface_Instance *pModel = pWrap->pModel;
+  int32_T worst = IEEE_Cigre_DLLInterface_Return_OK;
+
+  push_host_sample (pAdapter, host_time, pInputs);
+  while (DLLModelStepDue (host_time, pAdapter->NextStep, pAdapter->dt)) {
+    double t = (double) pAdapter->NextStep * pAdapter->dt;
+    interpolate_inputs (pAdapter, t, pAdapter->pModelInput);
+    for (int i = 0; i < pAdapter->NumInputs; i++) {
+      write_dll_real64 ((char *) pModel->ExternalInputs + pWrap->pInputMap[i].offset, pWrap->pInputMap[i].dtype,
+                        pAdapter->pModelInput[i]);
+    }
+    pModel->Time = t;
+    int32_T rc = pWrap->Model_Outputs (pModel);
+    if (rc >= IEEE_Cigre_DLLInterface_Return_Error) {
+      return rc;  // the host keeps its outputs, and NextStep stays at the failed step
+    }
+    if (rc > worst) {
+      worst = rc;
+    }
+    push_model_sample (pAdapter, t);
+    pAdapter->NextStep += 1;
+    pAdapter->NumModelSteps += 1;
+  }
+  extrapolate_outputs (pAdapter, host_time, pOutputs);
+  pAdapter->NumHostSteps += 1;
+  return worst;
+}
+
+void FreeDLLRateAdapter (DLLRateAdapter *pAdapter)
+{
+  if (NULL == pAdapter) {
+    return;
+  }
+  free (pAdapter->pHostInputs);
+  free (pAdapter->pModelInput);
+  free (pAdapter->pModelOutputs);
+  free (pAdapter);
+}
@@ -0,0 +1,292 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+An RMS program takes phasor-domain steps of 5 to 20 ms, far longer than the sample time of most EMT
+controller models. Each host step holds the network solution on the model inputs while every model
+makes as many Model_Outputs calls as fit in the step, so a 10 us model still sees its own time step.
+The outputs then go back to the network, which updates the inputs, and the models get a
+Model_Iterate call. These rounds continue until no real output moves by more than its tolerance,
+or MaxIterations is reached; a step that converges in the first round costs one extra network
+solution and one Model_Iterate per model.
+
+Models that do not export Model_Iterate, or whose Model_Iterate is only a stub, can iterate by
+replay instead. Their states are saved before the first Model_Outputs of the host step, and each
+round restores them and repeats the host step with the updated inputs. The states are the three
+state arrays, or the Model_SaveState blob for models that keep state on the heap.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "IEEE_Cigre_DLLRms.h"
+
+static int32_T state_array_bytes (const IEEE_Cigre_DLLInterface_Model_Info *pInfo)
+{
+  return pInfo->NumIntStates * (int32_T) sizeof (int32_T) + pInfo->NumFloatStates * (int32_T) sizeof (real32_T) +
+    pInfo->NumDoubleStates * (int32_T) sizeof (real64_T);
+}
+
+// returns IEEE_Cigre_DLLInterface_Return_Error if the model's Model_SaveState fails
+static int32_T save_states (Wrapped_IEEE_Cigre_DLL *pWrap, DLLRmsModel *pRms)
+{
+  IEEE_Cigre_DLLInterface_Instance *pModel = pWrap->pModel;
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo = pWrap->pInfo;
+  char *p = pRms->pSaved;
+
+  if (pRms->bHooks) {
+    if (pWrap->Model_SaveState (pModel, p, pRms->SavedBytes) < 0) {
+      printf ("DLL RMS: %s could not save its state at t=%g\n", pInfo->ModelName, pModel->Time);
+      return IEEE_Cigre_DLLInterface_Return_Error;
+    }
+    return IEEE_Cigre_DLLInterface_Return_OK;
+  }
+  memcpy (p, pModel->IntStates, pInfo->NumIntStates * sizeof (int32_T));
+  p += pInfo->NumIntStates * sizeof (int32_T);
+  memcpy (p, pModel->FloatStates, pInfo->NumFloatStates * sizeof (real32_T));
+  p += pInfo->NumFloatStates * sizeof (real32_T);
+  memcpy (p, pModel->DoubleStates, pInfo->NumDoubleStates * sizeof (real64_T));
+  return IEEE_Cigre_DLLInterface_Return_OK;
+}
+
+// returns IEEE_Cigre_DLLInterface_Return_Error if the model's Model_RestoreState fails
+static int32_T restore_states (Wrapped_IEEE_Cigre_DLL *pWrap, DLLRmsModel *pRms)
+{
+  IEEE_Cigre_DLLInterface_Instance *pModel = pWrap->pModel;
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo = pWrap->pInfo;
+  const char *p = pRms->pSaved;
+
+  if (pRms->bHooks) {
+    if (IEEE_Cigre_DLLInterface_Return_OK != pWrap->Model_RestoreState (pModel, p, pRms->SavedBytes)) {
+      printf ("DLL RMS: %s could not restore its state at t=%g\n", pInfo->ModelName, pModel->Time);
+      return IEEE_Cigre_DLLInterface_Return_Error;
+    }
+    return IEEE_Cigre_DLLInterface_Return_OK;
+  }
+  memcpy (pModel->IntStates, p, pInfo->NumIntStates * sizeof (int32_T));
+  p += pInfo->NumIntStates * sizeof (int32_T);
+  memcpy (pModel->FloatStates, p, pInfo->NumFloatStates * sizeof (real32_T));
+  p += pInfo->NumFloatStates * sizeof (real32_T);
+  memcpy (pModel->DoubleStates, p, pInfo->NumDoubleStates * sizeof (real64_T));
+  return IEEE_Cigre_DLLInterface_Return_OK;
+}
+
+// NumSubsteps Model_Outputs calls from host time t, with the inputs held
+static int32_T run_host_step (Wrapped_IEEE_Cigre_DLL *pWrap, DLLRmsModel *pRms, double t)
+{
+  int32_T worst = IEEE_Cigre_DLLInterface_Return_OK;
+  double dt = pWrap->pInfo->FixedStepBaseSampleTime;
+
+  for (int j = 0; j < pRms->NumSubsteps; j++) {
+    pWrap->pModel->Time = t + j * dt;
+    int32_T rc = pWrap->Model_Outputs (pWrap->pModel);
+    if (rc > worst) {
+      worst = rc;
+    }
+  }
+  return worst;
+}
+
+// largest change of a real output since pPrev, relative to its tolerance
+static double output_residual (Wrapped_IEEE_Cigre_DLL *pWrap, const char *pPrev, const DLLRmsOptions *pOptions)
+{
+  const char *pNow = (const char *) pWrap->pModel->ExternalOutputs;
+  double worst = 0.0;
+
+  for (int i = 0; i < pWrap->pInfo->NumOutputPorts; i++) {
+    ArrayMap *pMap = &pWrap->pOutputMap[i];
+    double y, yp;
+    if (IEEE_Cigre_DLLInterface_DataType_real64_T == pMap->dtype) {
+      y = *(const real64_T *) (pNow + pMap->offset);
+      yp = *(const real64_T *) (pPrev + pMap->offset);
+    } else if (IEEE_Cigre_DLLInterface_DataType_real32_T == pMap->dtype) {
+      y = *(const real32_T *) (pNow + pMap->offset);
+      yp = *(const real32_T *) (pPrev + pMap->offset);
+    } else {
+      if (0 != memcmp (pNow + pMap->offset, pPrev + pMap->offset, pMap->size)) {
+        worst = INFINITY;  // a discrete output changed
+      }
+      continue;
+    }
+    double r = fabs (y - yp) / (pOptions->AbsTol + pOptions->RelTol * fmax (fabs (y), fabs (yp)));
+    if (!(r <= worst)) {  // also catches NaN
+      worst = r;
+    }
+  }
+  return worst;
+}
+
+DLLRmsLoop * CreateDLLRmsLoop (Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps, const DLLRmsOptions *pOptions,
+                               DLL_RMS_NETWORK_FCN Network, void *pContext)
+{
+  DLLRmsLoop *pLoop = calloc (1, sizeof (*pLoop));
+
+  if (NULL == pLoop) {
+    printf ("DLL RMS: out of memory for %d models\n", NumWraps);
+    return NULL;
+  }
+  pLoop->options = *pOptions;
+  if (pLoop->options.MaxIterations < 0) {
+    pLoop->options.MaxIterations = 0;
+  } else if (pLoop->options.MaxIterations > DLL_RMS_MAX_ITERATIONS) {
+    pLoop->options.MaxIterations = DLL_RMS_MAX_ITERATIONS;
+  }
+  if (pLoop->options.AbsTol <= 0.0 && pLoop->options.RelTol <= 0.0) {
+    pLoop->options.AbsTol = 1.0e-6;
+  }
+  pLoop->ppWraps = ppWraps;
+  pLoop->NumWraps = NumWraps;
+  pLoop->Network = Network;
+  pLoop->pContext = pContext;
+  pLoop->pModels = calloc (NumWraps > 0 ? NumWraps : 1, sizeof (DLLRmsModel));
+  if (NULL == pLoop->pModels) {
+    printf ("DLL RMS: out of memory for %d models\n", NumWraps);
+    free (pLoop);
+    return NULL;
+  }
+  for (int i = 0; i < NumWraps; i++) {
+    Wrapped_IEEE_Cigre_DLL *pWrap = ppWraps[i];
+    DLLRmsModel *pRms = &pLoop->pModels[i];
+    double dt = pWrap->pInfo->FixedStepBaseSampleTime;
+    double ratio = pLoop->options.HostStep / dt;
+    if (0 == (pWrap->pInfo->EMT_RMS_Mode & 2) || 2 != pWrap->pModel->SimTool_EMT_RMS_Mode) {
+      printf ("DLL RMS: %s %s\n", pWrap->pInfo->ModelName, 0 == (pWrap->pInfo->EMT_RMS_Mode & 2) ?
+              "does not support RMS mode" : "was not created in RMS mode; see SetDLLModelClassMode");
+      FreeDLLRmsLoop (pLoop);
+      return NULL;
+    }
+    pRms->NumSubsteps = (int) (ratio + 0.5);
+    if (pRms->NumSubsteps < 1 || fabs (ratio - pRms->NumSubsteps) > 1.0e-6 * ratio) {
+      printf ("DLL RMS: host step %g is not a whole multiple of the %s sample time %g\n",
+              pLoop->options.HostStep, pWrap->pInfo->ModelName, dt);
+      FreeDLLRmsLoop (pLoop);
+      return NULL;
+    }
+    pRms->bReplay = (DLL_RMS_ITERATE_REPLAY == pLoop->options.IterateMode) ||
+      (DLL_RMS_ITERATE_AUTO == pLoop->options.IterateMode && NULL == pWrap->Model_Iterate);
+    if (pRms->bReplay) {
+      pRms->bHooks = (NULL != pWrap->Model_SaveState && NULL != pWrap->Model_RestoreState);
+      pRms->SavedBytes = pRms->bHooks ? pWrap->Model_SaveState (pWrap->pModel, NULL, 0) : state_array_bytes (pWrap->pInfo);
+      if (pRms->SavedBytes < 0) {
+        printf ("DLL RMS: %s could not size its saved state\n", pWrap->pInfo->ModelName);
+        FreeDLLRmsLoop (pLoop);
+        return NULL;
+      }
+      pRms->pSaved = malloc (pRms->SavedBytes > 0 ? pRms->SavedBytes : 1);
+    }
+    pRms->pPrevOutputs = malloc (pWrap->pClass->layout.OutputSize > 0 ? pWrap->pClass->layout.OutputSize : 1);
+    if ((pRms->bReplay && NULL == pRms->pSaved) || NULL == pRms->pPrevOutputs) {
+      printf ("DLL RMS: out of memory for the saved state of %s\n", pWrap->pInfo->ModelName);
+      FreeDLLRmsLoop (pLoop);
+      return NULL;
+    }
+  }
+  return pLoop;
+}
+
+int32_T DLLRmsStep (DLLRmsLoop *pLoop, double t)
+{
+  const DLLRmsOptions *pOptions = &pLoop->options;
+  int32_T worst = IEEE_Cigre_DLLInterface_Return_OK;
+  int32_T rc;
+  int nRounds = 0;
+
+  if (NULL != pLoop->Network) {
+    worst = pLoop->Network (pLoop->pContext, pLoop->ppWraps, pLoop->NumWraps, t, 0);
+  }
+  for (int i = 0; i < pLoop->NumWraps; i++) {
+    Wrapped_IEEE_Cigre_DLL *pWrap = pLoop->ppWraps[i];
+    DLLRmsModel *pRms = &pLoop->pModels[i];
+    rc = IEEE_Cigre_DLLInterface_Return_OK;
+    if (pRms->bReplay && pOptions->MaxIterations > 0) {
+      rc = save_states (pWrap, pRms);
+    }
+    if (rc < IEEE_Cigre_DLLInterface_Return_Error) {
+      rc = run_host_step (pWrap, pRms, t);
+    }
+    if (rc > worst) {
+      worst = rc;
+    }
+  }
+  pLoop->LastResidual = 0.0;
+  while (nRounds < pOptions->MaxIterations && worst < IEEE_Cigre_DLLInterface_Return_Error) {
+    for (int i = 0; i < pLoop->NumWraps; i++) {
+      Wrapped_IEEE_Cigre_DLL *pWrap = pLoop->ppWraps[i];
+      memcpy (pLoop->pModels[i].pPrevOutputs, pWrap->pModel->ExternalOutputs, pWrap->pClass->layout.OutputSize);
+    }
+    if (NULL != pLoop->Network) {
+      rc = pLoop->Network (pLoop->pContext, pLoop->ppWraps, pLoop->NumWraps, t, nRounds + 1);
+      if (rc > worst) {
+        worst = rc;
+      }
+    }
+    double residual = 0.0;
+    for (int i = 0; i < pLoop->NumWraps; i++) {
+      Wrapped_IEEE_Cigre_DLL *pWrap = pLoop->ppWraps[i];
+      DLLRmsModel *pRms = &pLoop->pModels[i];
+      rc = IEEE_Cigre_DLLInterface_Return_OK;
+      if (pRms->bReplay) {
+        rc = restore_states (pWrap, pRms);
+        if (rc < IEEE_Cigre_DLLInterface_Return_Error) {
+          rc = run_host_step (pWrap, pRms, t);
+        }
+      } else if (NULL != pWrap->Model_Iterate) {
+        rc = pWrap->Model_Iterate (pWrap->pModel);
+      }
+      if (rc > worst) {
+        worst = rc;
+      }
+      double r = output_residual (pWrap, pRms->pPrevOutputs, pOptions);
+      if (!(r <= residual)) {
+        residual = r;
+      }
+    }
+    nRounds += 1;
+    pLoop->LastResidual = residual;
+    if (residual <= 1.0) {
+      break;
+    }
+  }
+  if (pLoop->LastResidual > 1.0 || pLoop->LastResidual != pLoop->LastResidual) {
+    pLoop->NumNotConverged += 1;
+    if (!(pLoop->LastResidual <= pLoop->MaxResidual)) {
+      pLoop->MaxResidual = pLoop->LastResidual;
+    }
+  }
+  pLoop->RoundCounts[nRounds] += 1;
+  pLoop->NumRounds += nRounds;
+  pLoop->NumSteps += 1;
+  return worst;
+}
+
+void PrintDLLRmsStats (DLLRmsLoop *pLoop)
+{
+#ifndef ATP_MINGW
+  printf ("RMS loop: %ld host steps of %g s, %lld iteration rounds, %ld steps not converged",
+          pLoop->NumSteps, pLoop->options.HostStep, pLoop->NumRounds, pLoop->NumNotConverged);
+  if (pLoop->NumNotConverged > 0) {
+    printf (" (worst residual %g)", pLoop->MaxResidual);
+  }
+  printf ("\n  rounds:steps");
+  for (int k = 0; k <= pLoop->options.MaxIterations; k++) {
+    if (pLoop->RoundCounts[k] > 0) {
+      printf (" %d:%ld", k, pLoop->RoundCounts[k]);
+    }
+  }
+  printf ("\n");
+#endif
+}
+
+void FreeDLLRmsLoop (DLLRmsLoop *pLoop)
+{
+  if (NULL == pLoop) {
+    return;
+  }
+  for (int i = 0; i < pLoop->NumWraps; i++) {
+    free (pLoop->pModels[i].pSaved);
+    free (pLoop->pModels[i].pPrevOutputs);
+  }
+  free (pLoop->pModels);
+  free (pLoop);
+}
@@ -0,0 +1,194 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Each step divides the instances into contiguous shares, one per thread. A thread runs its own
+share first, then steals the remaining instances from the other shares, so a slow model does not
+hold up the whole step. The calling thread is worker 0, and the step ends at a barrier when every
+worker has finished. Workers spin between steps, which suits 10 us network steps; they yield
+their time slice after DLL_SPINS_BEFORE_YIELD idle spins.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "IEEE_Cigre_DLLScheduler.h"
+
+typedef struct _DLLWorkerArg_ {
+  DLLScheduler *pSched;
+  int id;
+} DLLWorkerArg;
+
+static void run_model_range (DLLScheduler *pSched, int id)
+{
+  DLLWorkerSlot *pMine = &pSched->pSlots[id];
+  uint64_t t0 = 0;
+  long i;
+
+  if (pSched->bMeasureLoad) {
+    t0 = DLLMonotonicNanoseconds ();
+  }
+  pMine->worst = IEEE_Cigre_DLLInterface_Return_OK;
+  for (int k = 0; k < pSched->NumThreads; k++) {
+    DLLWorkerSlot *pVictim = &pSched->pSlots[(id + k) % pSched->NumThreads];
+    while ((i = DLL_ATOMIC_ADD (&pVictim->next, 1)) < pVictim->end) {
+      Wrapped_IEEE_Cigre_DLL *pWrap = pSched->ppWraps[i];
+      int32_T val = pWrap->Model_Outputs (pWrap->pModel);
+      if (val > pMine->worst) {
+        pMine->worst = val;
+      }
+      if (val != IEEE_Cigre_DLLInterface_Return_OK && NULL != pSched->pMessages) {
+        PostDLLModelMessages (pSched->pMessages, pWrap, "Model_Outputs", val);
+      }
+      pMine->calls += 1;
+      if (k > 0) {
+        pMine->steals += 1;
+      }
+    }
+  }
+  if (pSched->bMeasureLoad) {
+    pMine->busy_ns += DLLMonotonicNanoseconds () - t0;
+  }
+}
+
+static void worker_main (void *p)
+{
+  DLLWorkerArg arg = *(DLLWorkerArg *) p;
+  DLLScheduler *pSched = arg.pSched;
+  long seen = 0;
+  free (p);
+
+  if (pSched->bPinCores) {
+    PinDLLThread (arg.id);
+  }
+  while (1) {
+    long spins = 0;
+    long gen;
+    while ((gen = DLL_ATOMIC_LOAD (&pSched->generation)) == seen) {
+      DLLSpinPause (++spins);
+    }
+    seen = gen;
+    if (DLL_ATOMIC_LOAD (&pSched->shutdown)) {
+      break;
+    }
+    run_model_range (pSched, arg.id);
+    DLL_ATOMIC_ADD (&pSched->pending, -1);
+  }
+}
+
+DLLScheduler * CreateDLLScheduler (int NumThreads, int bPinCores)
+{
+  DLLScheduler *pSched = calloc (1, sizeof (*pSched));
+
+  if (NumThreads < 1) {
+    NumThreads = GetDLLCoreCount ();
+  }
+  if (NULL == pSched) {
+    printf ("CreateDLLScheduler: out of memory\n");
+    return NULL;
+  }
+  pSched->NumThreads = 1;  // until the workers start, FreeDLLScheduler joins none of them
+  pSched->bPinCores = bPinCores;
+  pSched->pSlots = calloc (NumThreads, sizeof (DLLWorkerSlot));
+  pSched->pThreads = calloc (NumThreads, sizeof (DLL_THREAD));
+  if (NULL == pSched->pSlots || NULL == pSched->pThreads) {
+    printf ("CreateDLLScheduler: out of memory for %d threads\n", NumThreads);
+    FreeDLLScheduler (pSched);
+    return NULL;
+  }
+  pSched->NumThreads = NumThreads;
+  if (DLL_PIN_CALLER == bPinCores) {
+    PinDLLThread (0);
+  }
+  for (int i = 1; i < NumThreads; i++) {
+    DLLWorkerArg *pArg = malloc (sizeof (*pArg));
+    if (NULL != pArg) {
+      pArg->pSched = pSched;
+      pArg->id = i;
+    }
+    if (NULL == pArg || !StartDLLThread (&pSched->pThreads[i], worker_main, pArg)) {
+      printf ("CreateDLLScheduler: failed to start thread %d, using %d threads\n", i, i);
+      free (pArg);
+      pSched->NumThreads = i;
+      break;
+    }
+  }
+  return pSched;
+}
+
+int32_T DLLSchedulerStep (DLLScheduler *pSched, Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps)
+{
+  int T = pSched->NumThreads;
+  int32_T worst = IEEE_Cigre_DLLInterface_Return_OK;
+  uint64_t t0 = 0;
+
+  if (pSched->bMeasureLoad) {
+    t0 = DLLMonotonicNanoseconds ();
+  }
+  pSched->ppWraps = ppWraps;
+  pSched->NumWraps = NumWraps;
+  for (int t = 0; t < T; t++) {
+    pSched->pSlots[t].next = (long) ((long long) NumWraps * t / T);
+    pSched->pSlots[t].end = (long) ((long long) NumWraps * (t + 1) / T);
+  }
+  DLL_ATOMIC_STORE (&pSched->pending, T - 1);
+  DLL_ATOMIC_ADD (&pSched->generation, 1);  // release the workers
+  run_model_range (pSched, 0);
+
+  long spins = 0;
+  while (DLL_ATOMIC_LOAD (&pSched->pending) > 0) {
+    DLLSpinPause (++spins);
+  }
+  for (int t = 0; t < T; t++) {
+    if (pSched->pSlots[t].worst > worst) {
+      worst = pSched->pSlots[t].worst;
+    }
+  }
+  pSched->NumSteps += 1;
+  if (pSched->bMeasureLoad) {
+    pSched->StepNanoseconds += DLLMonotonicNanoseconds () - t0;
+  }
+  return worst;
+}
+
+int32_T DLLSchedulerBatch (void *pContext, Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps)
+{
+  return DLLSchedulerStep ((DLLScheduler *) pContext, ppWraps, NumWraps);
+}
+
+void PrintDLLSchedulerLoad (DLLScheduler *pSched)
+{
+  uint64_t max_ns = 0, total_ns = 0;
+  int T = pSched->NumThreads;
+
+  printf ("DLL scheduler: %d threads, %ld steps\n", T, pSched->NumSteps);
+  if (!pSched->bMeasureLoad) {
+    printf ("  set bMeasureLoad before stepping to report busy times\n");
+  }
+  printf ("  thread        calls       steals      busy [ms]\n");
+  for (int t = 0; t < T; t++) {
+    DLLWorkerSlot *pSlot = &pSched->pSlots[t];
+    printf ("  %6d %12ld %12ld %14.3f\n", t, pSlot->calls, pSlot->steals, 1.0e-6 * pSlot->busy_ns);
+    total_ns += pSlot->busy_ns;
+    if (pSlot->busy_ns > max_ns) {
+      max_ns = pSlot->busy_ns;
+    }
+  }
+  if (pSched->bMeasureLoad && total_ns > 0) {
+    double mean_ns = (double) total_ns / T;
+    printf ("  imbalance (max/mean busy) = %.3f\n", (double) max_ns / mean_ns);
+    printf ("  parallel efficiency (busy / threads*wall) = %.3f\n",
+            (double) total_ns / ((double) T * (double) pSched->StepNanoseconds));
+  }
+}
+
+void FreeDLLScheduler (DLLScheduler *pSched)
+{
+  DLL_ATOMIC_STORE (&pSched->shutdown, 1);
+  DLL_ATOMIC_ADD (&pSched->generation, 1);
+  for (int i = 1; i < pSched->NumThreads; i++) {
+    JoinDLLThread (pSched->pThreads[i]);
+  }
+  free (pSched->pThreads);
+  free (pSched->pSlots);
+  free (pSched);
+}
@@ -0,0 +1,274 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Connections are stored by node and port index as they are declared. BuildDLLSignalGraph turns
+them into either an alias of a whole ExternalInputs struct, or a short gather list of
+{destination, source, bytes} records per node, so a step does no name lookups, map lookups or
+per-port branching unless the two ports have different data types.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLSignalGraph.h"
+
+static int find_node (DLLSignalGraph *pGraph, Wrapped_IEEE_Cigre_DLL *pWrap)
+{
+  for (int i = 0; i < pGraph->NumNodes; i++) {
+    if (pGraph->pNodes[i].pWrap == pWrap) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+DLLSignalGraph * CreateDLLSignalGraph (void)
+{
+  return calloc (1, sizeof (DLLSignalGraph));
+}
+
+int AddDLLSignalNode (DLLSignalGraph *pGraph, Wrapped_IEEE_Cigre_DLL *pWrap)
+{
+  int i = find_node (pGraph, pWrap);
+  if (i >= 0) {
+    return i;
+  }
+  if (pGraph->NumNodes >= pGraph->MaxNodes) {
+    int nMax = pGraph->MaxNodes > 0 ? 2 * pGraph->MaxNodes : 8;
+    DLLSignalNode *pNodes = realloc (pGraph->pNodes, nMax * sizeof (DLLSignalNode));
+    if (NULL == pNodes) {
+      printf ("AddDLLSignalNode: out of memory for %s\n", pWrap->pInfo->ModelName);
+      return -1;
+    }
+    pGraph->pNodes = pNodes;
+    pGraph->MaxNodes = nMax;
+  }
+  i = pGraph->NumNodes++;
+  memset (&pGraph->pNodes[i], 0, sizeof (DLLSignalNode));
+  pGraph->pNodes[i].pWrap = pWrap;
+  pGraph->pNodes[i].pOwnInputs = pWrap->pModel->ExternalInputs;
+  pGraph->bBuilt = 0;
+  return i;
+}
+
+int ConnectDLLSignals (DLLSignalGraph *pGraph, Wrapped_IEEE_Cigre_DLL *pFrom, const char *OutputName,
+                       Wrapped_IEEE_Cigre_DLL *pTo, const char *InputName)
+{
+  DLLSignalConnection conn;
+
+  conn.FromNode = find_node (pGraph, pFrom);
+  conn.ToNode = find_node (pGraph, pTo);
+  if (conn.FromNode < 0 || conn.ToNode < 0) {
+    printf ("ConnectDLLSignals: add both models to the graph before connecting %s to %s\n", OutputName, InputName);
+    return 0;
+  }
+  conn.FromPort = GetOutputHandle (pFrom, OutputName).index;
+  if (conn.FromPort < 0) {
+    printf ("ConnectDLLSignals: %s has no output named %s\n", pFrom->pInfo->ModelName, OutputName);
+    return 0;
+  }
+  conn.ToPort = GetInputHandle (pTo, InputName).index;
+  if (conn.ToPort < 0) {
+    printf ("ConnectDLLSignals: %s has no input named %s\n", pTo->pInfo->ModelName, InputName);
+    return 0;
+  }
+  for (int i = 0; i < pGraph->NumConnections; i++) {
+    if (pGraph->pConnections[i].ToNode == conn.ToNode && pGraph->pConnections[i].ToPort == conn.ToPort) {
+      printf ("ConnectDLLSignals: input %s of %s is already connected\n", InputName, pTo->pInfo->ModelName);
+      return 0;
+    }
+  }
+  if (pGraph->NumConnections >= pGraph->MaxConnections) {
+    int nMax = pGraph->MaxConnections > 0 ? 2 * pGraph->MaxConnections : 16;
+    DLLSignalConnection *pConnections = realloc (pGraph->pConnections, nMax * sizeof (DLLSignalConnection));
+    if (NULL == pConnections) {
+      printf ("ConnectDLLSignals: out of memory connecting %s to %s\n", OutputName, InputName);
+      return 0;
+    }
+    pGraph->pConnections = pConnections;
+    pGraph->MaxConnections = nMax;
+  }
+  pGraph->pConnections[pGraph->NumConnections++] = conn;
+  pGraph->bBuilt = 0;
+  return 1;
+}
+
+// every input connected, in order, from one other node with matching types and byte spacing,
+// and the resulting struct pointer suitably aligned
+static int try_alias_inputs (DLLSignalGraph *pGraph, int node, const DLLSignalConnection **ppByPort)
+{
+  Wrapped_IEEE_Cigre_DLL *pTo = pGraph->pNodes[node].pWrap;
+  int n = pTo->pInfo->NumInputPorts;
+  Wrapped_IEEE_Cigre_DLL *pFrom;
+  int delta;
+  size_t align = 1;
+
+  if (n < 1 || NULL == ppByPort[0] || ppByPort[0]->FromNode == node) {
+    return 0;
+  }
+  pFrom = pGraph->pNodes[ppByPort[0]->FromNode].pWrap;
+  delta = pFrom->pOutputMap[ppByPort[0]->FromPort].offset - pTo->pInputMap[0].offset;
+  for (int k = 0; k < n; k++) {
+    const DLLSignalConnection *pConn = ppByPort[k];
+    if (NULL == pConn || pConn->FromNode != ppByPort[0]->FromNode) {
+      return 0;
+    }
+    if (pFrom->pOutputMap[pConn->FromPort].dtype != pTo->pInputMap[k].dtype) {
+      return 0;
+    }
+    if (pFrom->pOutputMap[pConn->FromPort].offset - pTo->pInputMap[k].offset != delta) {
+      return 0;
+    }
+    if (get_alignment_requirement (pTo->pInputMap[k].dtype) > align) {
+      align = get_alignment_requirement (pTo->pInputMap[k].dtype);
+    }
+  }
+  char *pBase = (char *) pFrom->pModel->ExternalOutputs + delta;
+  if (0 != (uintptr_t) pBase % align) {
+    return 0;
+  }
+  pTo->pModel->ExternalInputs = pBase;
+  pGraph->pNodes[node].bAliased = 1;
+  return 1;
+}
+
+int BuildDLLSignalGraph (DLLSignalGraph *pGraph)
+{
+  int maxInputs = 1;
+
+  for (int i = 0; i < pGraph->NumNodes; i++) {  // undo any earlier build
+    pGraph->pNodes[i].pWrap->pModel->ExternalInputs = pGraph->pNodes[i].pOwnInputs;
+    pGraph->pNodes[i].bAliased = 0;
+    pGraph->pNodes[i].NumCopies = 0;
+    if (pGraph->pNodes[i].pWrap->pInfo->NumInputPorts > maxInputs) {
+      maxInputs = pGraph->pNodes[i].pWrap->pInfo->NumInputPorts;
+    }
+  }
+  free (pGraph->pCopies);
+  pGraph->pCopies = malloc ((pGraph->NumConnections > 0 ? pGraph->NumConnections : 1) * sizeof (DLLSignalCopy));
+  pGraph->NumCopies = 0;
+  pGraph->bBuilt = 0;
+
+  const DLLSignalConnection **ppByPort = malloc (maxInputs * sizeof (DLLSignalConnection *));
+  if (NULL == pGraph->pCopies || NULL == ppByPort) {
+    printf ("BuildDLLSignalGraph: out of memory for %d connections\n", pGraph->NumConnections);
+    free (ppByPort);
+    return 0;
+  }
+  for (int node = 0; node < pGraph->NumNodes; node++) {
+    DLLSignalNode *pNode = &pGraph->pNodes[node];
+    Wrapped_IEEE_Cigre_DLL *pTo = pNode->pWrap;
+    int n = pTo->pInfo->NumInputPorts;
+    for (int k = 0; k < n; k++) {
+      ppByPort[k] = NULL;
+    }
+    for (int i = 0; i < pGraph->NumConnections; i++) {
+      if (pGraph->pConnections[i].ToNode == node) {
+        ppByPort[pGraph->pConnections[i].ToPort] = &pGraph->pConnections[i];
+      }
+    }
+    pNode->FirstCopy = pGraph->NumCopies;
+    pNode->NumCopies = 0;
+    if (try_alias_inputs (pGraph, node, ppByPort)) {
+      continue;
+    }
+    const DLLSignalConnection *pPrev = NULL;
+    for (int k = 0; k < n; k++) {
+      const DLLSignalConnection *pConn = ppByPort[k];
+      if (NULL == pConn) {
+        pPrev = NULL;
+        continue;
+      }
+      Wrapped_IEEE_Cigre_DLL *pFrom = pGraph->pNodes[pConn->FromNode].pWrap;
+      ArrayMap src = pFrom->pOutputMap[pConn->FromPort];
+      ArrayMap dst = pTo->pInputMap[k];
+      char *pDst = (char *) pTo->pModel->ExternalInputs + dst.offset;
+      const char *pSrc = (const char *) pFrom->pModel->ExternalOutputs + src.offset;
+      DLLSignalCopy *pLast = pNode->NumCopies > 0 ? &pGraph->pCopies[pGraph->NumCopies - 1] : NULL;
+      if (NULL != pPrev && NULL != pLast && src.dtype == dst.dtype && pLast->SrcType == pLast->DstType &&
+          pPrev->FromNode == pConn->FromNode && pPrev->FromPort + 1 == pConn->FromPort &&
+          pSrc - pLast->pSrc == pDst - pLast->pDst) {
+        pLast->nBytes = (int) (pDst - pLast->pDst) + dst.size;  // extend the run, padding included
+      } else {
+        DLLSignalCopy *pCopy = &pGraph->pCopies[pGraph->NumCopies++];
+        pCopy->pDst = pDst;
+        pCopy->pSrc = pSrc;
+        pCopy->nBytes = dst.size;
+        pCopy->DstType = dst.dtype;
+        pCopy->SrcType = src.dtype;
+        pNode->NumCopies += 1;
+      }
+      pPrev = pConn;
+    }
+  }
+  free (ppByPort);
+  pGraph->bBuilt = 1;
+  return 1;
+}
+
+void DLLSignalGraphGather (DLLSignalGraph *pGraph, int node)
+{
+  DLLSignalNode *pNode = &pGraph->pNodes[node];
+  DLLSignalCopy *pCopy = pGraph->pCopies + pNode->FirstCopy;
+
+  for (int i = 0; i < pNode->NumCopies; i++, pCopy++) {
+    if (pCopy->DstType == pCopy->SrcType) {
+      memcpy (pCopy->pDst, pCopy->pSrc, pCopy->nBytes);
+    } else {
+      write_dll_real64 (pCopy->pDst, pCopy->DstType, read_dll_real64 (pCopy->pSrc, pCopy->SrcType));
+    }
+  }
+}
+
+int32_T DLLSignalGraphStep (DLLSignalGraph *pGraph)
+{
+  int32_T worst = IEEE_Cigre_DLLInterface_Return_OK;
+
+  if (!pGraph->bBuilt && !BuildDLLSignalGraph (pGraph)) {
+    return IEEE_Cigre_DLLInterface_Return_Error;
+  }
+  for (int node = 0; node < pGraph->NumNodes; node++) {
+    Wrapped_IEEE_Cigre_DLL *pWrap = pGraph->pNodes[node].pWrap;
+    DLLSignalGraphGather (pGraph, node);
+    int32_T val = pWrap->Model_Outputs (pWrap->pModel);
+    if (val > worst) {
+      worst = val;
+    }
+  }
+  return worst;
+}
+
+void PrintDLLSignalGraph (DLLSignalGraph *pGraph)
+{
+  printf ("DLL signal graph: %d nodes, %d connections, %d gather records\n", pGraph->NumNodes,
+          pGraph->NumConnections, pGraph->NumCopies);
+  for (int i = 0; i < pGraph->NumConnections; i++) {
+    DLLSignalConnection *pConn = &pGraph->pConnections[i];
+    const IEEE_Cigre_DLLInterface_Model_Info *pFrom = pGraph->pNodes[pConn->FromNode].pWrap->pInfo;
+    const IEEE_Cigre_DLLInterface_Model_Info *pTo = pGraph->pNodes[pConn->ToNode].pWrap->pInfo;
+    printf ("  %s.%s -> %s.%s\n", pFrom->ModelName, pFrom->OutputPortsInfo[pConn->FromPort].Name,
+            pTo->ModelName, pTo->InputPortsInfo[pConn->ToPort].Name);
+  }
+  for (int i = 0; i < pGraph->NumNodes; i++) {
+    DLLSignalNode *pNode = &pGraph->pNodes[i];
+    int nBytes = 0;
+    for (int j = 0; j < pNode->NumCopies; j++) {
+      nBytes += pGraph->pCopies[pNode->FirstCopy + j].nBytes;
+    }
+    printf ("  node %d %-24s %s, %d copies, %d bytes\n", i, pNode->pWrap->pInfo->ModelName,
+            pNode->bAliased ? "inputs aliased" : "inputs gathered", pNode->NumCopies, nBytes);
+  }
+}
+
+void FreeDLLSignalGraph (DLLSignalGraph *pGraph)
+{
+  for (int i = 0; i < pGraph->NumNodes; i++) {
+    pGraph->pNodes[i].pWrap->pModel->ExternalInputs = pGraph->pNodes[i].pOwnInputs;
+  }
+  free (pGraph->pNodes);
+  free (pGraph->pConnections);
+  free (pGraph->pCopies);
+  free (pGraph);
+}
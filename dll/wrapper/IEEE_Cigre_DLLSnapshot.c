@@ -0,0 +1,205 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+A snapshot is one malloced blob: a DLLSnapshotHeader, then the Parameters, ExternalInputs and
+ExternalOutputs buffers, then the Double, Float and Int state arrays, then whatever the model's
+Model_SaveState hook wrote. Each section starts on an 8-byte boundary. The header records every
+section size and the model name, so a restore into an instance of a different model, or of the
+same model built with other dimensions, is refused before any byte is written.
+
+The state arrays are skipped when the model exports the hooks, because such a model may keep
+heap pointers in them; the hooks then serialize what the pointers lead to, and the target
+instance keeps its own pointers. Without hooks, the blob is the complete instance, so restoring
+it and stepping again reproduces the original run bit for bit.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLSnapshot.h"
+
+#define SNAPSHOT_ALIGN(n) (((size_t)(n) + 7) & ~(size_t)7)
+
+static void fill_header (Wrapped_IEEE_Cigre_DLL *pWrap, DLLSnapshotHeader *pHdr, int32_T nModelBytes)
+{
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo = pWrap->pInfo;
+  const DLLModelLayout *pLayout = &pWrap->pClass->layout;
+
+  memset (pHdr, 0, sizeof (*pHdr));
+  memcpy (pHdr->Magic, DLL_SNAPSHOT_MAGIC, sizeof DLL_SNAPSHOT_MAGIC);
+  pHdr->Version = DLL_SNAPSHOT_VERSION;
+  strncpy (pHdr->ModelName, pInfo->ModelName, sizeof (pHdr->ModelName) - 1);
+  pHdr->ParameterBytes = pLayout->ParameterSize;
+  pHdr->InputBytes = pLayout->InputSize;
+  pHdr->OutputBytes = pLayout->OutputSize;
+  if (NULL == pWrap->Model_SaveState) {
+    pHdr->DoubleStateBytes = pInfo->NumDoubleStates * (int32_T) sizeof (real64_T);
+    pHdr->FloatStateBytes = pInfo->NumFloatStates * (int32_T) sizeof (real32_T);
+    pHdr->IntStateBytes = pInfo->NumIntStates * (int32_T) sizeof (int32_T);
+  } else {
+    pHdr->bModelState = 1;
+  }
+  pHdr->ModelBytes = nModelBytes;
+  pHdr->Time = pWrap->pModel->Time;
+  pHdr->TotalBytes = SNAPSHOT_ALIGN (sizeof (*pHdr)) + SNAPSHOT_ALIGN (pHdr->ParameterBytes) +
+    SNAPSHOT_ALIGN (pHdr->InputBytes) + SNAPSHOT_ALIGN (pHdr->OutputBytes) +
+    SNAPSHOT_ALIGN (pHdr->DoubleStateBytes) + SNAPSHOT_ALIGN (pHdr->FloatStateBytes) +
+    SNAPSHOT_ALIGN (pHdr->IntStateBytes) + SNAPSHOT_ALIGN (pHdr->ModelBytes);
+}
+
+// copies nBytes between the instance buffer and the blob at *pOffset, in the direction given
+static void copy_section (char *pBlob, size_t *pOffset, void *pBuffer, int32_T nBytes, int bSave)
+{
+  if (nBytes > 0 && NULL != pBuffer) {
+    if (bSave) {
+      memcpy (pBlob + *pOffset, pBuffer, nBytes);
+    } else {
+      memcpy (pBuffer, pBlob + *pOffset, nBytes);
+    }
+  }
+  *pOffset += SNAPSHOT_ALIGN (nBytes);
+}
+
+void * SnapshotInstance (Wrapped_IEEE_Cigre_DLL *pWrap, size_t *pBytes)
+{
+  IEEE_Cigre_DLLInterface_Instance *pModel = pWrap->pModel;
+  DLLSnapshotHeader hdr;
+  int32_T nModelBytes = 0;
+  size_t offset;
+  char *pBlob;
+
+  *pBytes = 0;
+  if (NULL != pWrap->Model_SaveState) {
+    nModelBytes = pWrap->Model_SaveState (pModel, NULL, 0);
+    if (nModelBytes < 0) {
+      printf ("%s could not size its state for a snapshot\n", pWrap->pInfo->ModelName);
+      return NULL;
+    }
+  }
+  fill_header (pWrap, &hdr, nModelBytes);
+  pBlob = (char *) calloc (1, hdr.TotalBytes);
+  if (NULL == pBlob) {
+    printf ("could not allocate a %llu-byte snapshot of %s\n", (unsigned long long) hdr.TotalBytes,
+            pWrap->pInfo->ModelName);
+    return NULL;
+  }
+  memcpy (pBlob, &hdr, sizeof (hdr));
+  offset = SNAPSHOT_ALIGN (sizeof (hdr));
+  copy_section (pBlob, &offset, pModel->Parameters, hdr.ParameterBytes, 1);
+  copy_section (pBlob, &offset, pModel->ExternalInputs, hdr.InputBytes, 1);
+  copy_section (pBlob, &offset, pModel->ExternalOutputs, hdr.OutputBytes, 1);
+  copy_section (pBlob, &offset, pModel->DoubleStates, hdr.DoubleStateBytes, 1);
+  copy_section (pBlob, &offset, pModel->FloatStates, hdr.FloatStateBytes, 1);
+  copy_section (pBlob, &offset, pModel->IntStates, hdr.IntStateBytes, 1);
+  if (nModelBytes > 0 && pWrap->Model_SaveState (pModel, pBlob + offset, nModelBytes) != nModelBytes) {
+    printf ("%s did not save %d bytes of state for a snapshot\n", pWrap->pInfo->ModelName, nModelBytes);
+    free (pBlob);
+    return NULL;
+  }
+  *pBytes = hdr.TotalBytes;
+  return pBlob;
+}
+
+int32_T RestoreInstance (Wrapped_IEEE_Cigre_DLL *pWrap, const void *pBlob, size_t nBytes)
+{
+  IEEE_Cigre_DLLInterface_Instance *pModel = pWrap->pModel;
+  DLLSnapshotHeader hdr, expected;
+  size_t offset;
+
+  if (nBytes < sizeof (hdr)) {
+    printf ("snapshot of %llu bytes is too short for its header\n", (unsigned long long) nBytes);
+    return IEEE_Cigre_DLLInterface_Return_Error;
+  }
+  memcpy (&hdr, pBlob, sizeof (hdr));
+  if (0 != memcmp (hdr.Magic, DLL_SNAPSHOT_MAGIC, sizeof DLL_SNAPSHOT_MAGIC) || DLL_SNAPSHOT_VERSION != hdr.Version) {
+    printf ("not a version %d model snapshot\n", DLL_SNAPSHOT_VERSION);
+    return IEEE_Cigre_DLLInterface_Return_Error;
+  }
+  fill_header (pWrap, &expected, hdr.ModelBytes);
+  if (0 != strncmp (hdr.ModelName, expected.ModelName, sizeof (hdr.ModelName)) ||
+      hdr.bModelState != expected.bModelState ||
+      hdr.ParameterBytes != expected.ParameterBytes || hdr.InputBytes != expected.InputBytes ||
+      hdr.OutputBytes != expected.OutputBytes || hdr.DoubleStateBytes != expected.DoubleStateBytes ||
+      hdr.FloatStateBytes != expected.FloatStateBytes || hdr.IntStateBytes != expected.IntStateBytes ||
+      hdr.TotalBytes != expected.TotalBytes || hdr.TotalBytes > nBytes) {
+    printf ("snapshot of %s does not fit an instance of %s\n", hdr.ModelName, expected.ModelName);
+    return IEEE_Cigre_DLLInterface_Return_Error;
+  }
+  offset = SNAPSHOT_ALIGN (sizeof (hdr));
+  copy_section ((char *) pBlob, &offset, pModel->Parameters, hdr.ParameterBytes, 0);
+  // inputs a DLLSignalGraph aliases are another model's outputs, so they go to the instance's own
+  // buffer, which the graph hands back when it is freed
+  copy_section ((char *) pBlob, &offset, DLL_INSTANCE_HEADER (pModel)->pOwnInputs, hdr.InputBytes, 0);
+  copy_section ((char *) pBlob, &offset, pModel->ExternalOutputs, hdr.OutputBytes, 0);
+  copy_section ((char *) pBlob, &offset, pModel->DoubleStates, hdr.DoubleStateBytes, 0);
+  copy_section ((char *) pBlob, &offset, pModel->FloatStates, hdr.FloatStateBytes, 0);
+  copy_section ((char *) pBlob, &offset, pModel->IntStates, hdr.IntStateBytes, 0);
+  if (hdr.bModelState) {
+    if (NULL == pWrap->Model_RestoreState ||
+        IEEE_Cigre_DLLInterface_Return_OK != pWrap->Model_RestoreState (pModel, (const char *) pBlob + offset,
+                                                                         hdr.ModelBytes)) {
+      printf ("%s could not restore its state from a snapshot\n", expected.ModelName);
+      return IEEE_Cigre_DLLInterface_Return_Error;
+    }
+  }
+  pModel->Time = hdr.Time;
+  return IEEE_Cigre_DLLInterface_Return_OK;
+}
+
+void FreeInstanceSnapshot (void *pBlob)
+{
+  free (pBlob);
+}
+
+int WriteInstanceSnapshot (const char *file_name, const void *pBlob, size_t nBytes)
+{
+  FILE *fp = fopen (file_name, "wb");
+  size_t nWritten;
+
+  if (NULL == fp) {
+    printf ("could not open snapshot file %s\n", file_name);
+    return 0;
+  }
+  nWritten = fwrite (pBlob, 1, nBytes, fp);
+  fclose (fp);
+  if (nWritten != nBytes) {
+    printf ("wrote %llu of %llu bytes to %s\n", (unsigned long long) nWritten, (unsigned long long) nBytes, file_name);
+    return 0;
+  }
+  return 1;
+}
+
+void * ReadInstanceSnapshot (const char *file_name, size_t *pBytes)
+{
+  FILE *fp = fopen (file_name, "rb");
+  DLLSnapshotHeader hdr;
+  char *pBlob;
+
+  *pBytes = 0;
+  if (NULL == fp) {
+    printf ("could not open snapshot file %s\n", file_name);
+    return NULL;
+  }
+  if (1 != fread (&hdr, sizeof (hdr), 1, fp) || 0 != memcmp (hdr.Magic, DLL_SNAPSHOT_MAGIC, sizeof DLL_SNAPSHOT_MAGIC) ||
+      hdr.TotalBytes < sizeof (hdr)) {
+    printf ("%s is not a model snapshot\n", file_name);
+    fclose (fp);
+    return NULL;
+  }
+  pBlob = (char *) malloc (hdr.TotalBytes);
+  if (NULL == pBlob) {
+    fclose (fp);
+    return NULL;
+  }
+  memcpy (pBlob, &hdr, sizeof (hdr));
+  if (hdr.TotalBytes - sizeof (hdr) != fread (pBlob + sizeof (hdr), 1, hdr.TotalBytes - sizeof (hdr), fp)) {
+    printf ("%s is truncated\n", file_name);
+    free (pBlob);
+    fclose (fp);
+    return NULL;
+  }
+  fclose (fp);
+  *pBytes = hdr.TotalBytes;
+  return pBlob;
+}
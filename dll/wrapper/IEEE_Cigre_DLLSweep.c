@@ -0,0 +1,538 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Parameter sweeps over one model class. The variants are generated up front in the unit cube, one
+coordinate per swept parameter, and mapped onto each parameter's range, linearly or in log(value).
+The range defaults to the MinValue and MaxValue that the model declares, and is always clipped to
+them. A splitmix64 generator makes Latin hypercube and random samples repeatable from the seed.
+
+Each thread owns one instance of the class and takes the next variant from a shared atomic
+counter, so a slow variant never holds up the others. Between variants, the instance gets
+Model_Terminate, fresh parameters, inputs, outputs and states, then Model_FirstCall,
+Model_CheckParameters and Model_Initialize, the same sequence as a new instance. The last
+Model_Terminate comes from FreeDLLModelInstance. The instances are created and freed on the calling
+thread, because the class and timing bookkeeping is not thread-safe.
+
+The metrics are updated after every Model_Outputs from the resolved output handles, so nothing is
+stored per step and no trace is written. Overshoot and settling time are measured against the step
+from the output's value at StartTime to Reference; a step of zero falls back to |Reference|, or 1.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "IEEE_Cigre_DLLSweep.h"
+#include "IEEE_Cigre_DLLThreads.h"
+
+static const char *metric_names[DLL_NUM_METRIC_TYPES] = {"overshoot", "settling_time", "rms_error", "peak", "final"};
+
+const char *DLLSweepMetricName (int Type)
+{
+  return (Type >= 0 && Type < DLL_NUM_METRIC_TYPES) ? metric_names[Type] : "";
+}
+
+typedef struct _SweepAxis_ {  // a swept parameter, resolved against the class
+  DLLPortHandle h;
+  double Low;
+  double High;
+  int bLog;
+  int bInteger;
+} SweepAxis;
+
+typedef struct _MetricState_ {  // running values of one metric during one variant
+  int bStarted;
+  double y0;
+  double dir;                   // +1 for a step up to Reference, -1 for a step down
+  double scale;                 // size of the step
+  double peak;
+  double tLastOut;              // last time outside the settling band, or -1
+  double sumsq;
+  long n;
+  double last;
+} MetricState;
+
+typedef struct _SweepRun_ {  // shared by the worker threads
+  DLLModelClass *pClass;
+  const DLLSweepSpec *pSpec;
+  SweepAxis *pAxes;
+  DLLPortHandle *pOutputs;      // one per metric
+  DLLSweepResults *pResults;
+  long kEnd;
+  DLL_ATOMIC_LONG next;
+} SweepRun;
+
+typedef struct _SweepWorker_ {
+  SweepRun *pRun;
+  Wrapped_IEEE_Cigre_DLL *pWrap;
+  MetricState *pStates;
+  int NumRun;                   // variants this worker has run
+  DLL_THREAD thread;
+  int bStarted;                 // thread is running; otherwise the other workers take its share
+} SweepWorker;
+
+static uint64_t splitmix64 (uint64_t *pState)
+{
+  uint64_t z = (*pState += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// uniform on [0, 1)
+static double uniform (uint64_t *pState)
+{
+  return (double) (splitmix64 (pState) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// 0 if a parameter cannot be swept
+static int resolve_axes (Wrapped_IEEE_Cigre_DLL *pWrap, const DLLSweepSpec *pSpec, SweepAxis *pAxes)
+{
+  for (int i = 0; i < pSpec->NumParameters; i++) {
+    const DLLSweepParameter *pPar = &pSpec->pParameters[i];
+    SweepAxis *pAxis = &pAxes[i];
+    const IEEE_Cigre_DLLInterface_Parameter *pInfo;
+    double lo, hi;
+
+    pAxis->h = GetParameterHandle (pWrap, pPar->Name);
+    if (pAxis->h.index < 0) {
+      printf ("%s has no parameter named %s\n", pWrap->pInfo->ModelName, pPar->Name);
+      return 0;
+    }
+    if (IEEE_Cigre_DLLInterface_DataType_c_string_T == pAxis->h.dtype) {
+      printf ("%s is a string parameter, which cannot be swept\n", pPar->Name);
+      return 0;
+    }
+    pInfo = &pWrap->pInfo->ParametersInfo[pAxis->h.index];
+    lo = read_dll_real64 ((const char *) &pInfo->MinValue, pInfo->DataType);
+    hi = read_dll_real64 ((const char *) &pInfo->MaxValue, pInfo->DataType);
+    if (pPar->Low < pPar->High) {
+      pAxis->Low = pPar->Low > lo ? pPar->Low : lo;
+      pAxis->High = pPar->High < hi ? pPar->High : hi;
+    } else {
+      pAxis->Low = lo;
+      pAxis->High = hi;
+    }
+    pAxis->bLog = pPar->bLog;
+    if (pAxis->bLog && pAxis->Low <= 0.0) {
+      printf ("%s cannot be swept in log scale from %g\n", pPar->Name, pAxis->Low);
+      return 0;
+    }
+    pAxis->bInteger = IEEE_Cigre_DLLInterface_DataType_real32_T != pAxis->h.dtype &&
+      IEEE_Cigre_DLLInterface_DataType_real64_T != pAxis->h.dtype;
+  }
+  return 1;
+}
+
+static double axis_value (const SweepAxis *pAxis, double u)
+{
+  double x;
+
+  if (pAxis->bLog) {
+    x = exp (log (pAxis->Low) + u * (log (pAxis->High) - log (pAxis->Low)));
+  } else {
+    x = pAxis->Low + u * (pAxis->High - pAxis->Low);
+  }
+  return pAxis->bInteger ? floor (x + 0.5) : x;
+}
+
+static int count_variants (const DLLSweepSpec *pSpec)
+{
+  long n = 1;
+
+  if (DLL_SWEEP_GRID != pSpec->Sampling) {
+    return pSpec->NumSamples;
+  }
+  for (int i = 0; i < pSpec->NumParameters; i++) {
+    n *= pSpec->pParameters[i].NumLevels > 0 ? pSpec->pParameters[i].NumLevels : 1;
+    if (n > 100000000L) {
+      printf ("a grid of more than 100000000 variants is too large\n");
+      return 0;
+    }
+  }
+  return (int) n;
+}
+
+// fills the swept values of every row; the first parameter varies slowest in a grid. Returns 0 if out of memory.
+static int generate_variants (const DLLSweepSpec *pSpec, const SweepAxis *pAxes, DLLSweepResults *pResults)
+{
+  int nv = pResults->NumVariants;
+  int np = pSpec->NumParameters;
+  int stride = np + pSpec->NumMetrics;
+  uint64_t state = pSpec->Seed;
+  int *pPerm = (int *) malloc ((nv > 0 ? nv : 1) * sizeof (int));
+
+  if (NULL == pPerm) {
+    return 0;
+  }
+
+  for (int j = 0; j < np; j++) {
+    int levels = pSpec->pParameters[j].NumLevels > 0 ? pSpec->pParameters[j].NumLevels : 1;
+    long inner = 1;
+    for (int jj = j + 1; jj < np; jj++) {
+      inner *= pSpec->pParameters[jj].NumLevels > 0 ? pSpec->pParameters[jj].NumLevels : 1;
+    }
+    if (DLL_SWEEP_LATIN_HYPERCUBE == pSpec->Sampling) {
+      for (int i = 0; i < nv; i++) {
+        pPerm[i] = i;
+      }
+      for (int i = nv - 1; i > 0; i--) {  // Fisher-Yates shuffle of the strata
+        int r = (int) (uniform (&state) * (i + 1));
+        int tmp = pPerm[i];
+        pPerm[i] = pPerm[r];
+        pPerm[r] = tmp;
+      }
+    }
+    for (int i = 0; i < nv; i++) {
+      double u;
+      if (DLL_SWEEP_GRID == pSpec->Sampling) {
+        int level = (int) ((i / inner) % levels);
+        u = levels > 1 ? (double) level / (double) (levels - 1) : 0.5;
+      } else if (DLL_SWEEP_LATIN_HYPERCUBE == pSpec->Sampling) {
+        u = ((double) pPerm[i] + uniform (&state)) / (double) nv;
+      } else {
+        u = uniform (&state);
+      }
+      pResults->pValues[(size_t) i * stride + j] = axis_value (&pAxes[j], u);
+    }
+  }
+  free (pPerm);
+  return 1;
+}
+
+static void reset_instance (SweepWorker *pWorker)
+{
+  Wrapped_IEEE_Cigre_DLL *pWrap = pWorker->pWrap;
+  IEEE_Cigre_DLLInterface_Instance *pModel = pWrap->pModel;
+  const DLLModelLayout *pLayout = &pWorker->pRun->pClass->layout;
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo = pWrap->pInfo;
+  Wrapped_IEEE_Cigre_DLL *pTemplate = pWorker->pRun->pSpec->pTemplate;
+
+  if (NULL != pTemplate) {
+    memcpy (pModel->Parameters, pTemplate->pModel->Parameters, pLayout->ParameterSize);
+    memcpy (pModel->ExternalInputs, pTemplate->pModel->ExternalInputs, pLayout->InputSize);
+    memcpy (pModel->ExternalOutputs, pTemplate->pModel->ExternalOutputs, pLayout->OutputSize);
+  } else {
+    memcpy (pModel->Parameters, pLayout->pDefaultParameters, pLayout->ParameterSize);
+    memset (pModel->ExternalInputs, 0, pLayout->InputSize);
+    memset (pModel->ExternalOutputs, 0, pLayout->OutputSize);
+  }
+  if (pInfo->NumIntStates > 0) {
+    memset (pModel->IntStates, 0, pInfo->NumIntStates * sizeof (int32_T));
+  }
+  if (pInfo->NumFloatStates > 0) {
+    memset (pModel->FloatStates, 0, pInfo->NumFloatStates * sizeof (real32_T));
+  }
+  if (pInfo->NumDoubleStates > 0) {
+    memset (pModel->DoubleStates, 0, pInfo->NumDoubleStates * sizeof (real64_T));
+  }
+  pModel->Time = 0.0;
+}
+
+static void update_metric (const DLLSweepMetric *pMetric, MetricState *pState, double y, double t, double dt)
+{
+  double err = y - pMetric->Reference;
+
+  if (t < pMetric->StartTime - 0.5 * dt) {
+    return;
+  }
+  if (!pState->bStarted) {
+    pState->bStarted = 1;
+    pState->y0 = y;
+    pState->dir = pMetric->Reference >= y ? 1.0 : -1.0;
+    pState->scale = fabs (pMetric->Reference - y);
+    if (0.0 == pState->scale) {
+      pState->scale = 0.0 != pMetric->Reference ? fabs (pMetric->Reference) : 1.0;
+    }
+    pState->peak = -HUGE_VAL;
+    pState->tLastOut = -1.0;
+  }
+  switch (pMetric->Type) {
+    case DLL_METRIC_OVERSHOOT:
+      if (pState->dir * err > pState->peak) {
+        pState->peak = pState->dir * err;
+      }
+      break;
+    case DLL_METRIC_SETTLING_TIME:
+      if (fabs (err) > pMetric->Band * pState->scale) {
+        pState->tLastOut = t;
+      }
+      break;
+    case DLL_METRIC_RMS_ERROR:
+      pState->sumsq += err * err;
+      break;
+    case DLL_METRIC_PEAK:
+      if (fabs (y) > pState->peak) {
+        pState->peak = fabs (y);
+      }
+      break;
+    default:
+      break;
+  }
+  pState->n += 1;
+  pState->last = y;
+}
+
+static double metric_value (const DLLSweepMetric *pMetric, const MetricState *pState, double tEnd, double dt)
+{
+  if (!pState->bStarted) {
+    return NAN;
+  }
+  switch (pMetric->Type) {
+    case DLL_METRIC_OVERSHOOT:
+      return pState->peak > 0.0 ? 100.0 * pState->peak / pState->scale : 0.0;
+    case DLL_METRIC_SETTLING_TIME:
+      if (pState->tLastOut < 0.0) {
+        return 0.0;
+      }
+      // still outside the band at the last step means it never settled
+      return pState->tLastOut >= tEnd - 1.5 * dt ? HUGE_VAL : pState->tLastOut + dt - pMetric->StartTime;
+    case DLL_METRIC_RMS_ERROR:
+      return sqrt (pState->sumsq / (double) pState->n);
+    case DLL_METRIC_PEAK:
+      return pState->peak;
+    case DLL_METRIC_FINAL:
+      return pState->last;
+    default:
+      return NAN;
+  }
+}
+
+static int run_variant (SweepWorker *pWorker, int iVariant)
+{
+  SweepRun *pRun = pWorker->pRun;
+  const DLLSweepSpec *pSpec = pRun->pSpec;
+  Wrapped_IEEE_Cigre_DLL *pWrap = pWorker->pWrap;
+  IEEE_Cigre_DLLInterface_Instance *pModel = pWrap->pModel;
+  DLLSweepResults *pResults = pRun->pResults;
+  double *pRow = pResults->pValues + (size_t) iVariant * (pResults->NumParameters + pResults->NumMetrics);
+  double dt = pWrap->pInfo->FixedStepBaseSampleTime;
+
+  if (pWorker->NumRun > 0) {
+    pWrap->Model_Terminate (pModel);
+  }
+  pWorker->NumRun += 1;
+  reset_instance (pWorker);
+  for (int j = 0; j < pSpec->NumParameters; j++) {
+    char *p = (char *) DLL_PORT_PTR (pModel->Parameters, pRun->pAxes[j].h);
+    write_dll_real64 (p, pRun->pAxes[j].h.dtype, pRow[j]);
+    pRow[j] = read_dll_real64 (p, pRun->pAxes[j].h.dtype);  // the value the model actually sees
+  }
+  memset (pWorker->pStates, 0, pSpec->NumMetrics * sizeof (MetricState));
+
+  if (NULL != pWrap->Model_FirstCall && IEEE_Cigre_DLLInterface_Return_Error == pWrap->Model_FirstCall (pModel)) {
+    return DLL_SWEEP_MODEL_ERROR;
+  }
+  if (IEEE_Cigre_DLLInterface_Return_Error == pWrap->Model_CheckParameters (pModel)) {
+    return DLL_SWEEP_MODEL_ERROR;
+  }
+  if (NULL != pSpec->StepFcn) {
+    pSpec->StepFcn (pWrap, 0.0, iVariant, pSpec->pUser);
+  }
+  if (IEEE_Cigre_DLLInterface_Return_Error == pWrap->Model_Initialize (pModel)) {
+    return DLL_SWEEP_MODEL_ERROR;
+  }
+  for (long k = 0; k < pRun->kEnd; k++) {
+    double t = (double) k * dt;
+    pModel->Time = t;
+    if (NULL != pSpec->StepFcn) {
+      pSpec->StepFcn (pWrap, t, iVariant, pSpec->pUser);
+    }
+    if (IEEE_Cigre_DLLInterface_Return_Error == pWrap->Model_Outputs (pModel)) {
+      return DLL_SWEEP_MODEL_ERROR;
+    }
+    for (int m = 0; m < pSpec->NumMetrics; m++) {
+      double y = read_dll_real64 ((const char *) DLL_PORT_PTR (pModel->ExternalOutputs, pRun->pOutputs[m]),
+                                  pRun->pOutputs[m].dtype);
+      if (!isfinite (y)) {
+        return DLL_SWEEP_NOT_FINITE;
+      }
+      update_metric (&pSpec->pMetrics[m], &pWorker->pStates[m], y, t, dt);
+    }
+  }
+  for (int m = 0; m < pSpec->NumMetrics; m++) {
+    pRow[pSpec->NumParameters + m] = metric_value (&pSpec->pMetrics[m], &pWorker->pStates[m],
+                                                   (double) pRun->kEnd * dt, dt);
+  }
+  return DLL_SWEEP_OK;
+}
+
+static void sweep_worker (void *arg)
+{
+  SweepWorker *pWorker = (SweepWorker *) arg;
+  SweepRun *pRun = pWorker->pRun;
+  DLLSweepResults *pResults = pRun->pResults;
+  long i;
+
+  while ((i = DLL_ATOMIC_ADD (&pRun->next, 1)) < pResults->NumVariants) {
+    pResults->pStatus[i] = run_variant (pWorker, (int) i);
+  }
+}
+
+DLLSweepResults * RunDLLSweep (DLLModelClass *pClass, const DLLSweepSpec *pSpec, int NumThreads)
+{
+  SweepRun run;
+  SweepWorker *pWorkers;
+  DLLSweepResults *pResults;
+  int nv = count_variants (pSpec);
+  int stride = pSpec->NumParameters + pSpec->NumMetrics;
+  double dt = pClass->pInfo->FixedStepBaseSampleTime;
+  uint64_t t0;
+  int ok = 1;
+
+  if (nv < 1) {
+    printf ("RunDLLSweep: no variants to run\n");
+    return NULL;
+  }
+  if (NumThreads < 1) {
+    NumThreads = GetDLLCoreCount ();
+  }
+  if (NumThreads > nv) {
+    NumThreads = nv;
+  }
+  memset (&run, 0, sizeof (run));
+  run.pClass = pClass;
+  run.pSpec = pSpec;
+  run.kEnd = (long) (pSpec->EndTime / dt + 0.5);
+  run.pAxes = (SweepAxis *) calloc (pSpec->NumParameters + 1, sizeof (SweepAxis));
+  run.pOutputs = (DLLPortHandle *) calloc (pSpec->NumMetrics + 1, sizeof (DLLPortHandle));
+  pWorkers = (SweepWorker *) calloc (NumThreads, sizeof (SweepWorker));
+  if (NULL == run.pAxes || NULL == run.pOutputs || NULL == pWorkers) {
+    printf ("RunDLLSweep: out of memory for %d threads\n", NumThreads);
+    free (run.pAxes);
+    free (run.pOutputs);
+    free (pWorkers);
+    return NULL;
+  }
+  for (int w = 0; ok && w < NumThreads; w++) {
+    pWorkers[w].pRun = &run;
+    pWorkers[w].pWrap = CreateDLLModelInstance (pClass);
+    pWorkers[w].pStates = (MetricState *) calloc (pSpec->NumMetrics + 1, sizeof (MetricState));
+    if (NULL == pWorkers[w].pWrap || NULL == pWorkers[w].pStates) {
+      printf ("RunDLLSweep: could not create the instance for thread %d\n", w);
+      ok = 0;
+    }
+  }
+
+  ok = ok && resolve_axes (pWorkers[0].pWrap, pSpec, run.pAxes);
+  for (int m = 0; ok && m < pSpec->NumMetrics; m++) {
+    run.pOutputs[m] = GetOutputHandle (pWorkers[0].pWrap, pSpec->pMetrics[m].Output);
+    if (run.pOutputs[m].index < 0) {
+      printf ("%s has no output named %s\n", pClass->pInfo->ModelName, pSpec->pMetrics[m].Output);
+      ok = 0;
+    }
+  }
+  pResults = NULL;
+  if (ok) {
+    pResults = (DLLSweepResults *) calloc (1, sizeof (DLLSweepResults));
+    ok = NULL != pResults;
+  }
+  if (ok) {
+    pResults->NumVariants = nv;
+    pResults->NumParameters = pSpec->NumParameters;
+    pResults->NumMetrics = pSpec->NumMetrics;
+    pResults->pValues = (double *) calloc ((size_t) nv * stride + 1, sizeof (double));
+    pResults->pStatus = (int *) calloc (nv, sizeof (int));
+    pResults->pNames = (char **) calloc (stride + 1, sizeof (char *));
+    ok = NULL != pResults->pValues && NULL != pResults->pStatus && NULL != pResults->pNames;
+    for (int j = 0; ok && j < pSpec->NumParameters; j++) {
+      pResults->pNames[j] = strdup (pSpec->pParameters[j].Name);
+      ok = NULL != pResults->pNames[j];
+    }
+    for (int m = 0; ok && m < pSpec->NumMetrics; m++) {
+      size_t len = strlen (DLLSweepMetricName (pSpec->pMetrics[m].Type)) + strlen (pSpec->pMetrics[m].Output) + 3;
+      pResults->pNames[pSpec->NumParameters + m] = (char *) malloc (len);
+      ok = NULL != pResults->pNames[pSpec->NumParameters + m];
+      if (ok) {
+        snprintf (pResults->pNames[pSpec->NumParameters + m], len, "%s(%s)",
+                  DLLSweepMetricName (pSpec->pMetrics[m].Type), pSpec->pMetrics[m].Output);
+      }
+    }
+    ok = ok && generate_variants (pSpec, run.pAxes, pResults);
+    if (!ok) {
+      printf ("RunDLLSweep: out of memory for %d variants\n", nv);
+      FreeDLLSweepResults (pResults);
+      pResults = NULL;
+    }
+  }
+  if (ok) {
+    run.pResults = pResults;
+
+    t0 = DLLMonotonicNanoseconds ();
+    for (int w = 1; w < NumThreads; w++) {
+      pWorkers[w].bStarted = StartDLLThread (&pWorkers[w].thread, sweep_worker, &pWorkers[w]);
+    }
+    sweep_worker (&pWorkers[0]);
+    for (int w = 1; w < NumThreads; w++) {
+      if (pWorkers[w].bStarted) {
+        JoinDLLThread (pWorkers[w].thread);
+      }
+    }
+    pResults->Seconds = 1.0e-9 * (double) (DLLMonotonicNanoseconds () - t0);
+    for (int i = 0; i < nv; i++) {
+      if (DLL_SWEEP_OK != pResults->pStatus[i]) {
+        for (int m = 0; m < pSpec->NumMetrics; m++) {
+          pResults->pValues[(size_t) i * stride + pSpec->NumParameters + m] = NAN;
+        }
+      }
+    }
+  }
+
+  for (int w = 0; w < NumThreads; w++) {
+    if (NULL == pWorkers[w].pWrap) {
+      free (pWorkers[w].pStates);
+      continue;
+    }
+    if (0 == pWorkers[w].NumRun) {
+      // FreeDLLModelInstance calls Model_Terminate, which models like HWPV only survive after Model_CheckParameters
+      reset_instance (&pWorkers[w]);
+      pWorkers[w].pWrap->Model_CheckParameters (pWorkers[w].pWrap->pModel);
+    }
+    FreeDLLModelInstance (pWorkers[w].pWrap);
+    free (pWorkers[w].pStates);
+  }
+  free (pWorkers);
+  free (run.pAxes);
+  free (run.pOutputs);
+  return pResults;
+}
+
+int WriteDLLSweepCSV (const DLLSweepResults *pResults, const char *file_name)
+{
+  FILE *fp = fopen (file_name, "w");
+  int stride = pResults->NumParameters + pResults->NumMetrics;
+
+  if (NULL == fp) {
+    printf ("could not open %s\n", file_name);
+    return 0;
+  }
+  fprintf (fp, "variant,status");
+  for (int j = 0; j < stride; j++) {
+    fprintf (fp, ",%s", pResults->pNames[j]);
+  }
+  fprintf (fp, "\n");
+  for (int i = 0; i < pResults->NumVariants; i++) {
+    fprintf (fp, "%d,%d", i, pResults->pStatus[i]);
+    for (int j = 0; j < stride; j++) {
+      fprintf (fp, ",%.9g", pResults->pValues[(size_t) i * stride + j]);
+    }
+    fprintf (fp, "\n");
+  }
+  fclose (fp);
+  return 1;
+}
+
+void FreeDLLSweepResults (DLLSweepResults *pResults)
+{
+  if (NULL == pResults) {
+    return;
+  }
+  for (int j = 0; NULL != pResults->pNames && j < pResults->NumParameters + pResults->NumMetrics; j++) {
+    free (pResults->pNames[j]);
+  }
+  free (pResults->pNames);
+  free (pResults->pValues);
+  free (pResults->pStatus);
+  free (pResults);
+}
@@ -0,0 +1,148 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  // for pthread_setaffinity_np
+#endif
+
+#include <stdlib.h>
+
+#include "IEEE_Cigre_DLLThreads.h"
+
+#if defined(_WIN32)
+#include <intrin.h>
+#else
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef struct _DLLThreadStart_ {
+  DLL_THREAD_FCN fcn;
+  void *arg;
+} DLLThreadStart;
+
+#if defined(_WIN32)
+static DWORD WINAPI dll_thread_main (LPVOID p)
+#else
+static void *dll_thread_main (void *p)
+#endif
+{
+  DLLThreadStart start = *(DLLThreadStart *) p;
+  free (p);
+  start.fcn (start.arg);
+  return 0;
+}
+
+int StartDLLThread (DLL_THREAD *pThread, DLL_THREAD_FCN fcn, void *arg)
+{
+  DLLThreadStart *pStart = malloc (sizeof (*pStart));
+  if (NULL == pStart) {
+    return 0;
+  }
+  pStart->fcn = fcn;
+  pStart->arg = arg;
+#if defined(_WIN32)
+  *pThread = CreateThread (NULL, 0, dll_thread_main, pStart, 0, NULL);
+  if (NULL == *pThread) {
+    free (pStart);
+    return 0;
+  }
+#else
+  if (0 != pthread_create (pThread, NULL, dll_thread_main, pStart)) {
+    free (pStart);
+    return 0;
+  }
+#endif
+  return 1;
+}
+
+void JoinDLLThread (DLL_THREAD thread)
+{
+#if defined(_WIN32)
+  WaitForSingleObject (thread, INFINITE);
+  CloseHandle (thread);
+#else
+  pthread_join (thread, NULL);
+#endif
+}
+
+int PinDLLThread (int core)
+{
+  int ncores = GetDLLCoreCount ();
+  if (core < 0 || ncores < 1) {
+    return 0;
+  }
+  core = core % ncores;
+#if defined(_WIN32)
+  return 0 != SetThreadAffinityMask (GetCurrentThread (), (DWORD_PTR) 1 << core);
+#elif defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO (&cpus);
+  CPU_SET (core, &cpus);
+  return 0 == pthread_setaffinity_np (pthread_self (), sizeof (cpus), &cpus);
+#else
+  return 0;  // macOS only supports affinity hints
+#endif
+}
+
+int GetDLLCoreCount (void)
+{
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo (&info);
+  return (int) info.dwNumberOfProcessors;
+#else
+  long n = sysconf (_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int) n : 1;
+#endif
+}
+
+void DLLSpinPause (long spins)
+{
+#if defined(_WIN32)
+  _mm_pause ();
+  if (spins > DLL_SPINS_BEFORE_YIELD) {
+    SwitchToThread ();
+  }
+#else
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause ();
+#elif defined(__aarch64__)
+  __asm__ __volatile__ ("yield");
+#endif
+  if (spins > DLL_SPINS_BEFORE_YIELD) {
+    sched_yield ();
+  }
+#endif
+}
+
+void DLLSleepMicroseconds (long us)
+{
+#if defined(_WIN32)
+  Sleep ((DWORD) ((us + 999) / 1000));
+#else
+  struct timespec ts;
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (us % 1000000) * 1000;
+  nanosleep (&ts, NULL);
+#endif
+}
+
+uint64_t DLLMonotonicNanoseconds (void)
+{
+#if defined(_WIN32)
+  static LARGE_INTEGER freq = {0};
+  LARGE_INTEGER now;
+  if (0 == freq.QuadPart) {
+    QueryPerformanceFrequency (&freq);
+  }
+  QueryPerformanceCounter (&now);
+  uint64_t ticks = (uint64_t) now.QuadPart;
+  uint64_t hz = (uint64_t) freq.QuadPart;
+  return (ticks / hz) * 1000000000ull + (ticks % hz) * 1000000000ull / hz;
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+#endif
+}
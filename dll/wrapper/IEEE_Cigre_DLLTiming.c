@@ -0,0 +1,231 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Timing of every call a host makes through a wrapped model's entry points. When the wrapper is
+built with -DDLL_TIMING, each new instance has its Model_FirstCall, Model_CheckParameters,
+Model_Initialize, Model_Outputs, Model_Iterate and Model_Terminate pointers replaced with thunks. A
+thunk only receives pModel, so it finds the instance's DLLModelTiming through the DLLInstanceHeader
+that the wrapper allocates around pModel, reads the monotonic clock around the model's own function,
+and adds the latency to a log-scale histogram with four buckets per octave. The histograms keep the
+tail (p99, max) that a mean hides. Without -DDLL_TIMING, nothing here is called and the pointers
+are the model's own.
+
+There is no shared table, so the thunks may run on any thread, as long as each instance is stepped
+by one thread at a time. A timed instance has no Model_OutputsBatch, so DLLModelOutputsBatch steps
+it through its Model_Outputs thunk, one instance at a time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLTiming.h"
+#include "IEEE_Cigre_DLLThreads.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static uint64_t bucket_upper_bound (int idx)
+{
+  int msb;
+  uint64_t sub;
+  if (idx < DLL_TIMING_SUBBUCKETS) {
+    return (uint64_t) idx;
+  }
+  msb = idx / DLL_TIMING_SUBBUCKETS + 1;
+  sub = (uint64_t) (idx % DLL_TIMING_SUBBUCKETS);
+  return ((DLL_TIMING_SUBBUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+uint64_t DLLTimingPercentile (const DLLTimingHistogram *pHist, double p)
+{
+  uint64_t target = (uint64_t) (p / 100.0 * (double) pHist->NumCalls + 0.999999);
+  uint64_t seen = 0;
+
+  if (pHist->NumCalls < 1) {
+    return 0;
+  }
+  if (target < 1) {
+    target = 1;
+  }
+  for (int i = 0; i < DLL_TIMING_BUCKETS; i++) {
+    seen += pHist->pCounts[i];
+    if (seen >= target) {
+      uint64_t ub = bucket_upper_bound (i);
+      return ub < pHist->MaxNanoseconds ? ub : pHist->MaxNanoseconds;
+    }
+  }
+  return pHist->MaxNanoseconds;
+}
+
+#ifdef DLL_TIMING
+
+static const char *entry_names[DLL_NUM_TIMED_ENTRIES] = {"FirstCall", "CheckParameters", "Initialize",
+                                                         "Outputs", "Iterate", "Terminate"};
+
+static int highest_bit (uint64_t v)
+{
+#if defined(_MSC_VER)
+  unsigned long i;
+  _BitScanReverse64 (&i, v);
+  return (int) i;
+#else
+  return 63 - __builtin_clzll (v);
+#endif
+}
+
+static int timing_bucket (uint64_t ns)
+{
+  int msb;
+  if (ns < DLL_TIMING_SUBBUCKETS) {
+    return (int) ns;
+  }
+  msb = highest_bit (ns);
+  return (msb - 1) * DLL_TIMING_SUBBUCKETS + (int) ((ns >> (msb - 2)) & (DLL_TIMING_SUBBUCKETS - 1));
+}
+
+static DLLModelTiming *find_timing (const IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  return ((const DLLInstanceHeader *) pModel)->pTiming;
+}
+
+static int32_T timed_call (IEEE_Cigre_DLLInterface_Instance *pModel, int entry)
+{
+  DLLModelTiming *pTiming = find_timing (pModel);
+  DLLTimingHistogram *pHist = &pTiming->entries[entry];
+  uint64_t t0 = DLLMonotonicNanoseconds ();
+  int32_T val = pTiming->pFunctions[entry] (pModel);
+  uint64_t ns = DLLMonotonicNanoseconds () - t0;
+
+  pHist->NumCalls += 1;
+  pHist->TotalNanoseconds += ns;
+  if (ns < pHist->MinNanoseconds) {
+    pHist->MinNanoseconds = ns;
+  }
+  if (ns > pHist->MaxNanoseconds) {
+    pHist->MaxNanoseconds = ns;
+  }
+  pHist->pCounts[timing_bucket (ns)] += 1;
+  return val;
+}
+
+static int32_T DLL_CALL timed_firstcall (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  return timed_call (pModel, DLL_TIMED_FIRSTCALL);
+}
+
+static int32_T DLL_CALL timed_checkparameters (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  return timed_call (pModel, DLL_TIMED_CHECKPARAMETERS);
+}
+
+static int32_T DLL_CALL timed_initialize (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  return timed_call (pModel, DLL_TIMED_INITIALIZE);
+}
+
+static int32_T DLL_CALL timed_outputs (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  return timed_call (pModel, DLL_TIMED_OUTPUTS);
+}
+
+static int32_T DLL_CALL timed_iterate (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  return timed_call (pModel, DLL_TIMED_ITERATE);
+}
+
+static int32_T DLL_CALL timed_terminate (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  return timed_call (pModel, DLL_TIMED_TERMINATE);
+}
+
+void ResetDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap)
+{
+  DLLModelTiming *pTiming = find_timing (pWrap->pModel);
+  if (NULL != pTiming) {
+    memset (pTiming->entries, 0, sizeof (pTiming->entries));
+    for (int j = 0; j < DLL_NUM_TIMED_ENTRIES; j++) {
+      pTiming->entries[j].MinNanoseconds = UINT64_MAX;
+    }
+  }
+}
+
+void AttachDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap)
+{
+  DLLModelTiming *pTiming = calloc (1, sizeof (DLLModelTiming));
+
+  if (NULL == pTiming) {
+#ifndef ATP_MINGW
+    printf ("AttachDLLModelTiming: out of memory, %s is not timed\n", pWrap->pInfo->ModelName);
+#endif
+    return;
+  }
+  pTiming->pModel = pWrap->pModel;
+  pTiming->ModelName = pWrap->pInfo->ModelName;
+  pTiming->pFunctions[DLL_TIMED_FIRSTCALL] = pWrap->Model_FirstCall;
+  pTiming->pFunctions[DLL_TIMED_CHECKPARAMETERS] = pWrap->Model_CheckParameters;
+  pTiming->pFunctions[DLL_TIMED_INITIALIZE] = pWrap->Model_Initialize;
+  pTiming->pFunctions[DLL_TIMED_OUTPUTS] = pWrap->Model_Outputs;
+  pTiming->pFunctions[DLL_TIMED_ITERATE] = pWrap->Model_Iterate;
+  pTiming->pFunctions[DLL_TIMED_TERMINATE] = pWrap->Model_Terminate;
+  pTiming->Model_OutputsBatch = pWrap->Model_OutputsBatch;
+  DLL_INSTANCE_HEADER (pWrap->pModel)->pTiming = pTiming;
+  ResetDLLModelTiming (pWrap);
+
+  // the optional entry points stay NULL, so hosts still see which ones the model has
+  if (NULL != pWrap->Model_FirstCall) pWrap->Model_FirstCall = timed_firstcall;
+  pWrap->Model_CheckParameters = timed_checkparameters;
+  pWrap->Model_Initialize = timed_initialize;
+  pWrap->Model_Outputs = timed_outputs;
+  if (NULL != pWrap->Model_Iterate) pWrap->Model_Iterate = timed_iterate;
+  pWrap->Model_Terminate = timed_terminate;
+  pWrap->Model_OutputsBatch = NULL;  // so each call to Model_Outputs is timed
+}
+
+DLLModelTiming * GetDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap)
+{
+  return find_timing (pWrap->pModel);
+}
+
+void PrintDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap)
+{
+  DLLModelTiming *pTiming = find_timing (pWrap->pModel);
+  if (NULL == pTiming) {
+    return;
+  }
+  printf ("Timing of %s entry points, in microseconds:\n", pTiming->ModelName);
+  printf ("  %-16s %12s %10s %10s %10s %10s %10s\n", "Entry", "Calls", "Mean", "Min", "p50", "p99", "Max");
+  for (int j = 0; j < DLL_NUM_TIMED_ENTRIES; j++) {
+    const DLLTimingHistogram *pHist = &pTiming->entries[j];
+    if (pHist->NumCalls > 0) {
+      printf ("  %-16s %12llu %10.3f %10.3f %10.3f %10.3f %10.3f\n", entry_names[j],
+              (unsigned long long) pHist->NumCalls,
+              1.0e-3 * (double) pHist->TotalNanoseconds / (double) pHist->NumCalls,
+              1.0e-3 * (double) pHist->MinNanoseconds,
+              1.0e-3 * (double) DLLTimingPercentile (pHist, 50.0),
+              1.0e-3 * (double) DLLTimingPercentile (pHist, 99.0),
+              1.0e-3 * (double) pHist->MaxNanoseconds);
+    }
+  }
+}
+
+void DetachDLLModelTiming (Wrapped_IEEE_Cigre_DLL *pWrap)
+{
+  DLLModelTiming *pTiming = find_timing (pWrap->pModel);
+
+  if (NULL == pTiming) {
+    return;
+  }
+  pWrap->Model_FirstCall = pTiming->pFunctions[DLL_TIMED_FIRSTCALL];
+  pWrap->Model_CheckParameters = pTiming->pFunctions[DLL_TIMED_CHECKPARAMETERS];
+  pWrap->Model_Initialize = pTiming->pFunctions[DLL_TIMED_INITIALIZE];
+  pWrap->Model_Outputs = pTiming->pFunctions[DLL_TIMED_OUTPUTS];
+  pWrap->Model_Iterate = pTiming->pFunctions[DLL_TIMED_ITERATE];
+  pWrap->Model_Terminate = pTiming->pFunctions[DLL_TIMED_TERMINATE];
+  pWrap->Model_OutputsBatch = pTiming->Model_OutputsBatch;
+  DLL_INSTANCE_HEADER (pWrap->pModel)->pTiming = NULL;
+  free (pTiming);
+}
+
+#endif
@@ -0,0 +1,665 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+A trace file is a DLLTraceFileHeader, one DLLTraceFileColumn per column, and then fixed-size
+rows. Each row is the time followed by the traced ports, each at its natural alignment. Ports that
+are adjacent in the instance buffers stay adjacent in the row and are copied as one segment, so a
+full row of doubles costs two memcpy calls and no formatting. Rows collect in a large buffer
+that is written with one fwrite when full. The row count is not stored; readers take it from the
+file size, so a trace cut short by a crash is still readable. dll/bin/dlltrace.py maps the rows
+into numpy without parsing.
+
+With OpenDLLTraceAsync the buffer is one block of a ring. A full block is handed to the writer
+thread by advancing head, and the simulation thread moves on to the next block; the writer thread
+advances tail after each fwrite. Each counter has a single writer, so no locks are needed.
+
+The first fwrite that fails, e.g., on a full disk, latches WriteFailed. Nothing more is written:
+the simulation thread stops collecting rows and the writer thread only retires queued blocks, so
+neither waits on the other. CloseDLLTrace reports the failure.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "IEEE_Cigre_DLLTrace.h"
+
+static void copy_label (char *pDst, size_t n, const char *pSrc)
+{
+  memset (pDst, 0, n);
+  if (NULL != pSrc) {
+    strncpy (pDst, pSrc, n - 1);
+  }
+}
+
+static void set_column (DLLTraceFileColumn *pCol, const char *name, const char *unit,
+                        enum IEEE_Cigre_DLLInterface_DataType dtype, int offset)
+{
+  copy_label (pCol->Name, sizeof (pCol->Name), name);
+  copy_label (pCol->Unit, sizeof (pCol->Unit), unit);
+  pCol->DataType = (uint32_t) dtype;
+  pCol->Offset = (uint32_t) offset;
+}
+
+// fwrite unless an earlier write failed; latches WriteFailed on a short write
+static void write_trace_bytes (DLLTraceWriter *pTrace, const void *pData, size_t nBytes)
+{
+  if (nBytes > 0 && !DLL_ATOMIC_LOAD (&pTrace->WriteFailed) && nBytes != fwrite (pData, 1, nBytes, pTrace->fp)) {
+    DLL_ATOMIC_STORE (&pTrace->WriteFailed, 1);
+  }
+}
+
+static void flush_rows (DLLTraceWriter *pTrace)
+{
+  write_trace_bytes (pTrace, pTrace->pBuffer, pTrace->BufferUsed);
+  pTrace->BufferUsed = 0;
+}
+
+static void trace_writer_main (void *p)
+{
+  DLLTraceWriter *pTrace = (DLLTraceWriter *) p;
+  long spins = 0;
+
+  while (1) {
+    long tail = pTrace->tail;
+    if (tail == DLL_ATOMIC_LOAD (&pTrace->head)) {
+      if (DLL_ATOMIC_LOAD (&pTrace->shutdown) && tail == DLL_ATOMIC_LOAD (&pTrace->head)) {
+        break;
+      }
+      if (++spins > DLL_SPINS_BEFORE_YIELD) {
+        DLLSleepMicroseconds (100);
+      } else {
+        DLLSpinPause (spins);
+      }
+      continue;
+    }
+    spins = 0;
+    int k = (int) (tail % pTrace->NumBlocks);
+    write_trace_bytes (pTrace, pTrace->pRing + k * pTrace->BufferBytes, pTrace->pBlockUsed[k]);
+    DLL_ATOMIC_STORE (&pTrace->tail, tail + 1);
+  }
+}
+
+// the block after the last one queued, or NULL if all are queued and the caller will not wait
+static char *next_ring_block (DLLTraceWriter *pTrace, int bWait)
+{
+  long head = pTrace->head;
+
+  if (head - DLL_ATOMIC_LOAD (&pTrace->tail) >= pTrace->NumBlocks) {
+    if (!bWait) {
+      return NULL;
+    }
+    uint64_t t0 = DLLMonotonicNanoseconds ();
+    long spins = 0;
+    while (head - DLL_ATOMIC_LOAD (&pTrace->tail) >= pTrace->NumBlocks) {
+      DLLSpinPause (++spins);
+    }
+    pTrace->NumStalls += 1;
+    pTrace->StallNanoseconds += DLLMonotonicNanoseconds () - t0;
+  }
+  return pTrace->pRing + (head % pTrace->NumBlocks) * pTrace->BufferBytes;
+}
+
+static void queue_ring_block (DLLTraceWriter *pTrace)
+{
+  long head = pTrace->head;
+
+  pTrace->pBlockUsed[head % pTrace->NumBlocks] = pTrace->BufferUsed;
+  DLL_ATOMIC_STORE (&pTrace->head, head + 1);
+  long queued = head + 1 - DLL_ATOMIC_LOAD (&pTrace->tail);
+  if (queued > pTrace->MaxQueued) {
+    pTrace->MaxQueued = queued;
+  }
+  pTrace->BufferUsed = 0;
+  pTrace->pBuffer = NULL;
+}
+
+static void free_trace_writer (DLLTraceWriter *pTrace)
+{
+  free (pTrace->pColumns);
+  free (pTrace->pSegments);
+  if (NULL != pTrace->pRing) {
+    free (pTrace->pRing);
+    free (pTrace->pBlockUsed);
+  } else {
+    free (pTrace->pBuffer);
+  }
+  free (pTrace);
+}
+
+// closes the file of a writer that ran out of memory before its first row, and frees it
+static DLLTraceWriter *discard_trace_writer (DLLTraceWriter *pTrace, const char *file_name)
+{
+  printf ("OpenDLLTrace: out of memory for %s\n", file_name);
+  fclose (pTrace->fp);
+  free_trace_writer (pTrace);
+  return NULL;
+}
+
+// opens the file and fills in the header, with column 0 for t; the caller adds the other columns
+static DLLTraceWriter *create_trace_writer (const char *file_name, const IEEE_Cigre_DLLInterface_Model_Info *pInfo,
+                                            int MaxColumns)
+{
+  FILE *fp = fopen (file_name, "wb");
+  DLLTraceWriter *pTrace;
+
+  if (NULL == fp) {
+    printf ("OpenDLLTrace: cannot create %s\n", file_name);
+    return NULL;
+  }
+  setvbuf (fp, NULL, _IONBF, 0);  // the writer does its own buffering
+  pTrace = calloc (1, sizeof (*pTrace));
+  if (NULL == pTrace) {
+    printf ("OpenDLLTrace: out of memory for %s\n", file_name);
+    fclose (fp);
+    return NULL;
+  }
+  pTrace->fp = fp;
+  memcpy (pTrace->header.Magic, DLL_TRACE_MAGIC, sizeof (pTrace->header.Magic));
+  pTrace->header.Version = DLL_TRACE_VERSION;
+  pTrace->header.NumColumns = 1;
+  pTrace->header.RowBytes = (uint32_t) sizeof (real64_T);
+  pTrace->header.TimeStep = pInfo->FixedStepBaseSampleTime;
+  copy_label (pTrace->header.ModelName, sizeof (pTrace->header.ModelName), pInfo->ModelName);
+  pTrace->pColumns = calloc (MaxColumns, sizeof (DLLTraceFileColumn));
+  pTrace->pSegments = calloc (MaxColumns, sizeof (DLLTraceSegment));
+  if (NULL == pTrace->pColumns || NULL == pTrace->pSegments) {
+    return discard_trace_writer (pTrace, file_name);
+  }
+  set_column (&pTrace->pColumns[0], "t", "s", IEEE_Cigre_DLLInterface_DataType_real64_T, 0);
+  return pTrace;
+}
+
+// appends one port at the next naturally aligned row offset, extending the last segment when
+// both the port and its row position follow on from it
+static void add_trace_column (DLLTraceWriter *pTrace, const IEEE_Cigre_DLLInterface_Signal *pSignal,
+                              ArrayMap map, void **ppBase)
+{
+  int offset = ((int) pTrace->header.RowBytes + map.size - 1) / map.size * map.size;
+  DLLTraceSegment *pLast = pTrace->NumSegments > 0 ? &pTrace->pSegments[pTrace->NumSegments - 1] : NULL;
+
+  set_column (&pTrace->pColumns[pTrace->header.NumColumns++], pSignal->Name, pSignal->Unit, map.dtype, offset);
+  if (NULL != pLast && pLast->ppBase == ppBase && pLast->SrcOffset + pLast->nBytes == map.offset &&
+      pLast->DstOffset + pLast->nBytes == offset) {
+    pLast->nBytes += map.size;
+  } else {
+    DLLTraceSegment seg = {ppBase, map.offset, offset, map.size};
+    pTrace->pSegments[pTrace->NumSegments++] = seg;
+  }
+  pTrace->header.RowBytes = (uint32_t) (offset + map.size);
+}
+
+// pads the row to 8 bytes, allocates the buffer and writes the header; returns 0 if out of memory
+static int start_trace_rows (DLLTraceWriter *pTrace, size_t BufferBytes)
+{
+  pTrace->header.RowBytes = (pTrace->header.RowBytes + 7) & ~7u;
+  pTrace->header.HeaderBytes = (uint32_t) (sizeof (DLLTraceFileHeader) + pTrace->header.NumColumns * sizeof (DLLTraceFileColumn));
+  if (BufferBytes < 1) {
+    BufferBytes = DLL_TRACE_BUFFER_BYTES;
+  }
+  if (BufferBytes < pTrace->header.RowBytes) {
+    BufferBytes = pTrace->header.RowBytes;
+  }
+  pTrace->BufferBytes = BufferBytes;
+  pTrace->pBuffer = calloc (1, BufferBytes);  // zeroed, so the padding between columns is deterministic
+  if (NULL == pTrace->pBuffer) {
+    return 0;
+  }
+  write_trace_bytes (pTrace, &pTrace->header, sizeof (DLLTraceFileHeader));
+  write_trace_bytes (pTrace, pTrace->pColumns, pTrace->header.NumColumns * sizeof (DLLTraceFileColumn));
+  return 1;
+}
+
+// returns 0 if out of memory for the ring, leaving the writer as it was
+static int start_writer_thread (DLLTraceWriter *pTrace, const char *file_name, int NumBlocks, int bDropWhenFull)
+{
+  if (NumBlocks < 2) {
+    NumBlocks = DLL_TRACE_RING_BLOCKS;
+  }
+  char *pRing = calloc (NumBlocks, pTrace->BufferBytes);
+  size_t *pBlockUsed = calloc (NumBlocks, sizeof (size_t));
+  if (NULL == pRing || NULL == pBlockUsed) {
+    free (pRing);
+    free (pBlockUsed);
+    return 0;
+  }
+  free (pTrace->pBuffer);
+  pTrace->NumBlocks = NumBlocks;
+  pTrace->bDropWhenFull = bDropWhenFull;
+  pTrace->pRing = pRing;
+  pTrace->pBlockUsed = pBlockUsed;
+  pTrace->pBuffer = pTrace->pRing;
+  pTrace->bAsync = StartDLLThread (&pTrace->thread, trace_writer_main, pTrace);
+  if (!pTrace->bAsync) {
+    printf ("OpenDLLTraceAsync: no writer thread, writing %s from the simulation thread\n", file_name);
+  }
+  return 1;
+}
+
+DLLTraceWriter * OpenDLLTrace (const char *file_name, Wrapped_IEEE_Cigre_DLL *pWrap, size_t BufferBytes)
+{
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo = pWrap->pInfo;
+  DLLTraceWriter *pTrace = create_trace_writer (file_name, pInfo, 1 + pInfo->NumInputPorts + pInfo->NumOutputPorts);
+
+  if (NULL == pTrace) {
+    return NULL;
+  }
+  for (int i = 0; i < pInfo->NumInputPorts; i++) {
+    add_trace_column (pTrace, &pInfo->InputPortsInfo[i], pWrap->pInputMap[i], &pWrap->pModel->ExternalInputs);
+  }
+  for (int i = 0; i < pInfo->NumOutputPorts; i++) {
+    add_trace_column (pTrace, &pInfo->OutputPortsInfo[i], pWrap->pOutputMap[i], &pWrap->pModel->ExternalOutputs);
+  }
+  if (!start_trace_rows (pTrace, BufferBytes)) {
+    return discard_trace_writer (pTrace, file_name);
+  }
+  return pTrace;
+}
+
+DLLTraceWriter * OpenDLLTraceAsync (const char *file_name, Wrapped_IEEE_Cigre_DLL *pWrap, size_t BlockBytes,
+                                    int NumBlocks, int bDropWhenFull)
+{
+  DLLTraceWriter *pTrace = OpenDLLTrace (file_name, pWrap, BlockBytes);
+
+  if (NULL != pTrace && !start_writer_thread (pTrace, file_name, NumBlocks, bDropWhenFull)) {
+    return discard_trace_writer (pTrace, file_name);
+  }
+  return pTrace;
+}
+
+// space for the next row in the buffer, or NULL if the row is dropped
+static char *reserve_trace_row (DLLTraceWriter *pTrace)
+{
+  if (DLL_ATOMIC_LOAD (&pTrace->WriteFailed)) {
+    pTrace->NumDropped += 1;
+    return NULL;
+  }
+  if (pTrace->BufferUsed + pTrace->header.RowBytes > pTrace->BufferBytes) {
+    if (pTrace->bAsync) {
+      queue_ring_block (pTrace);
+    } else {
+      flush_rows (pTrace);
+    }
+  }
+  if (NULL == pTrace->pBuffer) {
+    pTrace->pBuffer = next_ring_block (pTrace, !pTrace->bDropWhenFull);
+    if (NULL == pTrace->pBuffer) {
+      pTrace->NumDropped += 1;
+      return NULL;
+    }
+  }
+  char *pRow = pTrace->pBuffer + pTrace->BufferUsed;
+  pTrace->BufferUsed += pTrace->header.RowBytes;
+  pTrace->NumRows += 1;
+  return pRow;
+}
+
+static void assemble_trace_row (DLLTraceWriter *pTrace, char *pRow, double t)
+{
+  memcpy (pRow, &t, sizeof (real64_T));
+  for (int i = 0; i < pTrace->NumSegments; i++) {
+    DLLTraceSegment *pSeg = &pTrace->pSegments[i];
+    memcpy (pRow + pSeg->DstOffset, (const char *) *pSeg->ppBase + pSeg->SrcOffset, pSeg->nBytes);
+  }
+}
+
+void WriteDLLTraceRow (DLLTraceWriter *pTrace, double t)
+{
+  char *pRow = reserve_trace_row (pTrace);
+  if (NULL != pRow) {
+    assemble_trace_row (pTrace, pRow, t);
+  }
+}
+
+int CloseDLLTrace (DLLTraceWriter *pTrace)
+{
+  if (pTrace->bAsync) {
+    if (pTrace->BufferUsed > 0) {
+      queue_ring_block (pTrace);
+    }
+    DLL_ATOMIC_STORE (&pTrace->shutdown, 1);
+    JoinDLLThread (pTrace->thread);
+  } else {
+    flush_rows (pTrace);
+  }
+  if (0 != fclose (pTrace->fp)) {
+    DLL_ATOMIC_STORE (&pTrace->WriteFailed, 1);
+  }
+  int bFailed = (int) DLL_ATOMIC_LOAD (&pTrace->WriteFailed);
+  if (bFailed) {
+    printf ("CloseDLLTrace: a write to the %s trace failed; the file ends early and %lld later rows were dropped\n",
+            pTrace->header.ModelName, pTrace->NumDropped);
+  }
+  free_trace_writer (pTrace);
+  return bFailed ? -1 : 0;
+}
+
+void PrintDLLTraceStats (DLLTraceWriter *pTrace)
+{
+  printf ("DLL trace: %lld rows of %u bytes", pTrace->NumRows, pTrace->header.RowBytes);
+  if (NULL != pTrace->pRing) {
+    printf (", %lld dropped, %ld stalls for %.3f ms, at most %ld of %d blocks queued",
+            pTrace->NumDropped, pTrace->NumStalls, 1.0e-6 * pTrace->StallNanoseconds,
+            pTrace->MaxQueued, pTrace->NumBlocks);
+  }
+  printf ("\n");
+}
+
+long long ExportDLLTraceCSV (const char *trace_name, const char *csv_name)
+{
+  DLLTraceFileHeader header;
+  DLLTraceFileColumn *pColumns;
+  FILE *fp = fopen (trace_name, "rb");
+  FILE *fcsv;
+  long long nRows = 0;
+
+  if (NULL == fp) {
+    printf ("ExportDLLTraceCSV: cannot open %s\n", trace_name);
+    return -1;
+  }
+  if (1 != fread (&header, sizeof (header), 1, fp) || 0 != memcmp (header.Magic, DLL_TRACE_MAGIC, sizeof (header.Magic))) {
+    printf ("ExportDLLTraceCSV: %s is not a DLL trace file\n", trace_name);
+    fclose (fp);
+    return -1;
+  }
+  pColumns = malloc (header.NumColumns * sizeof (DLLTraceFileColumn));
+  if (NULL == pColumns || header.NumColumns != fread (pColumns, sizeof (DLLTraceFileColumn), header.NumColumns, fp) ||
+      0 != fseek (fp, header.HeaderBytes, SEEK_SET)) {
+    printf ("ExportDLLTraceCSV: %s is truncated in its column table\n", trace_name);
+    free (pColumns);
+    fclose (fp);
+    return -1;
+  }
+  fcsv = fopen (csv_name, "w");
+  if (NULL == fcsv) {
+    printf ("ExportDLLTraceCSV: cannot create %s\n", csv_name);
+    free (pColumns);
+    fclose (fp);
+    return -1;
+  }
+  // c_string columns hold the writer's pointer, which means nothing in the file
+  for (uint32_t j = 0; j < header.NumColumns; j++) {
+    if (IEEE_Cigre_DLLInterface_DataType_c_string_T != pColumns[j].DataType) {
+      fprintf (fcsv, j > 0 ? ",%s" : "%s", pColumns[j].Name);
+    }
+  }
+  fprintf (fcsv, "\n");
+  char *pRow = malloc (header.RowBytes > 0 ? header.RowBytes : 1);
+  // a row cut short by a crash is not read, so every row written is whole
+  while (NULL != pRow && header.RowBytes > 0 && 1 == fread (pRow, header.RowBytes, 1, fp)) {
+    for (uint32_t j = 0; j < header.NumColumns; j++) {
+      if (IEEE_Cigre_DLLInterface_DataType_c_string_T != pColumns[j].DataType) {
+        fprintf (fcsv, j > 0 ? ",%g" : "%g",
+                 read_dll_real64 (pRow + pColumns[j].Offset, (enum IEEE_Cigre_DLLInterface_DataType) pColumns[j].DataType));
+      }
+    }
+    fprintf (fcsv, "\n");
+    nRows += 1;
+  }
+  free (pRow);
+  free (pColumns);
+  fclose (fcsv);
+  fclose (fp);
+  return nRows;
+}
+
+// <stem><suffix><ext>, where ext is the file extension of file_name if it has one; NULL if out of memory
+static char *derived_file_name (const char *file_name, const char *suffix)
+{
+  const char *pDot = strrchr (file_name, '.');
+  const char *pSlash = strrchr (file_name, '/');
+  const char *pBack = strrchr (file_name, '\\');
+  size_t stem;
+  char *pName = malloc (strlen (file_name) + strlen (suffix) + 1);
+
+  if (NULL == pName) {
+    return NULL;
+  }
+  if (NULL == pDot || (NULL != pSlash && pSlash > pDot) || (NULL != pBack && pBack > pDot)) {
+    pDot = file_name + strlen (file_name);
+  }
+  stem = (size_t) (pDot - file_name);
+  memcpy (pName, file_name, stem);
+  strcpy (pName + stem, suffix);
+  strcat (pName, pDot);
+  return pName;
+}
+
+static int find_trace_port (Wrapped_IEEE_Cigre_DLL *pWrap, const char *name, const IEEE_Cigre_DLLInterface_Signal **ppSignal,
+                            ArrayMap *pMap, void ***pppBase)
+{
+  DLLPortHandle h = GetInputHandle (pWrap, name);
+  if (h.index >= 0) {
+    *ppSignal = &pWrap->pInfo->InputPortsInfo[h.index];
+    *pMap = pWrap->pInputMap[h.index];
+    *pppBase = &pWrap->pModel->ExternalInputs;
+    return 1;
+  }
+  h = GetOutputHandle (pWrap, name);
+  if (h.index >= 0) {
+    *ppSignal = &pWrap->pInfo->OutputPortsInfo[h.index];
+    *pMap = pWrap->pOutputMap[h.index];
+    *pppBase = &pWrap->pModel->ExternalOutputs;
+    return 1;
+  }
+  return 0;
+}
+
+// a trace file holding the selected channels whose decimation is Decimation, or all of them if 0
+static DLLTraceWriter *open_channel_file (const char *file_name, Wrapped_IEEE_Cigre_DLL *pWrap,
+                                          const DLLTraceChannel *pChannels, int NumChannels, int Decimation, int bAsync)
+{
+  DLLTraceWriter *pTrace = create_trace_writer (file_name, pWrap->pInfo, 1 + NumChannels);
+  const IEEE_Cigre_DLLInterface_Signal *pSignal;
+  ArrayMap map;
+  void **ppBase;
+
+  if (NULL == pTrace) {
+    return NULL;
+  }
+  if (Decimation > 1) {  // so readers get the time between rows
+    pTrace->header.TimeStep *= Decimation;
+  }
+  for (int i = 0; i < NumChannels; i++) {
+    if ((0 == Decimation || pChannels[i].Decimation == Decimation) &&
+        find_trace_port (pWrap, pChannels[i].Name, &pSignal, &map, &ppBase)) {
+      add_trace_column (pTrace, pSignal, map, ppBase);
+    }
+  }
+  if (!start_trace_rows (pTrace, 0) || (bAsync && !start_writer_thread (pTrace, file_name, 0, 0))) {
+    return discard_trace_writer (pTrace, file_name);
+  }
+  return pTrace;
+}
+
+// closes the files opened so far for a set that could not be completed, and frees it
+static DLLTraceSet *discard_trace_set (DLLTraceSet *pSet, DLLTraceChannel *pChannels, const char *file_name)
+{
+  printf ("OpenDLLTraceSet: could not open every file for %s\n", file_name);
+  free (pChannels);
+  CloseDLLTraceSet (pSet);
+  return NULL;
+}
+
+DLLTraceSet * OpenDLLTraceSet (const char *file_name, Wrapped_IEEE_Cigre_DLL *pWrap, const DLLTracePolicy *pPolicy)
+{
+  const IEEE_Cigre_DLLInterface_Model_Info *pInfo = pWrap->pInfo;
+  DLLTraceSet *pSet = calloc (1, sizeof (*pSet));
+  int n = pPolicy->NumChannels;
+  DLLTraceChannel *pChannels;
+  const IEEE_Cigre_DLLInterface_Signal *pSignal;
+  ArrayMap map;
+  void **ppBase;
+
+  if (NULL == pSet) {
+    printf ("OpenDLLTraceSet: out of memory for %s\n", file_name);
+    return NULL;
+  }
+  pSet->policy = *pPolicy;
+  if (n < 1) {  // every port at every step
+    n = pInfo->NumInputPorts + pInfo->NumOutputPorts;
+    pChannels = malloc ((n > 0 ? n : 1) * sizeof (DLLTraceChannel));
+    if (NULL == pChannels) {
+      return discard_trace_set (pSet, NULL, file_name);
+    }
+    for (int i = 0; i < pInfo->NumInputPorts; i++) {
+      pChannels[i].Name = pInfo->InputPortsInfo[i].Name;
+      pChannels[i].Decimation = 1;
+    }
+    for (int i = 0; i < pInfo->NumOutputPorts; i++) {
+      pChannels[pInfo->NumInputPorts + i].Name = pInfo->OutputPortsInfo[i].Name;
+      pChannels[pInfo->NumInputPorts + i].Decimation = 1;
+    }
+  } else {
+    pChannels = malloc (n * sizeof (DLLTraceChannel));
+    if (NULL == pChannels) {
+      return discard_trace_set (pSet, NULL, file_name);
+    }
+    for (int i = 0; i < n; i++) {
+      pChannels[i] = pPolicy->pChannels[i];
+      if (pChannels[i].Decimation < 2) {
+        pChannels[i].Decimation = 1;
+      }
+      if (!find_trace_port (pWrap, pChannels[i].Name, &pSignal, &map, &ppBase)) {
+        printf ("OpenDLLTraceSet: %s has no port named %s\n", pInfo->ModelName, pChannels[i].Name);
+      }
+    }
+  }
+
+  pSet->ppGroups = calloc (n > 0 ? n : 1, sizeof (DLLTraceWriter *));
+  pSet->pDecimation = calloc (n > 0 ? n : 1, sizeof (int));
+  if (NULL == pSet->ppGroups || NULL == pSet->pDecimation) {
+    return discard_trace_set (pSet, pChannels, file_name);
+  }
+  for (int i = 0; i < n; i++) {
+    int bNew = 1;
+    for (int g = 0; g < pSet->NumGroups; g++) {
+      if (pSet->pDecimation[g] == pChannels[i].Decimation) {
+        bNew = 0;
+      }
+    }
+    if (bNew) {
+      char suffix[32];
+      char *pName;
+      snprintf (suffix, sizeof (suffix), "_d%d", pChannels[i].Decimation);
+      pName = pChannels[i].Decimation > 1 ? derived_file_name (file_name, suffix) : NULL;
+      if (pChannels[i].Decimation > 1 && NULL == pName) {
+        return discard_trace_set (pSet, pChannels, file_name);
+      }
+      pSet->ppGroups[pSet->NumGroups] = open_channel_file (NULL != pName ? pName : file_name, pWrap, pChannels, n,
+                                                           pChannels[i].Decimation, pPolicy->bAsync);
+      free (pName);
+      if (NULL == pSet->ppGroups[pSet->NumGroups]) {
+        return discard_trace_set (pSet, pChannels, file_name);
+      }
+      pSet->pDecimation[pSet->NumGroups++] = pChannels[i].Decimation;
+    }
+  }
+
+  if (NULL != pPolicy->TriggerName) {
+    if (find_trace_port (pWrap, pPolicy->TriggerName, &pSignal, &pSet->TriggerMap, &pSet->ppTriggerBase)) {
+      char *pName = derived_file_name (file_name, "_trig");
+      pSet->pWindows = NULL != pName ? open_channel_file (pName, pWrap, pChannels, n, 0, pPolicy->bAsync) : NULL;
+      free (pName);
+      if (NULL == pSet->pWindows) {
+        return discard_trace_set (pSet, pChannels, file_name);
+      }
+    } else {
+      printf ("OpenDLLTraceSet: %s has no trigger port named %s\n", pInfo->ModelName, pPolicy->TriggerName);
+    }
+    if (NULL != pSet->pWindows && pPolicy->PreTriggerSteps > 0) {
+      pSet->pPreRows = calloc (pPolicy->PreTriggerSteps, pSet->pWindows->header.RowBytes);
+      if (NULL == pSet->pPreRows) {
+        return discard_trace_set (pSet, pChannels, file_name);
+      }
+    }
+  }
+  free (pChannels);
+  return pSet;
+}
+
+static void check_trigger (DLLTraceSet *pSet, double t)
+{
+  DLLTraceWriter *pWin = pSet->pWindows;
+  int nPre = pSet->policy.PreTriggerSteps;
+  double level = pSet->policy.TriggerLevel;
+  double val = read_dll_real64 ((const char *) *pSet->ppTriggerBase + pSet->TriggerMap.offset, pSet->TriggerMap.dtype);
+  int bFired = 0;
+
+  if (pSet->NumSteps > 0) {
+    if (DLL_TRACE_FALLING == pSet->policy.TriggerEdge) {
+      bFired = pSet->LastTriggerValue >= level && val < level;
+    } else {
+      bFired = pSet->LastTriggerValue <= level && val > level;
+    }
+  }
+  pSet->LastTriggerValue = val;
+  if (bFired) {
+    pSet->NumTriggers += 1;
+    if (0 == pSet->PostLeft) {  // a new window starts with the rows kept before the trigger
+      for (int k = 0; k < pSet->PreCount; k++) {
+        const char *pSrc = pSet->pPreRows + (size_t) ((pSet->PreNext - pSet->PreCount + k + nPre) % nPre) * pWin->header.RowBytes;
+        char *pRow = reserve_trace_row (pWin);
+        if (NULL != pRow) {
+          memcpy (pRow, pSrc, pWin->header.RowBytes);
+        }
+      }
+      pSet->PreCount = 0;
+    }
+    pSet->PostLeft = (long long) pSet->policy.PostTriggerSteps + 1;  // this step, then the post-trigger steps
+  }
+  if (pSet->PostLeft > 0) {
+    WriteDLLTraceRow (pWin, t);
+    pSet->PostLeft -= 1;
+  } else if (nPre > 0) {
+    assemble_trace_row (pWin, pSet->pPreRows + (size_t) pSet->PreNext * pWin->header.RowBytes, t);
+    pSet->PreNext = (pSet->PreNext + 1) % nPre;
+    if (pSet->PreCount < nPre) {
+      pSet->PreCount += 1;
+    }
+  }
+}
+
+void WriteDLLTraceSet (DLLTraceSet *pSet, double t)
+{
+  for (int g = 0; g < pSet->NumGroups; g++) {
+    if (0 == pSet->NumSteps % pSet->pDecimation[g]) {
+      WriteDLLTraceRow (pSet->ppGroups[g], t);
+    }
+  }
+  if (NULL != pSet->pWindows) {
+    check_trigger (pSet, t);
+  }
+  pSet->NumSteps += 1;
+}
+
+void PrintDLLTraceSetStats (DLLTraceSet *pSet)
+{
+  for (int g = 0; g < pSet->NumGroups; g++) {
+    printf ("  decimation %d, %u columns: ", pSet->pDecimation[g], pSet->ppGroups[g]->header.NumColumns);
+    PrintDLLTraceStats (pSet->ppGroups[g]);
+  }
+  if (NULL != pSet->pWindows) {
+    printf ("  %ld triggers on %s: ", pSet->NumTriggers, pSet->policy.TriggerName);
+    PrintDLLTraceStats (pSet->pWindows);
+  }
+}
+
+int CloseDLLTraceSet (DLLTraceSet *pSet)
+{
+  int rc = 0;
+
+  for (int g = 0; g < pSet->NumGroups; g++) {
+    if (0 != CloseDLLTrace (pSet->ppGroups[g])) {
+      rc = -1;
+    }
+  }
+  if (NULL != pSet->pWindows && 0 != CloseDLLTrace (pSet->pWindows)) {
+    rc = -1;
+  }
+  free (pSet->ppGroups);
+  free (pSet->pDecimation);
+  free (pSet->pPreRows);
+  free (pSet);
+  return rc;
+}
@@ -1,6 +1,7 @@
 // Copyright (C) 2024-26 Meltran, Inc
 
 // see https://learn.microsoft.com/en-us/windows/win32/dlls/using-run-time-dynamic-linking
+// and https://man7.org/linux/man-pages/man3/dlopen.3.html
  
 #ifdef ATP_MINGW
 #undef RC_INVOKED
@@ -15,12 +16,17 @@
 #include <windows.h>
 #include <stdlib.h>
 #include <stddef.h>
-#else
+#elif defined(_WIN32)
 #include <windows.h>
 #include <stdio.h> 
+#else
+#include <dlfcn.h>
+#include <stdio.h> 
+#include <stddef.h>
 #endif
 
 #include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLTiming.h"
  
 struct MyCharPtrStruct {
   char_T c;
@@ -63,9 +69,47 @@ void show_struct_alignment_requirements () {
 #endif
 }
 
-DLL_MODEL_FCN LoadModelFunction (HINSTANCE hLib, char *name, char *dll_name)
+DLL_HANDLE OpenModelLibrary (const char *dll_name)
 {
-  DLL_MODEL_FCN fcn = (DLL_MODEL_FCN) GetProcAddress (hLib, name);
+#if defined(_WIN32)
+  return LoadLibrary (TEXT(dll_name));
+#else
+  // resolve all symbols now, so a missing dependency fails here instead of during time stepping
+  DLL_HANDLE hLib = dlopen (dll_name, RTLD_NOW | RTLD_LOCAL);
+  if (NULL == hLib && NULL == strchr (dll_name, '/')) {
+    // dlopen does not search the working directory, but LoadLibrary does
+    char local_name[1024];
+    snprintf (local_name, sizeof (local_name), "./%s", dll_name);
+    hLib = dlopen (local_name, RTLD_NOW | RTLD_LOCAL);
+  }
+  if (NULL == hLib) {
+    printf ("dlopen: %s\n", dlerror ());
+  }
+  return hLib;
+#endif
+}
+
+void *FindModelSymbol (DLL_HANDLE hLib, const char *name)
+{
+#if defined(_WIN32)
+  return (void *) GetProcAddress (hLib, name);
+#else
+  return dlsym (hLib, name);
+#endif
+}
+
+void CloseModelLibrary (DLL_HANDLE hLib)
+{
+#if defined(_WIN32)
+  FreeLibrary (hLib);
+#else
+  dlclose (hLib);
+#endif
+}
+
+DLL_MODEL_FCN LoadModelFunction (DLL_HANDLE hLib, char *name, char *dll_name)
+{
+  DLL_MODEL_FCN fcn = (DLL_MODEL_FCN) FindModelSymbol (hLib, name);
 #ifndef ATP_MINGW
   if (NULL == fcn) {
     printf("Failed to load %s from %s\n", name, dll_name);
@@ -146,6 +190,65 @@ void edit_dll_value (char *pVals, int offset, enum IEEE_Cigre_DLLInterface_DataT
   if (dtype == IEEE_Cigre_DLLInterface_DataType_c_string_T) memcpy (pVals+offset, &val.Char_Ptr, dsize);
 }
 
+int assign_dll_value (Wrapped_IEEE_Cigre_DLL *pWrap, char *assignment, int bInput)
+{
+  char *pEq = strchr (assignment, '=');
+  DLLPortHandle h;
+  char *pBase;
+
+  if (NULL == pEq) {
+    printf ("%s should be name=value\n", assignment);
+    return 0;
+  }
+  *pEq = '\0';
+  h = bInput ? GetInputHandle (pWrap, assignment) : GetParameterHandle (pWrap, assignment);
+  pBase = (char *) (bInput ? pWrap->pModel->ExternalInputs : pWrap->pModel->Parameters);
+  if (h.index < 0) {
+    printf ("%s has no %s named %s\n", pWrap->pInfo->ModelName, bInput ? "input" : "parameter", assignment);
+    return 0;
+  }
+  if (IEEE_Cigre_DLLInterface_DataType_c_string_T == h.dtype) {
+    union EditValueU val;
+    val.Char_Ptr = pEq + 1;  // the string is not copied
+    edit_dll_value (pBase, h.offset, h.dtype, h.size, val);
+  } else {
+    write_dll_real64 (pBase + h.offset, h.dtype, atof (pEq + 1));
+  }
+  return 1;
+}
+
+void write_dll_real64 (char *p, enum IEEE_Cigre_DLLInterface_DataType dtype, double x)
+{
+  switch (dtype) {
+    case IEEE_Cigre_DLLInterface_DataType_char_T: *(char_T *) p = (char_T) x; break;
+    case IEEE_Cigre_DLLInterface_DataType_int8_T: *(int8_T *) p = (int8_T) x; break;
+    case IEEE_Cigre_DLLInterface_DataType_uint8_T: *(uint8_T *) p = (uint8_T) x; break;
+    case IEEE_Cigre_DLLInterface_DataType_int16_T: *(int16_T *) p = (int16_T) x; break;
+    case IEEE_Cigre_DLLInterface_DataType_uint16_T: *(uint16_T *) p = (uint16_T) x; break;
+    case IEEE_Cigre_DLLInterface_DataType_int32_T: *(int32_T *) p = (int32_T) x; break;
+    case IEEE_Cigre_DLLInterface_DataType_uint32_T: *(uint32_T *) p = (uint32_T) x; break;
+    case IEEE_Cigre_DLLInterface_DataType_real32_T: *(real32_T *) p = (real32_T) x; break;
+    case IEEE_Cigre_DLLInterface_DataType_real64_T: *(real64_T *) p = x; break;
+    default: break;
+  }
+}
+
+double read_dll_real64 (const char *p, enum IEEE_Cigre_DLLInterface_DataType dtype)
+{
+  switch (dtype) {
+    case IEEE_Cigre_DLLInterface_DataType_char_T: return (double) *(const char_T *) p;
+    case IEEE_Cigre_DLLInterface_DataType_int8_T: return (double) *(const int8_T *) p;
+    case IEEE_Cigre_DLLInterface_DataType_uint8_T: return (double) *(const uint8_T *) p;
+    case IEEE_Cigre_DLLInterface_DataType_int16_T: return (double) *(const int16_T *) p;
+    case IEEE_Cigre_DLLInterface_DataType_uint16_T: return (double) *(const uint16_T *) p;
+    case IEEE_Cigre_DLLInterface_DataType_int32_T: return (double) *(const int32_T *) p;
+    case IEEE_Cigre_DLLInterface_DataType_uint32_T: return (double) *(const uint32_T *) p;
+    case IEEE_Cigre_DLLInterface_DataType_real32_T: return (double) *(const real32_T *) p;
+    case IEEE_Cigre_DLLInterface_DataType_real64_T: return *(const real64_T *) p;
+    default: return 0.0;
+  }
+}
+
 int get_next_struct_offset (int offset, int dsize, size_t align)
 {
   offset += 1;
@@ -157,146 +260,358 @@ int get_next_struct_offset (int offset, int dsize, size_t align)
   return offset;
 }
 
-IEEE_Cigre_DLLInterface_Instance* CreateModelInstance (const IEEE_Cigre_DLLInterface_Model_Info *pInfo,
-                                                       ArrayMap **pParameterMap,
-                                                       ArrayMap **pInputMap,
-                                                       ArrayMap **pOutputMap)
+size_t get_struct_alignment (const enum IEEE_Cigre_DLLInterface_DataType *pTypes, int n)
 {
-  int i, input_size, output_size, parm_size, dsize;
-  ArrayMap *pTest;
+  size_t struct_align = 0;
+  for (int i = 0; i < n; i++) {
+    size_t this_align = get_alignment_requirement (pTypes[i]);
+    if (this_align > struct_align) {
+      struct_align = this_align;
+    }
+  }
+  return struct_align;
+}
 
+// fills pMap for n values of the given types, packed as the model's C struct would be; returns the total size
+int layout_array_map (ArrayMap *pMap, const enum IEEE_Cigre_DLLInterface_DataType *pTypes, int n, const char *label)
+{
+  size_t struct_align = get_struct_alignment (pTypes, n);
+  int total_size = 0;
 #ifndef ATP_MINGW
-  printf("creating pModel on %s [%d,%d,%d]\n", pInfo->ModelName, pInfo->NumInputPorts, pInfo->NumOutputPorts, pInfo->NumParameters);
+  printf("  %s Struct Alignment Requirement = %zu\n", label, struct_align);
+#endif
+  for (int i = 0; i < n; i++) {
+    int dsize = get_datatype_size (pTypes[i]);
+    pMap[i].size = dsize;
+    pMap[i].offset = total_size;
+    pMap[i].dtype = pTypes[i];
+    total_size = get_next_struct_offset (total_size, dsize, struct_align);
+  }
+  return total_size;
+}
+
+void *aligned_block_alloc (size_t size)
+{
+#if defined(_WIN32)
+  return _aligned_malloc (size, DLL_INSTANCE_ALIGNMENT);
+#else
+  void *pBlock = NULL;
+  if (0 != posix_memalign (&pBlock, DLL_INSTANCE_ALIGNMENT, size)) {
+    return NULL;
+  }
+  return pBlock;
+#endif
+}
+
+void aligned_block_free (void *pBlock)
+{
+#if defined(_WIN32)
+  _aligned_free (pBlock);
+#else
+  free (pBlock);
 #endif
-  IEEE_Cigre_DLLInterface_Instance *pModel = malloc (sizeof *pModel);
-  pModel->Time = 0.0;
-  // allocate memory
-  pModel->IntStates = NULL;
-  pModel->FloatStates = NULL;
-  pModel->DoubleStates = NULL;
-  pModel->ExternalInputs = NULL;
-  pModel->ExternalOutputs = NULL;
-  pModel->Parameters = NULL;
+}
+
+size_t round_up_size (size_t size, size_t align)
+{
+  return (size + align - 1) / align * align;
+}
+
+// one instance block holds the DLLInstanceHeader, then its buffers hot-first: 
+//   ExternalInputs, ExternalOutputs, DoubleStates, FloatStates, IntStates, Parameters
+size_t get_instance_block_size (const IEEE_Cigre_DLLInterface_Model_Info *pInfo, const DLLModelLayout *pLayout)
+{
+  size_t size = round_up_size (sizeof (DLLInstanceHeader), sizeof (real64_T));
+  size += round_up_size (pLayout->InputSize, sizeof (real64_T));
+  size += round_up_size (pLayout->OutputSize, sizeof (real64_T));
+  size += round_up_size (pInfo->NumDoubleStates * sizeof (real64_T), sizeof (real64_T));
+  size += round_up_size (pInfo->NumFloatStates * sizeof (real32_T), sizeof (real64_T));
+  size += round_up_size (pInfo->NumIntStates * sizeof (int32_T), sizeof (real64_T));
+  size += round_up_size (pLayout->ParameterSize, sizeof (real64_T));
+  // a whole number of cache lines, so instances packed in a DLLInstanceArena never share a line
+  return round_up_size (size, DLL_INSTANCE_ALIGNMENT);
+}
+
+int ComputeModelLayout (const IEEE_Cigre_DLLInterface_Model_Info *pInfo, DLLModelLayout *pLayout)
+{
+  int i, n;
+  enum IEEE_Cigre_DLLInterface_DataType *pTypes;
+
+  pLayout->pParameterMap = NULL;
+  pLayout->pInputMap = NULL;
+  pLayout->pOutputMap = NULL;
+  pLayout->ParameterSize = 0;
+  pLayout->InputSize = 0;
+  pLayout->OutputSize = 0;
+  pLayout->pDefaultParameters = NULL;
+  pLayout->bArena = 1;
+  pLayout->SimMode = 1;
+  pLayout->InstanceBlockSize = get_instance_block_size (pInfo, pLayout);
+
+  n = pInfo->NumInputPorts;
+  if (pInfo->NumOutputPorts > n) n = pInfo->NumOutputPorts;
+  if (pInfo->NumParameters > n) n = pInfo->NumParameters;
+  if (n < 1) {
+    return 1;
+  }
+  pTypes = malloc (n * sizeof (*pTypes));
+  if (NULL == pTypes) {
+    return 0;
+  }
+
   if (pInfo->NumInputPorts > 0) {
-    size_t input_align = 0;
     for (i = 0; i < pInfo->NumInputPorts; i++) {
-      enum IEEE_Cigre_DLLInterface_DataType dtype = pInfo->InputPortsInfo[i].DataType;
-      size_t this_align = get_alignment_requirement (dtype);
-      if (this_align > input_align) {
-        input_align = this_align;
-      }
+      pTypes[i] = pInfo->InputPortsInfo[i].DataType;
     }
-#ifndef ATP_MINGW
-    printf("  Input Struct Alignment Requirement = %zu\n", input_align);
-#endif
-    pTest = malloc (pInfo->NumInputPorts * sizeof (ArrayMap));
-    *pInputMap = pTest;
-    input_size = 0;
-    for (i = 0; i < pInfo->NumInputPorts; i++) {
-      enum IEEE_Cigre_DLLInterface_DataType dtype = pInfo->InputPortsInfo[i].DataType;
-      int dsize = get_datatype_size (dtype);
-      pTest[i].size = dsize;
-      pTest[i].offset = input_size;
-      pTest[i].dtype = dtype;
-      input_size = get_next_struct_offset (input_size, dsize, input_align);
+    pLayout->pInputMap = malloc (pInfo->NumInputPorts * sizeof (ArrayMap));
+    if (NULL == pLayout->pInputMap) {
+      free (pTypes);
+      return 0;
     }
-//    printf ("%d inputs of total size %d\n", pInfo->NumInputPorts, input_size);
-    pModel->ExternalInputs = malloc(input_size);
+    pLayout->InputSize = layout_array_map (pLayout->pInputMap, pTypes, pInfo->NumInputPorts, "Input");
   }
   if (pInfo->NumOutputPorts > 0) {
-    size_t output_align = 0;
     for (i = 0; i < pInfo->NumOutputPorts; i++) {
-      enum IEEE_Cigre_DLLInterface_DataType dtype = pInfo->OutputPortsInfo[i].DataType;
-      size_t this_align = get_alignment_requirement (dtype);
-      if (this_align > output_align) {
-        output_align = this_align;
-      }
+      pTypes[i] = pInfo->OutputPortsInfo[i].DataType;
     }
-#ifndef ATP_MINGW
-    printf("  Output Struct Alignment Requirement = %zu\n", output_align);
-#endif
-    pTest = malloc (pInfo->NumOutputPorts * sizeof (ArrayMap));
-    *pOutputMap = pTest;
-    output_size = 0;
-    for (i = 0; i < pInfo->NumOutputPorts; i++) {
-      enum IEEE_Cigre_DLLInterface_DataType dtype = pInfo->OutputPortsInfo[i].DataType;
-      int dsize = get_datatype_size (dtype);
-      pTest[i].size = dsize;
-      pTest[i].offset = output_size;
-      pTest[i].dtype = dtype;
-      output_size = get_next_struct_offset (output_size, dsize, output_align);
+    pLayout->pOutputMap = malloc (pInfo->NumOutputPorts * sizeof (ArrayMap));
+    if (NULL == pLayout->pOutputMap) {
+      free (pTypes);
+      FreeModelLayout (pLayout);
+      return 0;
     }
-//    printf ("%d outputs of total size %d\n", pInfo->NumOutputPorts, output_size);
-    pModel->ExternalOutputs = malloc(output_size);
-  }
-  if (pInfo->NumIntStates > 0) {
-    pModel->IntStates = (int32_T *) malloc(pInfo->NumIntStates * sizeof(int32_T));
-  }
-  if (pInfo->NumFloatStates > 0) {
-    pModel->FloatStates = (real32_T *) malloc(pInfo->NumFloatStates * sizeof(real32_T));
-  }
-  if (pInfo->NumDoubleStates > 0) {
-    pModel->DoubleStates = (real64_T *) malloc(pInfo->NumDoubleStates * sizeof(real64_T));
+    pLayout->OutputSize = layout_array_map (pLayout->pOutputMap, pTypes, pInfo->NumOutputPorts, "Output");
   }
   if (pInfo->NumParameters > 0) {
-    size_t parm_align = 0;
     for (i = 0; i < pInfo->NumParameters; i++) {
-      enum IEEE_Cigre_DLLInterface_DataType dtype = pInfo->ParametersInfo[i].DataType;
-      size_t this_align = get_alignment_requirement (dtype);
-      if (this_align > parm_align) {
-        parm_align = this_align;
-      }
+      pTypes[i] = pInfo->ParametersInfo[i].DataType;
     }
-#ifndef ATP_MINGW
-    printf("  Parameter Struct Alignment Requirement = %zu\n", parm_align);
-#endif
-    pTest = malloc (pInfo->NumParameters * sizeof (ArrayMap));
-    *pParameterMap = pTest;
-    parm_size = 0;
-    for (i = 0; i < pInfo->NumParameters; i++) {
-      enum IEEE_Cigre_DLLInterface_DataType dtype = pInfo->ParametersInfo[i].DataType;
-      dsize = get_datatype_size (dtype);
-      pTest[i].size = dsize;
-      pTest[i].offset = parm_size;
-      pTest[i].dtype = dtype;
-      parm_size = get_next_struct_offset (parm_size, dsize, parm_align);
+    pLayout->pParameterMap = malloc (pInfo->NumParameters * sizeof (ArrayMap));
+    if (NULL == pLayout->pParameterMap) {
+      free (pTypes);
+      FreeModelLayout (pLayout);
+      return 0;
+    }
+    pLayout->ParameterSize = layout_array_map (pLayout->pParameterMap, pTypes, pInfo->NumParameters, "Parameter");
+    // default parameter values are copied into each new instance
+    pLayout->pDefaultParameters = calloc (1, pLayout->ParameterSize);
+    if (NULL == pLayout->pDefaultParameters) {
+      free (pTypes);
+      FreeModelLayout (pLayout);
+      return 0;
     }
-//    printf("parm_size = %d\n", parm_size);
-    pModel->Parameters = malloc (parm_size);
-    // initialize the parameters to default values
     for (i = 0; i < pInfo->NumParameters; i++) {
-      assign_default_value ((char *)pModel->Parameters, pTest[i].offset, pTest[i].dtype, 
-                            pTest[i].size, pInfo->ParametersInfo[i].DefaultValue);
+      assign_default_value (pLayout->pDefaultParameters, pLayout->pParameterMap[i].offset, pLayout->pParameterMap[i].dtype, 
+                            pLayout->pParameterMap[i].size, pInfo->ParametersInfo[i].DefaultValue);
     }
   }
+  free (pTypes);
+  pLayout->InstanceBlockSize = get_instance_block_size (pInfo, pLayout);
+  return 1;
+}
+
+void FreeModelLayout (DLLModelLayout *pLayout)
+{
+  free (pLayout->pParameterMap);
+  free (pLayout->pInputMap);
+  free (pLayout->pOutputMap);
+  free (pLayout->pDefaultParameters);
+  pLayout->pParameterMap = NULL;
+  pLayout->pInputMap = NULL;
+  pLayout->pOutputMap = NULL;
+  pLayout->pDefaultParameters = NULL;
+}
+
+// SimTool_EMT_RMS_Mode is const to the model, so it is written once, as the instance is made,
+// by initializing a copy of the instance struct
+static void set_instance_mode (IEEE_Cigre_DLLInterface_Instance *pModel, uint8_T SimMode)
+{
+  IEEE_Cigre_DLLInterface_Instance init = {
+    .ExternalInputs = pModel->ExternalInputs,
+    .ExternalOutputs = pModel->ExternalOutputs,
+    .Parameters = pModel->Parameters,
+    .Time = pModel->Time,
+    .SimTool_EMT_RMS_Mode = SimMode,
+    .LastErrorMessage = pModel->LastErrorMessage,
+    .LastGeneralMessage = pModel->LastGeneralMessage,
+    .IntStates = pModel->IntStates,
+    .FloatStates = pModel->FloatStates,
+    .DoubleStates = pModel->DoubleStates
+  };
+  memcpy (pModel, &init, sizeof (init));
+}
+
+// carve one instance out of a zeroed block of at least pLayout->InstanceBlockSize bytes
+IEEE_Cigre_DLLInterface_Instance* place_model_instance (const IEEE_Cigre_DLLInterface_Model_Info *pInfo,
+                                                        const DLLModelLayout *pLayout, char *pBlock)
+{
+  IEEE_Cigre_DLLInterface_Instance *pModel = (IEEE_Cigre_DLLInterface_Instance *) pBlock;
+  char *pNext = pBlock + round_up_size (sizeof (DLLInstanceHeader), sizeof (real64_T));
+  if (pLayout->InputSize > 0) {
+    pModel->ExternalInputs = pNext;
+    DLL_INSTANCE_HEADER (pModel)->pOwnInputs = pNext;
+    pNext += round_up_size (pLayout->InputSize, sizeof (real64_T));
+  }
+  if (pLayout->OutputSize > 0) {
+    pModel->ExternalOutputs = pNext;
+    pNext += round_up_size (pLayout->OutputSize, sizeof (real64_T));
+  }
+  if (pInfo->NumDoubleStates > 0) {
+    pModel->DoubleStates = (real64_T *) pNext;
+    pNext += round_up_size (pInfo->NumDoubleStates * sizeof (real64_T), sizeof (real64_T));
+  }
+  if (pInfo->NumFloatStates > 0) {
+    pModel->FloatStates = (real32_T *) pNext;
+    pNext += round_up_size (pInfo->NumFloatStates * sizeof (real32_T), sizeof (real64_T));
+  }
+  if (pInfo->NumIntStates > 0) {
+    pModel->IntStates = (int32_T *) pNext;
+    pNext += round_up_size (pInfo->NumIntStates * sizeof (int32_T), sizeof (real64_T));
+  }
+  if (pLayout->ParameterSize > 0) {
+    pModel->Parameters = pNext;
+    memcpy (pModel->Parameters, pLayout->pDefaultParameters, pLayout->ParameterSize);
+  }
+  set_instance_mode (pModel, pLayout->SimMode);
   return pModel;
 }
 
-void FreeModelInstance (IEEE_Cigre_DLLInterface_Instance *pModel, ArrayMap *pParameterMap,
-                        ArrayMap *pInputMap, ArrayMap *pOutputMap)
+IEEE_Cigre_DLLInterface_Instance* AllocateModelInstance (const IEEE_Cigre_DLLInterface_Model_Info *pInfo,
+                                                         const DLLModelLayout *pLayout)
 {
-#ifndef ATP_MINGW
-  printf("freeing pModel\n");
-#endif
-  if (NULL != pModel->ExternalInputs) {
-    free (pModel->ExternalInputs);
+  if (pLayout->bArena) {
+    char *pBlock = aligned_block_alloc (pLayout->InstanceBlockSize);
+    if (NULL == pBlock) {
+      return NULL;
+    }
+    memset (pBlock, 0, pLayout->InstanceBlockSize);
+    return place_model_instance (pInfo, pLayout, pBlock);
+  }
+  // every buffer starts zeroed, as in a block; calloc also clears Time and the message pointers,
+  // so check_messages is safe before the first call
+  IEEE_Cigre_DLLInterface_Instance *pModel = calloc (1, sizeof (DLLInstanceHeader));
+  if (NULL == pModel) {
+    return NULL;
+  }
+  if (pLayout->InputSize > 0) {
+    pModel->ExternalInputs = calloc (1, pLayout->InputSize);
+    DLL_INSTANCE_HEADER (pModel)->pOwnInputs = pModel->ExternalInputs;
+  }
+  if (pLayout->OutputSize > 0) {
+    pModel->ExternalOutputs = calloc (1, pLayout->OutputSize);
+  }
+  if (pInfo->NumIntStates > 0) {
+    pModel->IntStates = (int32_T *) calloc (pInfo->NumIntStates, sizeof(int32_T));
+  }
+  if (pInfo->NumFloatStates > 0) {
+    pModel->FloatStates = (real32_T *) calloc (pInfo->NumFloatStates, sizeof(real32_T));
   }
-  if (NULL != pModel->ExternalOutputs) {
-    free (pModel->ExternalOutputs);
+  if (pInfo->NumDoubleStates > 0) {
+    pModel->DoubleStates = (real64_T *) calloc (pInfo->NumDoubleStates, sizeof(real64_T));
   }
-  if (NULL != pModel->IntStates) {
-    free (pModel->IntStates);
+  if (pLayout->ParameterSize > 0) {
+    pModel->Parameters = malloc (pLayout->ParameterSize);
   }
-  if (NULL != pModel->FloatStates) {
-    free (pModel->FloatStates);
+  if ((pLayout->InputSize > 0 && NULL == pModel->ExternalInputs) ||
+      (pLayout->OutputSize > 0 && NULL == pModel->ExternalOutputs) ||
+      (pInfo->NumIntStates > 0 && NULL == pModel->IntStates) ||
+      (pInfo->NumFloatStates > 0 && NULL == pModel->FloatStates) ||
+      (pInfo->NumDoubleStates > 0 && NULL == pModel->DoubleStates) ||
+      (pLayout->ParameterSize > 0 && NULL == pModel->Parameters)) {
+    ReleaseModelInstance (pModel, pLayout);
+    return NULL;
   }
-  if (NULL != pModel->DoubleStates) {
-    free (pModel->DoubleStates);
+  if (pLayout->ParameterSize > 0) {
+    memcpy (pModel->Parameters, pLayout->pDefaultParameters, pLayout->ParameterSize);
   }
-  if (NULL != pModel->Parameters) {
-    free (pModel->Parameters);
+  set_instance_mode (pModel, pLayout->SimMode);
+  return pModel;
+}
+
+void ReleaseModelInstance (IEEE_Cigre_DLLInterface_Instance *pModel, const DLLModelLayout *pLayout)
+{
+  if (pLayout->bArena) {
+    aligned_block_free (pModel);
+    return;
   }
+  free (DLL_INSTANCE_HEADER (pModel)->pOwnInputs);  // ExternalInputs may still alias another model's outputs
+  free (pModel->ExternalOutputs);
+  free (pModel->IntStates);
+  free (pModel->FloatStates);
+  free (pModel->DoubleStates);
+  free (pModel->Parameters);
   free (pModel);
+}
+
+DLLInstanceArena * CreateInstanceArena (DLLModelClass *pClass, int NumInstances)
+{
+  DLLInstanceArena *pArena = malloc (sizeof (*pArena));
+  if (NULL == pArena) {
+    return NULL;
+  }
+  pArena->pClass = pClass;
+  pArena->Stride = pClass->layout.InstanceBlockSize;
+  pArena->NumInstances = NumInstances;
+  pArena->NumUsed = 0;
+  pArena->NumLive = 0;
+  pArena->pBlock = aligned_block_alloc (pArena->Stride * NumInstances);
+  if (NULL == pArena->pBlock) {
+#ifndef ATP_MINGW
+    printf ("CreateInstanceArena: could not allocate %d instances of %s\n", NumInstances, pClass->pInfo->ModelName);
+#endif
+    free (pArena);
+    return NULL;
+  }
+  memset (pArena->pBlock, 0, pArena->Stride * NumInstances);
+  return pArena;
+}
+
+void FreeInstanceArena (DLLInstanceArena *pArena)
+{
+  if (pArena->NumLive > 0) {
+#ifndef ATP_MINGW
+    printf ("FreeInstanceArena: %d instances still in use, not freed\n", pArena->NumLive);
+#endif
+    return;
+  }
+  aligned_block_free (pArena->pBlock);
+  free (pArena);
+}
+
+IEEE_Cigre_DLLInterface_Instance* CreateModelInstance (const IEEE_Cigre_DLLInterface_Model_Info *pInfo,
+                                                       ArrayMap **pParameterMap,
+                                                       ArrayMap **pInputMap,
+                                                       ArrayMap **pOutputMap)
+{
+  DLLModelLayout layout;
+
+#ifndef ATP_MINGW
+  printf("creating pModel on %s [%d,%d,%d]\n", pInfo->ModelName, pInfo->NumInputPorts, pInfo->NumOutputPorts, pInfo->NumParameters);
+#endif
+  if (!ComputeModelLayout (pInfo, &layout)) {
+    return NULL;
+  }
+  IEEE_Cigre_DLLInterface_Instance *pModel = AllocateModelInstance (pInfo, &layout);
+  if (NULL == pModel) {
+    FreeModelLayout (&layout);
+    return NULL;
+  }
+  // the caller owns the maps, to be freed in FreeModelInstance
+  *pParameterMap = layout.pParameterMap;
+  *pInputMap = layout.pInputMap;
+  *pOutputMap = layout.pOutputMap;
+  free (layout.pDefaultParameters);
+  return pModel;
+}
+
+void FreeModelInstance (IEEE_Cigre_DLLInterface_Instance *pModel, ArrayMap *pParameterMap,
+                        ArrayMap *pInputMap, ArrayMap *pOutputMap)
+{
+#ifndef ATP_MINGW
+  printf("freeing pModel\n");
+#endif
+  // CreateModelInstance always packs the instance into one block
+  aligned_block_free (pModel);
   if (NULL != pInputMap) {
     free (pInputMap);
   }
@@ -320,6 +635,22 @@ void check_messages (const char *loc, IEEE_Cigre_DLLInterface_Instance *pModel)
 #endif
 }
 
+int32_T check_model_return (const char *loc, IEEE_Cigre_DLLInterface_Instance *pModel, int32_T rc)
+{
+#ifndef ATP_MINGW
+  if (IEEE_Cigre_DLLInterface_Return_OK != rc) {
+    const char_T *pText = pModel->LastGeneralMessage;
+    if (IEEE_Cigre_DLLInterface_Return_Error == rc && NULL != pModel->LastErrorMessage) {
+      pText = pModel->LastErrorMessage;
+    }
+    if (NULL != pText) {
+      printf("  %s says %s\n", loc, pText);
+    }
+  }
+#endif
+  return rc;
+}
+
 void print_parameter_info (int k, IEEE_Cigre_DLLInterface_Parameter parm, char *pData, ArrayMap sMap)
 {
 #ifndef ATP_MINGW
@@ -410,25 +741,20 @@ void write_csv_header (FILE *fp, const IEEE_Cigre_DLLInterface_Model_Info *pInfo
 void write_csv_values (FILE *fp, IEEE_Cigre_DLLInterface_Instance *pModel, const IEEE_Cigre_DLLInterface_Model_Info *pInfo, 
                        ArrayMap *pInputMap, ArrayMap *pOutputMap, double t)
 {
-  char buf[256];
-  char line[16384];
-  line[0] = '\0';
-  sprintf (buf, "%g", t);
-  strcat (line, buf);
+  // formats straight into the stream; IEEE_Cigre_DLLTrace.h is much faster for long runs
   char *pData = (char *) pModel->ExternalInputs;
   double val;
+  fprintf (fp, "%g", t);
   for (int i = 0; i < pInfo->NumInputPorts; i++) {
     memcpy (&val, pData + pInputMap[i].offset, pInputMap[i].size);
-    sprintf (buf, ",%g", val);
-    strcat (line, buf);
+    fprintf (fp, ",%g", val);
   }
   pData = (char *) pModel->ExternalOutputs;
   for (int i = 0; i < pInfo->NumOutputPorts; i++) {
     memcpy (&val, pData + pOutputMap[i].offset, pOutputMap[i].size);
-    sprintf (buf, ",%g", val);
-    strcat (line, buf);
+    fprintf (fp, ",%g", val);
   }
-  fprintf (fp, "%s\n", line);
+  fprintf (fp, "\n");
 }
 
 void PrintDLLModelParameters (Wrapped_IEEE_Cigre_DLL *pWrap)
@@ -459,57 +785,260 @@ void PrintDLLModelParameters (Wrapped_IEEE_Cigre_DLL *pWrap)
 
 #endif
 
-Wrapped_IEEE_Cigre_DLL * CreateFirstDLLModel (char *dll_name)
+DLLModelClass * LoadDLLModelClass (char *dll_name)
 {
-  Wrapped_IEEE_Cigre_DLL *pWrap = malloc (sizeof (*pWrap));
+  DLLModelClass *pClass = malloc (sizeof (*pClass));
 
-  pWrap->hLib = LoadLibrary(TEXT(dll_name)); 
-  if (pWrap->hLib != NULL) { 
+  if (NULL == pClass) {
+    printf ("Unable to allocate the model class for %s\n", dll_name);
+    return NULL;
+  }
+  pClass->hLib = OpenModelLibrary (dll_name); 
+  if (pClass->hLib != NULL) { 
     // this function is not used in the wrapper
-    pWrap->Model_PrintInfo = (DLL_INFO_FCN) GetProcAddress(pWrap->hLib, "Model_PrintInfo"); 
+    pClass->Model_PrintInfo = (DLL_INFO_FCN) FindModelSymbol (pClass->hLib, "Model_PrintInfo"); 
     // find the required DLL functions for this wrapper
-    pWrap->Model_GetInfo = (DLL_STRUCT_FCN) GetProcAddress(pWrap->hLib, "Model_GetInfo");
-    if (NULL == pWrap->Model_GetInfo) {
+    pClass->Model_GetInfo = (DLL_STRUCT_FCN) FindModelSymbol (pClass->hLib, "Model_GetInfo");
+    if (NULL == pClass->Model_GetInfo) {
       printf("Failed to load Model_GetInfo from %s\n", dll_name);
     }
-    pWrap->Model_CheckParameters = LoadModelFunction (pWrap->hLib, "Model_CheckParameters", dll_name); 
-    pWrap->Model_Initialize = LoadModelFunction (pWrap->hLib, "Model_Initialize", dll_name);
-    pWrap->Model_Outputs = LoadModelFunction (pWrap->hLib, "Model_Outputs", dll_name);
-    pWrap->Model_Terminate = LoadModelFunction (pWrap->hLib, "Model_Terminate", dll_name);
+    pClass->Model_CheckParameters = LoadModelFunction (pClass->hLib, "Model_CheckParameters", dll_name); 
+    pClass->Model_Initialize = LoadModelFunction (pClass->hLib, "Model_Initialize", dll_name);
+    pClass->Model_Outputs = LoadModelFunction (pClass->hLib, "Model_Outputs", dll_name);
+    pClass->Model_Terminate = LoadModelFunction (pClass->hLib, "Model_Terminate", dll_name);
     // look for the new (optional) DLL functions
-    pWrap->Model_FirstCall = LoadModelFunction (pWrap->hLib, "Model_FirstCall", dll_name);
-    pWrap->Model_Iterate = LoadModelFunction (pWrap->hLib, "Model_Iterate", dll_name);
+    pClass->Model_FirstCall = LoadModelFunction (pClass->hLib, "Model_FirstCall", dll_name);
+    pClass->Model_Iterate = LoadModelFunction (pClass->hLib, "Model_Iterate", dll_name);
+    // snapshot hooks are an extension of this wrapper, so their absence is not reported
+    pClass->Model_SaveState = (DLL_SAVE_FCN) FindModelSymbol (pClass->hLib, "Model_SaveState");
+    pClass->Model_RestoreState = (DLL_RESTORE_FCN) FindModelSymbol (pClass->hLib, "Model_RestoreState");
+    pClass->Model_OutputsBatch = (DLL_OUTPUTS_BATCH_FCN) FindModelSymbol (pClass->hLib, "Model_OutputsBatch");
+    pClass->Model_SetMessageBuffer = (DLL_MESSAGE_BUFFER_FCN) FindModelSymbol (pClass->hLib, "Model_SetMessageBuffer");
     // make sure we have all of the required functions
-    if (NULL == pWrap->Model_GetInfo || NULL == pWrap->Model_CheckParameters || NULL == pWrap->Model_Outputs || 
-        NULL == pWrap->Model_Initialize || NULL == pWrap->Model_Terminate) {
+    if (NULL == pClass->Model_GetInfo || NULL == pClass->Model_CheckParameters || NULL == pClass->Model_Outputs || 
+        NULL == pClass->Model_Initialize || NULL == pClass->Model_Terminate) {
       printf ("Unable to load all of the required functions from %s\n", dll_name);
-      free (pWrap);
+      CloseModelLibrary (pClass->hLib);
+      free (pClass);
+      return NULL;
+    }
+    // retrieve the DLL interface points, and lay out the memory shared by all instances
+    pClass->pInfo = pClass->Model_GetInfo();
+#ifndef ATP_MINGW
+    printf("loading class %s [%d,%d,%d]\n", pClass->pInfo->ModelName, pClass->pInfo->NumInputPorts, 
+           pClass->pInfo->NumOutputPorts, pClass->pInfo->NumParameters);
+#endif
+    if (!ComputeModelLayout (pClass->pInfo, &pClass->layout)) {
+      printf ("Unable to allocate the port and parameter maps of %s\n", dll_name);
+      CloseModelLibrary (pClass->hLib);
+      free (pClass);
+      return NULL;
+    }
+    if (!BuildModelNameIndices (pClass)) {
+      printf ("Unable to allocate the name indices of %s\n", dll_name);
+      FreeModelNameIndices (pClass);
+      FreeModelLayout (&pClass->layout);
+      CloseModelLibrary (pClass->hLib);
+      free (pClass);
       return NULL;
     }
-    // retrieve the DLL interface points
-    pWrap->pInfo = pWrap->Model_GetInfo();
-    // create a model instance, initialized to default values
-    pWrap->pModel = CreateModelInstance (pWrap->pInfo, &pWrap->pParameterMap, &pWrap->pInputMap, &pWrap->pOutputMap);
+    pClass->NumInstances = 0;
   } else {
     printf ("LoadLibrary failed on %s\n", dll_name);
+    free (pClass);
+    return NULL;
+  }
+  return pClass;
+}
+
+Wrapped_IEEE_Cigre_DLL * wrap_model_instance (DLLModelClass *pClass)
+{
+  Wrapped_IEEE_Cigre_DLL *pWrap = malloc (sizeof (*pWrap));
+
+  if (NULL == pWrap) {
+    return NULL;
+  }
+  pWrap->pClass = pClass;
+  pWrap->pArena = NULL;
+  pWrap->bOwnsClass = 0;
+  pWrap->hLib = pClass->hLib;
+  pWrap->Model_PrintInfo = pClass->Model_PrintInfo;
+  pWrap->Model_GetInfo = pClass->Model_GetInfo;
+  pWrap->Model_CheckParameters = pClass->Model_CheckParameters;
+  pWrap->Model_Initialize = pClass->Model_Initialize;
+  pWrap->Model_Outputs = pClass->Model_Outputs;
+  pWrap->Model_FirstCall = pClass->Model_FirstCall;
+  pWrap->Model_Iterate = pClass->Model_Iterate;
+  pWrap->Model_Terminate = pClass->Model_Terminate;
+  pWrap->Model_SaveState = pClass->Model_SaveState;
+  pWrap->Model_RestoreState = pClass->Model_RestoreState;
+  pWrap->Model_OutputsBatch = pClass->Model_OutputsBatch;
+  pWrap->Model_SetMessageBuffer = pClass->Model_SetMessageBuffer;
+  pWrap->pInfo = pClass->pInfo;
+  // the maps belong to the class; only the instance buffers are allocated here
+  pWrap->pParameterMap = pClass->layout.pParameterMap;
+  pWrap->pInputMap = pClass->layout.pInputMap;
+  pWrap->pOutputMap = pClass->layout.pOutputMap;
+  pClass->NumInstances += 1;
+  return pWrap;
+}
+
+int SetDLLModelClassMode (DLLModelClass *pClass, uint8_T SimMode)
+{
+  // EMT_RMS_Mode is 1 for EMT, 2 for RMS, 3 for both, and 0 if the model does not say, taken as EMT
+  int Supported = (0 == pClass->pInfo->EMT_RMS_Mode) ? 1 : pClass->pInfo->EMT_RMS_Mode;
+  if ((1 != SimMode && 2 != SimMode) || 0 == (Supported & SimMode)) {
+#ifndef ATP_MINGW
+    printf ("SetDLLModelClassMode: %s runs in %s mode, not %s\n", pClass->pInfo->ModelName,
+            modeEMTorRMS (Supported), modeEMTorRMS (SimMode));
+#endif
+    return 0;
+  }
+  pClass->layout.SimMode = SimMode;
+  return 1;
+}
+
+// before any other entry point, so messages from Model_FirstCall on are the instance's own
+static void give_message_buffer (Wrapped_IEEE_Cigre_DLL *pWrap)
+{
+  if (NULL != pWrap->Model_SetMessageBuffer) {
+    DLLInstanceHeader *pHeader = DLL_INSTANCE_HEADER (pWrap->pModel);
+    pWrap->Model_SetMessageBuffer (pWrap->pModel, pHeader->Message, (int32_T) sizeof (pHeader->Message));
+  }
+}
+
+Wrapped_IEEE_Cigre_DLL * CreateDLLModelInstance (DLLModelClass *pClass)
+{
+  Wrapped_IEEE_Cigre_DLL *pWrap = wrap_model_instance (pClass);
+  if (NULL == pWrap) {
+    return NULL;
+  }
+  pWrap->pModel = AllocateModelInstance (pClass->pInfo, &pClass->layout);
+  if (NULL == pWrap->pModel) {
+#ifndef ATP_MINGW
+    printf ("CreateDLLModelInstance: could not allocate an instance of %s\n", pClass->pInfo->ModelName);
+#endif
+    pClass->NumInstances -= 1;
     free (pWrap);
     return NULL;
   }
+  give_message_buffer (pWrap);
+  AttachDLLModelTiming (pWrap);
+  return pWrap;
+}
+
+Wrapped_IEEE_Cigre_DLL * CreateDLLModelInstanceInArena (DLLInstanceArena *pArena)
+{
+  if (pArena->NumUsed >= pArena->NumInstances) {
+#ifndef ATP_MINGW
+    printf ("CreateDLLModelInstanceInArena: all %d instances already used\n", pArena->NumInstances);
+#endif
+    return NULL;
+  }
+  Wrapped_IEEE_Cigre_DLL *pWrap = wrap_model_instance (pArena->pClass);
+  if (NULL == pWrap) {
+    return NULL;
+  }
+  char *pBlock = pArena->pBlock + pArena->Stride * pArena->NumUsed;
+  pWrap->pModel = place_model_instance (pArena->pClass->pInfo, &pArena->pClass->layout, pBlock);
+  pWrap->pArena = pArena;
+  give_message_buffer (pWrap);
+  AttachDLLModelTiming (pWrap);
+  pArena->NumUsed += 1;
+  pArena->NumLive += 1;
+  return pWrap;
+}
+
+void FreeDLLModelInstance (Wrapped_IEEE_Cigre_DLL *pWrap)
+{
+  pWrap->Model_Terminate (pWrap->pModel);
+  check_messages ("Model_Terminate", pWrap->pModel);
+  if (pWrap->bOwnsClass) {  // the summary at FreeFirstDLLModel
+    PrintDLLModelTiming (pWrap);
+  }
+  DetachDLLModelTiming (pWrap);
+  if (NULL != pWrap->pArena) {
+    // the memory is released with the whole arena, in FreeInstanceArena
+    pWrap->pArena->NumLive -= 1;
+  } else {
+    ReleaseModelInstance (pWrap->pModel, &pWrap->pClass->layout);
+  }
+  pWrap->pClass->NumInstances -= 1;
+  free (pWrap);
+}
+
+void FreeDLLModelClass (DLLModelClass *pClass)
+{
+  if (pClass->NumInstances > 0) {
+#ifndef ATP_MINGW
+    printf ("FreeDLLModelClass: %s still has %d instances, not freed\n", pClass->pInfo->ModelName, pClass->NumInstances);
+#endif
+    return;
+  }
+  FreeModelLayout (&pClass->layout);
+  FreeModelNameIndices (pClass);
+  CloseModelLibrary (pClass->hLib);
+  free (pClass);
+}
+
+int32_T DLLModelOutputsBatch (Wrapped_IEEE_Cigre_DLL **ppWraps, int NumWraps)
+{
+  IEEE_Cigre_DLLInterface_Instance *pInstances[DLL_BATCH_CHUNK];
+  int32_T worst = IEEE_Cigre_DLLInterface_Return_OK;
+  int32_T rc;
+  int k = 0;
+
+  while (k < NumWraps) {
+    Wrapped_IEEE_Cigre_DLL *pLead = ppWraps[k];
+    int n = 1;
+    if (NULL != pLead->Model_OutputsBatch) {
+      while (k + n < NumWraps && n < DLL_BATCH_CHUNK && ppWraps[k + n]->pClass == pLead->pClass &&
+             ppWraps[k + n]->Model_OutputsBatch == pLead->Model_OutputsBatch) {
+        ++n;
+      }
+    }
+    if (n > 1) {
+      for (int i = 0; i < n; i++) {
+        pInstances[i] = ppWraps[k + i]->pModel;
+      }
+      rc = pLead->Model_OutputsBatch (pInstances, n);
+    } else {
+      rc = pLead->Model_Outputs (pLead->pModel);
+    }
+    if (rc > worst) {
+      worst = rc;
+    }
+    k += n;
+  }
+  return worst;
+}
+
+Wrapped_IEEE_Cigre_DLL * CreateFirstDLLModel (char *dll_name)
+{
+  DLLModelClass *pClass = LoadDLLModelClass (dll_name);
+  if (NULL == pClass) {
+    return NULL;
+  }
+  // create a model instance, initialized to default values
+  Wrapped_IEEE_Cigre_DLL *pWrap = CreateDLLModelInstance (pClass);
+  if (NULL == pWrap) {
+    FreeDLLModelClass (pClass);
+    return NULL;
+  }
+  pWrap->bOwnsClass = 1;
   return pWrap;
 }
 
 void FreeFirstDLLModel (Wrapped_IEEE_Cigre_DLL *pWrap)
 {
   // free the Model data and library
-  int val = pWrap->Model_Terminate (pWrap->pModel);
-//  if (IEEE_Cigre_DLLInterface_Return_OK != val) { // messages not initialized if the model was never used
-    check_messages ("Model_Terminate", pWrap->pModel);
-//  }
-  FreeModelInstance (pWrap->pModel, pWrap->pParameterMap, pWrap->pInputMap, pWrap->pOutputMap);
-  FreeLibrary (pWrap->hLib);
-  free (pWrap);
+  DLLModelClass *pClass = pWrap->pClass;
+  int bOwnsClass = pWrap->bOwnsClass;
+  FreeDLLModelInstance (pWrap);
+  if (bOwnsClass) {
+    FreeDLLModelClass (pClass);
+  }
 #ifndef ATP_MINGW
   printf ("normal finish\n"); 
 #endif
 }
-
@@ -0,0 +1,437 @@
+// Copyright (C) 2024-26 Meltran, Inc
+
+/*
+Checks of the wrapper layers that no model test harness exercises. Each test prints what it
+checked and returns the number of failures, and the exit status is the total, so a build script
+can run TEST_WRAPPER and stop on a nonzero status.
+
+Usage: TEST_WRAPPER [test]
+  multirate   steps stub models at the IBR, HWPV, SCRX9 and PPC sample times through
+              DLLMultiRateStep for several hyperperiods, with and without the firing table, and
+              checks the number and times of their Model_Outputs calls
+  graph       connects a stub source to two stub models through a DLLSignalGraph, one with its
+              inputs aliased to the source outputs and one gathering mixed types, and checks the
+              inputs each model sees against the source outputs of the same step
+  names       builds the name indices of a stub class with many ports and a repeated name, and
+              checks every lookup against a scan of the names
+  messages    posts repeated, interleaved and many distinct messages to a rate-limited queue, and
+              checks what is queued, the Repeats counts, NumSuppressed and NumDropped
+
+Without an argument, every test runs.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "IEEE_Cigre_DLLWrapper.h"
+#include "IEEE_Cigre_DLLMultiRate.h"
+#include "IEEE_Cigre_DLLSignalGraph.h"
+#include "IEEE_Cigre_DLLMessages.h"
+
+// ====== stub models, with no library behind them ======
+
+#define MAX_STUBS 8
+
+typedef struct _StubModel_ {
+  IEEE_Cigre_DLLInterface_Instance instance;
+  Wrapped_IEEE_Cigre_DLL wrap;
+  long long calls;
+  long long bad_times;  // calls whose Time was not calls * FixedStepBaseSampleTime
+} StubModel;
+
+static StubModel stubs[MAX_STUBS];
+
+static int32_T stub_outputs (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  StubModel *pStub = (StubModel *) ((char *) pModel - offsetof (StubModel, instance));
+  double expected = (double) pStub->calls * pStub->wrap.pInfo->FixedStepBaseSampleTime;
+  if (fabs (pModel->Time - expected) > 1.0e-9 * pStub->wrap.pInfo->FixedStepBaseSampleTime + 1.0e-15 * expected) {
+    pStub->bad_times += 1;
+  }
+  pStub->calls += 1;
+  return IEEE_Cigre_DLLInterface_Return_OK;
+}
+
+static Wrapped_IEEE_Cigre_DLL **make_stubs (const IEEE_Cigre_DLLInterface_Model_Info *pInfos, int n)
+{
+  static Wrapped_IEEE_Cigre_DLL *ppWraps[MAX_STUBS];
+  for (int i = 0; i < n; i++) {
+    memset (&stubs[i].wrap, 0, sizeof (stubs[i].wrap));
+    stubs[i].instance.Time = 0.0;
+    stubs[i].calls = 0;
+    stubs[i].bad_times = 0;
+    stubs[i].wrap.pInfo = &pInfos[i];
+    stubs[i].wrap.pModel = &stubs[i].instance;
+    stubs[i].wrap.Model_Outputs = stub_outputs;
+    ppWraps[i] = &stubs[i].wrap;
+  }
+  return ppWraps;
+}
+
+// ====== multi-rate scheduler ======
+
+static const IEEE_Cigre_DLLInterface_Model_Info plant_rates[] = {
+  {.ModelName = "IBR", .FixedStepBaseSampleTime = 10.0e-6},
+  {.ModelName = "HWPV", .FixedStepBaseSampleTime = 0.002},
+  {.ModelName = "SCRX9", .FixedStepBaseSampleTime = 0.005},
+  {.ModelName = "PPC", .FixedStepBaseSampleTime = 0.02},
+};
+
+static const IEEE_Cigre_DLLInterface_Model_Info prime_rates[] = {  // 1 ns tick, no table
+  {.ModelName = "fast", .FixedStepBaseSampleTime = 0.999999e-3},
+  {.ModelName = "slow", .FixedStepBaseSampleTime = 1.000001e-3},
+};
+
+// steps the models for nSteps host steps and compares the calls with floor(last tick / period) + 1
+static int check_multirate (const char *label, const IEEE_Cigre_DLLInterface_Model_Info *pInfos, int n,
+                            double HostStep, long nSteps, int bTable)
+{
+  Wrapped_IEEE_Cigre_DLL **ppWraps = make_stubs (pInfos, n);
+  DLLMultiRateScheduler *pSched = CreateDLLMultiRateScheduler (HostStep, ppWraps, n);
+  int failures = 0;
+
+  if (NULL == pSched) {
+    printf ("  %s: CreateDLLMultiRateScheduler failed\n", label);
+    return 1;
+  }
+  if (!bTable) {
+    pSched->HyperPeriodTicks = 0;  // steps through next_due_tick instead of the table
+  }
+  for (long k = 0; k < nSteps; k++) {
+    DLLMultiRateStep (pSched);
+  }
+  PrintDLLMultiRateTable (pSched);
+  long long last = (long long) (nSteps - 1) * pSched->HostTicks;
+  for (int i = 0; i < n; i++) {
+    long long expected = last / pSched->pPeriodTicks[i] + 1;
+    int bad = stubs[i].calls != expected || pSched->pCalls[i] != expected || stubs[i].bad_times > 0;
+    printf ("  %s %-6s %lld calls, expected %lld, %lld at the wrong time: %s\n", label, pInfos[i].ModelName,
+            stubs[i].calls, expected, stubs[i].bad_times, bad ? "FAIL" : "ok");
+    failures += bad;
+  }
+  if (fabs (DLLMultiRateTime (pSched) - (double) last * pSched->TickSeconds) > 1.0e-12) {
+    printf ("  %s host time %.12g, expected %.12g: FAIL\n", label, DLLMultiRateTime (pSched), (double) last * pSched->TickSeconds);
+    failures += 1;
+  }
+  FreeDLLMultiRateScheduler (pSched);
+  return failures;
+}
+
+static int test_multirate (void)
+{
+  int failures = 0;
+  printf ("multirate: 50 us host step over five 20 ms hyperperiods, from the firing table\n");
+  failures += check_multirate ("table", plant_rates, 4, 50.0e-6, 2000, 1);
+  printf ("multirate: the same models, stepping to each next due tick\n");
+  failures += check_multirate ("no table", plant_rates, 4, 50.0e-6, 2000, 0);
+  printf ("multirate: sample times with no common tick above 1 ns, so no table\n");
+  failures += check_multirate ("1 ns tick", prime_rates, 2, 50.0e-6, 400, 1);
+  return failures;
+}
+
+// ====== signal graph ======
+
+// sink_a takes every source output but the last, in order, so its inputs alias the source
+// outputs. sink_b converts P to real32, takes Q and N as one merged copy, and keeps V from the host.
+typedef struct _SourceOutputs_ { real64_T P; real64_T Q; int32_T N; } SourceOutputs;
+typedef struct _SinkAInputs_ { real64_T P; real64_T Q; } SinkAInputs;
+typedef struct _SinkBInputs_ { real32_T P; real64_T Q; int32_T N; real64_T V; } SinkBInputs;
+
+static SourceOutputs source_outputs;
+static SinkAInputs sink_a_inputs;
+static SinkBInputs sink_b_inputs;
+static SinkAInputs sink_a_seen;
+static SinkBInputs sink_b_seen;
+
+static IEEE_Cigre_DLLInterface_Signal source_out_ports[] = {
+  {.Name = "P", .DataType = IEEE_Cigre_DLLInterface_DataType_real64_T, .Width = 1},
+  {.Name = "Q", .DataType = IEEE_Cigre_DLLInterface_DataType_real64_T, .Width = 1},
+  {.Name = "N", .DataType = IEEE_Cigre_DLLInterface_DataType_int32_T, .Width = 1},
+};
+static ArrayMap source_out_map[] = {
+  {sizeof (real64_T), offsetof (SourceOutputs, P), IEEE_Cigre_DLLInterface_DataType_real64_T},
+  {sizeof (real64_T), offsetof (SourceOutputs, Q), IEEE_Cigre_DLLInterface_DataType_real64_T},
+  {sizeof (int32_T), offsetof (SourceOutputs, N), IEEE_Cigre_DLLInterface_DataType_int32_T},
+};
+static IEEE_Cigre_DLLInterface_Signal sink_a_in_ports[] = {
+  {.Name = "Pin", .DataType = IEEE_Cigre_DLLInterface_DataType_real64_T, .Width = 1},
+  {.Name = "Qin", .DataType = IEEE_Cigre_DLLInterface_DataType_real64_T, .Width = 1},
+};
+static ArrayMap sink_a_in_map[] = {
+  {sizeof (real64_T), offsetof (SinkAInputs, P), IEEE_Cigre_DLLInterface_DataType_real64_T},
+  {sizeof (real64_T), offsetof (SinkAInputs, Q), IEEE_Cigre_DLLInterface_DataType_real64_T},
+};
+static IEEE_Cigre_DLLInterface_Signal sink_b_in_ports[] = {
+  {.Name = "Pin", .DataType = IEEE_Cigre_DLLInterface_DataType_real32_T, .Width = 1},
+  {.Name = "Qin", .DataType = IEEE_Cigre_DLLInterface_DataType_real64_T, .Width = 1},
+  {.Name = "Nin", .DataType = IEEE_Cigre_DLLInterface_DataType_int32_T, .Width = 1},
+  {.Name = "V", .DataType = IEEE_Cigre_DLLInterface_DataType_real64_T, .Width = 1},
+};
+static ArrayMap sink_b_in_map[] = {
+  {sizeof (real32_T), offsetof (SinkBInputs, P), IEEE_Cigre_DLLInterface_DataType_real32_T},
+  {sizeof (real64_T), offsetof (SinkBInputs, Q), IEEE_Cigre_DLLInterface_DataType_real64_T},
+  {sizeof (int32_T), offsetof (SinkBInputs, N), IEEE_Cigre_DLLInterface_DataType_int32_T},
+  {sizeof (real64_T), offsetof (SinkBInputs, V), IEEE_Cigre_DLLInterface_DataType_real64_T},
+};
+
+static const IEEE_Cigre_DLLInterface_Model_Info graph_models[] = {
+  {.ModelName = "source", .FixedStepBaseSampleTime = 50.0e-6, .NumOutputPorts = 3, .OutputPortsInfo = source_out_ports},
+  {.ModelName = "sink_a", .FixedStepBaseSampleTime = 50.0e-6, .NumInputPorts = 2, .InputPortsInfo = sink_a_in_ports},
+  {.ModelName = "sink_b", .FixedStepBaseSampleTime = 50.0e-6, .NumInputPorts = 4, .InputPortsInfo = sink_b_in_ports},
+};
+
+static int32_T source_model_outputs (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  SourceOutputs *pOut = (SourceOutputs *) pModel->ExternalOutputs;
+  pOut->P = 1000.0 + 1.0e5 * pModel->Time;
+  pOut->Q = -0.5 * pOut->P;
+  pOut->N += 1;
+  return IEEE_Cigre_DLLInterface_Return_OK;
+}
+
+static int32_T sink_a_model_outputs (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  sink_a_seen = *(const SinkAInputs *) pModel->ExternalInputs;
+  return IEEE_Cigre_DLLInterface_Return_OK;
+}
+
+static int32_T sink_b_model_outputs (IEEE_Cigre_DLLInterface_Instance *pModel)
+{
+  sink_b_seen = *(const SinkBInputs *) pModel->ExternalInputs;
+  return IEEE_Cigre_DLLInterface_Return_OK;
+}
+
+static int check_graph (const char *label, int bad)
+{
+  printf ("  %s: %s\n", label, bad ? "FAIL" : "ok");
+  return bad ? 1 : 0;
+}
+
+static int test_graph (void)
+{
+  Wrapped_IEEE_Cigre_DLL **ppWraps = make_stubs (graph_models, 3);
+  Wrapped_IEEE_Cigre_DLL *pSource = ppWraps[0], *pSinkA = ppWraps[1], *pSinkB = ppWraps[2];
+  int failures = 0;
+  int bad = 0;
+
+  printf ("graph: a source feeding one aliased and one gathered model for 100 steps\n");
+  memset (&source_outputs, 0, sizeof (source_outputs));
+  pSource->pModel->ExternalOutputs = &source_outputs;
+  pSource->pOutputMap = source_out_map;
+  pSource->Model_Outputs = source_model_outputs;
+  pSinkA->pModel->ExternalInputs = &sink_a_inputs;
+  pSinkA->pInputMap = sink_a_in_map;
+  pSinkA->Model_Outputs = sink_a_model_outputs;
+  pSinkB->pModel->ExternalInputs = &sink_b_inputs;
+  pSinkB->pInputMap = sink_b_in_map;
+  pSinkB->Model_Outputs = sink_b_model_outputs;
+  sink_b_inputs.V = 230.0;  // the host's own input, never connected
+
+  DLLSignalGraph *pGraph = CreateDLLSignalGraph ();
+  if (NULL == pGraph) {
+    printf ("  CreateDLLSignalGraph failed: FAIL\n");
+    return 1;
+  }
+  failures += check_graph ("add nodes", AddDLLSignalNode (pGraph, pSource) != 0 ||
+                           AddDLLSignalNode (pGraph, pSinkA) != 1 || AddDLLSignalNode (pGraph, pSinkB) != 2);
+  failures += check_graph ("connect", !ConnectDLLSignals (pGraph, pSource, "P", pSinkA, "Pin") ||
+                           !ConnectDLLSignals (pGraph, pSource, "Q", pSinkA, "Qin") ||
+                           !ConnectDLLSignals (pGraph, pSource, "P", pSinkB, "Pin") ||
+                           !ConnectDLLSignals (pGraph, pSource, "Q", pSinkB, "Qin") ||
+                           !ConnectDLLSignals (pGraph, pSource, "N", pSinkB, "Nin"));
+  failures += check_graph ("reject a second connection to one input",
+                           ConnectDLLSignals (pGraph, pSource, "Q", pSinkB, "Pin"));
+  failures += check_graph ("reject an unknown port", ConnectDLLSignals (pGraph, pSource, "S", pSinkB, "V"));
+  failures += check_graph ("build", !BuildDLLSignalGraph (pGraph));
+  PrintDLLSignalGraph (pGraph);
+  failures += check_graph ("sink_a inputs aliased to the source outputs",
+                           !pGraph->pNodes[1].bAliased || pSinkA->pModel->ExternalInputs != (void *) &source_outputs);
+  failures += check_graph ("sink_b gathers P, then Q and N in one copy",
+                           pGraph->pNodes[2].bAliased || pGraph->pNodes[2].NumCopies != 2);
+
+  for (int k = 0; k < 100; k++) {
+    for (int i = 0; i < 3; i++) {
+      ppWraps[i]->pModel->Time = k * 50.0e-6;
+    }
+    if (IEEE_Cigre_DLLInterface_Return_OK != DLLSignalGraphStep (pGraph)) {
+      bad += 1;
+    }
+    if (sink_a_seen.P != source_outputs.P || sink_a_seen.Q != source_outputs.Q ||
+        sink_b_seen.P != (real32_T) source_outputs.P || sink_b_seen.Q != source_outputs.Q ||
+        sink_b_seen.N != source_outputs.N || sink_b_seen.N != k + 1 || sink_b_seen.V != 230.0) {
+      bad += 1;
+    }
+  }
+  printf ("  %d of 100 steps with inputs that differ from the source outputs\n", bad);
+  failures += check_graph ("outputs reach inputs in the same step", bad > 0);
+
+  FreeDLLSignalGraph (pGraph);
+  failures += check_graph ("sink_a gets its own inputs back", pSinkA->pModel->ExternalInputs != (void *) &sink_a_inputs);
+  return failures;
+}
+
+// ====== name indices ======
+
+#define NUM_INDEX_NAMES 500
+
+static char index_names[NUM_INDEX_NAMES][16];
+
+static int test_names (void)
+{
+  // the Signal members are const, so the ports are written once into heap memory
+  IEEE_Cigre_DLLInterface_Signal *pPorts = calloc (NUM_INDEX_NAMES, sizeof (IEEE_Cigre_DLLInterface_Signal));
+  IEEE_Cigre_DLLInterface_Model_Info info = {.ModelName = "names", .NumInputPorts = NUM_INDEX_NAMES,
+                                             .InputPortsInfo = pPorts};
+  DLLModelClass cls;
+  int failures = 0;
+  int bad = 0;
+
+  printf ("names: %d input names, the last a repeat of the first, and no outputs or parameters\n", NUM_INDEX_NAMES);
+  if (NULL == pPorts) {
+    printf ("  out of memory: FAIL\n");
+    return 1;
+  }
+  for (int i = 0; i < NUM_INDEX_NAMES; i++) {
+    snprintf (index_names[i], sizeof (index_names[i]), "Vin%d", i);
+    *(const char_T **) &pPorts[i].Name = index_names[i];
+  }
+  strcpy (index_names[NUM_INDEX_NAMES - 1], index_names[0]);
+  memset (&cls, 0, sizeof (cls));
+  cls.pInfo = &info;
+  if (!BuildModelNameIndices (&cls)) {
+    printf ("  BuildModelNameIndices failed: FAIL\n");
+    free (pPorts);
+    return 1;
+  }
+  printf ("  %d names in %d buckets\n", cls.InputIndex.NumNames, cls.InputIndex.NumBuckets);
+  for (int i = 0; i < NUM_INDEX_NAMES; i++) {
+    int expected = i < NUM_INDEX_NAMES - 1 ? i : 0;
+    if (LookupDLLName (&cls.InputIndex, index_names[i]) != expected) {
+      bad += 1;
+    }
+  }
+  printf ("  %d of %d names found at the wrong index: %s\n", bad, NUM_INDEX_NAMES, bad ? "FAIL" : "ok");
+  failures += bad > 0;
+  bad = LookupDLLName (&cls.InputIndex, "Vout1") != -1 || LookupDLLName (&cls.InputIndex, "") != -1 ||
+        LookupDLLName (&cls.OutputIndex, "Vin1") != -1 || LookupDLLName (&cls.ParameterIndex, "Vin1") != -1;
+  printf ("  names not in the set are rejected: %s\n", bad ? "FAIL" : "ok");
+  failures += bad;
+  FreeModelNameIndices (&cls);
+  free (pPorts);
+  return failures;
+}
+
+// ====== message queue ======
+
+static int check_message (DLLMessageQueue *pQueue, const char *label, double t, const char *text, long repeats)
+{
+  DLLMessage msg;
+  int bad = !PopDLLMessage (pQueue, &msg) || msg.Time != t || 0 != strcmp (msg.Text, text) || msg.Repeats != repeats;
+  printf ("  %s: %s\n", label, bad ? "FAIL" : "ok");
+  return bad;
+}
+
+static int check_count (const char *label, long long count, long long expected)
+{
+  printf ("  %s %lld, expected %lld: %s\n", label, count, expected, count != expected ? "FAIL" : "ok");
+  return count != expected;
+}
+
+static int test_messages (void)
+{
+  static const int source_a = 0, source_b = 0;  // two instances, by address
+  DLLMessageQueue *pQueue = CreateDLLMessageQueue (0, 10.0);
+  char text[32];
+  DLLMessage msg;
+  int failures = 0;
+
+  printf ("messages: a 10 s rate limit, with one message posted every second\n");
+  if (NULL == pQueue) {
+    printf ("  CreateDLLMessageQueue failed: FAIL\n");
+    return 1;
+  }
+  for (int k = 0; k <= 25; k++) {  // queued at 0, 10 and 20, each later copy counting the 9 before it
+    PostDLLMessage (pQueue, &source_a, "stub", "Model_Outputs", (double) k, IEEE_Cigre_DLLInterface_Return_Message, "limit\n");
+    PostDLLMessage (pQueue, &source_b, "stub", "Model_Outputs", (double) k, IEEE_Cigre_DLLInterface_Return_Message, "limit\n");
+    if (0 == k % 5) {
+      PostDLLMessage (pQueue, &source_a, "stub", "Model_Outputs", (double) k, IEEE_Cigre_DLLInterface_Return_Error, "fault");
+    }
+  }
+  failures += check_message (pQueue, "first copy from a", 0.0, "limit", 0);
+  failures += check_message (pQueue, "first copy from b", 0.0, "limit", 0);
+  failures += check_message (pQueue, "other text from a", 0.0, "fault", 0);
+  failures += check_message (pQueue, "a at 10 s", 10.0, "limit", 9);
+  failures += check_message (pQueue, "b at 10 s", 10.0, "limit", 9);
+  failures += check_message (pQueue, "other text at 10 s", 10.0, "fault", 1);
+  failures += check_message (pQueue, "a at 20 s", 20.0, "limit", 9);
+  failures += check_message (pQueue, "b at 20 s", 20.0, "limit", 9);
+  failures += check_message (pQueue, "other text at 20 s", 20.0, "fault", 1);
+  failures += check_count ("suppressed", pQueue->NumSuppressed, 2 * 23 + 3);
+  PostDLLMessage (pQueue, &source_a, "stub", "Model_Outputs", 3.0, IEEE_Cigre_DLLInterface_Return_Message, "limit");
+  failures += check_message (pQueue, "time going back starts over", 3.0, "limit", 0);
+  failures += check_count ("left in the queue", PopDLLMessage (pQueue, &msg), 0);
+
+  printf ("messages: %d distinct texts at 0 s, then the last 100 again at 1 s\n", 4 * DLL_MESSAGE_RATE_SLOTS);
+  long long suppressed = pQueue->NumSuppressed;
+  for (int i = 0; i < 4 * DLL_MESSAGE_RATE_SLOTS; i++) {
+    snprintf (text, sizeof (text), "text %d", i);
+    PostDLLMessage (pQueue, &source_a, "stub", "Model_Outputs", 0.0, IEEE_Cigre_DLLInterface_Return_Message, text);
+    PopDLLMessage (pQueue, &msg);
+  }
+  for (int i = 4 * DLL_MESSAGE_RATE_SLOTS - 100; i < 4 * DLL_MESSAGE_RATE_SLOTS; i++) {
+    snprintf (text, sizeof (text), "text %d", i);
+    PostDLLMessage (pQueue, &source_a, "stub", "Model_Outputs", 1.0, IEEE_Cigre_DLLInterface_Return_Message, text);
+  }
+  failures += check_count ("recent texts suppressed", pQueue->NumSuppressed - suppressed, 100);
+  failures += check_count ("rate slots reused", pQueue->NumEvicted > 0, 1);
+  PrintDLLMessageStats (pQueue);
+  FreeDLLMessageQueue (pQueue);
+
+  printf ("messages: six texts into a queue of four\n");
+  pQueue = CreateDLLMessageQueue (4, 0.0);
+  if (NULL == pQueue) {
+    printf ("  CreateDLLMessageQueue failed: FAIL\n");
+    return failures + 1;
+  }
+  for (int i = 0; i < 6; i++) {
+    snprintf (text, sizeof (text), "text %d", i);
+    PostDLLMessage (pQueue, &source_a, "stub", "Model_Outputs", 0.0, IEEE_Cigre_DLLInterface_Return_Message, text);
+  }
+  failures += check_count ("dropped", pQueue->NumDropped, 2);
+  failures += check_count ("printed", PrintDLLMessages (pQueue), 4);
+  FreeDLLMessageQueue (pQueue);
+  return failures;
+}
+
+int main (int argc, char **argv)
+{
+  const char *test = argc > 1 ? argv[1] : NULL;
+  int failures = 0;
+  int ran = 0;
+
+  if (NULL == test || 0 == strcmp (test, "multirate")) {
+    failures += test_multirate ();
+    ran += 1;
+  }
+  if (NULL == test || 0 == strcmp (test, "graph")) {
+    failures += test_graph ();
+    ran += 1;
+  }
+  if (NULL == test || 0 == strcmp (test, "names")) {
+    failures += test_names ();
+    ran += 1;
+  }
+  if (NULL == test || 0 == strcmp (test, "messages")) {
+    failures += test_messages ();
+    ran += 1;
+  }
+  if (0 == ran) {
+    printf ("usage: TEST_WRAPPER [multirate|graph|names|messages]\n");
+    return 1;
+  }
+  printf ("%d failures\n", failures);
+  return failures;
+}